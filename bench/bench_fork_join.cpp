@@ -0,0 +1,306 @@
+#include "pone_bench.h"
+
+#include "pone_arena.h"
+#include "pone_atomic.h"
+#include "pone_memory.h"
+#include "pone_platform.h"
+#include "pone_thread_pool.h"
+#include "pone_work_queue.h"
+
+#include <stdio.h>
+
+// Runs 1k, 100k and 1M small jobs through the thread pool, whose threads
+// each own a work stealing deque, and through the pool it replaced, kept
+// here, where every thread pushes to and pops from the one shared MPMC
+// ring. Flat pushes every job from the calling thread, tree splits the
+// range in halves with one job per node, so the workers push most jobs.
+// Both pools get the same worker count. Prints the best time of the fork
+// and the join, and checks that every leaf ran once per run.
+
+// The thread pool before the deques: workers drain the shared ring and
+// park on work_semaphore, every push signals it.
+struct PoneBenchRingPool {
+    PoneWorkQueue work_queue;
+    PoneSemaphore work_semaphore;
+    volatile u32 pending_count;
+    volatile b8 is_running;
+    usize worker_count;
+    PonePlatformThread *threads;
+};
+
+static b8 pone_bench_ring_pool_try_consume_work(PoneBenchRingPool *pool) {
+    PoneWorkQueueData data;
+    if (!pone_work_queue_dequeue(&pool->work_queue, &data)) {
+        return 0;
+    }
+
+    (data.work)(data.user_data);
+
+    if (_pone_atomic_fetch_sub(&pool->pending_count, 1,
+                               PONE_MEMORY_ORDERING_ACQ_REL) == 1) {
+        pone_platform_wake_by_address_all(&pool->pending_count);
+    }
+
+    return 1;
+}
+
+static void pone_bench_ring_pool_worker_proc(void *param) {
+    PoneBenchRingPool *pool = (PoneBenchRingPool *)param;
+    while (_pone_atomic_load_n(&pool->is_running,
+                               PONE_MEMORY_ORDERING_ACQUIRE)) {
+        if (!pone_bench_ring_pool_try_consume_work(pool)) {
+            pone_semaphore_wait(&pool->work_semaphore);
+        }
+    }
+}
+
+static void pone_bench_ring_pool_init(PoneBenchRingPool *pool,
+                                      usize worker_count, Arena *arena) {
+    pone_work_queue_init(&pool->work_queue, arena);
+    pone_semaphore_init(&pool->work_semaphore, 0);
+    _pone_atomic_store_n(&pool->pending_count, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&pool->is_running, 1, PONE_MEMORY_ORDERING_RELEASE);
+    pool->worker_count = worker_count;
+    pool->threads = arena_alloc_array(arena, worker_count, PonePlatformThread);
+    for (usize i = 0; i < worker_count; ++i) {
+        pone_platform_create_thread(&pool->threads[i],
+                                    pone_bench_ring_pool_worker_proc, pool);
+    }
+}
+
+static void pone_bench_ring_pool_wait_all(PoneBenchRingPool *pool) {
+    for (;;) {
+        u32 pending_count = _pone_atomic_load_n(&pool->pending_count,
+                                                PONE_MEMORY_ORDERING_ACQUIRE);
+        if (pending_count == 0) {
+            break;
+        }
+
+        if (!pone_bench_ring_pool_try_consume_work(pool)) {
+            pone_platform_wait_on_address(&pool->pending_count,
+                                          pending_count);
+        }
+    }
+}
+
+static void pone_bench_ring_pool_destroy(PoneBenchRingPool *pool) {
+    pone_bench_ring_pool_wait_all(pool);
+
+    _pone_atomic_store_n(&pool->is_running, 0, PONE_MEMORY_ORDERING_RELEASE);
+    for (usize i = 0; i < pool->worker_count; ++i) {
+        pone_semaphore_signal(&pool->work_semaphore);
+    }
+    for (usize i = 0; i < pool->worker_count; ++i) {
+        pone_platform_join_thread(&pool->threads[i]);
+    }
+}
+
+static void pone_bench_ring_pool_push(PoneBenchRingPool *pool,
+                                      PoneWorkFn work, void *user_data) {
+    PoneWorkQueueData data = {
+        .work = work,
+        .user_data = user_data,
+    };
+
+    _pone_atomic_fetch_add(&pool->pending_count, 1,
+                           PONE_MEMORY_ORDERING_RELAXED);
+    // A full queue is drained by the producer itself instead of failing.
+    while (!pone_work_queue_enqueue(&pool->work_queue, &data)) {
+        pone_bench_ring_pool_try_consume_work(pool);
+    }
+    pone_semaphore_signal(&pool->work_semaphore);
+}
+
+enum PoneBenchPoolKind {
+    PONE_BENCH_POOL_KIND_RING,
+    PONE_BENCH_POOL_KIND_DEQUES,
+    PONE_BENCH_POOL_KIND_COUNT,
+};
+
+// A range of leaves, a tree node's children are 2 * index + 1 and + 2.
+struct PoneBenchForkJoinNode {
+    u32 begin;
+    u32 end;
+};
+
+struct PoneBenchForkJoinLeaf {
+    u32 run_count;
+    u32 value;
+};
+
+struct PoneBenchForkJoin {
+    PoneBenchPoolKind pool_kind;
+    PoneBenchRingPool *ring_pool;
+    PoneThreadPool *thread_pool;
+    PoneBenchForkJoinNode *nodes;
+    PoneBenchForkJoinLeaf *leaves;
+};
+
+static PoneBenchForkJoin pone_bench_fork_join;
+
+static void pone_bench_fork_join_push(PoneWorkFn work, void *user_data) {
+    if (pone_bench_fork_join.pool_kind == PONE_BENCH_POOL_KIND_RING) {
+        pone_bench_ring_pool_push(pone_bench_fork_join.ring_pool, work,
+                                  user_data);
+    } else {
+        pone_thread_pool_push(pone_bench_fork_join.thread_pool, work,
+                              user_data);
+    }
+}
+
+static void pone_bench_fork_join_wait_all(void) {
+    if (pone_bench_fork_join.pool_kind == PONE_BENCH_POOL_KIND_RING) {
+        pone_bench_ring_pool_wait_all(pone_bench_fork_join.ring_pool);
+    } else {
+        pone_thread_pool_wait_all(pone_bench_fork_join.thread_pool);
+    }
+}
+
+// A few dozen cycles of work, so the pool overhead dominates.
+static void pone_bench_fork_join_leaf(u32 index) {
+    PoneBenchRandom random = {.state = index + 1};
+    u32 x = 0;
+    for (u32 i = 0; i < 8; ++i) {
+        x += pone_bench_random(&random);
+    }
+    PoneBenchForkJoinLeaf *leaf = pone_bench_fork_join.leaves + index;
+    leaf->run_count += 1;
+    leaf->value = x;
+}
+
+static void pone_bench_fork_join_flat_work(void *user_data) {
+    pone_bench_fork_join_leaf((u32)(usize)user_data);
+}
+
+static void pone_bench_fork_join_tree_work(void *user_data) {
+    PoneBenchForkJoinNode *nodes = pone_bench_fork_join.nodes;
+    usize node_index = (usize)user_data;
+    PoneBenchForkJoinNode *node = nodes + node_index;
+    if (node->end - node->begin == 1) {
+        pone_bench_fork_join_leaf(node->begin);
+        return;
+    }
+
+    u32 middle = node->begin + (node->end - node->begin) / 2;
+    usize left_index = 2 * node_index + 1;
+    usize right_index = 2 * node_index + 2;
+    nodes[left_index] = {.begin = node->begin, .end = middle};
+    nodes[right_index] = {.begin = middle, .end = node->end};
+    pone_bench_fork_join_push(pone_bench_fork_join_tree_work,
+                              (void *)left_index);
+    pone_bench_fork_join_push(pone_bench_fork_join_tree_work,
+                              (void *)right_index);
+}
+
+static void pone_bench_fork_join_flat(u32 leaf_count) {
+    for (u32 leaf_index = 0; leaf_index < leaf_count; ++leaf_index) {
+        pone_bench_fork_join_push(pone_bench_fork_join_flat_work,
+                                  (void *)(usize)leaf_index);
+    }
+    pone_bench_fork_join_wait_all();
+}
+
+static void pone_bench_fork_join_tree(u32 leaf_count) {
+    pone_bench_fork_join.nodes[0] = {.begin = 0, .end = leaf_count};
+    pone_bench_fork_join_push(pone_bench_fork_join_tree_work, (void *)0);
+    pone_bench_fork_join_wait_all();
+}
+
+typedef void (*PoneBenchForkJoinFn)(u32 leaf_count);
+
+int main(void) {
+    pone_memory_init();
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)1), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+
+    u32 leaf_counts[] = {1000, 100000, 1000000};
+    u32 max_leaf_count = leaf_counts[pone_array_count(leaf_counts) - 1];
+    // The tree is ceil(log2(n)) levels deep, so its heap indices stay
+    // below 4 * n.
+    pone_bench_fork_join.nodes = arena_alloc_array(
+        &arena, 4 * (usize)max_leaf_count, PoneBenchForkJoinNode);
+    pone_bench_fork_join.leaves =
+        arena_alloc_array(&arena, max_leaf_count, PoneBenchForkJoinLeaf);
+
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    usize worker_count =
+        system_info.processor_count > 1 ? system_info.processor_count - 1 : 1;
+    PoneBenchRingPool ring_pool;
+    pone_bench_ring_pool_init(&ring_pool, worker_count, &arena);
+    PoneThreadPool thread_pool;
+    pone_thread_pool_init(&thread_pool, worker_count, &arena);
+    pone_bench_fork_join.ring_pool = &ring_pool;
+    pone_bench_fork_join.thread_pool = &thread_pool;
+
+    struct {
+        const char *name;
+        PoneBenchForkJoinFn fn;
+    } shapes[] = {
+        {"flat", pone_bench_fork_join_flat},
+        {"tree", pone_bench_fork_join_tree},
+    };
+    const char *pool_names[PONE_BENCH_POOL_KIND_COUNT] = {"ring", "deques"};
+
+    printf("Worker threads: %zu and the calling thread, best of 5 runs, 3 for "
+           "1M\n",
+           worker_count);
+    printf("  %-8s", "jobs");
+    for (usize shape_index = 0; shape_index < pone_array_count(shapes);
+         ++shape_index) {
+        for (u32 pool_kind = 0; pool_kind < PONE_BENCH_POOL_KIND_COUNT;
+             ++pool_kind) {
+            char column_name[32];
+            snprintf(column_name, sizeof(column_name), "%s, %s",
+                     shapes[shape_index].name, pool_names[pool_kind]);
+            printf("  %17s", column_name);
+        }
+    }
+    printf("\n");
+
+    for (usize count_index = 0; count_index < pone_array_count(leaf_counts);
+         ++count_index) {
+        u32 leaf_count = leaf_counts[count_index];
+        u32 run_count = leaf_count < 1000000 ? 5 : 3;
+        printf("  %-8u", leaf_count);
+        for (usize shape_index = 0; shape_index < pone_array_count(shapes);
+             ++shape_index) {
+            for (u32 pool_kind = 0; pool_kind < PONE_BENCH_POOL_KIND_COUNT;
+                 ++pool_kind) {
+                pone_bench_fork_join.pool_kind = (PoneBenchPoolKind)pool_kind;
+                pone_memset(pone_bench_fork_join.leaves, 0,
+                            leaf_count * sizeof(PoneBenchForkJoinLeaf));
+                f64 best_ms = 0.0;
+                for (u32 run = 0; run < run_count; ++run) {
+                    u64 t0 = pone_platform_get_time();
+                    shapes[shape_index].fn(leaf_count);
+                    f64 ms = pone_bench_ms(t0, pone_platform_get_time());
+                    if (run == 0 || ms < best_ms) {
+                        best_ms = ms;
+                    }
+                }
+                b8 is_correct = 1;
+                for (u32 i = 0; is_correct && i < leaf_count; ++i) {
+                    is_correct = pone_bench_fork_join.leaves[i].run_count ==
+                                 run_count;
+                }
+
+                if (is_correct) {
+                    printf("  %14.3f ms", best_ms);
+                } else {
+                    printf("  %17s", "wrong");
+                }
+            }
+        }
+        printf("\n");
+    }
+
+    pone_bench_ring_pool_destroy(&ring_pool);
+    pone_thread_pool_destroy(&thread_pool);
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+#include "pone_bench.h"
+
+#include "pone_arena.h"
+#include "pone_memory.h"
+#include "pone_platform.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+
+// The JSON and glTF parsers are built into this benchmark with their node
+// allocations routed through pone_bench_gltf_alloc, which counts the bytes
+// asked for and allocates either with an AllocationHeader, as the parsers
+// did before, or header-less, as they do now.
+#undef arena_alloc_array
+#undef arena_alloc_struct
+#undef arena_alloc_array_aligned
+#define arena_alloc_array(arena, count, type)                                  \
+    (type *)pone_bench_gltf_alloc(arena, (count) * sizeof(type),              \
+                                  alignof(type), 1)
+#define arena_alloc_struct(arena, type)                                        \
+    (type *)pone_bench_gltf_alloc(arena, sizeof(type), alignof(type), 0)
+#define arena_alloc_array_aligned(arena, count, type)                          \
+    (type *)pone_bench_gltf_alloc(arena, (count) * sizeof(type),              \
+                                  alignof(type), 0)
+
+static void *pone_bench_gltf_alloc(Arena *arena, usize size, usize align,
+                                   b8 keeps_header);
+
+#include "../src/pone_gltf.cpp"
+#include "../src/pone_json.cpp"
+
+// Parses the .glb given as the argument, or a generated one with
+// PONE_BENCH_GLTF_ACCESSOR_COUNT accessors and PONE_BENCH_GLTF_MESH_COUNT
+// meshes, once with every node allocation carrying a header and once
+// header-less. Prints the arena bytes used, how many of them went to
+// headers and alignment padding, and the best parse time of 20 runs.
+
+#define PONE_BENCH_GLTF_ACCESSOR_COUNT 5000
+#define PONE_BENCH_GLTF_MESH_COUNT 2000
+#define PONE_BENCH_GLTF_BUFFER_VIEW_COUNT 64
+#define PONE_BENCH_GLTF_BIN_SIZE KILOBYTES((usize)64)
+#define PONE_BENCH_GLTF_RUN_COUNT 20
+
+enum PoneBenchGltfAllocMode {
+    PONE_BENCH_GLTF_ALLOC_MODE_HEADER,
+    PONE_BENCH_GLTF_ALLOC_MODE_HEADERLESS,
+    PONE_BENCH_GLTF_ALLOC_MODE_COUNT,
+};
+
+static PoneBenchGltfAllocMode pone_bench_gltf_alloc_mode;
+static usize pone_bench_gltf_alloc_count;
+static usize pone_bench_gltf_requested_bytes;
+
+static void *pone_bench_gltf_alloc(Arena *arena, usize size, usize align,
+                                   b8 keeps_header) {
+    ++pone_bench_gltf_alloc_count;
+    pone_bench_gltf_requested_bytes += size;
+    if (keeps_header ||
+        pone_bench_gltf_alloc_mode == PONE_BENCH_GLTF_ALLOC_MODE_HEADER) {
+        return arena_alloc(arena, size);
+    }
+
+    return arena_alloc_aligned(arena, size, align);
+}
+
+struct PoneBenchText {
+    u8 *buf;
+    usize len;
+    usize capacity;
+};
+
+static void pone_bench_text_append(PoneBenchText *text, const char *fmt,
+                                   ...) {
+    va_list args;
+    va_start(args, fmt);
+    i32 len = vsnprintf((char *)text->buf + text->len,
+                        text->capacity - text->len, fmt, args);
+    va_end(args);
+    pone_assert(len >= 0 && text->len + len < text->capacity);
+    text->len += len;
+}
+
+static void pone_bench_glb_write_u32(u8 *p, u32 value) {
+    pone_memcpy(p, &value, sizeof(value));
+}
+
+// Accessors alternate between float VEC3 positions and u16 indices, each
+// with min, max and a name. Every mesh has one primitive with three
+// attributes, indices and a material.
+static u8 *pone_bench_gltf_generate(Arena *arena, usize *size) {
+    PoneBenchText json = {
+        .buf = (u8 *)arena_alloc(arena, MEGABYTES((usize)4)),
+        .len = 0,
+        .capacity = MEGABYTES((usize)4),
+    };
+    usize view_size =
+        PONE_BENCH_GLTF_BIN_SIZE / PONE_BENCH_GLTF_BUFFER_VIEW_COUNT;
+    pone_bench_text_append(&json,
+                           "{\"asset\":{\"version\":\"2.0\"},"
+                           "\"buffers\":[{\"byteLength\":%zu}],"
+                           "\"bufferViews\":[",
+                           (usize)PONE_BENCH_GLTF_BIN_SIZE);
+    for (u32 i = 0; i < PONE_BENCH_GLTF_BUFFER_VIEW_COUNT; ++i) {
+        pone_bench_text_append(&json,
+                               "%s{\"buffer\":0,\"byteOffset\":%zu,"
+                               "\"byteLength\":%zu,\"target\":34962}",
+                               i ? "," : "", i * view_size, view_size);
+    }
+    pone_bench_text_append(&json, "],\"accessors\":[");
+    for (u32 i = 0; i < PONE_BENCH_GLTF_ACCESSOR_COUNT; ++i) {
+        const char *separator = i ? "," : "";
+        u32 buffer_view = i % PONE_BENCH_GLTF_BUFFER_VIEW_COUNT;
+        if (i % 2 == 0) {
+            pone_bench_text_append(
+                &json,
+                "%s{\"bufferView\":%u,\"componentType\":5126,\"count\":24,"
+                "\"type\":\"VEC3\",\"max\":[1.0,1.0,1.0],"
+                "\"min\":[-1.0,-1.0,-1.0],\"name\":\"positions_%u\"}",
+                separator, buffer_view, i);
+        } else {
+            pone_bench_text_append(
+                &json,
+                "%s{\"bufferView\":%u,\"componentType\":5123,\"count\":36,"
+                "\"type\":\"SCALAR\",\"max\":[23],\"min\":[0],"
+                "\"name\":\"indices_%u\"}",
+                separator, buffer_view, i);
+        }
+    }
+    pone_bench_text_append(&json, "],\"meshes\":[");
+    for (u32 i = 0; i < PONE_BENCH_GLTF_MESH_COUNT; ++i) {
+        u32 accessor = (2 * i) % PONE_BENCH_GLTF_ACCESSOR_COUNT;
+        pone_bench_text_append(
+            &json,
+            "%s{\"primitives\":[{\"attributes\":{\"POSITION\":%u,"
+            "\"NORMAL\":%u,\"TEXCOORD_0\":%u},\"indices\":%u,"
+            "\"material\":0,\"mode\":4}],\"name\":\"mesh_%u\"}",
+            i ? "," : "", accessor, accessor, accessor, accessor + 1, i);
+    }
+    pone_bench_text_append(&json, "]}");
+    // Chunks are 4 byte aligned, the JSON one is padded with spaces.
+    while (json.len % 4) {
+        pone_bench_text_append(&json, " ");
+    }
+
+    usize glb_size = 12 + 8 + json.len + 8 + PONE_BENCH_GLTF_BIN_SIZE;
+    u8 *glb = (u8 *)arena_alloc(arena, glb_size);
+    pone_memcpy(glb, (void *)"glTF", 4);
+    pone_bench_glb_write_u32(glb + 4, 2);
+    pone_bench_glb_write_u32(glb + 8, (u32)glb_size);
+    u8 *chunk = glb + 12;
+    pone_bench_glb_write_u32(chunk, (u32)json.len);
+    pone_memcpy(chunk + 4, (void *)"JSON", 4);
+    pone_memcpy(chunk + 8, json.buf, json.len);
+    chunk += 8 + json.len;
+    pone_bench_glb_write_u32(chunk, PONE_BENCH_GLTF_BIN_SIZE);
+    pone_memcpy(chunk + 4, (void *)"BIN\0", 4);
+    pone_memset(chunk + 8, 0, PONE_BENCH_GLTF_BIN_SIZE);
+
+    *size = glb_size;
+    return glb;
+}
+
+int main(int argc, char **argv) {
+    pone_memory_init();
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)1), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+
+    u8 *glb;
+    usize glb_size;
+    if (argc > 1) {
+        PoneString path;
+        pone_string_from_cstr(argv[1], &path);
+        glb = (u8 *)pone_platform_map_file(&path, &glb_size, &arena);
+        if (!glb) {
+            printf("Could not open %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        glb = pone_bench_gltf_generate(&arena, &glb_size);
+    }
+
+    const char *mode_names[PONE_BENCH_GLTF_ALLOC_MODE_COUNT] = {
+        "with headers",
+        "header-less",
+    };
+    printf("%.1f KB glb, best of %d runs\n", (f64)glb_size / 1024.0,
+           PONE_BENCH_GLTF_RUN_COUNT);
+    printf("  %-14s %8s %12s %12s %18s %10s\n", "", "allocs", "requested",
+           "arena", "header+padding", "time");
+    for (u32 mode = 0; mode < PONE_BENCH_GLTF_ALLOC_MODE_COUNT; ++mode) {
+        pone_bench_gltf_alloc_mode = (PoneBenchGltfAllocMode)mode;
+        f64 best_ms = 0.0;
+        usize arena_bytes = 0;
+        for (u32 run = 0; run < PONE_BENCH_GLTF_RUN_COUNT; ++run) {
+            PoneArenaTmp tmp = pone_arena_tmp_begin(&arena);
+            pone_bench_gltf_alloc_count = 0;
+            pone_bench_gltf_requested_bytes = 0;
+            u64 t0 = pone_platform_get_time();
+            pone_gltf_parse(glb, &arena);
+            f64 ms = pone_bench_ms(t0, pone_platform_get_time());
+            arena_bytes = arena.offset - tmp.offset;
+            pone_arena_tmp_end(tmp);
+            if (run == 0 || ms < best_ms) {
+                best_ms = ms;
+            }
+        }
+
+        usize overhead_bytes = arena_bytes - pone_bench_gltf_requested_bytes;
+        printf("  %-14s %8zu %9.3f MB %9.3f MB %9.3f MB (%2.0f%%) %7.3f ms\n",
+               mode_names[mode], pone_bench_gltf_alloc_count,
+               (f64)pone_bench_gltf_requested_bytes / 1048576.0,
+               (f64)arena_bytes / 1048576.0,
+               (f64)overhead_bytes / 1048576.0,
+               100.0 * (f64)overhead_bytes / (f64)arena_bytes, best_ms);
+    }
+
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "pone_bench.h"
+
+#include "pone_atomic.h"
+#include "pone_memory.h"
+#include "pone_platform.h"
+
+#include <pthread.h>
+#include <stdio.h>
+
+// Locks and unlocks the futex backed mutex and rw lock and their pthread
+// counterparts from 1, 2, 4 and 8 threads, around a critical section that
+// reads or increments one counter. The threads start together on an event
+// and share a fixed number of operations, the time runs from the event to
+// the last join. Prints the best ns per lock/unlock pair of 3 runs, with 1
+// thread that is the uncontended latency.
+
+#define PONE_BENCH_LOCK_OP_COUNT 4000000
+#define PONE_BENCH_LOCK_RUN_COUNT 3
+#define PONE_BENCH_LOCK_MAX_THREAD_COUNT 8
+
+enum PoneBenchLockImpl {
+    PONE_BENCH_LOCK_IMPL_PONE,
+    PONE_BENCH_LOCK_IMPL_PTHREAD,
+    PONE_BENCH_LOCK_IMPL_COUNT,
+};
+
+enum PoneBenchLockKind {
+    PONE_BENCH_LOCK_KIND_MUTEX,
+    PONE_BENCH_LOCK_KIND_RW_LOCK,
+};
+
+struct PoneBenchLockCase {
+    const char *name;
+    PoneBenchLockKind kind;
+    // Every write_period-th rw lock operation is a write, 0 for none.
+    u32 write_period;
+};
+
+struct PoneBenchLockShared {
+    PoneBenchLockCase *lock_case;
+    PoneBenchLockImpl impl;
+    usize thread_op_count;
+    PoneEvent start;
+    PoneMutex mutex;
+    PoneRwLock rw_lock;
+    pthread_mutex_t pthread_mutex;
+    pthread_rwlock_t pthread_rw_lock;
+    volatile u64 counter;
+};
+
+static void pone_bench_lock_thread(void *param) {
+    PoneBenchLockShared *shared = (PoneBenchLockShared *)param;
+    PoneBenchLockCase *lock_case = shared->lock_case;
+    b8 is_pone = shared->impl == PONE_BENCH_LOCK_IMPL_PONE;
+    pone_event_wait(&shared->start);
+
+    for (usize op = 0; op < shared->thread_op_count; ++op) {
+        if (lock_case->kind == PONE_BENCH_LOCK_KIND_MUTEX) {
+            if (is_pone) {
+                pone_mutex_lock(&shared->mutex);
+                shared->counter = shared->counter + 1;
+                pone_mutex_unlock(&shared->mutex);
+            } else {
+                pthread_mutex_lock(&shared->pthread_mutex);
+                shared->counter = shared->counter + 1;
+                pthread_mutex_unlock(&shared->pthread_mutex);
+            }
+        } else if (lock_case->write_period &&
+                   op % lock_case->write_period == 0) {
+            if (is_pone) {
+                pone_rw_lock_write_lock(&shared->rw_lock);
+                shared->counter = shared->counter + 1;
+                pone_rw_lock_write_unlock(&shared->rw_lock);
+            } else {
+                pthread_rwlock_wrlock(&shared->pthread_rw_lock);
+                shared->counter = shared->counter + 1;
+                pthread_rwlock_unlock(&shared->pthread_rw_lock);
+            }
+        } else {
+            if (is_pone) {
+                pone_rw_lock_read_lock(&shared->rw_lock);
+                (void)shared->counter;
+                pone_rw_lock_read_unlock(&shared->rw_lock);
+            } else {
+                pthread_rwlock_rdlock(&shared->pthread_rw_lock);
+                (void)shared->counter;
+                pthread_rwlock_unlock(&shared->pthread_rw_lock);
+            }
+        }
+    }
+}
+
+// Best ns per lock/unlock pair, 0 when the counter does not add up.
+static f64 pone_bench_lock_run(PoneBenchLockCase *lock_case,
+                               PoneBenchLockImpl impl, u32 thread_count,
+                               PonePlatformThread *threads) {
+    usize thread_op_count = PONE_BENCH_LOCK_OP_COUNT / thread_count;
+    usize thread_write_count = thread_op_count;
+    if (lock_case->kind == PONE_BENCH_LOCK_KIND_RW_LOCK) {
+        thread_write_count =
+            lock_case->write_period
+                ? (thread_op_count + lock_case->write_period - 1) /
+                      lock_case->write_period
+                : 0;
+    }
+
+    f64 best_ns = 0.0;
+    for (u32 run = 0; run < PONE_BENCH_LOCK_RUN_COUNT; ++run) {
+        PoneBenchLockShared shared = {
+            .lock_case = lock_case,
+            .impl = impl,
+            .thread_op_count = thread_op_count,
+            .counter = 0,
+        };
+        pone_event_init(&shared.start, 0);
+        pone_mutex_init(&shared.mutex);
+        pone_rw_lock_init(&shared.rw_lock);
+        pthread_mutex_init(&shared.pthread_mutex, 0);
+        pthread_rwlock_init(&shared.pthread_rw_lock, 0);
+        for (u32 thread_index = 0; thread_index < thread_count;
+             ++thread_index) {
+            pone_platform_create_thread(threads + thread_index,
+                                        pone_bench_lock_thread, &shared);
+        }
+
+        u64 t0 = pone_platform_get_time();
+        pone_event_set(&shared.start);
+        for (u32 thread_index = 0; thread_index < thread_count;
+             ++thread_index) {
+            pone_platform_join_thread(threads + thread_index);
+        }
+        f64 ns = (f64)(pone_platform_get_time() - t0) /
+                 (f64)(thread_op_count * thread_count);
+        pthread_mutex_destroy(&shared.pthread_mutex);
+        pthread_rwlock_destroy(&shared.pthread_rw_lock);
+
+        if (shared.counter != (u64)thread_write_count * thread_count) {
+            return 0.0;
+        }
+        if (run == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+
+    return best_ns;
+}
+
+int main(void) {
+    PoneBenchLockCase lock_cases[] = {
+        {"mutex", PONE_BENCH_LOCK_KIND_MUTEX, 0},
+        {"rw lock, writes", PONE_BENCH_LOCK_KIND_RW_LOCK, 1},
+        {"rw lock, reads", PONE_BENCH_LOCK_KIND_RW_LOCK, 0},
+        {"rw lock, 1 in 8 writes", PONE_BENCH_LOCK_KIND_RW_LOCK, 8},
+    };
+    const char *impl_names[PONE_BENCH_LOCK_IMPL_COUNT] = {"pone", "pthread"};
+    u32 thread_counts[] = {1, 2, 4, 8};
+    PonePlatformThread threads[PONE_BENCH_LOCK_MAX_THREAD_COUNT];
+
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    printf("%u processors, ns per lock/unlock, best of %d runs\n",
+           system_info.processor_count, PONE_BENCH_LOCK_RUN_COUNT);
+    printf("  %-22s %-8s", "", "");
+    for (usize count_index = 0; count_index < pone_array_count(thread_counts);
+         ++count_index) {
+        printf(" %6u thr", thread_counts[count_index]);
+    }
+    printf("\n");
+
+    for (usize case_index = 0; case_index < pone_array_count(lock_cases);
+         ++case_index) {
+        for (u32 impl = 0; impl < PONE_BENCH_LOCK_IMPL_COUNT; ++impl) {
+            printf("  %-22s %-8s", impl == 0 ? lock_cases[case_index].name : "",
+                   impl_names[impl]);
+            for (usize count_index = 0;
+                 count_index < pone_array_count(thread_counts);
+                 ++count_index) {
+                f64 ns = pone_bench_lock_run(
+                    lock_cases + case_index, (PoneBenchLockImpl)impl,
+                    thread_counts[count_index], threads);
+                if (ns > 0.0) {
+                    printf(" %10.1f", ns);
+                } else {
+                    printf(" %10s", "wrong");
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
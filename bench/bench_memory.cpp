@@ -0,0 +1,122 @@
+#include "pone_bench.h"
+
+#include "pone_arena.h"
+#include "pone_math.h"
+#include "pone_memory.h"
+#include "pone_platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Copies and fills blocks from 16 B to 64 MB with pone_memcpy and
+// pone_memset against the C library, once with aligned pointers and once
+// with the destination 1 byte and the source 3 bytes past a cache line.
+// Prints the best throughput of 3 runs, each moving at least
+// PONE_BENCH_MEMORY_RUN_BYTES.
+
+#define PONE_BENCH_MEMORY_MIN_SIZE 16
+#define PONE_BENCH_MEMORY_MAX_SIZE MEGABYTES((usize)64)
+#define PONE_BENCH_MEMORY_RUN_BYTES MEGABYTES((usize)256)
+#define PONE_BENCH_MEMORY_RUN_COUNT 3
+
+// Called through pointers, so the compiler can neither inline the C library
+// nor drop the repeated calls.
+static void *(*volatile pone_bench_libc_memcpy)(void *dst, const void *src,
+                                                size_t len) = memcpy;
+static void *(*volatile pone_bench_libc_memset)(void *p, int c,
+                                                size_t n) = memset;
+
+enum PoneBenchMemoryOp {
+    PONE_BENCH_MEMORY_OP_PONE_MEMCPY,
+    PONE_BENCH_MEMORY_OP_LIBC_MEMCPY,
+    PONE_BENCH_MEMORY_OP_PONE_MEMSET,
+    PONE_BENCH_MEMORY_OP_LIBC_MEMSET,
+    PONE_BENCH_MEMORY_OP_COUNT,
+};
+
+// Best throughput in GB/s.
+static f64 pone_bench_memory_run(PoneBenchMemoryOp op, u8 *dst, u8 *src,
+                                 usize size) {
+    usize call_count = PONE_MAX(PONE_BENCH_MEMORY_RUN_BYTES / size, (usize)4);
+    f64 best_ns = 0.0;
+    for (u32 run = 0; run < PONE_BENCH_MEMORY_RUN_COUNT; ++run) {
+        u64 t0 = pone_platform_get_time();
+        for (usize call = 0; call < call_count; ++call) {
+            switch (op) {
+            case PONE_BENCH_MEMORY_OP_PONE_MEMCPY:
+                pone_memcpy(dst, src, size);
+                break;
+            case PONE_BENCH_MEMORY_OP_LIBC_MEMCPY:
+                pone_bench_libc_memcpy(dst, src, size);
+                break;
+            case PONE_BENCH_MEMORY_OP_PONE_MEMSET:
+                pone_memset(dst, (u8)call, size);
+                break;
+            case PONE_BENCH_MEMORY_OP_LIBC_MEMSET:
+                pone_bench_libc_memset(dst, (u8)call, size);
+                break;
+            default:
+                break;
+            }
+        }
+        f64 ns = (f64)(pone_platform_get_time() - t0);
+        if (run == 0 || ns < best_ns) {
+            best_ns = ns;
+        }
+    }
+
+    return (f64)(call_count * size) / best_ns;
+}
+
+int main(void) {
+    pone_memory_init();
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)1), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+    usize buf_size = PONE_BENCH_MEMORY_MAX_SIZE + 64;
+    u8 *dst_buf = (u8 *)arena_alloc_aligned(&arena, buf_size, 64);
+    u8 *src_buf = (u8 *)arena_alloc_aligned(&arena, buf_size, 64);
+    // Touches every page, so no run pays for faulting them in.
+    pone_bench_libc_memset(dst_buf, 0, buf_size);
+    for (usize i = 0; i < buf_size; ++i) {
+        src_buf[i] = (u8)(i * 31);
+    }
+
+    struct {
+        const char *name;
+        usize dst_offset;
+        usize src_offset;
+    } alignments[] = {
+        {"aligned", 0, 0},
+        {"dst + 1, src + 3", 1, 3},
+    };
+    for (usize alignment_index = 0;
+         alignment_index < pone_array_count(alignments); ++alignment_index) {
+        u8 *dst = dst_buf + alignments[alignment_index].dst_offset;
+        u8 *src = src_buf + alignments[alignment_index].src_offset;
+        printf("%s, GB/s\n", alignments[alignment_index].name);
+        printf("  %9s  %11s %11s  %11s %11s\n", "size", "pone_memcpy",
+               "memcpy", "pone_memset", "memset");
+        for (usize size = PONE_BENCH_MEMORY_MIN_SIZE;
+             size <= PONE_BENCH_MEMORY_MAX_SIZE; size *= 2) {
+            if (size >= MEGABYTES((usize)1)) {
+                printf("  %6zu MB", size >> 20);
+            } else if (size >= KILOBYTES((usize)1)) {
+                printf("  %6zu KB", size >> 10);
+            } else {
+                printf("  %6zu B ", size);
+            }
+            for (u32 op = 0; op < PONE_BENCH_MEMORY_OP_COUNT; ++op) {
+                f64 gb_per_s = pone_bench_memory_run((PoneBenchMemoryOp)op,
+                                                     dst, src, size);
+                printf("%s%11.2f", op % 2 ? " " : "  ", gb_per_s);
+            }
+            printf("\n");
+        }
+    }
+
+    return 0;
+}
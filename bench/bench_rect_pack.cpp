@@ -0,0 +1,135 @@
+#include "pone_bench.h"
+
+#include "pone_arena.h"
+#include "pone_memory.h"
+#include "pone_platform.h"
+#include "pone_rect_pack.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Packs the same rects with the guillotine packer and its binary search over
+// the bin side, skyline and MaxRects, and prints the best time and how much
+// of the final square bin the rects cover. The optional argument caps the
+// item count, the guillotine packer and MaxRects take tens of seconds at
+// 100k.
+
+typedef b8 (*PoneBenchRectPackFn)(PoneRectPackItem *items, usize item_count,
+                                  u32 max_bin_side, Arena *arena, u32 *side);
+
+struct PoneBenchRectPacker {
+    const char *name;
+    PoneBenchRectPackFn pack;
+};
+
+struct PoneBenchRectDistribution {
+    const char *name;
+    u32 min_width;
+    u32 max_width;
+    u32 min_height;
+    u32 max_height;
+};
+
+#define PONE_BENCH_RECT_PACK_MAX_SIDE 16384
+
+int main(int argc, char **argv) {
+    usize max_item_count = argc > 1 ? (usize)atoll(argv[1]) : 100000;
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)4), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+
+    PoneBenchRectPacker packers[] = {
+        {"guillotine+search", pone_rect_pack},
+        {"skyline", pone_rect_pack_skyline},
+        {"maxrects", pone_rect_pack_max_rects},
+    };
+    PoneBenchRectDistribution distributions[] = {
+        {"random 8..64 px", 8, 64, 8, 64},
+        {"glyph like 20..39 x 30..59 px", 20, 39, 30, 59},
+    };
+    usize item_counts[] = {100, 1000, 10000, 100000};
+
+    for (usize distribution_index = 0;
+         distribution_index < pone_array_count(distributions);
+         ++distribution_index) {
+        PoneBenchRectDistribution *distribution =
+            distributions + distribution_index;
+        printf("%s, time (occupancy)\n", distribution->name);
+        printf("  %-7s", "n");
+        for (usize packer_index = 0; packer_index < pone_array_count(packers);
+             ++packer_index) {
+            printf("  %-21s", packers[packer_index].name);
+        }
+        printf("\n");
+        for (usize count_index = 0; count_index < pone_array_count(item_counts);
+             ++count_index) {
+            usize item_count = item_counts[count_index];
+            if (item_count > max_item_count) {
+                break;
+            }
+
+            PoneRectPackItem *src_items =
+                arena_alloc_array(&arena, item_count, PoneRectPackItem);
+            PoneRectPackItem *items =
+                arena_alloc_array(&arena, item_count, PoneRectPackItem);
+            PoneBenchRandom random = {.state = 7};
+            u64 item_area = 0;
+            for (usize item_index = 0; item_index < item_count; ++item_index) {
+                u32 width = pone_bench_random_range(
+                    &random, distribution->min_width, distribution->max_width);
+                u32 height =
+                    pone_bench_random_range(&random, distribution->min_height,
+                                            distribution->max_height);
+                src_items[item_index] = {
+                    .rect = {.x_min = 0, .y_min = 0, .x_max = width,
+                             .y_max = height},
+                };
+                item_area += (u64)width * height;
+            }
+
+            printf("  %-7zu", item_count);
+            // The large cases run for seconds, one run is enough there.
+            u32 run_count = item_count <= 10000 ? 3 : 1;
+            for (usize packer_index = 0;
+                 packer_index < pone_array_count(packers); ++packer_index) {
+                f64 best_ms = 0.0;
+                u32 side = 0;
+                b8 packed = 0;
+                for (u32 run = 0; run < run_count; ++run) {
+                    pone_memcpy(items, src_items,
+                                item_count * sizeof(PoneRectPackItem));
+                    u64 t0 = pone_platform_get_time();
+                    packed = packers[packer_index].pack(
+                        items, item_count, PONE_BENCH_RECT_PACK_MAX_SIDE,
+                        &arena, &side);
+                    f64 ms = pone_bench_ms(t0, pone_platform_get_time());
+                    if (!packed) {
+                        break;
+                    }
+                    if (run == 0 || ms < best_ms) {
+                        best_ms = ms;
+                    }
+                }
+                for (usize item_index = 0; packed && item_index < item_count;
+                     ++item_index) {
+                    PoneRectU32 *rect = &items[item_index].rect;
+                    packed = rect->x_max <= side && rect->y_max <= side;
+                }
+
+                if (packed) {
+                    printf("  %10.3f ms (%4.1f%%)", best_ms,
+                           100.0 * (f64)item_area / ((f64)side * side));
+                } else {
+                    printf("  %-21s", "failed");
+                }
+            }
+            printf("\n");
+            arena_clear(&arena);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,231 @@
+#include "pone_bench.h"
+
+// The SDF passes are internal to the TrueType module, so it is built into
+// this benchmark instead of linked.
+#include "../src/pone_truetype.cpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// Renders every glyph of the font given as the argument as a single channel
+// SDF twice with the scalar kernel: signed by the scanline winding fill, and
+// by the per pixel sign tracking it replaced, which is kept here. Prints the
+// best total time of each and how many glyphs come out differently.
+
+// The span kernel before the winding fill: every pixel of the edge's padded
+// bbox gets the nearest distance and the side of the edge it is on, a side
+// flip between neighbours inside the edge's y band changes the winding delta
+// of the right one.
+static void pone_bench_sign_tracking_span(PoneSdfEdgeBuffer *edges,
+                                          usize edge_index,
+                                          PoneRectU32 *pixels, usize width,
+                                          f32 *d_mins, i8 *delta_windings) {
+    PoneTrueTypeEdgeSegment edge;
+    PoneRectF32 edge_bbox;
+    pone_sdf_edge_buffer_get(edges, edge_index, &edge, &edge_bbox);
+    for (u32 y = pixels->y_min; y < pixels->y_max; ++y) {
+        f32 *d_mins_row = d_mins + (y * width);
+        i8 *delta_windings_row = delta_windings + (y * width);
+        i8 prev_side = 0;
+        for (u32 x = pixels->x_min; x < pixels->x_max; ++x) {
+            Vec2 p_px = {.x = x + 0.5f, .y = y + 0.5f};
+            f32 *d_min = d_mins_row + x;
+            i8 *delta_winding = delta_windings_row + x;
+            f32 t;
+            f32 d = pone_truetype_edge_segment_find_distance(&edge, p_px, &t);
+            b8 side = pone_truetype_edge_segment_calculate_side(&edge, p_px, t);
+            if (pone_truetype_between_closed_open(p_px, &edge_bbox)) {
+                if (prev_side == -1 && !side) {
+                    *delta_winding += 1;
+                } else if (prev_side == 1 && side) {
+                    *delta_winding += -1;
+                }
+            }
+            prev_side = side ? -1 : 1;
+            if (pone_abs(d) < pone_abs(*d_min)) {
+                *d_min = d;
+            }
+        }
+    }
+}
+
+// pone_truetype_outline_generate_sdf for the single channel formats, with
+// the sign tracking span instead of the distance span and the winding fill.
+static void pone_bench_generate_sdf_sign_tracking(
+    PoneTrueTypeOutline *outline, PoneRectF32 *sdf_bbox, u32 width,
+    u32 height, PoneTrueTypeSdfAtlasFormat format, f32 pixels_per_funit,
+    u32 d_pad, u32 d_max, u8 *sdf_buf) {
+    PoneArenaTmp scratch = pone_scratch_begin(0, 0);
+    f32 *d_mins = arena_alloc_array(scratch.arena, width * height, f32);
+    for (usize i = 0; i < (usize)width * height; ++i) {
+        d_mins[i] = -(f32)(d_pad * d_pad);
+    }
+    i8 *delta_windings = arena_alloc_array(scratch.arena, width * height, i8);
+    pone_memset(delta_windings, 0, width * height * sizeof(i8));
+    PoneRectF32 range_b = {
+        .p_min = {.x = 0.0f, .y = 0.0f},
+        .p_max = {.x = (f32)width, .y = (f32)height},
+    };
+    PoneSdfData sdf_data = {
+        .width = width,
+        .height = height,
+        .format = format,
+        .sdf_buf = sdf_buf,
+        .d_mins = d_mins,
+        .delta_windings = delta_windings,
+        .msdf_distances = 0,
+        .d_pad = d_pad,
+        .d_max = d_max,
+    };
+    PoneSfntGlyphPointRangeMap range_map = {
+        .scale = pixels_per_funit,
+        .range_a = sdf_bbox,
+        .range_b = &range_b,
+        .invert_y = 1,
+    };
+
+    PoneSdfEdgeBuffer edges;
+    pone_sdf_edge_buffer_init(&edges, outline, &range_map, scratch.arena);
+    f32 x_slack = width * PONE_EPSILON;
+    f32 y_slack = height * PONE_EPSILON;
+    for (usize edge_index = 0; edge_index < edges.count; ++edge_index) {
+        PoneRectU32 pixels = {
+            .x_min = (u32)pone_floor(edges.x_mins[edge_index] - d_pad),
+            .y_min = (u32)pone_floor(edges.y_mins[edge_index] - d_pad),
+            .x_max = (u32)pone_ceil((edges.x_maxs[edge_index] + d_pad) -
+                                    x_slack),
+            .y_max = (u32)pone_ceil((edges.y_maxs[edge_index] + d_pad) -
+                                    y_slack),
+        };
+        pone_bench_sign_tracking_span(&edges, edge_index, &pixels, width,
+                                      d_mins, delta_windings);
+    }
+    pone_sdf_data_resolve_sign(&sdf_data);
+    pone_sdf_data_encode(&sdf_data);
+    pone_scratch_end(scratch);
+}
+
+struct PoneBenchSignConfig {
+    u32 resolution;
+    u32 d_pad;
+};
+
+struct PoneBenchSignGlyph {
+    PoneTrueTypeOutline outline;
+    PoneRectF32 sdf_bbox;
+    u32 width;
+    u32 height;
+    u8 *winding_fill_buf;
+};
+
+#define PONE_BENCH_SIGN_RUN_COUNT 5
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s font.ttf\n", argv[0]);
+        return 1;
+    }
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)4), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+    PoneString font_path;
+    pone_string_from_cstr(argv[1], &font_path);
+    PoneTruetypeInput input;
+    input.data = pone_platform_map_file(&font_path, &input.length, &arena);
+    if (!input.data) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+    PoneTrueTypeFont *font = pone_truetype_parse(input, &arena);
+    if (!font) {
+        printf("Could not parse %s\n", argv[1]);
+        return 1;
+    }
+
+    PoneBenchSignConfig configs[] = {{32, 4}, {48, 8}, {64, 8}};
+    PoneTrueTypeSdfAtlasFormat format =
+        PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM;
+    usize glyph_count = font->glyph_count;
+    PoneBenchSignGlyph *glyphs =
+        arena_alloc_array(&arena, glyph_count, PoneBenchSignGlyph);
+    for (usize glyph_id = 0; glyph_id < glyph_count; ++glyph_id) {
+        pone_truetype_outline_flatten(font,
+                                      pone_truetype_font_glyph(font, glyph_id),
+                                      &glyphs[glyph_id].outline, &arena);
+    }
+
+    printf("%zu glyphs, scalar kernel, best of %d runs\n", glyph_count,
+           PONE_BENCH_SIGN_RUN_COUNT);
+    for (usize config_index = 0; config_index < pone_array_count(configs);
+         ++config_index) {
+        PoneBenchSignConfig *config = configs + config_index;
+        PoneArenaTmp config_tmp = pone_arena_tmp_begin(&arena);
+        f32 pixels_per_funit = (f32)(config->resolution - 2 * config->d_pad) /
+                               (f32)font->units_per_em;
+        usize max_buf_size = 0;
+        for (usize glyph_id = 0; glyph_id < glyph_count; ++glyph_id) {
+            PoneBenchSignGlyph *glyph = glyphs + glyph_id;
+            PoneRectF32 glyph_bbox;
+            pone_truetype_outline_sdf_bbox(&glyph->outline, pixels_per_funit,
+                                           config->d_pad, &glyph_bbox,
+                                           &glyph->sdf_bbox, &glyph->width,
+                                           &glyph->height);
+            usize buf_size = (usize)glyph->width * glyph->height;
+            glyph->winding_fill_buf = (u8 *)arena_alloc(&arena, buf_size);
+            max_buf_size = PONE_MAX(max_buf_size, buf_size);
+        }
+        u8 *sign_tracking_buf = (u8 *)arena_alloc(&arena, max_buf_size);
+
+        f64 winding_fill_ms = 0.0;
+        f64 sign_tracking_ms = 0.0;
+        for (u32 run = 0; run < PONE_BENCH_SIGN_RUN_COUNT; ++run) {
+            u64 t0 = pone_platform_get_time();
+            for (usize glyph_id = 0; glyph_id < glyph_count; ++glyph_id) {
+                PoneBenchSignGlyph *glyph = glyphs + glyph_id;
+                pone_truetype_outline_generate_sdf(
+                    &glyph->outline, &glyph->sdf_bbox, glyph->width,
+                    glyph->height, format, pixels_per_funit, config->d_pad,
+                    config->d_pad,
+                    pone_truetype_edge_segment_distance_span_scalar,
+                    glyph->winding_fill_buf);
+            }
+            f64 ms = pone_bench_ms(t0, pone_platform_get_time());
+            if (run == 0 || ms < winding_fill_ms) {
+                winding_fill_ms = ms;
+            }
+        }
+        usize mismatch_count = 0;
+        for (u32 run = 0; run < PONE_BENCH_SIGN_RUN_COUNT; ++run) {
+            f64 ms = 0.0;
+            for (usize glyph_id = 0; glyph_id < glyph_count; ++glyph_id) {
+                PoneBenchSignGlyph *glyph = glyphs + glyph_id;
+                u64 t0 = pone_platform_get_time();
+                pone_bench_generate_sdf_sign_tracking(
+                    &glyph->outline, &glyph->sdf_bbox, glyph->width,
+                    glyph->height, format, pixels_per_funit, config->d_pad,
+                    config->d_pad, sign_tracking_buf);
+                ms += pone_bench_ms(t0, pone_platform_get_time());
+                if (run == 0 &&
+                    memcmp(sign_tracking_buf, glyph->winding_fill_buf,
+                           (usize)glyph->width * glyph->height)) {
+                    ++mismatch_count;
+                }
+            }
+            if (run == 0 || ms < sign_tracking_ms) {
+                sign_tracking_ms = ms;
+            }
+        }
+
+        printf("%3u px, %2u px range: sign tracking %9.3f ms, winding fill "
+               "%9.3f ms (%.2fx), %zu glyphs differ\n",
+               config->resolution, config->d_pad, sign_tracking_ms,
+               winding_fill_ms, sign_tracking_ms / winding_fill_ms,
+               mismatch_count);
+        pone_arena_tmp_end(config_tmp);
+    }
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include "pone_bench.h"
+
+// The distance span kernels are internal to the TrueType module, so it is
+// built into this benchmark instead of linked.
+#include "../src/pone_truetype.cpp"
+
+#include <stdio.h>
+#include <string.h>
+
+// Renders every glyph of the SDF atlas charset of the font given as the
+// argument with each distance span kernel the CPU runs, and prints the mean
+// and slowest time per glyph. Every kernel's texels are checked against the
+// scalar ones, the approximations may round a texel of a glyph to the next
+// step. Only 8 bit formats are measured, so texels are compared byte wise.
+
+struct PoneBenchSdfKernel {
+    const char *name;
+    PoneSdfSpanFn distance_span;
+    u32 cpu_feature;
+};
+
+struct PoneBenchSdfConfig {
+    const char *name;
+    PoneTrueTypeSdfAtlasFormat format;
+    u32 resolution;
+    u32 d_pad;
+};
+
+struct PoneBenchSdfGlyph {
+    PoneTrueTypeOutline outline;
+    PoneRectF32 sdf_bbox;
+    u32 width;
+    u32 height;
+    u8 *scalar_buf;
+};
+
+#define PONE_BENCH_SDF_RUN_COUNT 5
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s font.ttf\n", argv[0]);
+        return 1;
+    }
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)1), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+    PoneString font_path;
+    pone_string_from_cstr(argv[1], &font_path);
+    PoneTruetypeInput input;
+    input.data = pone_platform_map_file(&font_path, &input.length, &arena);
+    if (!input.data) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+    PoneTrueTypeFont *font = pone_truetype_parse(input, &arena);
+    if (!font) {
+        printf("Could not parse %s\n", argv[1]);
+        return 1;
+    }
+
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    PoneBenchSdfKernel kernels[] = {
+        {"scalar", pone_truetype_edge_segment_distance_span_scalar, 0},
+#if defined(PONE_TRUETYPE_X64)
+        {"sse4.1", pone_truetype_edge_segment_distance_span_sse4_1,
+         PONE_PLATFORM_CPU_FEATURE_SSE4_1},
+        {"avx2", pone_truetype_edge_segment_distance_span_avx2,
+         PONE_PLATFORM_CPU_FEATURE_AVX2},
+#endif
+    };
+    PoneBenchSdfConfig configs[] = {
+        {"SDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM, 32, 4},
+        {"SDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM, 64, 8},
+        {"MSDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM, 32, 4},
+        {"MSDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM, 64, 8},
+        {"MSDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM, 128, 16},
+    };
+
+    usize glyph_count;
+    u32 *char_codes = pone_truetype_sdf_atlas_char_codes(&arena, &glyph_count);
+    u32 *glyph_ids = arena_alloc_array(&arena, glyph_count, u32);
+    pone_truetype_font_glyph_indices(font, char_codes, glyph_count, glyph_ids);
+    PoneBenchSdfGlyph *glyphs =
+        arena_alloc_array(&arena, glyph_count, PoneBenchSdfGlyph);
+    for (usize glyph_index = 0; glyph_index < glyph_count; ++glyph_index) {
+        pone_truetype_outline_flatten(
+            font, pone_truetype_font_glyph(font, glyph_ids[glyph_index]),
+            &glyphs[glyph_index].outline, &arena);
+    }
+
+    printf("%zu glyphs, best of %d runs each\n", glyph_count,
+           PONE_BENCH_SDF_RUN_COUNT);
+    for (usize config_index = 0; config_index < pone_array_count(configs);
+         ++config_index) {
+        PoneBenchSdfConfig *config = configs + config_index;
+        PoneArenaTmp config_tmp = pone_arena_tmp_begin(&arena);
+        f32 pixels_per_funit = (f32)(config->resolution - 2 * config->d_pad) /
+                               (f32)font->units_per_em;
+        usize pixel_size = pone_truetype_sdf_atlas_format_size(config->format);
+        usize max_buf_size = 0;
+        for (usize glyph_index = 0; glyph_index < glyph_count; ++glyph_index) {
+            PoneBenchSdfGlyph *glyph = glyphs + glyph_index;
+            PoneRectF32 glyph_bbox;
+            pone_truetype_outline_sdf_bbox(&glyph->outline, pixels_per_funit,
+                                           config->d_pad, &glyph_bbox,
+                                           &glyph->sdf_bbox, &glyph->width,
+                                           &glyph->height);
+            usize buf_size = (usize)glyph->width * glyph->height * pixel_size;
+            glyph->scalar_buf = (u8 *)arena_alloc(&arena, buf_size);
+            max_buf_size = PONE_MAX(max_buf_size, buf_size);
+        }
+        u8 *sdf_buf = (u8 *)arena_alloc(&arena, max_buf_size);
+
+        printf("%-4s %3u px", config->name, config->resolution);
+        f64 scalar_mean_us = 0.0;
+        for (usize kernel_index = 0; kernel_index < pone_array_count(kernels);
+             ++kernel_index) {
+            PoneBenchSdfKernel *kernel = kernels + kernel_index;
+            if ((system_info.cpu_features & kernel->cpu_feature) !=
+                kernel->cpu_feature) {
+                continue;
+            }
+
+            f64 total_us = 0.0;
+            f64 max_us = 0.0;
+            usize mismatch_count = 0;
+            u32 max_difference = 0;
+            for (usize glyph_index = 0; glyph_index < glyph_count;
+                 ++glyph_index) {
+                PoneBenchSdfGlyph *glyph = glyphs + glyph_index;
+                u8 *buf = kernel_index == 0 ? glyph->scalar_buf : sdf_buf;
+                f64 best_us = 0.0;
+                for (u32 run = 0; run < PONE_BENCH_SDF_RUN_COUNT; ++run) {
+                    u64 t0 = pone_platform_get_time();
+                    pone_truetype_outline_generate_sdf(
+                        &glyph->outline, &glyph->sdf_bbox, glyph->width,
+                        glyph->height, config->format, pixels_per_funit,
+                        config->d_pad, config->d_pad, kernel->distance_span,
+                        buf);
+                    f64 us =
+                        pone_bench_ms(t0, pone_platform_get_time()) * 1e3;
+                    if (run == 0 || us < best_us) {
+                        best_us = us;
+                    }
+                }
+                total_us += best_us;
+                max_us = PONE_MAX(max_us, best_us);
+                usize buf_size =
+                    (usize)glyph->width * glyph->height * pixel_size;
+                if (kernel_index > 0 &&
+                    memcmp(buf, glyph->scalar_buf, buf_size)) {
+                    ++mismatch_count;
+                    for (usize i = 0; i < buf_size; ++i) {
+                        u32 a = buf[i];
+                        u32 b = glyph->scalar_buf[i];
+                        max_difference =
+                            PONE_MAX(max_difference, a > b ? a - b : b - a);
+                    }
+                }
+            }
+
+            f64 mean_us = total_us / (f64)glyph_count;
+            if (kernel_index == 0) {
+                scalar_mean_us = mean_us;
+            }
+            printf("  %s %7.2f us/glyph (max %7.2f, %.2fx)", kernel->name,
+                   mean_us, max_us, scalar_mean_us / mean_us);
+            if (mismatch_count) {
+                printf(" %zu glyphs differ by up to %u", mismatch_count,
+                       max_difference);
+            }
+        }
+        printf("\n");
+        pone_arena_tmp_end(config_tmp);
+    }
+
+    return 0;
+}
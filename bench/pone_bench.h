@@ -0,0 +1,35 @@
+#ifndef PONE_BENCH_H
+#define PONE_BENCH_H
+
+#include "pone_types.h"
+
+// Benchmarks are standalone programs, build.sh builds each one with
+// bench_<name>. They print one line per case and take no arguments unless
+// they say so.
+
+struct PoneBenchRandom {
+    u32 state;
+};
+
+// xorshift32, the same sequence on every platform for a given seed.
+static inline u32 pone_bench_random(PoneBenchRandom *random) {
+    u32 x = random->state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    random->state = x;
+
+    return x;
+}
+
+// Uniform enough in [min, max] for the small ranges used here.
+static inline u32 pone_bench_random_range(PoneBenchRandom *random, u32 min,
+                                          u32 max) {
+    return min + pone_bench_random(random) % (max - min + 1);
+}
+
+static inline f64 pone_bench_ms(u64 begin, u64 end) {
+    return (f64)(end - begin) * 1e-6;
+}
+
+#endif
@@ -1,12 +1,34 @@
 #!/bin/bash
 
+# ./build.sh [root dir] [target], target is pone by default, bench for every
+# benchmark or bench_<name> for one of them, fuzz and fuzz_<name> likewise for
+# the fuzzers.
 PONE_ROOT_DIR="${1:-$(pwd)}"
+PONE_TARGET="${2:-pone}"
 PONE_SRC_DIR="$PONE_ROOT_DIR/src"
 PONE_INCLUDE_DIR="$PONE_ROOT_DIR/include"
+PONE_BENCH_DIR="$PONE_ROOT_DIR/bench"
+PONE_FUZZ_DIR="$PONE_ROOT_DIR/fuzz"
 PONE_BUILD_DIR="$PONE_ROOT_DIR/build"
 
 CFLAGS="-Wall -Wno-writable-strings -g -O0 -c -I$PONE_INCLUDE_DIR"
-LDFLAGS="-lm -lwayland-client -lrt"
+# CFLAGS="$CFLAGS -DPONE_ARENA_STATS"
+LDFLAGS="-lm -lwayland-client -lrt -lpthread"
+
+# Benchmarks are built optimized with the engine sources they may need, the
+# window and the renderer are left out.
+BENCH_CFLAGS="-Wall -Wno-writable-strings -g -O2 -I$PONE_INCLUDE_DIR"
+BENCH_LDFLAGS="-lm -lrt -lpthread"
+BENCH_SOURCES="pone_platform_linux pone_memory pone_arena pone_string
+    pone_json pone_gltf pone_truetype pone_math pone_vec2 pone_rect
+    pone_atomic pone_work_queue pone_work_deque pone_job pone_rect_pack
+    pone_pool pone_thread_pool pone_hash"
+
+# Fuzzers link the same sources, with AddressSanitizer and
+# UndefinedBehaviorSanitizer stopping at the first error.
+FUZZ_CFLAGS="-Wall -Wno-writable-strings -g -O1 -fno-omit-frame-pointer
+    -fsanitize=address,undefined -fno-sanitize-recover=undefined
+    -I$PONE_INCLUDE_DIR"
 
 add_object_file() {
     local file_name=$1
@@ -18,8 +40,49 @@ add_object_file() {
     fi
 }
 
+add_program() {
+    local dir=$1
+    local name=$2
+    local cflags=$3
+    local sources=""
+
+    for file_name in $BENCH_SOURCES; do
+        # Programs testing a module's internals include its source themselves.
+        if ! grep -q "src/$file_name.cpp\"" $dir/$name.cpp; then
+            sources="$sources $PONE_SRC_DIR/$file_name.cpp"
+        fi
+    done
+    echo "Building $name"
+    clang $cflags -o $PONE_BUILD_DIR/$name $dir/$name.cpp $sources \
+        $BENCH_LDFLAGS
+}
+
 mkdir -p $PONE_BUILD_DIR
 
+case $PONE_TARGET in
+bench)
+    for bench_file in $PONE_BENCH_DIR/bench_*.cpp; do
+        add_program $PONE_BENCH_DIR $(basename $bench_file .cpp) \
+            "$BENCH_CFLAGS"
+    done
+    exit
+    ;;
+bench_*)
+    add_program $PONE_BENCH_DIR $PONE_TARGET "$BENCH_CFLAGS"
+    exit
+    ;;
+fuzz)
+    for fuzz_file in $PONE_FUZZ_DIR/fuzz_*.cpp; do
+        add_program $PONE_FUZZ_DIR $(basename $fuzz_file .cpp) "$FUZZ_CFLAGS"
+    done
+    exit
+    ;;
+fuzz_*)
+    add_program $PONE_FUZZ_DIR $PONE_TARGET "$FUZZ_CFLAGS"
+    exit
+    ;;
+esac
+
 echo "Building object file pone_platform.o"
 clang $CFLAGS -o $PONE_BUILD_DIR/pone_platform.o $PONE_SRC_DIR/pone_platform_linux.cpp
 add_object_file "pone_memory"
@@ -33,9 +96,14 @@ add_object_file "pone_truetype"
 add_object_file "pone_math"
 add_object_file "pone_vec2"
 add_object_file "pone_rect"
-# add_object_file "pone_atomic"
+add_object_file "pone_atomic"
 add_object_file "pone_work_queue"
+add_object_file "pone_work_deque"
+add_object_file "pone_job"
 add_object_file "pone_rect_pack"
+add_object_file "pone_pool"
+add_object_file "pone_thread_pool"
+add_object_file "pone_hash"
 add_object_file "xdg-shell-protocol" "c"
 
 clang $LDFLAGS -o $PONE_BUILD_DIR/pone \
@@ -50,7 +118,13 @@ clang $LDFLAGS -o $PONE_BUILD_DIR/pone \
     $PONE_BUILD_DIR/pone_math.o \
     $PONE_BUILD_DIR/pone_vec2.o \
     $PONE_BUILD_DIR/pone_rect.o \
+    $PONE_BUILD_DIR/pone_atomic.o \
     $PONE_BUILD_DIR/pone_work_queue.o \
+    $PONE_BUILD_DIR/pone_work_deque.o \
+    $PONE_BUILD_DIR/pone_job.o \
     $PONE_BUILD_DIR/pone_rect_pack.o \
+    $PONE_BUILD_DIR/pone_pool.o \
+    $PONE_BUILD_DIR/pone_thread_pool.o \
+    $PONE_BUILD_DIR/pone_hash.o \
     $PONE_BUILD_DIR/xdg-shell-protocol.o \
     $PONE_BUILD_DIR/main.o
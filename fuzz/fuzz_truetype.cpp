@@ -0,0 +1,164 @@
+#include "pone_arena.h"
+#include "pone_memory.h"
+#include "pone_platform.h"
+#include "pone_string.h"
+#include "pone_truetype.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Feeds damaged copies of the font given as the first argument to the
+// TrueType parser, built with AddressSanitizer and UndefinedBehaviorSanitizer
+// by build.sh fuzz_truetype. Each copy is the font truncated at a random
+// length, with 1 to 16 random bytes overwritten anywhere, or with them
+// overwritten in the first kilobyte, where the table directory and most of
+// the small tables are. Every copy goes through pone_truetype_parse, which
+// has to give back everything it took from the arena when it fails, and
+// through pone_truetype_parse_lazy, whose glyphs are then all decoded and
+// whose cmap is looked up over the first two planes. Every 16th lazily
+// parsed font also renders ASCII through a glyph cache. The optional second
+// and third arguments are the iteration count, 10000 by default, and the
+// seed, 1 by default, the same pair damages the same bytes again.
+
+#define PONE_FUZZ_TRUETYPE_ITERATION_COUNT 10000
+#define PONE_FUZZ_TRUETYPE_MAX_CORRUPT_COUNT 16
+#define PONE_FUZZ_TRUETYPE_HEAD_SIZE 1024
+#define PONE_FUZZ_TRUETYPE_RENDER_PERIOD 16
+
+enum PoneFuzzTruetypeDamage {
+    PONE_FUZZ_TRUETYPE_DAMAGE_TRUNCATE,
+    PONE_FUZZ_TRUETYPE_DAMAGE_CORRUPT,
+    PONE_FUZZ_TRUETYPE_DAMAGE_CORRUPT_HEAD,
+    PONE_FUZZ_TRUETYPE_DAMAGE_COUNT,
+};
+
+// xorshift32, the same sequence on every platform for a given seed.
+static u32 pone_fuzz_random(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return x;
+}
+
+// The damaged copy goes to the heap, sized to the byte, so AddressSanitizer
+// catches a read one past its end, the arena has no redzones to catch it.
+static u8 *pone_fuzz_truetype_damage(u8 *font, usize font_size, u32 *random,
+                                     usize *size) {
+    PoneFuzzTruetypeDamage damage = (PoneFuzzTruetypeDamage)(
+        pone_fuzz_random(random) % PONE_FUZZ_TRUETYPE_DAMAGE_COUNT);
+    usize len = font_size;
+    if (damage == PONE_FUZZ_TRUETYPE_DAMAGE_TRUNCATE) {
+        len = pone_fuzz_random(random) % (font_size + 1);
+    }
+
+    u8 *copy = (u8 *)malloc(len ? len : 1);
+    pone_memcpy(copy, font, len);
+    if (damage != PONE_FUZZ_TRUETYPE_DAMAGE_TRUNCATE) {
+        usize range = len;
+        if (damage == PONE_FUZZ_TRUETYPE_DAMAGE_CORRUPT_HEAD &&
+            range > PONE_FUZZ_TRUETYPE_HEAD_SIZE) {
+            range = PONE_FUZZ_TRUETYPE_HEAD_SIZE;
+        }
+        u32 corrupt_count = 1 + pone_fuzz_random(random) %
+                                    PONE_FUZZ_TRUETYPE_MAX_CORRUPT_COUNT;
+        for (u32 i = 0; i < corrupt_count; ++i) {
+            copy[pone_fuzz_random(random) % range] =
+                (u8)pone_fuzz_random(random);
+        }
+    }
+
+    *size = len;
+    return copy;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        printf("Usage: %s font.ttf [iteration count] [seed]\n", argv[0]);
+        return 1;
+    }
+
+    pone_memory_init();
+
+    Arena arena;
+    if (!pone_arena_create_virtual(0, GIGABYTES((usize)1), 0, &arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
+
+    PoneString path;
+    pone_string_from_cstr(argv[1], &path);
+    usize font_size;
+    u8 *font = (u8 *)pone_platform_map_file(&path, &font_size, &arena);
+    if (!font || !font_size) {
+        printf("Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    u32 iteration_count = argc > 2 ? (u32)strtoul(argv[2], 0, 10)
+                                   : PONE_FUZZ_TRUETYPE_ITERATION_COUNT;
+    u32 seed = argc > 3 ? (u32)strtoul(argv[3], 0, 10) : 1;
+    // xorshift32 never leaves 0.
+    u32 random = seed ? seed : 1;
+
+    u32 parsed_count = 0;
+    u32 lazy_parsed_count = 0;
+    u32 rendered_count = 0;
+    for (u32 iteration = 0; iteration < iteration_count; ++iteration) {
+        usize size;
+        u8 *damaged =
+            pone_fuzz_truetype_damage(font, font_size, &random, &size);
+        PoneTruetypeInput input = {
+            .data = damaged,
+            .length = size,
+        };
+
+        PoneArenaTmp tmp = pone_arena_tmp_begin(&arena);
+        if (pone_truetype_parse(input, &arena)) {
+            ++parsed_count;
+        } else if (arena.offset != tmp.offset) {
+            printf("Iteration %u, seed %u: pone_truetype_parse failed and "
+                   "kept %zu arena bytes\n",
+                   iteration, seed, arena.offset - tmp.offset);
+            return 1;
+        }
+        pone_arena_tmp_end(tmp);
+
+        tmp = pone_arena_tmp_begin(&arena);
+        PoneTrueTypeFont *lazy_font = pone_truetype_parse_lazy(input, &arena);
+        if (lazy_font) {
+            ++lazy_parsed_count;
+            for (u32 glyph_id = 0; glyph_id < lazy_font->glyph_count;
+                 ++glyph_id) {
+                pone_truetype_font_glyph(lazy_font, glyph_id);
+            }
+            for (u32 codepoint = 0; codepoint < 0x20000; codepoint += 7) {
+                pone_truetype_font_glyph_index(lazy_font, codepoint);
+            }
+            if (lazy_parsed_count % PONE_FUZZ_TRUETYPE_RENDER_PERIOD == 0) {
+                PoneTrueTypeGlyphCache cache;
+                pone_truetype_glyph_cache_init(
+                    &cache, lazy_font, 16, 2,
+                    PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM, 512, 1, 128, 2,
+                    &arena);
+                for (u32 codepoint = '!'; codepoint <= '~'; ++codepoint) {
+                    pone_truetype_glyph_cache_get(&cache, codepoint);
+                }
+                ++rendered_count;
+            }
+            pone_truetype_font_release(lazy_font);
+        }
+        pone_arena_tmp_end(tmp);
+
+        free(damaged);
+    }
+
+    printf("%u iterations, seed %u: %u parsed, %u parsed lazily, %u "
+           "rendered\n",
+           iteration_count, seed, parsed_count, lazy_parsed_count,
+           rendered_count);
+
+    return 0;
+}
@@ -4,10 +4,27 @@
 #include "pone_types.h"
 #include <stdarg.h>
 
+enum PoneArenaFlags {
+    // Address range is only reserved, pages get committed as offset grows.
+    PONE_ARENA_FLAG_VIRTUAL = 1 << 0,
+    // An inaccessible page right after capacity so overruns fault.
+    PONE_ARENA_FLAG_GUARD_PAGE = 1 << 1,
+};
+
+struct PoneArenaStats;
+
 struct Arena {
     void *base;
     usize offset;
     usize capacity;
+    usize committed;
+    // Sub-arenas of a virtual arena live below this offset and commit their
+    // own pages, so the arena never decommits below it.
+    usize sub_arena_end;
+    u32 flags;
+#if defined(PONE_ARENA_STATS)
+    PoneArenaStats *stats;
+#endif
 };
 
 struct AllocationHeader {
@@ -20,22 +37,88 @@ void arena_init(Arena *arena, void *base, usize capacity);
 Arena *arena_create(usize capacity);
 void *arena_alloc(Arena *arena, usize size);
 void *arena_realloc(Arena *arena, void *p, usize size);
+// Header-less, so the allocation can not be passed to arena_realloc.
+void *arena_alloc_aligned(Arena *arena, usize size, usize align);
 void arena_clear(Arena *arena);
 void arena_destroy(Arena **arena);
 i32 arena_vsprintf(Arena *arena, char **s, const char *fmt, va_list args);
 i32 arena_sprintf(Arena *arena, char **s, const char *fmt, ...);
 void pone_arena_create_sub_arena(Arena *arena, usize capacity,
                                  Arena *sub_arena);
+// Returns 0 when the address space cannot be reserved.
+b8 pone_arena_create_virtual(void *addr, usize capacity, u32 flags,
+                             Arena *arena);
+void pone_arena_release(Arena *arena);
 
 struct PoneArenaTmp {
     usize offset;
     Arena *arena;
 };
 
-PoneArenaTmp *pone_arena_tmp_begin(Arena *arena);
-void pone_arena_tmp_end(PoneArenaTmp *tmp);
+PoneArenaTmp pone_arena_tmp_begin(Arena *arena);
+void pone_arena_tmp_end(PoneArenaTmp tmp);
+
+// Every thread owns PONE_SCRATCH_ARENA_COUNT scratch arenas, reserved on first
+// use. pone_scratch_begin hands out one that is not in conflicts, so a
+// function can take scratch memory while its caller's arena is itself a
+// scratch arena.
+#define PONE_SCRATCH_ARENA_COUNT 2
+#define PONE_SCRATCH_ARENA_CAPACITY GIGABYTES((usize)1)
+
+PoneArenaTmp pone_scratch_begin(Arena **conflicts, usize conflict_count);
+void pone_scratch_end(PoneArenaTmp scratch);
+// Releases the calling thread's scratch arenas, threads other than the main
+// one call it before they exit.
+void pone_scratch_release(void);
+
+// Build with -DPONE_ARENA_STATS to track registered arenas. Allocations are
+// charged to the calling thread's current tag, set with PONE_ARENA_TAG_BEGIN
+// and restored with PONE_ARENA_TAG_END in the same scope.
+enum PoneArenaTag {
+    PONE_ARENA_TAG_GENERAL,
+    PONE_ARENA_TAG_JSON,
+    PONE_ARENA_TAG_GLTF,
+    PONE_ARENA_TAG_TRUETYPE,
+    PONE_ARENA_TAG_VULKAN,
+    PONE_ARENA_TAG_COUNT,
+};
+
+#if defined(PONE_ARENA_STATS)
+struct PoneArenaStats {
+    const char *name;
+    Arena *arena;
+    usize high_water;
+    usize alloc_count;
+    usize tag_bytes[PONE_ARENA_TAG_COUNT];
+    isize open_tmp_count;
+};
+
+void pone_arena_stats_register(Arena *arena, const char *name);
+// The arena's record stays in the report, without its current usage.
+void pone_arena_stats_unregister(Arena *arena);
+PoneArenaTag pone_arena_stats_set_tag(PoneArenaTag tag);
+void pone_arena_stats_report(void);
+
+#define PONE_ARENA_STATS_REGISTER(arena, name)                                 \
+    pone_arena_stats_register(arena, name)
+#define PONE_ARENA_STATS_UNREGISTER(arena) pone_arena_stats_unregister(arena)
+#define PONE_ARENA_STATS_REPORT() pone_arena_stats_report()
+#define PONE_ARENA_TAG_BEGIN(tag)                                              \
+    PoneArenaTag _pone_arena_prev_tag = pone_arena_stats_set_tag(tag)
+#define PONE_ARENA_TAG_END() pone_arena_stats_set_tag(_pone_arena_prev_tag)
+#else
+#define PONE_ARENA_STATS_REGISTER(arena, name)
+#define PONE_ARENA_STATS_UNREGISTER(arena)
+#define PONE_ARENA_STATS_REPORT()
+#define PONE_ARENA_TAG_BEGIN(tag)
+#define PONE_ARENA_TAG_END()
+#endif
 
 #define arena_alloc_array(arena, count, type)                                  \
     (type *)arena_alloc(arena, (count) * sizeof(type))
+#define arena_alloc_struct(arena, type)                                        \
+    (type *)arena_alloc_aligned(arena, sizeof(type), alignof(type))
+#define arena_alloc_array_aligned(arena, count, type)                          \
+    (type *)arena_alloc_aligned(arena, (count) * sizeof(type), alignof(type))
 
 #endif
@@ -7,6 +7,12 @@
     __atomic_fetch_add(ptr, val, (int)mem_order)
 #define _pone_atomic_fetch_sub(ptr, val, mem_order)                            \
     __atomic_fetch_sub(ptr, val, (int)mem_order)
+#define _pone_atomic_fetch_and(ptr, val, mem_order)                            \
+    __atomic_fetch_and(ptr, val, (int)mem_order)
+#define _pone_atomic_fetch_or(ptr, val, mem_order)                             \
+    __atomic_fetch_or(ptr, val, (int)mem_order)
+#define _pone_atomic_exchange_n(ptr, val, mem_order)                           \
+    __atomic_exchange_n(ptr, val, (int)mem_order)
 #define _pone_atomic_load(ptr, ret, mem_order)                                 \
     __atomic_load(ptr, ret, (int)mem_order)
 #define _pone_atomic_load_n(ptr, mem_order) __atomic_load_n(ptr, (int)mem_order)
@@ -21,6 +27,15 @@
 #define _pone_atomic_test_and_set(ptr, memorder)                               \
     __atomic_test_and_set(ptr, memorder)
 #define _pone_atomic_clear(ptr, memorder) __atomic_clear(ptr, (int)memorder)
+#define _pone_atomic_thread_fence(memorder) __atomic_thread_fence((int)memorder)
+
+#define PONE_CACHE_LINE_SIZE 64
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define _pone_cpu_relax() __builtin_ia32_pause()
+#else
+#define _pone_cpu_relax()
+#endif
 
 enum PoneMemoryOrdering {
     PONE_MEMORY_ORDERING_RELAXED,
@@ -31,16 +46,57 @@ enum PoneMemoryOrdering {
     PONE_MEMORY_ORDERING_SEQ_CST,
 };
 
-struct PoneSemaphore;
+// All primitives below spin for a short while before parking the thread on
+// the platform's wait-on-address (futex on Linux).
+
+struct PoneSemaphore {
+    volatile u32 val;
+    volatile u32 waiter_count;
+};
 
 void pone_semaphore_init(PoneSemaphore *sem, u32 val);
 void pone_semaphore_signal(PoneSemaphore *sem);
 void pone_semaphore_wait(PoneSemaphore *sem);
 
-struct PoneMutex;
+// state is 0 when unlocked, 1 when locked and 2 when locked with possible
+// waiters. spin_count adapts to how long the lock is usually held.
+struct PoneMutex {
+    volatile u32 state;
+    volatile u32 spin_count;
+};
 
 void pone_mutex_init(PoneMutex *mutex);
 void pone_mutex_lock(PoneMutex *mutex);
 void pone_mutex_unlock(PoneMutex *mutex);
 
+// Reader count in the low bits, plus a writer bit and a waiters bit.
+struct PoneRwLock {
+    volatile u32 state;
+};
+
+void pone_rw_lock_init(PoneRwLock *lock);
+void pone_rw_lock_read_lock(PoneRwLock *lock);
+void pone_rw_lock_read_unlock(PoneRwLock *lock);
+void pone_rw_lock_write_lock(PoneRwLock *lock);
+void pone_rw_lock_write_unlock(PoneRwLock *lock);
+
+// Manual-reset event.
+struct PoneEvent {
+    volatile u32 is_set;
+};
+
+void pone_event_init(PoneEvent *event, b8 is_set);
+void pone_event_set(PoneEvent *event);
+void pone_event_reset(PoneEvent *event);
+void pone_event_wait(PoneEvent *event);
+
+struct PoneCondition {
+    volatile u32 seq;
+};
+
+void pone_condition_init(PoneCondition *cond);
+void pone_condition_wait(PoneCondition *cond, PoneMutex *mutex);
+void pone_condition_signal(PoneCondition *cond);
+void pone_condition_broadcast(PoneCondition *cond);
+
 #endif
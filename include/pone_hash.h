@@ -0,0 +1,10 @@
+#ifndef PONE_HASH_H
+#define PONE_HASH_H
+
+#include "pone_types.h"
+
+// XXH64, the output matches the reference implementation so hashes can be
+// stored on disk.
+u64 pone_hash_64(void *data, usize size, u64 seed);
+
+#endif
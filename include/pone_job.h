@@ -0,0 +1,80 @@
+#ifndef PONE_JOB_H
+#define PONE_JOB_H
+
+#include "pone_arena.h"
+#include "pone_pool.h"
+#include "pone_thread_pool.h"
+#include "pone_types.h"
+
+#define PONE_JOB_MAX_CONTINUATIONS 16
+
+struct PoneJob;
+struct PoneJobSystem;
+
+typedef void (*PoneJobFn)(PoneJobSystem *system, PoneJob *job,
+                          void *user_data);
+typedef void (*PoneJobRangeFn)(void *user_data, usize begin, usize end);
+
+// A job runs once every job it depends on has finished and it has been
+// submitted. It finishes once its own function and all of its children
+// returned, then its continuations lose one dependency each.
+//
+// dependency_count starts at 1 for the submit that is still missing,
+// unfinished_count at 1 for the job itself. ref_count starts at 2, one
+// reference is dropped after the job finished and one by pone_job_wait or
+// pone_job_release, the job goes back to the pool when both are gone.
+// continuation_count gets PONE_JOB_SEALED once the job finished, late
+// pone_job_add_dependency calls see that and skip the dependency.
+struct alignas(PONE_CACHE_LINE_SIZE) PoneJob {
+    PoneJobSystem *system;
+    PoneJobFn fn;
+    void *user_data;
+    PoneJob *parent;
+    volatile u32 dependency_count;
+    volatile u32 unfinished_count;
+    volatile u32 ref_count;
+    volatile u32 is_finished;
+    volatile u32 continuation_count;
+    PoneJob *volatile continuations[PONE_JOB_MAX_CONTINUATIONS];
+
+    // Only used by parallel-for jobs.
+    PoneJobRangeFn range_fn;
+    usize range_begin;
+    usize range_end;
+    usize range_chunk_size;
+};
+
+// Jobs come from a fixed-size lock-free pool, creating more than
+// job_capacity live jobs at once is a bug.
+struct PoneJobSystem {
+    PoneThreadPool *pool;
+    PoneAtomicPool job_pool;
+};
+
+void pone_job_system_init(PoneJobSystem *system, PoneThreadPool *pool,
+                          usize job_capacity, Arena *arena);
+PoneJob *pone_job_create(PoneJobSystem *system, PoneJobFn fn,
+                         void *user_data);
+// Has to be called from inside parent's function, parent does not finish
+// before the child did.
+PoneJob *pone_job_create_child(PoneJobSystem *system, PoneJob *parent,
+                               PoneJobFn fn, void *user_data);
+// job runs after dependency finished. job must not be submitted yet.
+void pone_job_add_dependency(PoneJob *job, PoneJob *dependency);
+void pone_job_submit(PoneJobSystem *system, PoneJob *job);
+// Runs other work while job is unfinished, then releases the job.
+void pone_job_wait(PoneJobSystem *system, PoneJob *job);
+void pone_job_release(PoneJobSystem *system, PoneJob *job);
+void pone_job_run_and_wait(PoneJobSystem *system, PoneJob *job);
+
+// Calls fn on [begin, end) chunks of [0, count) that are at most chunk_size
+// long, chunk_size == 0 picks one from the worker count. The returned job
+// is not submitted yet, so it can take part in a graph like any other job.
+PoneJob *pone_job_create_parallel_for(PoneJobSystem *system, usize count,
+                                      usize chunk_size, PoneJobRangeFn fn,
+                                      void *user_data);
+void pone_job_parallel_for(PoneJobSystem *system, usize count,
+                           usize chunk_size, PoneJobRangeFn fn,
+                           void *user_data);
+
+#endif
@@ -19,6 +19,8 @@ b8 pone_f32_is_nan(f32 x);
 
 f32 pone_f32_copysign(f32 x, f32 y);
 f32 pone_f32_signum(f32 x);
+u16 pone_f32_to_f16(f32 x);
+f32 pone_f16_to_f32(u16 x);
 
 f32 pone_abs(f32 x);
 f32 pone_ceil(f32 x);
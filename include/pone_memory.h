@@ -10,6 +10,9 @@
 
 #define pone_array_count(arr) sizeof((arr)) / sizeof((arr)[0])
 
+// Picks the memcpy/memset implementations for the running CPU. Calling it is
+// optional, the first copy resolves them otherwise.
+void pone_memory_init(void);
 void *pone_memcpy(void *dst, void *src, usize len);
 void pone_memset(void *p, u8 c, usize n);
 
@@ -11,15 +11,55 @@
 #include "pone_arena.h"
 #include "pone_types.h"
 
+enum PonePlatformCpuFeature {
+    PONE_PLATFORM_CPU_FEATURE_SSE2 = 1 << 0,
+    PONE_PLATFORM_CPU_FEATURE_SSE4_1 = 1 << 1,
+    PONE_PLATFORM_CPU_FEATURE_AVX2 = 1 << 2,
+    PONE_PLATFORM_CPU_FEATURE_FMA = 1 << 3,
+};
+
 struct PonePlatformSystemInfo {
     usize page_size;
+    u32 cpu_features;
+    u32 processor_count;
+};
+
+typedef void (*PonePlatformThreadProc)(void *param);
+
+// Has to stay alive until the thread is joined, the new thread reads proc
+// and param from it.
+struct PonePlatformThread {
+    u64 handle;
+    PonePlatformThreadProc proc;
+    void *param;
 };
 
 void pone_platform_get_system_info(PonePlatformSystemInfo *info);
 void *pone_platform_allocate_memory(void *addr, usize size);
 void pone_platform_deallocate_memory(void *p);
+void *pone_platform_reserve_memory(void *addr, usize size);
+b8 pone_platform_commit_memory(void *p, usize size);
+void pone_platform_decommit_memory(void *p, usize size);
+void pone_platform_release_memory(void *p, usize size);
 u64 pone_platform_get_time(void);
+// Blocks while *addr == expected, spurious wakeups are possible.
+void pone_platform_wait_on_address(volatile u32 *addr, u32 expected);
+void pone_platform_wake_by_address_single(volatile u32 *addr);
+void pone_platform_wake_by_address_all(volatile u32 *addr);
+void pone_platform_create_thread(PonePlatformThread *thread,
+                                 PonePlatformThreadProc proc, void *param);
+void pone_platform_join_thread(PonePlatformThread *thread);
+void pone_platform_pin_thread(PonePlatformThread *thread,
+                              u32 processor_index);
+void pone_platform_yield_thread(void);
 void pone_platform_read_file(PoneString *path, usize *size, void *data,
                              Arena *arena);
+// Maps the whole file read-only, returns 0 when it can not be opened.
+void *pone_platform_map_file(PoneString *path, usize *size, Arena *arena);
+void pone_platform_unmap_file(void *p, usize size);
+// Writes a temporary file next to path and renames it over path, readers
+// never see a partially written file.
+b8 pone_platform_write_file(PoneString *path, void *data, usize size,
+                            Arena *arena);
 
 #endif
@@ -0,0 +1,52 @@
+#ifndef PONE_POOL_H
+#define PONE_POOL_H
+
+#include "pone_arena.h"
+#include "pone_types.h"
+
+struct PonePoolFreeNode {
+    PonePoolFreeNode *next;
+};
+
+// Fixed-size blocks carved from an arena on demand. Freed blocks go on an
+// intrusive free list and are handed out again before the arena grows.
+struct PonePool {
+    Arena *arena;
+    usize block_size;
+    usize block_align;
+    PonePoolFreeNode *free_list;
+};
+
+void pone_pool_init(PonePool *pool, Arena *arena, usize block_size,
+                    usize block_align);
+void *pone_pool_alloc(PonePool *pool);
+void pone_pool_free(PonePool *pool, void *p);
+
+#define pone_pool_init_struct(pool, arena, type)                               \
+    pone_pool_init(pool, arena, sizeof(type), alignof(type))
+#define pone_pool_alloc_struct(pool, type) (type *)pone_pool_alloc(pool)
+
+// Lock-free variant for use across threads. All blocks are reserved from the
+// arena at init, unused ones are handed out with an atomic bump index and
+// freed ones live on a Treiber stack. The stack head keeps an ABA tag in the
+// upper 16 bits of the pointer.
+struct PoneAtomicPool {
+    u8 *blocks;
+    usize block_size;
+    usize block_count;
+    volatile usize next_unused;
+    volatile u64 head;
+};
+
+void pone_atomic_pool_init(PoneAtomicPool *pool, Arena *arena,
+                           usize block_size, usize block_align,
+                           usize block_count);
+void *pone_atomic_pool_alloc(PoneAtomicPool *pool);
+void pone_atomic_pool_free(PoneAtomicPool *pool, void *p);
+
+#define pone_atomic_pool_init_struct(pool, arena, type, count)                 \
+    pone_atomic_pool_init(pool, arena, sizeof(type), alignof(type), count)
+#define pone_atomic_pool_alloc_struct(pool, type)                              \
+    (type *)pone_atomic_pool_alloc(pool)
+
+#endif
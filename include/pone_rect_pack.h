@@ -6,6 +6,9 @@
 
 struct PoneRectPackItem {
     PoneRectU32 rect;
+    // The bin rect is in, only pone_rect_pack_max_rects_pages fills more
+    // than one.
+    u32 page;
     void *user_data;
 };
 
@@ -25,4 +28,128 @@ void pone_rect_pack_item_sort_by_area(PoneRectPackItem *items, usize item_count,
 u32 pone_rect_pack_item_calculate_total_area(PoneRectPackItem *items,
                                              usize item_count);
 
+// Same interface as pone_rect_pack, but items are placed in a single pass
+// into a square bin that starts at the side their total area needs and grows
+// by a 64th whenever an item does not fit, instead of packing all items
+// again for every side the binary search probes. side ends up as the
+// smallest square holding every placed rect.
+//
+// Skyline bottom left tracks only the top edge of the packed area, so it is
+// the faster one. MaxRects best short side fit keeps every maximal free rect
+// and fills holes the skyline can not see, for a denser bin.
+b8 pone_rect_pack_skyline(PoneRectPackItem *items, usize item_count,
+                          u32 max_bin_side, Arena *arena, u32 *side);
+b8 pone_rect_pack_max_rects(PoneRectPackItem *items, usize item_count,
+                            u32 max_bin_side, Arena *arena, u32 *side);
+// MaxRects over up to max_page_count square bins of the same side. The first
+// one grows like above, once it is max_bin_side wide items that fit nowhere
+// open a new page of that side, and every item goes to the first page it
+// fits. side is the smallest square holding every placed rect of any page.
+// Fails only when an item is larger than max_bin_side or the pages run out.
+b8 pone_rect_pack_max_rects_pages(PoneRectPackItem *items, usize item_count,
+                                  u32 max_bin_side, u32 max_page_count,
+                                  Arena *arena, u32 *side, u32 *page_count);
+
+#define PONE_RECT_SHELF_NONE U32_MAX
+// Free blocks are kept in one list per shelf height class and width class,
+// width classes are exact below 8 and split every power of two into 4 above.
+#define PONE_RECT_SHELF_WIDTH_CLASS_COUNT 64
+
+// A packed rect or a free span of a shelf, the blocks of a shelf cover its
+// whole width. Free neighbours are always merged.
+struct PoneRectShelfBlock {
+    u32 x;
+    u32 width;
+    // Height of the packed rect, 0 for free blocks.
+    u32 height;
+    u32 shelf;
+    // Neighbours within the shelf, by x.
+    u32 prev;
+    u32 next;
+    // The size class list of a free block, the hash chain of a packed one.
+    u32 link_prev;
+    u32 link_next;
+};
+
+struct PoneRectShelf {
+    u32 y;
+    u32 height;
+    u32 first_block;
+};
+
+// Packs rects one at a time into rows of fixed height that are opened top
+// down, and takes them back out again. used_height only grows when no open
+// shelf fits, and shrinks when the bottom shelves become empty.
+//
+// Inserting looks at the few height classes a rect may waste and takes a
+// free block from the first size class list that surely fits, through the
+// class masks, so it costs the same for any number of rects. Removing finds
+// the rect's block by hash and merges it with its free neighbours.
+struct PoneRectShelfPacker {
+    u32 width;
+    u32 height;
+    u32 used_height;
+    usize item_capacity;
+    usize shelf_count;
+    usize shelf_capacity;
+    PoneRectShelf *shelves;
+    PoneRectShelfBlock *blocks;
+    u32 free_block;
+    // shelf_capacity height classes, each with
+    // PONE_RECT_SHELF_WIDTH_CLASS_COUNT lists.
+    u32 *free_lists;
+    // Bit per width class with a non empty list, per height class.
+    u64 *width_class_masks;
+    // Bit per height class with any free block.
+    u64 *height_class_masks;
+    u32 *buckets;
+    u32 bucket_mask;
+};
+
+struct PoneRectShelfPackerStats {
+    usize rect_count;
+    usize free_block_count;
+    u64 used_area;
+    // Free spans of open shelves and the rows below the last one.
+    u64 free_area;
+    // Shelf rows above rects lower than their shelf, they are lost until the
+    // rect is removed.
+    u64 waste_area;
+    // The bigger of the largest free span times its shelf's height and the
+    // rows below the last shelf.
+    u64 largest_free_area;
+    // 1 - largest_free_area / free_area, 0 while all free space is in one
+    // piece.
+    f32 fragmentation;
+};
+
+// Copying src to dst moves a rect from its old place to its new one.
+struct PoneRectShelfMove {
+    PoneRectU32 src;
+    PoneRectU32 dst;
+};
+
+// item_capacity is the most rects that are packed at the same time. width
+// has to stay below 65536.
+void pone_rect_shelf_packer_init(PoneRectShelfPacker *packer, u32 width,
+                                 u32 height, usize item_capacity,
+                                 Arena *arena);
+b8 pone_rect_shelf_packer_insert(PoneRectShelfPacker *packer, u32 width,
+                                 u32 height, PoneRectU32 *rect);
+// rect has to come from pone_rect_shelf_packer_insert on the same packer.
+void pone_rect_shelf_packer_remove(PoneRectShelfPacker *packer,
+                                   PoneRectU32 *rect);
+// Walks every block, meant for debug overlays and deciding when to
+// defragment.
+void pone_rect_shelf_packer_stats(PoneRectShelfPacker *packer,
+                                  PoneRectShelfPackerStats *stats);
+// Packs every rect again, tallest first, into fresh shelves. moves gets one
+// entry for every rect that changed place and is allocated from arena. A
+// dst may overlap the src of another move, so the copies have to read from
+// a copy of the old contents. Returns 0 and leaves the packer as it was
+// when the rects do not fit again.
+b8 pone_rect_shelf_packer_defragment(PoneRectShelfPacker *packer,
+                                     Arena *arena, PoneRectShelfMove **moves,
+                                     usize *move_count);
+
 #endif
@@ -0,0 +1,48 @@
+#ifndef PONE_THREAD_POOL_H
+#define PONE_THREAD_POOL_H
+
+#include "pone_arena.h"
+#include "pone_atomic.h"
+#include "pone_platform.h"
+#include "pone_types.h"
+#include "pone_work_deque.h"
+#include "pone_work_queue.h"
+
+struct PoneThreadPool;
+
+struct PoneThreadPoolWorker {
+    PoneThreadPool *pool;
+    usize thread_index;
+    PonePlatformThread thread;
+};
+
+// Every pool thread owns a work-stealing deque: deques[0] belongs to the
+// thread that called pone_thread_pool_init, deques[i] to worker i. Work
+// pushed from a pool thread goes to its own deque, work from any other
+// thread goes through the shared work_queue. Idle threads pop their own
+// deque, then the shared queue, then steal from a random victim, and park on
+// work_semaphore once all of that fails. pending_count counts work that was
+// pushed but has not finished yet, pone_thread_pool_wait_all parks on it.
+struct PoneThreadPool {
+    PoneWorkQueue work_queue;
+    PoneWorkDeque *deques;
+    PoneSemaphore work_semaphore;
+    volatile u32 sleeper_count;
+    volatile u32 pending_count;
+    volatile b8 is_running;
+    usize worker_count;
+    PoneThreadPoolWorker *workers;
+};
+
+// worker_count == 0 spawns one worker per processor besides the caller's.
+void pone_thread_pool_init(PoneThreadPool *pool, usize worker_count,
+                           Arena *arena);
+void pone_thread_pool_destroy(PoneThreadPool *pool);
+void pone_thread_pool_push(PoneThreadPool *pool, PoneWorkFn work,
+                           void *user_data);
+b8 pone_thread_pool_try_consume_work(PoneThreadPool *pool);
+void pone_thread_pool_wait_all(PoneThreadPool *pool);
+// 0 for threads that are not pool workers, 1..worker_count otherwise.
+usize pone_thread_pool_thread_index(void);
+
+#endif
@@ -2,8 +2,12 @@
 #define PONE_TRUETYPE_H
 
 #include "pone_arena.h"
+#include "pone_atomic.h"
+#include "pone_job.h"
 #include "pone_mat2.h"
 #include "pone_rect.h"
+#include "pone_rect_pack.h"
+#include "pone_string.h"
 #include "pone_types.h"
 #include "pone_vec2.h"
 
@@ -75,27 +79,248 @@ struct PoneSfntCmapFormat12 {
     PoneSfntSequentialMapGroup *groups;
 };
 
+#define PONE_TRUETYPE_MISSING_GLYPH 0
+#define PONE_TRUETYPE_BMP_END 0xffff
+#define PONE_TRUETYPE_CMAP_PAGE_SIZE 256
+#define PONE_TRUETYPE_CMAP_PAGE_COUNT                                          \
+    ((PONE_TRUETYPE_BMP_END + 1) / PONE_TRUETYPE_CMAP_PAGE_SIZE)
+
+// Glyph ids of the BMP in pages of 256 codepoints, indexed by the high byte.
+// Page 0 only holds missing glyphs and stands in for every page the font
+// does not map anything in.
+struct PoneTrueTypeCmapPageTable {
+    u16 page_indices[PONE_TRUETYPE_CMAP_PAGE_COUNT];
+    usize page_count;
+    u16 (*pages)[PONE_TRUETYPE_CMAP_PAGE_SIZE];
+};
+
+// Fresh pages read as zero, so every glyph starts out missing.
+#define PONE_TRUETYPE_GLYPH_OUTLINE_MISSING 0
+#define PONE_TRUETYPE_GLYPH_OUTLINE_DECODED 1
+
+// Outlines of a lazily parsed font, decoded the first time they are asked
+// for and kept as long as the font. glyph_states and glyphs are indexed by
+// glyph id and sit at the start of arena, a virtual reservation, so only the
+// pages of glyphs that are asked for are ever touched. Finding a decoded
+// glyph takes no lock, decoding takes mutex and allocates from arena.
+struct PoneTrueTypeGlyphOutlineCache {
+    PoneMutex mutex;
+    Arena arena;
+    usize glyph_count;
+    // From maxp, arena has room for every glyph of the font this large.
+    u16 max_points;
+    u16 max_contours;
+    u16 max_component_elements;
+    volatile u32 *glyph_states;
+    PoneSfntGlyph *glyphs;
+};
+
 struct PoneTrueTypeFont {
     u16 units_per_em;
     usize glyph_count;
     PoneSfntGlyphBbox global_bbox;
+    // Every outline, or 0 when they are decoded on demand into
+    // outline_cache. Either way glyphs are reached through
+    // pone_truetype_font_glyph.
     PoneSfntGlyph *glyphs;
+    PoneTrueTypeGlyphOutlineCache *outline_cache;
+    // Where outlines are decoded from.
+    PoneTruetypeInput input;
+    usize glyf_offset;
+    b8 loca_format;
+    void *loca_offsets;
     PoneSfntCmapFormat12 format_12;
+    PoneTrueTypeCmapPageTable cmap_page_table;
+};
+
+enum PoneTrueTypeSdfAtlasFormat {
+    PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM,
+    PONE_TRUETYPE_SDF_ATLAS_FORMAT_R16_SFLOAT,
+    PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM,
 };
 
+// Every channel holds (d + distance_range) / (2 * distance_range), where d
+// is a signed distance in atlas pixels, positive inside. The single channel
+// formats store the true distance. The MSDF format stores per-channel
+// pseudo-distances in RGB, whose median is the distance with sharp corners
+// kept, and the true distance in A.
+//
+// Bounds of the atlases pone_truetype_font_generate_sdf makes, glyphs that
+// do not fit in one layer spill into the next. Both are within what every
+// Vulkan device supports for array textures, 4096 texels and 256 layers.
+#define PONE_TRUETYPE_SDF_ATLAS_MAX_SIDE 2048
+#define PONE_TRUETYPE_SDF_ATLAS_MAX_LAYER_COUNT 256
+
+// A glyph's rect starts glyph_padding texels left of and above its bbox,
+// which is in font units and scaled by pixels_per_funit. units_per_em is the
+// font's, so text can be laid out from a cached atlas without the font.
+//
+// The atlas is layer_count layers of width by height texels, one after the
+// other in buf, to be uploaded as the layers of an array texture. A glyph's
+// rect is within layer glyph_layers[glyph].
 struct PoneTrueTypeSdfAtlas {
-    u32 *buf;
+    PoneTrueTypeSdfAtlasFormat format;
+    f32 distance_range;
+    f32 pixels_per_funit;
+    u32 glyph_padding;
+    u16 units_per_em;
+    void *buf;
     usize width;
     usize height;
+    usize layer_count;
     usize glyph_count;
     PoneRectU32 *glyph_rects;
+    u32 *glyph_layers;
     PoneRectF32 *glyph_bboxes;
 };
 
+// A mapped cache file, atlases loaded from it point into the mapping.
+struct PoneTrueTypeSdfAtlasCache {
+    void *data;
+    usize size;
+};
+
+#define PONE_TRUETYPE_GLYPH_CACHE_NONE U32_MAX
+
+struct PoneTrueTypeGlyphCacheEntry {
+    u32 codepoint;
+    u32 glyph_id;
+    // Padded like the rects of a whole atlas, empty for glyphs without an
+    // outline.
+    PoneRectU32 rect;
+    u32 layer;
+    // In font units.
+    PoneRectF32 bbox;
+    u64 last_used_frame;
+    u32 lru_prev;
+    u32 lru_next;
+    u32 hash_next;
+};
+
+// Renders glyphs into atlas the first time their codepoint is asked for.
+// atlas's glyph arrays stay empty, the entries take their place. Every
+// layer has its own packer and glyphs go to the first layer they fit in.
+// Rows of a layer below its packer's used height are never touched, so
+// atlas->buf's memory grows with the glyphs in use.
+//
+// When the atlas or the entries are full the least recently used glyphs are
+// evicted, except for the ones used in the last frames_in_flight frames as
+// the GPU may still read those.
+struct PoneTrueTypeGlyphCache {
+    PoneTrueTypeFont *font;
+    PoneTrueTypeSdfAtlas atlas;
+    // One per atlas layer.
+    PoneRectShelfPacker *packers;
+    usize entry_count;
+    usize entry_capacity;
+    PoneTrueTypeGlyphCacheEntry *entries;
+    u32 *buckets;
+    u32 bucket_mask;
+    u32 free_entry;
+    // Most recently used first.
+    u32 lru_head;
+    u32 lru_tail;
+    u64 frame;
+    u32 frames_in_flight;
+    // Bounds every glyph written since the last
+    // pone_truetype_glyph_cache_take_dirty_rect, in the layers from
+    // dirty_layer_min to dirty_layer_max.
+    b8 is_dirty;
+    PoneRectU32 dirty_rect;
+    u32 dirty_layer_min;
+    u32 dirty_layer_max;
+};
+
+struct PoneTrueTypeSdfAtlasComparison {
+    // Reference texels within one texel of an outline.
+    usize edge_sample_count;
+    // Reference texels anywhere whose inside/outside state the atlas gets
+    // wrong.
+    usize error_count;
+};
+
+usize pone_truetype_sdf_atlas_format_size(PoneTrueTypeSdfAtlasFormat format);
+
+// Returns 0 when the font is truncated, corrupt or needs something that is
+// not supported, like CFF outlines or a cmap without a format 12 subtable.
+// Nothing outside of input is ever read, and nothing in the font points
+// into it afterwards.
 PoneTrueTypeFont *pone_truetype_parse(PoneTruetypeInput input, Arena *arena);
+// Only reads the tables and loca, outlines are decoded the first time
+// pone_truetype_font_glyph asks for them, corrupt ones come back without an
+// outline. Also returns 0 when no address space is left for the outlines.
+// input has to outlive the font.
+PoneTrueTypeFont *pone_truetype_parse_lazy(PoneTruetypeInput input,
+                                           Arena *arena);
+// Gives back the outlines of a lazily parsed font, nothing else the font
+// holds. Does nothing for fonts from pone_truetype_parse.
+void pone_truetype_font_release(PoneTrueTypeFont *font);
+// Safe to call from several threads at once, compound glyphs' components
+// have to be looked up on their own.
+PoneSfntGlyph *pone_truetype_font_glyph(PoneTrueTypeFont *font, u32 glyph_id);
+// BMP codepoints take two table loads, the rest a binary search over the
+// cmap groups. Unmapped codepoints give PONE_TRUETYPE_MISSING_GLYPH.
+u32 pone_truetype_font_glyph_index(PoneTrueTypeFont *font, u32 codepoint);
+// Maps UTF-32 codepoints to glyph ids, glyph_indices holds count ids.
+void pone_truetype_font_glyph_indices(PoneTrueTypeFont *font, u32 *codepoints,
+                                      usize count, u32 *glyph_indices);
+// Glyphs are rendered and blitted on job_system's threads, or serially on
+// the calling thread when job_system is 0. The result is the same either way.
 void pone_truetype_font_generate_sdf(PoneTrueTypeFont *font, u32 resolution,
                                      u32 d_pad, Arena *permanent_arena,
                                      Arena *transient_arena,
+                                     PoneJobSystem *job_system,
+                                     PoneTrueTypeSdfAtlasFormat format,
                                      PoneTrueTypeSdfAtlas *atlas);
 
+// Identifies the atlas pone_truetype_font_generate_sdf makes from input with
+// these parameters, input is the font file.
+u64 pone_truetype_sdf_atlas_cache_key(PoneTruetypeInput input, u32 resolution,
+                                      u32 d_pad,
+                                      PoneTrueTypeSdfAtlasFormat format,
+                                      Arena *arena);
+// Maps the cache file at path and points atlas into it, atlas stays valid
+// until pone_truetype_sdf_atlas_cache_unload. Returns 0 when the file is
+// missing, from another version or for another key.
+b8 pone_truetype_sdf_atlas_cache_load(PoneString *path, u64 key,
+                                      PoneTrueTypeSdfAtlasCache *cache,
+                                      PoneTrueTypeSdfAtlas *atlas,
+                                      Arena *arena);
+void pone_truetype_sdf_atlas_cache_unload(PoneTrueTypeSdfAtlasCache *cache);
+b8 pone_truetype_sdf_atlas_cache_store(PoneString *path, u64 key,
+                                       PoneTrueTypeSdfAtlas *atlas,
+                                       Arena *arena);
+
+void pone_truetype_glyph_cache_init(PoneTrueTypeGlyphCache *cache,
+                                    PoneTrueTypeFont *font, u32 resolution,
+                                    u32 d_pad,
+                                    PoneTrueTypeSdfAtlasFormat format,
+                                    u32 atlas_side, u32 atlas_layer_count,
+                                    usize glyph_capacity,
+                                    u32 frames_in_flight, Arena *arena);
+void pone_truetype_glyph_cache_begin_frame(PoneTrueTypeGlyphCache *cache);
+// Codepoints the font does not map get its missing glyph. Returns 0 when the
+// glyph does not fit even after evicting everything that may be evicted.
+PoneTrueTypeGlyphCacheEntry *
+pone_truetype_glyph_cache_get(PoneTrueTypeGlyphCache *cache, u32 codepoint);
+// Copies the glyphs of baked, an atlas from
+// pone_truetype_font_generate_sdf or a cache file with the cache's parameters,
+// into the cache without rendering them again. Returns 0 when the parameters
+// differ or not every glyph fits, the glyphs copied so far stay.
+b8 pone_truetype_glyph_cache_seed(PoneTrueTypeGlyphCache *cache,
+                                  PoneTrueTypeSdfAtlas *baked);
+// Returns 0 when nothing was written since the last call. rect is dirty in
+// layer_count layers from first_layer on.
+b8 pone_truetype_glyph_cache_take_dirty_rect(PoneTrueTypeGlyphCache *cache,
+                                             PoneRectU32 *rect,
+                                             u32 *first_layer,
+                                             u32 *layer_count);
+
+// Samples atlas at every texel centre of reference the way the text shader
+// does, bilinear and median of three for MSDF. Both atlases have to hold the
+// same glyphs of the same font, reference should be a lot larger.
+void pone_truetype_sdf_atlas_compare(
+    PoneTrueTypeSdfAtlas *atlas, PoneTrueTypeSdfAtlas *reference,
+    PoneTrueTypeSdfAtlasComparison *comparison);
+
 #endif
@@ -0,0 +1,37 @@
+#ifndef PONE_WORK_DEQUE_H
+#define PONE_WORK_DEQUE_H
+
+#include "pone_arena.h"
+#include "pone_atomic.h"
+#include "pone_types.h"
+#include "pone_work_queue.h"
+
+struct PoneWorkDequeArray {
+    usize capacity;
+    PoneWorkQueueData *buffer;
+};
+
+enum PoneWorkDequeStealResult {
+    PONE_WORK_DEQUE_STEAL_RESULT_EMPTY,
+    PONE_WORK_DEQUE_STEAL_RESULT_ABORT,
+    PONE_WORK_DEQUE_STEAL_RESULT_SUCCESS,
+};
+
+// Chase-Lev work-stealing deque. Only the owner thread pushes and pops at
+// bottom, any thread may steal from top. The array doubles when full, the
+// old ones stay in arena since a thief may still be reading them.
+struct PoneWorkDeque {
+    alignas(PONE_CACHE_LINE_SIZE) volatile isize top;
+    alignas(PONE_CACHE_LINE_SIZE) volatile isize bottom;
+    alignas(PONE_CACHE_LINE_SIZE) PoneWorkDequeArray *volatile array;
+    Arena arena;
+};
+
+void pone_work_deque_init(PoneWorkDeque *deque);
+void pone_work_deque_destroy(PoneWorkDeque *deque);
+void pone_work_deque_push(PoneWorkDeque *deque, PoneWorkQueueData *data);
+b8 pone_work_deque_pop(PoneWorkDeque *deque, PoneWorkQueueData *data);
+PoneWorkDequeStealResult pone_work_deque_steal(PoneWorkDeque *deque,
+                                               PoneWorkQueueData *data);
+
+#endif
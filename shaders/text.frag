@@ -2,15 +2,31 @@
 
 layout(location = 0) in vec2 in_uv;
 layout(location = 1) in vec4 in_color;
+layout(location = 2) flat in uint in_layer;
 
-layout(binding = 0) uniform texture2D _texture;
+// PoneTrueTypeSdfAtlas's layers, each glyph instance picks its own so one
+// draw covers all of them.
+layout(binding = 0) uniform texture2DArray _texture;
 layout(binding = 1) uniform sampler _sampler;
 
+// PoneTrueTypeSdfAtlas::distance_range and format, set at pipeline creation.
+layout(constant_id = 0) const float distance_range = 8.0;
+layout(constant_id = 1) const bool is_msdf = false;
+
 layout(location = 0) out vec4 out_frag_color;
 
+float median(float r, float g, float b) {
+  return max(min(r, g), min(max(r, g), b));
+}
+
 void main() {
-  vec4 dist = texture(sampler2D(_texture, _sampler), in_uv);
-  float alpha = smoothstep(0.4, 0.6, dist.r);
+  vec4 texel =
+      texture(sampler2DArray(_texture, _sampler), vec3(in_uv, float(in_layer)));
+  float encoded = is_msdf ? median(texel.r, texel.g, texel.b) : texel.r;
+  // Signed distance in atlas texels, positive inside.
+  float dist = (encoded - 0.5) * 2.0 * distance_range;
+  float edge_width = max(fwidth(dist), 1e-4);
+  float alpha = smoothstep(-0.5 * edge_width, 0.5 * edge_width, dist);
 
   out_frag_color = vec4(in_color.xyz, in_color.a * alpha);
 }
@@ -2,10 +2,12 @@
 #include "pone_assert.h"
 #include "pone_atomic.h"
 #include "pone_gltf.h"
+#include "pone_job.h"
 #include "pone_json.h"
 #include "pone_math.h"
 #include "pone_memory.h"
 #include "pone_platform.h"
+#include "pone_thread_pool.h"
 #include "pone_truetype.h"
 #include "pone_types.h"
 #include "pone_vulkan.h"
@@ -750,7 +752,8 @@ static void pone_renderer_vk_resize_swapchain(
         .clipped = 1,
     };
 
-    PoneArenaTmp *tmp_arena = pone_arena_tmp_begin(arena);
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_VULKAN);
+    PoneArenaTmp tmp_arena = pone_arena_tmp_begin(arena);
     PoneVkSwapchainKhr *new_swapchain =
         pone_vk_create_swapchain_khr(device, &swapchain_create_info, arena);
     u32 new_swapchain_image_count;
@@ -758,7 +761,7 @@ static void pone_renderer_vk_resize_swapchain(
                                      &new_swapchain_image_count, arena);
     pone_assert(new_swapchain_image_count == swapchain_image_count);
     for (usize i = 0; i < swapchain_image_count; i++) {
-        PoneArenaTmp *tmp_arena_2 = pone_arena_tmp_begin(arena);
+        PoneArenaTmp tmp_arena_2 = pone_arena_tmp_begin(arena);
         VkImageViewCreateInfo swapchain_image_view_create_info = {
             .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
             .pNext = 0,
@@ -790,6 +793,7 @@ static void pone_renderer_vk_resize_swapchain(
 
     swapchain->handle = new_swapchain->handle;
     pone_arena_tmp_end(tmp_arena);
+    PONE_ARENA_TAG_END();
 }
 
 
@@ -915,13 +919,13 @@ static VkBuffer pone_renderer_create_buffer(PoneVkDevice *device,
 }
 
 static VkShaderModule pone_renderer_create_shader(PoneVkDevice *device,
-                                                  PoneString *path, Arena *arena) {
-    PoneArenaTmp *scratch = pone_arena_tmp_begin(arena);
+                                                  PoneString *path) {
+    PoneArenaTmp scratch = pone_scratch_begin(0, 0);
     usize file_size;
-    pone_platform_read_file(path, &file_size, 0, scratch->arena);
+    pone_platform_read_file(path, &file_size, 0, scratch.arena);
     pone_assert(file_size % 4 == 0);
-    void *shader_code = arena_alloc(scratch->arena, file_size);
-    pone_platform_read_file(path, &file_size, shader_code, scratch->arena);
+    void *shader_code = arena_alloc(scratch.arena, file_size);
+    pone_platform_read_file(path, &file_size, shader_code, scratch.arena);
 
     VkShaderModuleCreateInfo shader_module_create_info = {
         .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
@@ -933,24 +937,212 @@ static VkShaderModule pone_renderer_create_shader(PoneVkDevice *device,
 
     VkShaderModule shader_module;
     pone_vk_create_shader_module(device, &shader_module_create_info, &shader_module);
-    
+    pone_scratch_end(scratch);
+
     return shader_module;
 }
 
+static VkFormat
+pone_renderer_sdf_atlas_vk_format(PoneTrueTypeSdfAtlasFormat format) {
+    switch (format) {
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM:
+        return VK_FORMAT_R8_UNORM;
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R16_SFLOAT:
+        return VK_FORMAT_R16_SFLOAT;
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM:
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+    pone_assert(0);
+    return VK_FORMAT_UNDEFINED;
+}
+
+// Copies the glyphs written since the last upload from the cache's atlas
+// into staging_data, which mirrors the whole atlas, and records the copy of
+// just that rect of the dirty layers into image. image is in
+// SHADER_READ_ONLY_OPTIMAL before and after.
+static void
+pone_renderer_upload_glyph_cache(PoneVkCommandBuffer *command_buffer,
+                                 PoneTrueTypeGlyphCache *glyph_cache,
+                                 void *staging_data, VkBuffer staging_buffer,
+                                 VkImage image) {
+    PoneRectU32 dirty_rect;
+    u32 first_layer;
+    u32 layer_count;
+    if (!pone_truetype_glyph_cache_take_dirty_rect(
+            glyph_cache, &dirty_rect, &first_layer, &layer_count)) {
+        return;
+    }
+
+    PoneTrueTypeSdfAtlas *atlas = &glyph_cache->atlas;
+    usize pixel_size = pone_truetype_sdf_atlas_format_size(atlas->format);
+    usize row_size = pone_rect_u32_width(&dirty_rect) * pixel_size;
+    usize dirty_rect_offset =
+        (((usize)first_layer * atlas->height + dirty_rect.y_min) *
+             atlas->width +
+         dirty_rect.x_min) *
+        pixel_size;
+    for (usize layer = first_layer; layer < first_layer + layer_count;
+         ++layer) {
+        for (usize y = dirty_rect.y_min; y < dirty_rect.y_max; ++y) {
+            usize offset =
+                ((layer * atlas->height + y) * atlas->width +
+                 dirty_rect.x_min) *
+                pixel_size;
+            pone_memcpy((u8 *)staging_data + offset,
+                        (u8 *)atlas->buf + offset, row_size);
+        }
+    }
+
+    VkImageMemoryBarrier2 image_memory_barrier = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext = 0,
+        .srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange =
+            (VkImageSubresourceRange){
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = first_layer,
+                .layerCount = layer_count,
+            },
+    };
+    VkDependencyInfo dependency_info = {
+        .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext = 0,
+        .dependencyFlags = 0,
+        .memoryBarrierCount = 0,
+        .pMemoryBarriers = 0,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers = 0,
+        .imageMemoryBarrierCount = 1,
+        .pImageMemoryBarriers = &image_memory_barrier,
+    };
+    pone_vk_cmd_pipeline_barrier_2(command_buffer, &dependency_info);
+
+    VkBufferImageCopy2 buffer_image_copy_region = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
+        .pNext = 0,
+        .bufferOffset = dirty_rect_offset,
+        .bufferRowLength = (u32)atlas->width,
+        // Layers are a whole atlas layer apart in the staging buffer.
+        .bufferImageHeight = (u32)atlas->height,
+        .imageSubresource =
+            (VkImageSubresourceLayers){
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = 0,
+                .baseArrayLayer = first_layer,
+                .layerCount = layer_count,
+            },
+        .imageOffset = (VkOffset3D){.x = (i32)dirty_rect.x_min,
+                                    .y = (i32)dirty_rect.y_min,
+                                    .z = 0},
+        .imageExtent =
+            (VkExtent3D){.width = pone_rect_u32_width(&dirty_rect),
+                         .height = pone_rect_u32_height(&dirty_rect),
+                         .depth = 1},
+    };
+    VkCopyBufferToImageInfo2 copy_buffer_to_image_info = {
+        .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
+        .pNext = 0,
+        .srcBuffer = staging_buffer,
+        .dstImage = image,
+        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .regionCount = 1,
+        .pRegions = &buffer_image_copy_region,
+    };
+    pone_vk_cmd_copy_buffer_to_image_2(command_buffer,
+                                       &copy_buffer_to_image_info);
+
+    image_memory_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+    image_memory_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    image_memory_barrier.dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+    image_memory_barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    image_memory_barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    image_memory_barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    pone_vk_cmd_pipeline_barrier_2(command_buffer, &dependency_info);
+}
+
+// Build with -DPONE_SDF_QUALITY_REPORT to print how SDF and MSDF atlases of
+// a few sizes reconstruct the outlines of a large reference atlas.
+#if defined(PONE_SDF_QUALITY_REPORT)
+static void pone_sdf_quality_report(PoneTrueTypeFont *font,
+                                    PoneJobSystem *job_system, Arena *arena) {
+    struct PoneSdfQualityConfig {
+        const char *name;
+        PoneTrueTypeSdfAtlasFormat format;
+        u32 resolution;
+        u32 d_pad;
+    };
+    PoneSdfQualityConfig configs[] = {
+        {"SDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM, 48, 8},
+        {"SDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM, 32, 4},
+        {"SDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM, 24, 4},
+        {"MSDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM, 48, 8},
+        {"MSDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM, 32, 4},
+        {"MSDF", PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM, 24, 4},
+    };
+
+    PoneArenaTmp tmp = pone_arena_tmp_begin(arena);
+    PoneTrueTypeSdfAtlas reference;
+    pone_truetype_font_generate_sdf(font, 272, 8, arena, arena, job_system,
+                                    PONE_TRUETYPE_SDF_ATLAS_FORMAT_R16_SFLOAT,
+                                    &reference);
+    for (usize i = 0; i < pone_array_count(configs); ++i) {
+        PoneSdfQualityConfig *config = configs + i;
+        PoneTrueTypeSdfAtlas atlas;
+        u64 t0 = pone_platform_get_time();
+        pone_truetype_font_generate_sdf(font, config->resolution,
+                                        config->d_pad, arena, arena,
+                                        job_system, config->format, &atlas);
+        u64 t1 = pone_platform_get_time();
+
+        PoneTrueTypeSdfAtlasComparison comparison;
+        pone_truetype_sdf_atlas_compare(&atlas, &reference, &comparison);
+        usize texel_count = atlas.width * atlas.height * atlas.layer_count;
+        printf("%-4s %2u px: %7zu texels %8zu bytes %8.3lf ms, %.4lf wrong "
+               "texels per outline texel\n",
+               config->name, config->resolution, texel_count,
+               texel_count * pone_truetype_sdf_atlas_format_size(atlas.format),
+               (f64)(t1 - t0) * 1e-6,
+               (f64)comparison.error_count /
+                   (f64)comparison.edge_sample_count);
+    }
+    pone_arena_tmp_end(tmp);
+}
+#endif
+
 int main(void) {
+    pone_memory_init();
+
+    // Only reserves address space, the sub-arenas commit pages as they grow
+    // and each gets a guard page, hence the slack over 2 GB.
     Arena global_arena;
-    global_arena.base = (void *)(usize)TERABYTES((usize)2);
-    global_arena.offset = 0;
-    global_arena.capacity = GIGABYTES((usize)2);
-    global_arena.base =
-        mmap(global_arena.base, global_arena.capacity, PROT_READ | PROT_WRITE,
-             MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
-    pone_assert(global_arena.base != MAP_FAILED);
+    if (!pone_arena_create_virtual((void *)(usize)TERABYTES((usize)2),
+                                   GIGABYTES((usize)2) + MEGABYTES((usize)1),
+                                   PONE_ARENA_FLAG_GUARD_PAGE, &global_arena)) {
+        printf("Could not reserve memory\n");
+        return 1;
+    }
 
     Arena permanent_arena;
     pone_arena_create_sub_arena(&global_arena, GIGABYTES(1), &permanent_arena);
     Arena scratch_arena;
     pone_arena_create_sub_arena(&global_arena, GIGABYTES(1), &scratch_arena);
+    PONE_ARENA_STATS_REGISTER(&permanent_arena, "permanent");
+    PONE_ARENA_STATS_REGISTER(&scratch_arena, "scratch");
+
+    PoneThreadPool thread_pool;
+    pone_thread_pool_init(&thread_pool, 0, &permanent_arena);
+    PoneJobSystem job_system;
+    pone_job_system_init(&job_system, &thread_pool, 4096, &permanent_arena);
 
     PoneWayland wayland = {
         .width = 960,
@@ -976,6 +1168,7 @@ int main(void) {
     xdg_toplevel_set_title(wayland.xdg_toplevel, "Pone Renderer");
     wl_surface_commit(wayland.surface);
 
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_VULKAN);
     PoneVkInstance *instance = pone_vk_create_instance(&permanent_arena);
     PoneVkSurface *surface = pone_vk_create_wayland_surface_khr(
         instance, wayland.display, wayland.surface, &permanent_arena);
@@ -1176,27 +1369,97 @@ int main(void) {
         pone_vk_create_semaphore(device, &semaphore_create_info,
                                  acquire_semaphore);
     }
+    PONE_ARENA_TAG_END();
+
     PoneString font_file_path;
     pone_string_from_cstr("./fonts/JetBrainsMonoNerdFontMono-Regular.ttf",
                           &font_file_path);
 
+    // Parsed in place, the lazily parsed font decodes outlines from the
+    // mapping for as long as it lives.
     PoneTruetypeInput font_file;
-    pone_platform_read_file(&font_file_path, &font_file.length, 0,
-                            &scratch_arena);
-    font_file.data = arena_alloc(&scratch_arena, font_file.length);
-    pone_platform_read_file(&font_file_path, &font_file.length, font_file.data,
-                            &scratch_arena);
-
-    PoneTrueTypeFont *font = pone_truetype_parse(font_file, &scratch_arena);
-    PoneTrueTypeSdfAtlas atlas;
+    font_file.data = pone_platform_map_file(&font_file_path, &font_file.length,
+                                            &scratch_arena);
+    if (!font_file.data) {
+        printf("Could not open %.*s\n", (int)font_file_path.len,
+               (char *)font_file_path.buf);
+        return 1;
+    }
+
+#if defined(PONE_SDF_QUALITY_REPORT)
+    PoneTrueTypeFont *report_font =
+        pone_truetype_parse(font_file, &scratch_arena);
+    if (report_font) {
+        pone_sdf_quality_report(report_font, &job_system, &scratch_arena);
+    }
+#endif
     usize permanent_arena_size = permanent_arena.offset;
     usize scratch_arena_size = scratch_arena.offset;
     u64 t0 = pone_platform_get_time();
-    u32 d_pad = 8;
-    pone_truetype_font_generate_sdf(font, 48, d_pad, &permanent_arena,
-                                    &scratch_arena, &atlas);
+    // Glyphs are decoded and rendered the first time they are drawn, the
+    // font has thousands of icons of which only a few are ever used.
+    PoneTrueTypeFont *font =
+        pone_truetype_parse_lazy(font_file, &permanent_arena);
+    if (!font) {
+        printf("Could not parse %.*s\n", (int)font_file_path.len,
+               (char *)font_file_path.buf);
+        return 1;
+    }
+    u32 glyph_resolution = 32;
+    u32 d_pad = 4;
+    PoneTrueTypeSdfAtlasFormat glyph_format =
+        PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM;
+    // The atlas becomes one array texture, so its layers can not be larger
+    // or more than the device's images. Glyphs only spill into the next
+    // layer once the ones before are full.
+    VkPhysicalDeviceLimits *physical_device_limits =
+        &physical_device_properties.properties.limits;
+    u32 glyph_cache_side =
+        PONE_MIN(1024u, physical_device_limits->maxImageDimension2D);
+    u32 glyph_cache_layer_count =
+        PONE_MIN(4u, physical_device_limits->maxImageArrayLayers);
+    PoneTrueTypeGlyphCache glyph_cache;
+    pone_truetype_glyph_cache_init(
+        &glyph_cache, font, glyph_resolution, d_pad, glyph_format,
+        glyph_cache_side, glyph_cache_layer_count, 1024,
+        (u32)frame_data.frame_in_flight_count, &permanent_arena);
+    PoneTrueTypeSdfAtlas *atlas = &glyph_cache.atlas;
+
+    // The startup charset is baked once and kept next to the font, later
+    // starts copy it into the glyph cache instead of rendering it again.
+    PoneString atlas_cache_path;
+    pone_string_from_cstr(
+        "./fonts/JetBrainsMonoNerdFontMono-Regular.sdf_atlas_cache",
+        &atlas_cache_path);
+    PoneArenaTmp baked_tmp = pone_arena_tmp_begin(&scratch_arena);
+    PoneTrueTypeSdfAtlas baked_atlas;
+    PoneTrueTypeSdfAtlasCache atlas_cache = {};
+    u64 atlas_cache_key = pone_truetype_sdf_atlas_cache_key(
+        font_file, glyph_resolution, d_pad, glyph_format, &scratch_arena);
+    b8 is_atlas_cached = pone_truetype_sdf_atlas_cache_load(
+        &atlas_cache_path, atlas_cache_key, &atlas_cache, &baked_atlas,
+        &scratch_arena);
+    if (!is_atlas_cached) {
+        pone_truetype_font_generate_sdf(font, glyph_resolution, d_pad,
+                                        &scratch_arena, &scratch_arena,
+                                        &job_system, glyph_format,
+                                        &baked_atlas);
+        if (!pone_truetype_sdf_atlas_cache_store(
+                &atlas_cache_path, atlas_cache_key, &baked_atlas,
+                &scratch_arena)) {
+            printf("Could not write the SDF atlas cache\n");
+        }
+    }
+    if (!pone_truetype_glyph_cache_seed(&glyph_cache, &baked_atlas)) {
+        printf("Could not seed the glyph cache from the SDF atlas\n");
+    }
+    if (is_atlas_cached) {
+        pone_truetype_sdf_atlas_cache_unload(&atlas_cache);
+    }
+    pone_arena_tmp_end(baked_tmp);
     u64 t1 = pone_platform_get_time();
-    printf("%.3lf ms\n", (f64)(t1 - t0) * 1e-6);
+    printf("Font ready in %.3lf ms, SDF atlas %s\n", (f64)(t1 - t0) * 1e-6,
+           is_atlas_cached ? "loaded from cache" : "generated");
     printf("Memory used: %.3lf %.3lf\n",
            (f64)(permanent_arena.offset - permanent_arena_size) / 1048576.0,
            (f64)(scratch_arena.offset - scratch_arena_size) / 1048576.0);
@@ -1211,15 +1474,19 @@ int main(void) {
         Vec2 size;
         Vec2 uv_min;
         Vec2 uv_max;
+        u32 layer;
     };
     
     f32 point_size = 64.0f; // 64 pt
     f32 ppi = 72.0f;
     f32 dpi = 96.0f;
-    f32 scale = (point_size * dpi) / (ppi * font->units_per_em);
+    f32 scale = (point_size * dpi) / (ppi * atlas->units_per_em);
     
-    PoneRectU32 *d_atlas_uv_rect = &atlas.glyph_rects[35];
-    PoneRectF32 *d_glyph_bbox = &atlas.glyph_bboxes[35];
+    PoneTrueTypeGlyphCacheEntry *d_glyph =
+        pone_truetype_glyph_cache_get(&glyph_cache, 'D');
+    pone_assert(d_glyph);
+    PoneRectU32 *d_atlas_uv_rect = &d_glyph->rect;
+    PoneRectF32 *d_glyph_bbox = &d_glyph->bbox;
     
     PoneGlyphInstanceData d_glyph_instance = {
         .offset = { .x = 0.0f, .y = 0.0f },
@@ -1228,13 +1495,14 @@ int main(void) {
             .y = pone_rect_f32_height(d_glyph_bbox) * scale,
         },
         .uv_min = {
-            .x = (f32)(d_atlas_uv_rect->x_min + d_pad) / (f32)atlas.width,
-            .y = (f32)(d_atlas_uv_rect->y_min + d_pad) / (f32)atlas.height
+            .x = (f32)(d_atlas_uv_rect->x_min + d_pad) / (f32)atlas->width,
+            .y = (f32)(d_atlas_uv_rect->y_min + d_pad) / (f32)atlas->height
         },
         .uv_max = {
-            .x = (f32)(d_atlas_uv_rect->x_max - d_pad) / (f32)atlas.width,
-            .y = (f32)(d_atlas_uv_rect->y_max - d_pad) / (f32)atlas.height
+            .x = (f32)(d_atlas_uv_rect->x_max - d_pad) / (f32)atlas->width,
+            .y = (f32)(d_atlas_uv_rect->y_max - d_pad) / (f32)atlas->height
         },
+        .layer = d_glyph->layer,
     };
 
     PoneGlyphVertexData d_glyph_quad_vertices[4] = {
@@ -1270,12 +1538,17 @@ int main(void) {
                                     VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT);
                                                                      
+    usize atlas_buf_size =
+        atlas->width * atlas->height * atlas->layer_count *
+        pone_truetype_sdf_atlas_format_size(atlas->format);
+    VkFormat atlas_texture_format =
+        pone_renderer_sdf_atlas_vk_format(atlas->format);
     VkBuffer atlas_texture_staging_buffer;
     VkBufferCreateInfo atlas_texture_staging_buffer_create_info = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .pNext = 0,
         .flags = 0,
-        .size = atlas.width * atlas.height * sizeof(u32),
+        .size = atlas_buf_size,
         .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
@@ -1320,42 +1593,21 @@ int main(void) {
                        atlas_texture_staging_buffer_memory_requirements
                            .memoryRequirements.size,
                        0, &atlas_texture_staging_buffer_data);
-    pone_memcpy(atlas_texture_staging_buffer_data, atlas.buf,
-                atlas.width * atlas.height * sizeof(u32));
-
-    VkBufferImageCopy2 atlas_texture_buffer_image_copy_region = {
-        .sType = VK_STRUCTURE_TYPE_BUFFER_IMAGE_COPY_2,
-        .pNext = 0,
-        .bufferOffset = 0,
-        .bufferRowLength = (u32)atlas.width,
-        .bufferImageHeight = (u32)atlas.height,
-        .imageSubresource =
-            (VkImageSubresourceLayers){
-                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-                .mipLevel = 0,
-                .baseArrayLayer = 0,
-                .layerCount = 1,
-            },
-        .imageOffset = (VkOffset3D){.x = 0, .y = 0, .z = 0},
-        .imageExtent = (VkExtent3D){.width = (u32)atlas.width,
-                                    .height = (u32)atlas.height,
-                                    .depth = 1},
-    };
 
     VkImageCreateInfo atlas_texture_image_create_info = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .pNext = 0,
         .flags = 0,
         .imageType = VK_IMAGE_TYPE_2D,
-        .format = VK_FORMAT_B8G8R8A8_UNORM,
+        .format = atlas_texture_format,
         .extent =
             (VkExtent3D){
-                .width = (u32)atlas.width,
-                .height = (u32)atlas.height,
+                .width = (u32)atlas->width,
+                .height = (u32)atlas->height,
                 .depth = 1,
             },
         .mipLevels = 1,
-        .arrayLayers = 1,
+        .arrayLayers = (u32)atlas->layer_count,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
         .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
@@ -1401,8 +1653,8 @@ int main(void) {
         .pNext = 0,
         .flags = 0,
         .image = atlas_texture_image->handle,
-        .viewType = VK_IMAGE_VIEW_TYPE_2D,
-        .format = VK_FORMAT_B8G8R8A8_UNORM,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = atlas_texture_format,
         .components =
             (VkComponentMapping){
                 .r = VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -1416,7 +1668,7 @@ int main(void) {
                 .baseMipLevel = 0,
                 .levelCount = 1,
                 .baseArrayLayer = 0,
-                .layerCount = 1,
+                .layerCount = (u32)atlas->layer_count,
             },
     };
     VkImageView atlas_texture_image_view;
@@ -1428,18 +1680,20 @@ int main(void) {
         .baseMipLevel = 0,
         .levelCount = 1,
         .baseArrayLayer = 0,
-        .layerCount = 1,
+        .layerCount = (u32)atlas->layer_count,
     };
 
+    // Texels outside of the glyphs are never sampled, so the image starts out
+    // undefined and only dirty rects are copied in.
     VkImageMemoryBarrier2 atlas_texture_image_memory_barrier = {
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
         .pNext = 0,
         .srcStageMask = VK_PIPELINE_STAGE_2_NONE,
         .srcAccessMask = VK_ACCESS_2_NONE,
-        .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
-        .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
         .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
         .srcQueueFamilyIndex = queue_family_index,
         .dstQueueFamilyIndex = queue_family_index,
         .image = atlas_texture_image->handle,
@@ -1462,35 +1716,10 @@ int main(void) {
                                  VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
     pone_vk_cmd_pipeline_barrier_2(atlas_texture_image_command_buffer,
                                    &atlas_texture_image_dependency_info);
-
-    VkCopyBufferToImageInfo2 atlas_texture_copy_buffer_to_image_info = {
-        .sType = VK_STRUCTURE_TYPE_COPY_BUFFER_TO_IMAGE_INFO_2,
-        .pNext = 0,
-        .srcBuffer = atlas_texture_staging_buffer,
-        .dstImage = atlas_texture_image->handle,
-        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .regionCount = 1,
-        .pRegions = &atlas_texture_buffer_image_copy_region,
-    };
-    pone_vk_cmd_copy_buffer_to_image_2(
-        atlas_texture_image_command_buffer,
-        &atlas_texture_copy_buffer_to_image_info);
-
-    atlas_texture_image_memory_barrier.srcStageMask =
-        VK_PIPELINE_STAGE_2_COPY_BIT;
-    atlas_texture_image_memory_barrier.srcAccessMask =
-        VK_ACCESS_2_TRANSFER_WRITE_BIT;
-    atlas_texture_image_memory_barrier.dstStageMask =
-        VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
-    atlas_texture_image_memory_barrier.dstAccessMask =
-        VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
-    atlas_texture_image_memory_barrier.oldLayout =
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-    atlas_texture_image_memory_barrier.newLayout =
-        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-    pone_vk_cmd_pipeline_barrier_2(atlas_texture_image_command_buffer,
-                                   &atlas_texture_image_dependency_info);
+    pone_renderer_upload_glyph_cache(
+        atlas_texture_image_command_buffer, &glyph_cache,
+        atlas_texture_staging_buffer_data, atlas_texture_staging_buffer,
+        atlas_texture_image->handle);
     pone_vk_end_command_buffer(atlas_texture_image_command_buffer);
 
     VkCommandBufferSubmitInfo atlas_texture_image_command_buffer_submit_info = {
@@ -1607,13 +1836,13 @@ int main(void) {
 
     PoneString text_vertex_shader_path;
     pone_string_from_cstr("shaders/text.vert.spv", &text_vertex_shader_path);
-    VkShaderModule text_vertex_shader_module = pone_renderer_create_shader(device,
-                                                                           &text_vertex_shader_path, &scratch_arena);
+    VkShaderModule text_vertex_shader_module =
+        pone_renderer_create_shader(device, &text_vertex_shader_path);
 
     PoneString text_frag_shader_path;
     pone_string_from_cstr("shaders/text.frag.spv", &text_frag_shader_path);
-    VkShaderModule text_frag_shader_module = pone_renderer_create_shader(device,
-                                                                         &text_frag_shader_path, &scratch_arena);
+    VkShaderModule text_frag_shader_module =
+        pone_renderer_create_shader(device, &text_frag_shader_path);
 
     VkPipelineShaderStageCreateInfo text_pipeline_vertex_shader_stage_create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
@@ -1624,6 +1853,34 @@ int main(void) {
         .pName = "main",
         .pSpecializationInfo = 0,
     };
+    struct PoneTextFragSpecialization {
+        f32 distance_range;
+        VkBool32 is_msdf;
+    };
+    PoneTextFragSpecialization text_frag_specialization = {
+        .distance_range = atlas->distance_range,
+        .is_msdf = atlas->format ==
+                   PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM,
+    };
+    VkSpecializationMapEntry text_frag_specialization_map_entries[2] = {
+        {
+            .constantID = 0,
+            .offset = __builtin_offsetof(PoneTextFragSpecialization,
+                                         distance_range),
+            .size = sizeof(f32),
+        },
+        {
+            .constantID = 1,
+            .offset = __builtin_offsetof(PoneTextFragSpecialization, is_msdf),
+            .size = sizeof(VkBool32),
+        },
+    };
+    VkSpecializationInfo text_frag_specialization_info = {
+        .mapEntryCount = pone_array_count(text_frag_specialization_map_entries),
+        .pMapEntries = text_frag_specialization_map_entries,
+        .dataSize = sizeof(text_frag_specialization),
+        .pData = (void *)&text_frag_specialization,
+    };
     VkPipelineShaderStageCreateInfo text_pipeline_frag_shader_stage_create_info = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
         .pNext = 0,
@@ -1631,7 +1888,7 @@ int main(void) {
         .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
         .module = text_frag_shader_module,
         .pName = "main",
-        .pSpecializationInfo = 0,
+        .pSpecializationInfo = &text_frag_specialization_info,
     };
     VkPipelineShaderStageCreateInfo text_pipeline_shader_stages[2] = {
         text_pipeline_vertex_shader_stage_create_info,
@@ -1690,6 +1947,12 @@ int main(void) {
             .binding = 1,
             .format = VK_FORMAT_R32G32_SFLOAT,
             .offset = __builtin_offsetof(PoneGlyphInstanceData, uv_max),
+        },
+        {
+            .location = 6,
+            .binding = 1,
+            .format = VK_FORMAT_R32_UINT,
+            .offset = __builtin_offsetof(PoneGlyphInstanceData, layer),
         }
     };
     u32 text_vertex_input_attribute_description_count = sizeof(text_vertex_input_attribute_descriptions)
@@ -1911,6 +2174,7 @@ int main(void) {
         pone_vk_wait_for_fences(device, 1, frame_fence, 1, 1000000000,
                                 &permanent_arena);
         pone_vk_reset_fences(device, 1, frame_fence, &permanent_arena);
+        pone_truetype_glyph_cache_begin_frame(&glyph_cache);
 
         u32 swapchain_image_index;
         PoneVkAcquireNextImageInfoKhr acquire_swapchain_image_info = {
@@ -1929,6 +2193,10 @@ int main(void) {
             submit_semaphores + swapchain_image_index;
 
         pone_vk_begin_command_buffer(command_buffer, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        pone_renderer_upload_glyph_cache(command_buffer, &glyph_cache,
+                                         atlas_texture_staging_buffer_data,
+                                         atlas_texture_staging_buffer,
+                                         atlas_texture_image->handle);
         transition_image(command_buffer,
                          swapchain->images[swapchain_image_index],
                          VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
@@ -2056,6 +2324,10 @@ int main(void) {
         frame_index = (frame_index + 1) % frame_data.frame_in_flight_count;
     }
 
+    pone_thread_pool_destroy(&thread_pool);
+    pone_truetype_font_release(font);
+    PONE_ARENA_STATS_REPORT();
+
     return 0;
 }
 
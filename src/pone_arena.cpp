@@ -7,6 +7,16 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#if defined(PONE_ARENA_STATS)
+#include "pone_atomic.h"
+#endif
+
+// Virtual arenas commit in chunks of this size and give pages back once
+// more than PONE_ARENA_DECOMMIT_THRESHOLD bytes are committed above the
+// chunk that holds the offset.
+#define PONE_ARENA_COMMIT_CHUNK MEGABYTES((usize)1)
+#define PONE_ARENA_DECOMMIT_THRESHOLD MEGABYTES((usize)16)
+
 void arena_init(Arena *arena, void *base, usize capacity) {
     arena->base = base;
     arena->offset = 0;
@@ -34,6 +44,169 @@ Arena *arena_create(usize capacity) {
     return arena;
 }
 
+#if defined(PONE_ARENA_STATS)
+#define PONE_ARENA_STATS_MAX_ARENAS 64
+
+static PoneArenaStats pone_arena_stats[PONE_ARENA_STATS_MAX_ARENAS];
+static volatile usize pone_arena_stats_count;
+static thread_local PoneArenaTag pone_arena_current_tag;
+
+void pone_arena_stats_register(Arena *arena, const char *name) {
+    usize index = _pone_atomic_fetch_add(&pone_arena_stats_count, 1,
+                                         PONE_MEMORY_ORDERING_RELAXED);
+    if (index >= PONE_ARENA_STATS_MAX_ARENAS) {
+        return;
+    }
+
+    PoneArenaStats *stats = &pone_arena_stats[index];
+    *stats = (PoneArenaStats){
+        .name = name,
+        .arena = arena,
+        .high_water = arena->offset,
+    };
+    arena->stats = stats;
+}
+
+void pone_arena_stats_unregister(Arena *arena) {
+    if (arena->stats) {
+        arena->stats->arena = 0;
+        arena->stats = 0;
+    }
+}
+
+PoneArenaTag pone_arena_stats_set_tag(PoneArenaTag tag) {
+    PoneArenaTag prev_tag = pone_arena_current_tag;
+    pone_arena_current_tag = tag;
+
+    return prev_tag;
+}
+
+static const char *pone_arena_tag_names[PONE_ARENA_TAG_COUNT] = {
+    "general", "json", "gltf", "truetype", "vulkan",
+};
+
+void pone_arena_stats_report(void) {
+    usize count = _pone_atomic_load_n(&pone_arena_stats_count,
+                                      PONE_MEMORY_ORDERING_ACQUIRE);
+    if (count > PONE_ARENA_STATS_MAX_ARENAS) {
+        count = PONE_ARENA_STATS_MAX_ARENAS;
+    }
+
+    PoneArenaStats *sorted[PONE_ARENA_STATS_MAX_ARENAS];
+    for (usize i = 0; i < count; ++i) {
+        usize j = i;
+        for (; j > 0 && sorted[j - 1]->high_water <
+                            pone_arena_stats[i].high_water;
+             --j) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = &pone_arena_stats[i];
+    }
+
+    printf("Arena report (%zu arenas)\n", count);
+    for (usize i = 0; i < count; ++i) {
+        PoneArenaStats *stats = sorted[i];
+        Arena *arena = stats->arena;
+        if (arena) {
+            printf("  %-16s high water %10.3lf MB / %10.3lf MB, in use "
+                   "%10.3lf MB, committed %10.3lf MB, %zu allocations\n",
+                   stats->name, (f64)stats->high_water / 1048576.0,
+                   (f64)arena->capacity / 1048576.0,
+                   (f64)arena->offset / 1048576.0,
+                   (f64)arena->committed / 1048576.0, stats->alloc_count);
+        } else {
+            printf("  %-16s high water %10.3lf MB, released, %zu "
+                   "allocations\n",
+                   stats->name, (f64)stats->high_water / 1048576.0,
+                   stats->alloc_count);
+        }
+        if (stats->open_tmp_count != 0) {
+            printf("    %zd temporary scopes were never ended\n",
+                   stats->open_tmp_count);
+        }
+
+        u32 tags[PONE_ARENA_TAG_COUNT];
+        for (u32 t = 0; t < PONE_ARENA_TAG_COUNT; ++t) {
+            u32 j = t;
+            for (; j > 0 && stats->tag_bytes[tags[j - 1]] < stats->tag_bytes[t];
+                 --j) {
+                tags[j] = tags[j - 1];
+            }
+            tags[j] = t;
+        }
+        for (u32 t = 0; t < PONE_ARENA_TAG_COUNT; ++t) {
+            usize bytes = stats->tag_bytes[tags[t]];
+            if (bytes) {
+                printf("    %-10s %10.3lf MB\n", pone_arena_tag_names[tags[t]],
+                       (f64)bytes / 1048576.0);
+            }
+        }
+    }
+}
+#endif
+
+static inline void _pone_arena_stats_record(Arena *arena, usize next_offset) {
+#if defined(PONE_ARENA_STATS)
+    PoneArenaStats *stats = arena->stats;
+    if (!stats || next_offset <= arena->offset) {
+        return;
+    }
+
+    stats->alloc_count++;
+    stats->tag_bytes[pone_arena_current_tag] += next_offset - arena->offset;
+    if (next_offset > stats->high_water) {
+        stats->high_water = next_offset;
+    }
+#endif
+}
+
+static inline b8 _pone_is_power_of_two(usize n) {
+    return (n != 0 && (n & (n - 1)) == 0);
+}
+
+static usize _pone_arena_commit_end(Arena *arena, usize offset) {
+    usize end = offset + ((PONE_ARENA_COMMIT_CHUNK - 1) & -offset);
+    if (end > arena->capacity) {
+        end = arena->capacity;
+    }
+
+    return end;
+}
+
+static inline void _pone_arena_commit(Arena *arena, usize offset) {
+    if (!(arena->flags & PONE_ARENA_FLAG_VIRTUAL) ||
+        offset <= arena->committed) {
+        return;
+    }
+
+    usize end = _pone_arena_commit_end(arena, offset);
+    b8 ok = pone_platform_commit_memory((u8 *)arena->base + arena->committed,
+                                        end - arena->committed);
+    pone_assert(ok);
+    arena->committed = end;
+}
+
+static void _pone_arena_decommit(Arena *arena) {
+    if (!(arena->flags & PONE_ARENA_FLAG_VIRTUAL)) {
+        return;
+    }
+
+    // committed is only page aligned after a sub-arena was carved out, so
+    // the chunk end can lie above it.
+    usize end = _pone_arena_commit_end(arena, arena->offset);
+    if (end < arena->sub_arena_end) {
+        end = arena->sub_arena_end;
+    }
+    if (arena->committed <= end ||
+        arena->committed - end < PONE_ARENA_DECOMMIT_THRESHOLD) {
+        return;
+    }
+
+    pone_platform_decommit_memory((u8 *)arena->base + end,
+                                  arena->committed - end);
+    arena->committed = end;
+}
+
 static void *arena_alloc_align(Arena *arena, usize size, usize align) {
     PONE_ASSERT(arena);
     if (size == 0) {
@@ -47,9 +220,11 @@ static void *arena_alloc_align(Arena *arena, usize size, usize align) {
     usize next_offset = addr + size - (usize)arena->base;
 
     PONE_ASSERT(next_offset <= arena->capacity);
+    _pone_arena_commit(arena, next_offset);
     *(AllocationHeader *)header_addr = {
         .size = size,
     };
+    _pone_arena_stats_record(arena, next_offset);
     arena->offset = next_offset;
 
     return (void *)addr;
@@ -59,6 +234,24 @@ void *arena_alloc(Arena *arena, usize size) {
     return arena_alloc_align(arena, size, alignof(max_align_t));
 }
 
+void *arena_alloc_aligned(Arena *arena, usize size, usize align) {
+    PONE_ASSERT(arena && _pone_is_power_of_two(align));
+    if (size == 0) {
+        return 0;
+    }
+
+    usize addr = (usize)arena->base + arena->offset;
+    addr += (align - 1) & -addr;
+    usize next_offset = addr + size - (usize)arena->base;
+
+    PONE_ASSERT(next_offset <= arena->capacity);
+    _pone_arena_commit(arena, next_offset);
+    _pone_arena_stats_record(arena, next_offset);
+    arena->offset = next_offset;
+
+    return (void *)addr;
+}
+
 static void *arena_realloc_align(Arena *arena, void *p, usize size,
                                  usize align) {
     if (size == 0) {
@@ -75,8 +268,12 @@ static void *arena_realloc_align(Arena *arena, void *p, usize size,
     usize old_size = header->size;
 
     if ((usize)p + old_size == (usize)arena->base + arena->offset) {
+        usize next_offset = (usize)p + size - (usize)arena->base;
+        PONE_ASSERT(next_offset <= arena->capacity);
+        _pone_arena_commit(arena, next_offset);
         header->size = size;
-        arena->offset = (usize)p + size - (usize)arena->base;
+        _pone_arena_stats_record(arena, next_offset);
+        arena->offset = next_offset;
 
         return p;
     }
@@ -97,7 +294,10 @@ void *arena_realloc(Arena *arena, void *p, usize size) {
     return arena_realloc_align(arena, p, size, alignof(max_align_t));
 }
 
-void arena_clear(Arena *arena) { arena->offset = 0; }
+void arena_clear(Arena *arena) {
+    arena->offset = 0;
+    _pone_arena_decommit(arena);
+}
 
 void arena_destroy(Arena **arena) {
 
@@ -132,10 +332,6 @@ i32 arena_sprintf(Arena *arena, char **s, const char *fmt, ...) {
     return n;
 }
 
-static inline b8 _pone_is_power_of_two(usize n) {
-    return (n != 0 && (n & (n - 1)) == 0);
-}
-
 static usize _pone_align_address(usize addr, usize align) {
     pone_assert(_pone_is_power_of_two(align)); 
     addr += (align - 1) & -addr;
@@ -150,7 +346,9 @@ static void _pone_arena_create_sub_arena_aligned(Arena *arena, usize capacity,
 
     pone_assert(base + capacity <= (usize)arena->base + arena->capacity);
 
-    arena->offset = (base + capacity) - (usize)arena->base;
+    usize next_offset = (base + capacity) - (usize)arena->base;
+    _pone_arena_stats_record(arena, next_offset);
+    arena->offset = next_offset;
     *sub_arena = (Arena){
         .base = (void *)base,
         .offset = 0,
@@ -160,22 +358,134 @@ static void _pone_arena_create_sub_arena_aligned(Arena *arena, usize capacity,
 
 void pone_arena_create_sub_arena(Arena *arena, usize capacity,
                                  Arena *sub_arena) {
-    _pone_arena_create_sub_arena_aligned(arena, capacity, sub_arena,
-                                         alignof(max_align_t));
+    if (!(arena->flags & PONE_ARENA_FLAG_VIRTUAL)) {
+        _pone_arena_create_sub_arena_aligned(arena, capacity, sub_arena,
+                                             alignof(max_align_t));
+        return;
+    }
+
+    // Sub-arenas of a virtual arena own whole pages and commit them on
+    // their own. The parent never touches that range again, so it is
+    // counted as committed there, and it is never decommitted even when
+    // the parent is rewound below it while the sub-arena is still in use.
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    usize page_size = system_info.page_size;
+
+    capacity = _pone_align_address(capacity, page_size);
+    usize guard_size =
+        (arena->flags & PONE_ARENA_FLAG_GUARD_PAGE) ? page_size : 0;
+    _pone_arena_create_sub_arena_aligned(arena, capacity + guard_size,
+                                         sub_arena, page_size);
+    sub_arena->capacity = capacity;
+    sub_arena->flags = arena->flags;
+    if (arena->committed < arena->offset) {
+        arena->committed = arena->offset;
+    }
+    if (arena->sub_arena_end < arena->offset) {
+        arena->sub_arena_end = arena->offset;
+    }
+}
+
+b8 pone_arena_create_virtual(void *addr, usize capacity, u32 flags,
+                             Arena *arena) {
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    usize page_size = system_info.page_size;
+
+    capacity = _pone_align_address(capacity, page_size);
+    usize guard_size = (flags & PONE_ARENA_FLAG_GUARD_PAGE) ? page_size : 0;
+    void *base = pone_platform_reserve_memory(addr, capacity + guard_size);
+    if (!base) {
+        return 0;
+    }
+
+    *arena = (Arena){
+        .base = base,
+        .offset = 0,
+        .capacity = capacity,
+        .committed = 0,
+        .sub_arena_end = 0,
+        .flags = flags | PONE_ARENA_FLAG_VIRTUAL,
+    };
+
+    return 1;
 }
 
-PoneArenaTmp *pone_arena_tmp_begin(Arena *arena) {
-    usize offset = arena->offset;
-    PoneArenaTmp *tmp = (PoneArenaTmp *)arena_alloc(arena, sizeof(PoneArenaTmp));
+void pone_arena_release(Arena *arena) {
+    pone_assert(arena->flags & PONE_ARENA_FLAG_VIRTUAL);
 
-    *tmp = (PoneArenaTmp) {
-        .offset = offset,
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    usize guard_size = (arena->flags & PONE_ARENA_FLAG_GUARD_PAGE)
+                           ? system_info.page_size
+                           : 0;
+    pone_platform_release_memory(arena->base, arena->capacity + guard_size);
+    *arena = (Arena){};
+}
+
+PoneArenaTmp pone_arena_tmp_begin(Arena *arena) {
+#if defined(PONE_ARENA_STATS)
+    if (arena->stats) {
+        arena->stats->open_tmp_count++;
+    }
+#endif
+
+    return (PoneArenaTmp){
+        .offset = arena->offset,
         .arena = arena,
     };
+}
+
+void pone_arena_tmp_end(PoneArenaTmp tmp) {
+    Arena *arena = tmp.arena;
+#if defined(PONE_ARENA_STATS)
+    if (arena->stats) {
+        arena->stats->open_tmp_count--;
+    }
+#endif
+    arena->offset = tmp.offset;
+    _pone_arena_decommit(arena);
+}
+
+static thread_local Arena pone_scratch_arenas[PONE_SCRATCH_ARENA_COUNT];
+
+PoneArenaTmp pone_scratch_begin(Arena **conflicts, usize conflict_count) {
+    for (usize i = 0; i < PONE_SCRATCH_ARENA_COUNT; ++i) {
+        Arena *scratch = &pone_scratch_arenas[i];
+
+        b8 is_conflicting = 0;
+        for (usize j = 0; j < conflict_count; ++j) {
+            if (conflicts[j] == scratch) {
+                is_conflicting = 1;
+                break;
+            }
+        }
+        if (is_conflicting) {
+            continue;
+        }
+
+        if (!scratch->base) {
+            pone_arena_create_virtual(0, PONE_SCRATCH_ARENA_CAPACITY,
+                                      PONE_ARENA_FLAG_GUARD_PAGE, scratch);
+            PONE_ARENA_STATS_REGISTER(scratch, "thread scratch");
+        }
+
+        return pone_arena_tmp_begin(scratch);
+    }
 
-    return tmp;
+    pone_assert(0 && "every scratch arena conflicts");
+    return (PoneArenaTmp){};
 }
 
-void pone_arena_tmp_end(PoneArenaTmp *tmp) {
-    tmp->arena->offset = tmp->offset;
+void pone_scratch_end(PoneArenaTmp scratch) { pone_arena_tmp_end(scratch); }
+
+void pone_scratch_release(void) {
+    for (usize i = 0; i < PONE_SCRATCH_ARENA_COUNT; ++i) {
+        Arena *scratch = &pone_scratch_arenas[i];
+        if (scratch->base) {
+            PONE_ARENA_STATS_UNREGISTER(scratch);
+            pone_arena_release(scratch);
+        }
+    }
 }
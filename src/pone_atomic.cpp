@@ -1,60 +1,250 @@
 #include "pone_atomic.h"
-#include "windows.h"
+#include "pone_platform.h"
 
-struct PoneSemaphore {
-    volatile u32 val;
-};
+#define PONE_SPIN_COUNT 64
+#define PONE_MUTEX_MAX_SPIN_COUNT 256
 
-void pone_semaphore_init(PoneSemaphore *sem, u32 val) { sem->val = val; }
+#define PONE_RW_LOCK_WRITER 0x40000000u
+#define PONE_RW_LOCK_WAITERS 0x80000000u
+#define PONE_RW_LOCK_READER_MASK 0x3fffffffu
+
+void pone_semaphore_init(PoneSemaphore *sem, u32 val) {
+    _pone_atomic_store_n(&sem->val, val, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&sem->waiter_count, 0, PONE_MEMORY_ORDERING_RELAXED);
+}
 
 void pone_semaphore_signal(PoneSemaphore *sem) {
-    _pone_atomic_fetch_add(&sem->val, 1, PONE_MEMORY_ORDERING_RELEASE);
-    WakeByAddressSingle((void *)&sem->val);
+    _pone_atomic_fetch_add(&sem->val, 1, PONE_MEMORY_ORDERING_SEQ_CST);
+    if (_pone_atomic_load_n(&sem->waiter_count,
+                            PONE_MEMORY_ORDERING_SEQ_CST)) {
+        pone_platform_wake_by_address_single(&sem->val);
+    }
+}
+
+static b8 _pone_semaphore_try_wait(PoneSemaphore *sem) {
+    u32 curr_val = _pone_atomic_load_n(&sem->val, PONE_MEMORY_ORDERING_RELAXED);
+    while (curr_val) {
+        if (_pone_atomic_compare_exchange_n(&sem->val, &curr_val, curr_val - 1,
+                                            1, PONE_MEMORY_ORDERING_ACQUIRE,
+                                            PONE_MEMORY_ORDERING_RELAXED)) {
+            return 1;
+        }
+    }
+
+    return 0;
 }
 
 void pone_semaphore_wait(PoneSemaphore *sem) {
-    u32 curr_val = sem->val;
+    for (u32 i = 0; i < PONE_SPIN_COUNT; ++i) {
+        if (_pone_semaphore_try_wait(sem)) {
+            return;
+        }
+        _pone_cpu_relax();
+    }
 
+    // The waiter count is published before val is checked again, so a
+    // signal racing with us either sees it or leaves a count we can take.
+    _pone_atomic_fetch_add(&sem->waiter_count, 1, PONE_MEMORY_ORDERING_SEQ_CST);
+    while (!_pone_semaphore_try_wait(sem)) {
+        pone_platform_wait_on_address(&sem->val, 0);
+    }
+    _pone_atomic_fetch_sub(&sem->waiter_count, 1, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+void pone_mutex_init(PoneMutex *mutex) {
+    _pone_atomic_store_n(&mutex->state, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&mutex->spin_count, 0, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+void pone_mutex_lock(PoneMutex *mutex) {
+    u32 state = 0;
+    if (_pone_atomic_compare_exchange_n(&mutex->state, &state, 1, 0,
+                                        PONE_MEMORY_ORDERING_ACQUIRE,
+                                        PONE_MEMORY_ORDERING_RELAXED)) {
+        return;
+    }
+
+    // Spin a bit longer than it took on average recently, every thread
+    // nudges the estimate by 1/8 of its own observation.
+    u32 spin_count =
+        _pone_atomic_load_n(&mutex->spin_count, PONE_MEMORY_ORDERING_RELAXED);
+    u32 max_spin_count = spin_count * 2 + 10;
+    if (max_spin_count > PONE_MUTEX_MAX_SPIN_COUNT) {
+        max_spin_count = PONE_MUTEX_MAX_SPIN_COUNT;
+    }
+    for (u32 i = 0; i < max_spin_count; ++i) {
+        _pone_cpu_relax();
+        state =
+            _pone_atomic_load_n(&mutex->state, PONE_MEMORY_ORDERING_RELAXED);
+        if (state == 0 && _pone_atomic_compare_exchange_n(
+                              &mutex->state, &state, 1, 0,
+                              PONE_MEMORY_ORDERING_ACQUIRE,
+                              PONE_MEMORY_ORDERING_RELAXED)) {
+            i32 delta = ((i32)i - (i32)spin_count) / 8;
+            _pone_atomic_store_n(&mutex->spin_count, spin_count + delta,
+                                 PONE_MEMORY_ORDERING_RELAXED);
+            return;
+        }
+    }
+    i32 delta = ((i32)max_spin_count - (i32)spin_count) / 8;
+    _pone_atomic_store_n(&mutex->spin_count, spin_count + delta,
+                         PONE_MEMORY_ORDERING_RELAXED);
+
+    while (_pone_atomic_exchange_n(&mutex->state, 2,
+                                   PONE_MEMORY_ORDERING_ACQUIRE) != 0) {
+        pone_platform_wait_on_address(&mutex->state, 2);
+    }
+}
+
+void pone_mutex_unlock(PoneMutex *mutex) {
+    if (_pone_atomic_exchange_n(&mutex->state, 0,
+                                PONE_MEMORY_ORDERING_RELEASE) == 2) {
+        pone_platform_wake_by_address_single(&mutex->state);
+    }
+}
+
+void pone_rw_lock_init(PoneRwLock *lock) {
+    _pone_atomic_store_n(&lock->state, 0, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+// Marks the lock as having waiters and parks until state changes.
+static void _pone_rw_lock_park(PoneRwLock *lock, u32 state) {
+    if (!(state & PONE_RW_LOCK_WAITERS)) {
+        if (!_pone_atomic_compare_exchange_n(
+                &lock->state, &state, state | PONE_RW_LOCK_WAITERS, 0,
+                PONE_MEMORY_ORDERING_RELAXED, PONE_MEMORY_ORDERING_RELAXED)) {
+            return;
+        }
+    }
+    pone_platform_wait_on_address(&lock->state, state | PONE_RW_LOCK_WAITERS);
+}
+
+void pone_rw_lock_read_lock(PoneRwLock *lock) {
+    u32 spin_count = 0;
+    u32 state = _pone_atomic_load_n(&lock->state, PONE_MEMORY_ORDERING_RELAXED);
     for (;;) {
-        if (curr_val) {
-            if (_pone_atomic_compare_exchange_n(&sem->val, &curr_val,
-                                                curr_val - 1, 0,
-                                                PONE_MEMORY_ORDERING_ACQUIRE,
+        if (!(state & PONE_RW_LOCK_WRITER)) {
+            if (_pone_atomic_compare_exchange_n(&lock->state, &state, state + 1,
+                                                1, PONE_MEMORY_ORDERING_ACQUIRE,
                                                 PONE_MEMORY_ORDERING_RELAXED)) {
-                break;
+                return;
             }
+            continue;
+        }
+
+        if (spin_count < PONE_SPIN_COUNT) {
+            ++spin_count;
+            _pone_cpu_relax();
         } else {
-            WaitOnAddress((volatile void *)&sem->val, (void *)&curr_val,
-                          sizeof(u32), INFINITE);
-            curr_val = sem->val;
+            _pone_rw_lock_park(lock, state);
         }
+        state = _pone_atomic_load_n(&lock->state, PONE_MEMORY_ORDERING_RELAXED);
     }
 }
 
-struct PoneMutex {
-    volatile b8 flag;
-};
-
-void pone_mutex_init(PoneMutex *mutex) { mutex->flag = 0; }
+void pone_rw_lock_read_unlock(PoneRwLock *lock) {
+    u32 state = _pone_atomic_load_n(&lock->state, PONE_MEMORY_ORDERING_RELAXED);
+    for (;;) {
+        u32 new_state = state - 1;
+        if ((new_state & PONE_RW_LOCK_READER_MASK) == 0) {
+            new_state &= ~PONE_RW_LOCK_WAITERS;
+        }
+        if (_pone_atomic_compare_exchange_n(&lock->state, &state, new_state, 1,
+                                            PONE_MEMORY_ORDERING_RELEASE,
+                                            PONE_MEMORY_ORDERING_RELAXED)) {
+            if ((state & PONE_RW_LOCK_WAITERS) &&
+                !(new_state & PONE_RW_LOCK_WAITERS)) {
+                pone_platform_wake_by_address_all(&lock->state);
+            }
+            return;
+        }
+    }
+}
 
-void pone_mutex_lock(PoneMutex *mutex) {
-    b8 curr_flag = mutex->flag;
+void pone_rw_lock_write_lock(PoneRwLock *lock) {
+    u32 spin_count = 0;
+    u32 state = _pone_atomic_load_n(&lock->state, PONE_MEMORY_ORDERING_RELAXED);
     for (;;) {
-        if (!curr_flag) {
-            if (_pone_atomic_compare_exchange_n(&mutex->flag, &curr_flag, 1, 0,
-                                                PONE_MEMORY_ORDERING_ACQUIRE,
-                                                PONE_MEMORY_ORDERING_RELAXED)) {
-                break;
+        if ((state & ~PONE_RW_LOCK_WAITERS) == 0) {
+            if (_pone_atomic_compare_exchange_n(
+                    &lock->state, &state, state | PONE_RW_LOCK_WRITER, 1,
+                    PONE_MEMORY_ORDERING_ACQUIRE,
+                    PONE_MEMORY_ORDERING_RELAXED)) {
+                return;
             }
+            continue;
+        }
+
+        if (spin_count < PONE_SPIN_COUNT) {
+            ++spin_count;
+            _pone_cpu_relax();
         } else {
-            WaitOnAddress((volatile void *)&mutex->flag, (void *)&curr_flag,
-                          sizeof(b8), INFINITE);
-            curr_flag = mutex->flag;
+            _pone_rw_lock_park(lock, state);
         }
+        state = _pone_atomic_load_n(&lock->state, PONE_MEMORY_ORDERING_RELAXED);
     }
 }
 
-void pone_mutex_unlock(PoneMutex *mutex) {
-    _pone_atomic_clear(&mutex->flag, PONE_MEMORY_ORDERING_RELEASE);
-    WakeByAddressSingle((void *)&mutex->flag);
+void pone_rw_lock_write_unlock(PoneRwLock *lock) {
+    u32 state =
+        _pone_atomic_exchange_n(&lock->state, 0, PONE_MEMORY_ORDERING_RELEASE);
+    if (state & PONE_RW_LOCK_WAITERS) {
+        pone_platform_wake_by_address_all(&lock->state);
+    }
+}
+
+void pone_event_init(PoneEvent *event, b8 is_set) {
+    _pone_atomic_store_n(&event->is_set, (u32)is_set,
+                         PONE_MEMORY_ORDERING_RELAXED);
+}
+
+void pone_event_set(PoneEvent *event) {
+    if (!_pone_atomic_exchange_n(&event->is_set, 1,
+                                 PONE_MEMORY_ORDERING_RELEASE)) {
+        pone_platform_wake_by_address_all(&event->is_set);
+    }
+}
+
+void pone_event_reset(PoneEvent *event) {
+    _pone_atomic_store_n(&event->is_set, 0, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+void pone_event_wait(PoneEvent *event) {
+    for (u32 i = 0; i < PONE_SPIN_COUNT; ++i) {
+        if (_pone_atomic_load_n(&event->is_set, PONE_MEMORY_ORDERING_ACQUIRE)) {
+            return;
+        }
+        _pone_cpu_relax();
+    }
+
+    while (!_pone_atomic_load_n(&event->is_set, PONE_MEMORY_ORDERING_ACQUIRE)) {
+        pone_platform_wait_on_address(&event->is_set, 0);
+    }
+}
+
+void pone_condition_init(PoneCondition *cond) {
+    _pone_atomic_store_n(&cond->seq, 0, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+void pone_condition_wait(PoneCondition *cond, PoneMutex *mutex) {
+    u32 seq = _pone_atomic_load_n(&cond->seq, PONE_MEMORY_ORDERING_RELAXED);
+    pone_mutex_unlock(mutex);
+    pone_platform_wait_on_address(&cond->seq, seq);
+
+    // Relock as contended so whoever unlocks next wakes the other waiters
+    // that a broadcast let through.
+    while (_pone_atomic_exchange_n(&mutex->state, 2,
+                                   PONE_MEMORY_ORDERING_ACQUIRE) != 0) {
+        pone_platform_wait_on_address(&mutex->state, 2);
+    }
+}
+
+void pone_condition_signal(PoneCondition *cond) {
+    _pone_atomic_fetch_add(&cond->seq, 1, PONE_MEMORY_ORDERING_RELEASE);
+    pone_platform_wake_by_address_single(&cond->seq);
+}
+
+void pone_condition_broadcast(PoneCondition *cond) {
+    _pone_atomic_fetch_add(&cond->seq, 1, PONE_MEMORY_ORDERING_RELEASE);
+    pone_platform_wake_by_address_all(&cond->seq);
 }
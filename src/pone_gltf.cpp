@@ -50,7 +50,7 @@ static void pone_gltf_parse_accessor(PoneJsonObject *object, Arena *arena,
         PoneJsonValue *value = pair->value;
         if (pone_string_eq(
                 name, (PoneString){.buf = (u8 *)"bufferView", .len = 10})) {
-            accessor->buffer_view = (u32 *)arena_alloc(arena, sizeof(u32));
+            accessor->buffer_view = arena_alloc_struct(arena, u32);
             *accessor->buffer_view = (u32)value->number;
         } else if (pone_string_eq(name, (PoneString){.buf = (u8 *)"byteOffset",
                                                      .len = 10})) {
@@ -109,27 +109,34 @@ static void pone_gltf_parse_accessor(PoneJsonObject *object, Arena *arena,
 
             switch (accessor->component_type) {
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_BYTE: {
-                accessor->max = arena_alloc_array(arena, array->count, i8);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, i8);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                accessor->max = arena_alloc_array(arena, array->count, u8);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, u8);
             } break;
 
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_SHORT: {
-                accessor->max = arena_alloc_array(arena, array->count, i16);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, i16);
             } break;
 
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                accessor->max = arena_alloc_array(arena, array->count, u16);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, u16);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_INT: {
-                accessor->max = arena_alloc_array(arena, array->count, u32);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, u32);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT: {
-                accessor->max = arena_alloc_array(arena, array->count, f32);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, f32);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNKNOWN: {
-                accessor->max = arena_alloc_array(arena, array->count, f32);
+                accessor->max =
+                    arena_alloc_array_aligned(arena, array->count, f32);
             } break;
             }
 
@@ -179,27 +186,34 @@ static void pone_gltf_parse_accessor(PoneJsonObject *object, Arena *arena,
 
             switch (accessor->component_type) {
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_BYTE: {
-                accessor->min = arena_alloc_array(arena, array->count, i8);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, i8);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_BYTE: {
-                accessor->min = arena_alloc_array(arena, array->count, u8);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, u8);
             } break;
 
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_SHORT: {
-                accessor->min = arena_alloc_array(arena, array->count, i16);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, i16);
             } break;
 
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_SHORT: {
-                accessor->min = arena_alloc_array(arena, array->count, u16);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, u16);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNSIGNED_INT: {
-                accessor->min = arena_alloc_array(arena, array->count, u32);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, u32);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_FLOAT: {
-                accessor->min = arena_alloc_array(arena, array->count, f32);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, f32);
             } break;
             case PONE_GLTF_ACCESSOR_COMPONENT_TYPE_UNKNOWN: {
-                accessor->min = arena_alloc_array(arena, array->count, f32);
+                accessor->min =
+                    arena_alloc_array_aligned(arena, array->count, f32);
             } break;
             }
 
@@ -245,9 +259,9 @@ static void pone_gltf_parse_accessor(PoneJsonObject *object, Arena *arena,
         } else if (pone_string_eq(
                        name, (PoneString){.buf = (u8 *)"name", .len = 4})) {
             PONE_ASSERT(value->type == PONE_JSON_TYPE_STRING);
-            accessor->name =
-                (PoneString *)arena_alloc(arena, sizeof(PoneString));
-            accessor->name->buf = (u8 *)arena_alloc(arena, value->string.len);
+            accessor->name = arena_alloc_struct(arena, PoneString);
+            accessor->name->buf =
+                arena_alloc_array_aligned(arena, value->string.len, u8);
             accessor->name->len = value->string.len;
 
             pone_memcpy((void *)accessor->name->buf, (void *)value->string.buf,
@@ -286,7 +300,7 @@ static void pone_gltf_parse_mesh_primitive_attributes(
         PoneGltfMeshPrimitiveAttribute *attribute =
             &attributes[attribute_index];
 
-        u8 *buf = arena_alloc_array(arena, pair->name.len, u8);
+        u8 *buf = arena_alloc_array_aligned(arena, pair->name.len, u8);
         attribute->name.buf = buf;
         attribute->name.len = pair->name.len;
         pone_memcpy((void *)attribute->name.buf, (void *)pair->name.buf,
@@ -301,6 +315,8 @@ static void pone_gltf_parse_mesh_primitive(PoneJsonObject *object, Arena *arena,
                                            PoneGltfMeshPrimitive *primitive) {
     primitive->attributes = 0;
     primitive->attribute_count = 0;
+    primitive->indices = 0;
+    primitive->material = 0;
     primitive->mode = PONE_GLTF_TOPOLOGY_TYPE_TRIANGLES;
 
     for (PoneJsonPair *pair = object->pairs; pair; pair = pair->next) {
@@ -311,7 +327,7 @@ static void pone_gltf_parse_mesh_primitive(PoneJsonObject *object, Arena *arena,
                 name, (PoneString){.buf = (u8 *)"attributes", .len = 10})) {
             PONE_ASSERT(value->type == PONE_JSON_TYPE_OBJECT);
 
-            primitive->attributes = arena_alloc_array(
+            primitive->attributes = arena_alloc_array_aligned(
                 arena, value->object.count, PoneGltfMeshPrimitiveAttribute);
             primitive->attribute_count = value->object.count;
             pone_gltf_parse_mesh_primitive_attributes(&value->object, arena,
@@ -320,14 +336,14 @@ static void pone_gltf_parse_mesh_primitive(PoneJsonObject *object, Arena *arena,
                        name, (PoneString){.buf = (u8 *)"indices", .len = 7})) {
             PONE_ASSERT(value->type == PONE_JSON_TYPE_NUMBER);
 
-            primitive->indices = (u32 *)arena_alloc(arena, sizeof(u32));
+            primitive->indices = arena_alloc_struct(arena, u32);
 
             *primitive->indices = (u32)value->number;
         } else if (pone_string_eq(
                        name, (PoneString){.buf = (u8 *)"material", .len = 8})) {
             PONE_ASSERT(value->type == PONE_JSON_TYPE_NUMBER);
 
-            primitive->material = (u32 *)arena_alloc(arena, sizeof(u32));
+            primitive->material = arena_alloc_struct(arena, u32);
 
             *primitive->material = (u32)value->number;
         } else if (pone_string_eq(
@@ -370,8 +386,8 @@ static void pone_gltf_parse_mesh(PoneJsonObject *object, Arena *arena,
 
         if (pone_string_eq(name, {.buf = (u8 *)"primitives", .len = 10})) {
             PONE_ASSERT(value->type == PONE_JSON_TYPE_ARRAY);
-            mesh->primitives = arena_alloc_array(arena, value->array.count,
-                                                 PoneGltfMeshPrimitive);
+            mesh->primitives = arena_alloc_array_aligned(
+                arena, value->array.count, PoneGltfMeshPrimitive);
             mesh->primitive_count = value->array.count;
 
             pone_gltf_parse_mesh_primitives(&value->array, arena,
@@ -380,8 +396,9 @@ static void pone_gltf_parse_mesh(PoneJsonObject *object, Arena *arena,
             PONE_ASSERT(0);
         } else if (pone_string_eq(name, {.buf = (u8 *)"name", .len = 4})) {
             PONE_ASSERT(value->type == PONE_JSON_TYPE_STRING);
-            mesh->name = (PoneString *)arena_alloc(arena, sizeof(PoneString));
-            mesh->name->buf = (u8 *)arena_alloc(arena, value->string.len);
+            mesh->name = arena_alloc_struct(arena, PoneString);
+            mesh->name->buf =
+                arena_alloc_array_aligned(arena, value->string.len, u8);
             mesh->name->len = value->string.len;
             pone_memcpy((void *)mesh->name->buf, (void *)value->string.buf,
                         mesh->name->len);
@@ -407,15 +424,19 @@ static void pone_gltf_parse_meshes(PoneJsonArray *array, Arena *arena,
 
 static void pone_gltf_parse_buffer(PoneJsonObject *object, Arena *arena,
                                    PoneGltfBuffer *buffer) {
+    buffer->uri = 0;
+    buffer->byte_length = 0;
+    buffer->name = 0;
+
     PoneJsonPair *pair = object->pairs;
     for (usize buffer_index = 0; buffer_index < object->count; ++buffer_index) {
         PONE_ASSERT(pair);
 
         if (pone_string_eq(pair->name, {.buf = (u8 *)"uri", .len = 3})) {
             PONE_ASSERT(pair->value->type == PONE_JSON_TYPE_STRING);
-            PoneString *uri =
-                (PoneString *)arena_alloc(arena, sizeof(PoneString));
-            uri->buf = arena_alloc_array(arena, pair->value->string.len, u8);
+            PoneString *uri = arena_alloc_struct(arena, PoneString);
+            uri->buf =
+                arena_alloc_array_aligned(arena, pair->value->string.len, u8);
             uri->len = pair->value->string.len;
 
             buffer->uri = uri;
@@ -427,9 +448,9 @@ static void pone_gltf_parse_buffer(PoneJsonObject *object, Arena *arena,
         } else if (pone_string_eq(pair->name,
                                   {.buf = (u8 *)"byteLength", .len = 10})) {
             PONE_ASSERT(pair->value->type == PONE_JSON_TYPE_STRING);
-            PoneString *name =
-                (PoneString *)arena_alloc(arena, sizeof(PoneString));
-            name->buf = arena_alloc_array(arena, pair->value->string.len, u8);
+            PoneString *name = arena_alloc_struct(arena, PoneString);
+            name->buf =
+                arena_alloc_array_aligned(arena, pair->value->string.len, u8);
             name->len = pair->value->string.len;
 
             buffer->name = name;
@@ -459,6 +480,7 @@ static void pone_gltf_parse_buffer_view(PoneJsonObject *object, Arena *arena,
     buffer_view->byte_offset = 0;
     buffer_view->byte_stride = 0;
     buffer_view->target = PONE_GLTF_BUFFER_TYPE_NONE;
+    buffer_view->name = 0;
 
     PoneJsonPair *pair = object->pairs;
     for (usize pair_index = 0; pair_index < object->count; ++pair_index) {
@@ -490,9 +512,9 @@ static void pone_gltf_parse_buffer_view(PoneJsonObject *object, Arena *arena,
         } else if (pone_string_eq(pair->name,
                                   {.buf = (u8 *)"name", .len = 4})) {
             PONE_ASSERT(pair->value->type == PONE_JSON_TYPE_STRING);
-            PoneString *name =
-                (PoneString *)arena_alloc(arena, sizeof(PoneString));
-            name->buf = arena_alloc_array(arena, pair->value->string.len, u8);
+            PoneString *name = arena_alloc_struct(arena, PoneString);
+            name->buf =
+                arena_alloc_array_aligned(arena, pair->value->string.len, u8);
             name->len = pair->value->string.len;
 
             buffer_view->name = name;
@@ -611,7 +633,8 @@ void pone_gltf_get_mesh_primitive_index_data(PoneGltf *gltf, usize mesh_index,
 }
 
 PoneGltf *pone_gltf_parse(void *data, Arena *arena) {
-    PoneGltf *gltf = (PoneGltf *)arena_alloc(arena, sizeof(PoneGltf));
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_GLTF);
+    PoneGltf *gltf = arena_alloc_struct(arena, PoneGltf);
 
     pone_gltf_parse_header(data, &gltf->header);
     usize offset = 12;
@@ -638,7 +661,7 @@ PoneGltf *pone_gltf_parse(void *data, Arena *arena) {
                                                       .len = 9})) {
                     PONE_ASSERT(value->type == PONE_JSON_TYPE_ARRAY);
 
-                    gltf->accessors = arena_alloc_array(
+                    gltf->accessors = arena_alloc_array_aligned(
                         arena, value->array.count, PoneGltfAccessor);
                     gltf->accessor_count = value->array.count;
 
@@ -648,8 +671,8 @@ PoneGltf *pone_gltf_parse(void *data, Arena *arena) {
                                           {.buf = (u8 *)"meshes", .len = 6})) {
                     PONE_ASSERT(value->type == PONE_JSON_TYPE_ARRAY);
 
-                    gltf->meshes = arena_alloc_array(arena, value->array.count,
-                                                     PoneGltfMesh);
+                    gltf->meshes = arena_alloc_array_aligned(
+                        arena, value->array.count, PoneGltfMesh);
                     gltf->mesh_count = value->array.count;
 
                     pone_gltf_parse_meshes(&value->array, arena, gltf->meshes);
@@ -658,8 +681,9 @@ PoneGltf *pone_gltf_parse(void *data, Arena *arena) {
                     PONE_ASSERT(value->type == PONE_JSON_TYPE_ARRAY);
 
                     usize buffer_view_count = value->array.count;
-                    PoneGltfBufferView *buffer_views = arena_alloc_array(
-                        arena, buffer_view_count, PoneGltfBufferView);
+                    PoneGltfBufferView *buffer_views =
+                        arena_alloc_array_aligned(arena, buffer_view_count,
+                                                  PoneGltfBufferView);
 
                     pone_gltf_parse_buffer_views(&value->array, arena,
                                                  buffer_views);
@@ -671,8 +695,8 @@ PoneGltf *pone_gltf_parse(void *data, Arena *arena) {
                     PONE_ASSERT(value->type == PONE_JSON_TYPE_ARRAY);
 
                     usize buffer_count = value->array.count;
-                    PoneGltfBuffer *buffers =
-                        arena_alloc_array(arena, buffer_count, PoneGltfBuffer);
+                    PoneGltfBuffer *buffers = arena_alloc_array_aligned(
+                        arena, buffer_count, PoneGltfBuffer);
 
                     pone_gltf_parse_buffers(&value->array, arena, buffers);
 
@@ -692,5 +716,7 @@ PoneGltf *pone_gltf_parse(void *data, Arena *arena) {
         offset += 2 * sizeof(u32) + chunk.length;
     }
 
+    PONE_ARENA_TAG_END();
+
     return gltf;
 }
@@ -0,0 +1,84 @@
+#include "pone_hash.h"
+
+#define PONE_HASH_PRIME_64_1 0x9e3779b185ebca87ull
+#define PONE_HASH_PRIME_64_2 0xc2b2ae3d27d4eb4full
+#define PONE_HASH_PRIME_64_3 0x165667b19e3779f9ull
+#define PONE_HASH_PRIME_64_4 0x85ebca77c2b2ae63ull
+#define PONE_HASH_PRIME_64_5 0x27d4eb2f165667c5ull
+
+typedef u32 pone_hash_unaligned_u32 __attribute__((aligned(1), may_alias));
+typedef u64 pone_hash_unaligned_u64 __attribute__((aligned(1), may_alias));
+
+static inline u64 pone_hash_rotl_64(u64 x, u32 r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static inline u64 pone_hash_round(u64 acc, u64 input) {
+    acc += input * PONE_HASH_PRIME_64_2;
+    acc = pone_hash_rotl_64(acc, 31);
+    return acc * PONE_HASH_PRIME_64_1;
+}
+
+static inline u64 pone_hash_merge_round(u64 acc, u64 val) {
+    acc ^= pone_hash_round(0, val);
+    return acc * PONE_HASH_PRIME_64_1 + PONE_HASH_PRIME_64_4;
+}
+
+u64 pone_hash_64(void *data, usize size, u64 seed) {
+    u8 *p = (u8 *)data;
+    u8 *end = p + size;
+    u64 h;
+
+    if (size >= 32) {
+        // Four independent lanes keep the multipliers busy.
+        u64 v1 = seed + PONE_HASH_PRIME_64_1 + PONE_HASH_PRIME_64_2;
+        u64 v2 = seed + PONE_HASH_PRIME_64_2;
+        u64 v3 = seed;
+        u64 v4 = seed - PONE_HASH_PRIME_64_1;
+        u8 *limit = end - 32;
+        do {
+            v1 = pone_hash_round(v1, *(pone_hash_unaligned_u64 *)p);
+            v2 = pone_hash_round(v2, *(pone_hash_unaligned_u64 *)(p + 8));
+            v3 = pone_hash_round(v3, *(pone_hash_unaligned_u64 *)(p + 16));
+            v4 = pone_hash_round(v4, *(pone_hash_unaligned_u64 *)(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = pone_hash_rotl_64(v1, 1) + pone_hash_rotl_64(v2, 7) +
+            pone_hash_rotl_64(v3, 12) + pone_hash_rotl_64(v4, 18);
+        h = pone_hash_merge_round(h, v1);
+        h = pone_hash_merge_round(h, v2);
+        h = pone_hash_merge_round(h, v3);
+        h = pone_hash_merge_round(h, v4);
+    } else {
+        h = seed + PONE_HASH_PRIME_64_5;
+    }
+
+    h += (u64)size;
+
+    while (p + 8 <= end) {
+        h ^= pone_hash_round(0, *(pone_hash_unaligned_u64 *)p);
+        h = pone_hash_rotl_64(h, 27) * PONE_HASH_PRIME_64_1 +
+            PONE_HASH_PRIME_64_4;
+        p += 8;
+    }
+    if (p + 4 <= end) {
+        h ^= (u64)(*(pone_hash_unaligned_u32 *)p) * PONE_HASH_PRIME_64_1;
+        h = pone_hash_rotl_64(h, 23) * PONE_HASH_PRIME_64_2 +
+            PONE_HASH_PRIME_64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (u64)(*p) * PONE_HASH_PRIME_64_5;
+        h = pone_hash_rotl_64(h, 11) * PONE_HASH_PRIME_64_1;
+        p++;
+    }
+
+    h ^= h >> 33;
+    h *= PONE_HASH_PRIME_64_2;
+    h ^= h >> 29;
+    h *= PONE_HASH_PRIME_64_3;
+    h ^= h >> 32;
+
+    return h;
+}
@@ -0,0 +1,195 @@
+#include "pone_job.h"
+
+#include "pone_assert.h"
+#include "pone_memory.h"
+
+#define PONE_JOB_SEALED 0x80000000u
+#define PONE_JOB_CHUNKS_PER_THREAD 4
+
+void pone_job_system_init(PoneJobSystem *system, PoneThreadPool *pool,
+                          usize job_capacity, Arena *arena) {
+    system->pool = pool;
+    pone_atomic_pool_init_struct(&system->job_pool, arena, PoneJob,
+                                 job_capacity);
+}
+
+static void _pone_job_execute(void *user_data);
+
+static void _pone_job_release_dependency(PoneJob *job) {
+    if (_pone_atomic_fetch_sub(&job->dependency_count, 1,
+                               PONE_MEMORY_ORDERING_ACQ_REL) == 1) {
+        pone_thread_pool_push(job->system->pool, _pone_job_execute,
+                              (void *)job);
+    }
+}
+
+static void _pone_job_finish(PoneJob *job) {
+    // Sealing makes every later pone_job_add_dependency skip this job, the
+    // ones that got a slot before may still be writing it.
+    u32 continuation_count =
+        _pone_atomic_fetch_or(&job->continuation_count, PONE_JOB_SEALED,
+                              PONE_MEMORY_ORDERING_ACQ_REL);
+    for (u32 i = 0; i < continuation_count; ++i) {
+        PoneJob *continuation;
+        while (!(continuation = _pone_atomic_load_n(
+                     &job->continuations[i], PONE_MEMORY_ORDERING_ACQUIRE))) {
+            _pone_cpu_relax();
+        }
+        _pone_job_release_dependency(continuation);
+    }
+
+    PoneJob *parent = job->parent;
+    // Waiters poll is_finished while they help with other work, nobody
+    // sleeps on it.
+    _pone_atomic_store_n(&job->is_finished, 1, PONE_MEMORY_ORDERING_RELEASE);
+
+    if (parent && _pone_atomic_fetch_sub(&parent->unfinished_count, 1,
+                                         PONE_MEMORY_ORDERING_ACQ_REL) == 1) {
+        _pone_job_finish(parent);
+    }
+
+    pone_job_release(job->system, job);
+}
+
+static void _pone_job_execute(void *user_data) {
+    PoneJob *job = (PoneJob *)user_data;
+    if (job->fn) {
+        (job->fn)(job->system, job, job->user_data);
+    }
+
+    if (_pone_atomic_fetch_sub(&job->unfinished_count, 1,
+                               PONE_MEMORY_ORDERING_ACQ_REL) == 1) {
+        _pone_job_finish(job);
+    }
+}
+
+PoneJob *pone_job_create(PoneJobSystem *system, PoneJobFn fn,
+                         void *user_data) {
+    PoneJob *job = pone_atomic_pool_alloc_struct(&system->job_pool, PoneJob);
+    pone_assert(job);
+    pone_memset((void *)job, 0, sizeof(PoneJob));
+
+    job->system = system;
+    job->fn = fn;
+    job->user_data = user_data;
+    _pone_atomic_store_n(&job->dependency_count, 1,
+                         PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&job->unfinished_count, 1,
+                         PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&job->ref_count, 2, PONE_MEMORY_ORDERING_RELAXED);
+
+    return job;
+}
+
+PoneJob *pone_job_create_child(PoneJobSystem *system, PoneJob *parent,
+                               PoneJobFn fn, void *user_data) {
+    PoneJob *job = pone_job_create(system, fn, user_data);
+    job->parent = parent;
+    _pone_atomic_fetch_add(&parent->unfinished_count, 1,
+                           PONE_MEMORY_ORDERING_RELAXED);
+
+    return job;
+}
+
+void pone_job_add_dependency(PoneJob *job, PoneJob *dependency) {
+    // Counted first, so the dependency can not run job before it is stored.
+    _pone_atomic_fetch_add(&job->dependency_count, 1,
+                           PONE_MEMORY_ORDERING_RELAXED);
+
+    u32 index = _pone_atomic_fetch_add(&dependency->continuation_count, 1,
+                                       PONE_MEMORY_ORDERING_ACQ_REL);
+    if (index & PONE_JOB_SEALED) {
+        // Already finished. job still holds its submit count, so this can
+        // not hit zero.
+        _pone_atomic_fetch_sub(&job->dependency_count, 1,
+                               PONE_MEMORY_ORDERING_RELAXED);
+        return;
+    }
+
+    pone_assert(index < PONE_JOB_MAX_CONTINUATIONS);
+    _pone_atomic_store_n(&dependency->continuations[index], job,
+                         PONE_MEMORY_ORDERING_RELEASE);
+}
+
+void pone_job_submit(PoneJobSystem *system, PoneJob *job) {
+    pone_assert(job->system == system);
+    _pone_job_release_dependency(job);
+}
+
+void pone_job_wait(PoneJobSystem *system, PoneJob *job) {
+    while (!_pone_atomic_load_n(&job->is_finished,
+                                PONE_MEMORY_ORDERING_ACQUIRE)) {
+        if (!pone_thread_pool_try_consume_work(system->pool)) {
+            pone_platform_yield_thread();
+        }
+    }
+
+    pone_job_release(system, job);
+}
+
+void pone_job_release(PoneJobSystem *system, PoneJob *job) {
+    if (_pone_atomic_fetch_sub(&job->ref_count, 1,
+                               PONE_MEMORY_ORDERING_ACQ_REL) == 1) {
+        pone_atomic_pool_free(&system->job_pool, (void *)job);
+    }
+}
+
+void pone_job_run_and_wait(PoneJobSystem *system, PoneJob *job) {
+    pone_job_submit(system, job);
+    pone_job_wait(system, job);
+}
+
+// Halves the range and hands the upper half to a child until what is left
+// fits one chunk, thieves then take the biggest pieces first.
+static void _pone_job_parallel_for(PoneJobSystem *system, PoneJob *job,
+                                   void *user_data) {
+    usize begin = job->range_begin;
+    usize end = job->range_end;
+    while (end - begin > job->range_chunk_size) {
+        usize mid = begin + (end - begin) / 2;
+
+        PoneJob *child = pone_job_create_child(system, job,
+                                               _pone_job_parallel_for,
+                                               user_data);
+        child->range_fn = job->range_fn;
+        child->range_begin = mid;
+        child->range_end = end;
+        child->range_chunk_size = job->range_chunk_size;
+        pone_job_submit(system, child);
+        pone_job_release(system, child);
+
+        end = mid;
+    }
+
+    if (begin < end) {
+        (job->range_fn)(user_data, begin, end);
+    }
+}
+
+PoneJob *pone_job_create_parallel_for(PoneJobSystem *system, usize count,
+                                      usize chunk_size, PoneJobRangeFn fn,
+                                      void *user_data) {
+    if (chunk_size == 0) {
+        usize thread_count = system->pool->worker_count + 1;
+        chunk_size = count / (thread_count * PONE_JOB_CHUNKS_PER_THREAD);
+        if (chunk_size == 0) {
+            chunk_size = 1;
+        }
+    }
+
+    PoneJob *job = pone_job_create(system, _pone_job_parallel_for, user_data);
+    job->range_fn = fn;
+    job->range_begin = 0;
+    job->range_end = count;
+    job->range_chunk_size = chunk_size;
+
+    return job;
+}
+
+void pone_job_parallel_for(PoneJobSystem *system, usize count,
+                           usize chunk_size, PoneJobRangeFn fn,
+                           void *user_data) {
+    PoneJob *job =
+        pone_job_create_parallel_for(system, count, chunk_size, fn, user_data);
+    pone_job_run_and_wait(system, job);
+}
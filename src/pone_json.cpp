@@ -93,6 +93,8 @@ static void pone_json_scanner_parse_object(PoneJsonScanner *s, Arena *arena,
                                            PoneJsonObject *object) {
     ++s->cursor;
     pone_json_scanner_skip_whitespace(s);
+    // Arena memory is not zeroed, the list is terminated after the loop.
+    object->count = 0;
     u8 b;
     PoneJsonPair **pair = &object->pairs;
     while (!pone_json_scanner_is_eof(s) &&
@@ -101,13 +103,12 @@ static void pone_json_scanner_parse_object(PoneJsonScanner *s, Arena *arena,
             ++s->cursor;
             pone_json_scanner_skip_whitespace(s);
         }
-        *pair = (PoneJsonPair *)arena_alloc(arena, sizeof(PoneJsonPair));
+        *pair = arena_alloc_struct(arena, PoneJsonPair);
         PONE_ASSERT(*pair);
         pone_json_scanner_parse_string(s, arena, &(*pair)->name);
         PONE_ASSERT(pone_json_scanner_peek(s) == ':');
         ++s->cursor;
-        (*pair)->value =
-            (PoneJsonValue *)arena_alloc(arena, sizeof(PoneJsonValue));
+        (*pair)->value = arena_alloc_struct(arena, PoneJsonValue);
         PONE_ASSERT((*pair)->value);
         pone_json_scanner_skip_whitespace(s);
         _pone_json_scanner_parse_value(s, arena, (*pair)->value);
@@ -115,6 +116,7 @@ static void pone_json_scanner_parse_object(PoneJsonScanner *s, Arena *arena,
         pair = &(*pair)->next;
         ++object->count;
     }
+    *pair = 0;
 
     ++s->cursor;
 }
@@ -123,6 +125,8 @@ static void pone_json_scanner_parse_array(PoneJsonScanner *s, Arena *arena,
                                           PoneJsonArray *array) {
     ++s->cursor;
     pone_json_scanner_skip_whitespace(s);
+    array->values = 0;
+    array->count = 0;
     u8 b;
     PoneJsonArrayValue **array_value = &array->values;
     while (!pone_json_scanner_is_eof(s) &&
@@ -131,11 +135,9 @@ static void pone_json_scanner_parse_array(PoneJsonScanner *s, Arena *arena,
             ++s->cursor;
             pone_json_scanner_skip_whitespace(s);
         }
-        *array_value = (PoneJsonArrayValue *)arena_alloc(
-            arena, sizeof(PoneJsonArrayValue));
+        *array_value = arena_alloc_struct(arena, PoneJsonArrayValue);
         PONE_ASSERT(*array_value);
-        (*array_value)->value =
-            (PoneJsonValue *)arena_alloc(arena, sizeof(PoneJsonValue));
+        (*array_value)->value = arena_alloc_struct(arena, PoneJsonValue);
         PONE_ASSERT((*array_value)->value);
         (*array_value)->next = 0;
         _pone_json_scanner_parse_value(s, arena, (*array_value)->value);
@@ -148,10 +150,11 @@ static void pone_json_scanner_parse_array(PoneJsonScanner *s, Arena *arena,
 }
 
 PoneJsonValue *pone_json_scanner_parse_value(PoneJsonScanner *s, Arena *arena) {
-    PoneJsonValue *value =
-        (PoneJsonValue *)arena_alloc(arena, sizeof(PoneJsonValue));
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_JSON);
+    PoneJsonValue *value = arena_alloc_struct(arena, PoneJsonValue);
     PONE_ASSERT(value);
     _pone_json_scanner_parse_value(s, arena, value);
+    PONE_ARENA_TAG_END();
 
     return value;
 }
@@ -54,6 +54,77 @@ f32 pone_f32_signum(f32 x) {
     }
 }
 
+// Rounds to nearest even. Values too large for a half become infinity,
+// values too small become half subnormals or zero.
+u16 pone_f32_to_f16(f32 x) {
+    union {
+        f32 f;
+        u32 u;
+    } value;
+    value.f = x;
+
+    u32 sign = (value.u >> 16) & 0x8000;
+    u32 exponent = (value.u >> 23) & 0xFF;
+    u32 mantissa = value.u & 0x7FFFFF;
+
+    if (exponent == 0xFF) {
+        return (u16)(sign | 0x7C00 | (mantissa ? 0x200 : 0));
+    }
+
+    i32 half_exponent = (i32)exponent - 127 + 15;
+    if (half_exponent >= 0x1F) {
+        return (u16)(sign | 0x7C00);
+    }
+
+    if (half_exponent <= 0) {
+        if (half_exponent < -10) {
+            return (u16)sign;
+        }
+        mantissa |= 0x800000;
+        u32 shift = (u32)(14 - half_exponent);
+        u32 half_mantissa = mantissa >> shift;
+        u32 remainder = mantissa & ((1u << shift) - 1);
+        u32 halfway = 1u << (shift - 1);
+        if (remainder > halfway ||
+            (remainder == halfway && (half_mantissa & 1))) {
+            half_mantissa++;
+        }
+        return (u16)(sign | half_mantissa);
+    }
+
+    u32 half = ((u32)half_exponent << 10) | (mantissa >> 13);
+    u32 remainder = mantissa & 0x1FFF;
+    // A carry out of the mantissa correctly bumps the exponent, up to
+    // infinity.
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) {
+        half++;
+    }
+
+    return (u16)(sign | half);
+}
+
+f32 pone_f16_to_f32(u16 x) {
+    union {
+        f32 f;
+        u32 u;
+    } value;
+
+    u32 sign = ((u32)x & 0x8000) << 16;
+    u32 exponent = ((u32)x >> 10) & 0x1F;
+    u32 mantissa = (u32)x & 0x3FF;
+    if (exponent == 0x1F) {
+        value.u = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+        // Subnormal halves are normal floats.
+        value.f = (f32)mantissa * (1.0f / 16777216.0f);
+        value.u |= sign;
+    } else {
+        value.u = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+
+    return value.f;
+}
+
 f32 pone_abs(f32 x) {
     union {
         f32 f;
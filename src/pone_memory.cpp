@@ -1,18 +1,388 @@
 #include "pone_memory.h"
 
-void *pone_memcpy(void *dst, void *src, usize len) {
+#include "pone_platform.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PONE_MEMORY_X64
+#include <immintrin.h>
+#endif
+
+// Copies up to this size are done with a couple of overlapping vector
+// loads/stores, anything bigger goes through the aligned loop.
+#define PONE_MEMORY_MEDIUM_MAX 256
+// Above this size the destination is not going to stay in cache anyway
+// (staging buffers, atlas uploads), so we bypass it with streaming stores.
+#define PONE_MEMORY_NON_TEMPORAL_THRESHOLD MEGABYTES((usize)2)
+
+typedef u16 pone_unaligned_u16 __attribute__((aligned(1), may_alias));
+typedef u32 pone_unaligned_u32 __attribute__((aligned(1), may_alias));
+typedef u64 pone_unaligned_u64 __attribute__((aligned(1), may_alias));
+
+typedef void *(*PoneMemcpyFn)(void *dst, void *src, usize len);
+typedef void (*PoneMemsetFn)(void *p, u8 c, usize n);
+
+static inline void pone_memcpy_small(u8 *d, u8 *s, usize len) {
+    // len <= 16, head and tail loads overlap for sizes in between.
+    if (len >= 8) {
+        u64 head = *(pone_unaligned_u64 *)s;
+        u64 tail = *(pone_unaligned_u64 *)(s + len - 8);
+        *(pone_unaligned_u64 *)d = head;
+        *(pone_unaligned_u64 *)(d + len - 8) = tail;
+    } else if (len >= 4) {
+        u32 head = *(pone_unaligned_u32 *)s;
+        u32 tail = *(pone_unaligned_u32 *)(s + len - 4);
+        *(pone_unaligned_u32 *)d = head;
+        *(pone_unaligned_u32 *)(d + len - 4) = tail;
+    } else if (len >= 2) {
+        u16 head = *(pone_unaligned_u16 *)s;
+        u16 tail = *(pone_unaligned_u16 *)(s + len - 2);
+        *(pone_unaligned_u16 *)d = head;
+        *(pone_unaligned_u16 *)(d + len - 2) = tail;
+    } else if (len) {
+        *d = *s;
+    }
+}
+
+static inline void pone_memset_small(u8 *d, u64 c8, usize n) {
+    if (n >= 8) {
+        *(pone_unaligned_u64 *)d = c8;
+        *(pone_unaligned_u64 *)(d + n - 8) = c8;
+    } else if (n >= 4) {
+        *(pone_unaligned_u32 *)d = (u32)c8;
+        *(pone_unaligned_u32 *)(d + n - 4) = (u32)c8;
+    } else if (n >= 2) {
+        *(pone_unaligned_u16 *)d = (u16)c8;
+        *(pone_unaligned_u16 *)(d + n - 2) = (u16)c8;
+    } else if (n) {
+        *d = (u8)c8;
+    }
+}
+
+#if !defined(PONE_MEMORY_X64)
+
+static void *pone_memcpy_scalar(void *dst, void *src, usize len) {
+    u8 *d = (u8 *)dst;
+    u8 *s = (u8 *)src;
+    if (len <= 16) {
+        pone_memcpy_small(d, s, len);
+        return dst;
+    }
+
+    for (; len >= 8; len -= 8) {
+        *(pone_unaligned_u64 *)d = *(pone_unaligned_u64 *)s;
+        d += 8;
+        s += 8;
+    }
+    pone_memcpy_small(d, s, len);
+
+    return dst;
+}
+
+static void pone_memset_scalar(void *p, u8 c, usize n) {
+    u8 *d = (u8 *)p;
+    u64 c8 = (u64)c * 0x0101010101010101ull;
+    if (n <= 16) {
+        pone_memset_small(d, c8, n);
+        return;
+    }
+
+    for (; n >= 8; n -= 8) {
+        *(pone_unaligned_u64 *)d = c8;
+        d += 8;
+    }
+    pone_memset_small(d, c8, n);
+}
+
+#else
+
+static void *pone_memcpy_sse2(void *dst, void *src, usize len) {
     u8 *d = (u8 *)dst;
     u8 *s = (u8 *)src;
-    for (; len; len--) {
-        *d++ = *s++;
+    if (len <= 16) {
+        pone_memcpy_small(d, s, len);
+        return dst;
+    }
+    if (len <= 32) {
+        __m128i head = _mm_loadu_si128((__m128i *)s);
+        __m128i tail = _mm_loadu_si128((__m128i *)(s + len - 16));
+        _mm_storeu_si128((__m128i *)d, head);
+        _mm_storeu_si128((__m128i *)(d + len - 16), tail);
+        return dst;
+    }
+    if (len <= 64) {
+        // Two vectors from each end, which overlap below 64 bytes.
+        __m128i head_a = _mm_loadu_si128((__m128i *)s);
+        __m128i head_b = _mm_loadu_si128((__m128i *)(s + 16));
+        __m128i tail_a = _mm_loadu_si128((__m128i *)(s + len - 32));
+        __m128i tail_b = _mm_loadu_si128((__m128i *)(s + len - 16));
+        _mm_storeu_si128((__m128i *)d, head_a);
+        _mm_storeu_si128((__m128i *)(d + 16), head_b);
+        _mm_storeu_si128((__m128i *)(d + len - 32), tail_a);
+        _mm_storeu_si128((__m128i *)(d + len - 16), tail_b);
+        return dst;
     }
 
+    // The last 16 bytes are always written with one unaligned store at the
+    // end, so every loop below may overshoot into them.
+    __m128i tail = _mm_loadu_si128((__m128i *)(s + len - 16));
+    u8 *d_tail = d + len - 16;
+
+    if (len > PONE_MEMORY_MEDIUM_MAX) {
+        __m128i head = _mm_loadu_si128((__m128i *)s);
+        _mm_storeu_si128((__m128i *)d, head);
+        usize skew = 16 - ((usize)d & 15);
+        d += skew;
+        s += skew;
+
+        if (len >= PONE_MEMORY_NON_TEMPORAL_THRESHOLD) {
+            for (; d + 64 <= d_tail; d += 64, s += 64) {
+                __m128i a = _mm_loadu_si128((__m128i *)s);
+                __m128i b = _mm_loadu_si128((__m128i *)(s + 16));
+                __m128i c = _mm_loadu_si128((__m128i *)(s + 32));
+                __m128i e = _mm_loadu_si128((__m128i *)(s + 48));
+                _mm_stream_si128((__m128i *)d, a);
+                _mm_stream_si128((__m128i *)(d + 16), b);
+                _mm_stream_si128((__m128i *)(d + 32), c);
+                _mm_stream_si128((__m128i *)(d + 48), e);
+            }
+            _mm_sfence();
+        } else {
+            for (; d + 64 <= d_tail; d += 64, s += 64) {
+                __m128i a = _mm_loadu_si128((__m128i *)s);
+                __m128i b = _mm_loadu_si128((__m128i *)(s + 16));
+                __m128i c = _mm_loadu_si128((__m128i *)(s + 32));
+                __m128i e = _mm_loadu_si128((__m128i *)(s + 48));
+                _mm_store_si128((__m128i *)d, a);
+                _mm_store_si128((__m128i *)(d + 16), b);
+                _mm_store_si128((__m128i *)(d + 32), c);
+                _mm_store_si128((__m128i *)(d + 48), e);
+            }
+        }
+    }
+
+    for (; d < d_tail; d += 16, s += 16) {
+        _mm_storeu_si128((__m128i *)d, _mm_loadu_si128((__m128i *)s));
+    }
+    _mm_storeu_si128((__m128i *)d_tail, tail);
+
     return dst;
 }
 
-void pone_memset(void *p, u8 c, usize n) {
-    for (usize i = 0; i < n; ++i) {
-        u8 *b = (u8 *)p + i;
-        *b = c;
+static void pone_memset_sse2(void *p, u8 c, usize n) {
+    u8 *d = (u8 *)p;
+    if (n <= 16) {
+        pone_memset_small(d, (u64)c * 0x0101010101010101ull, n);
+        return;
+    }
+
+    __m128i v = _mm_set1_epi8((char)c);
+    u8 *d_tail = d + n - 16;
+    _mm_storeu_si128((__m128i *)d, v);
+    if (n <= 32) {
+        _mm_storeu_si128((__m128i *)d_tail, v);
+        return;
+    }
+    if (n <= 64) {
+        _mm_storeu_si128((__m128i *)(d + 16), v);
+        _mm_storeu_si128((__m128i *)(d_tail - 16), v);
+        _mm_storeu_si128((__m128i *)d_tail, v);
+        return;
+    }
+
+    d += 16 - ((usize)d & 15);
+    if (n >= PONE_MEMORY_NON_TEMPORAL_THRESHOLD) {
+        for (; d + 64 <= d_tail; d += 64) {
+            _mm_stream_si128((__m128i *)d, v);
+            _mm_stream_si128((__m128i *)(d + 16), v);
+            _mm_stream_si128((__m128i *)(d + 32), v);
+            _mm_stream_si128((__m128i *)(d + 48), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; d + 64 <= d_tail; d += 64) {
+            _mm_store_si128((__m128i *)d, v);
+            _mm_store_si128((__m128i *)(d + 16), v);
+            _mm_store_si128((__m128i *)(d + 32), v);
+            _mm_store_si128((__m128i *)(d + 48), v);
+        }
+    }
+    for (; d < d_tail; d += 16) {
+        _mm_store_si128((__m128i *)d, v);
     }
+    _mm_storeu_si128((__m128i *)d_tail, v);
 }
+
+__attribute__((target("avx2"))) static void *
+pone_memcpy_avx2(void *dst, void *src, usize len) {
+    u8 *d = (u8 *)dst;
+    u8 *s = (u8 *)src;
+    if (len <= 16) {
+        pone_memcpy_small(d, s, len);
+        return dst;
+    }
+    if (len <= 32) {
+        __m128i head = _mm_loadu_si128((__m128i *)s);
+        __m128i tail = _mm_loadu_si128((__m128i *)(s + len - 16));
+        _mm_storeu_si128((__m128i *)d, head);
+        _mm_storeu_si128((__m128i *)(d + len - 16), tail);
+        return dst;
+    }
+    if (len <= 64) {
+        __m256i head = _mm256_loadu_si256((__m256i *)s);
+        __m256i tail = _mm256_loadu_si256((__m256i *)(s + len - 32));
+        _mm256_storeu_si256((__m256i *)d, head);
+        _mm256_storeu_si256((__m256i *)(d + len - 32), tail);
+        return dst;
+    }
+    if (len <= 128) {
+        // Two vectors from each end, which overlap below 128 bytes.
+        __m256i head_a = _mm256_loadu_si256((__m256i *)s);
+        __m256i head_b = _mm256_loadu_si256((__m256i *)(s + 32));
+        __m256i tail_a = _mm256_loadu_si256((__m256i *)(s + len - 64));
+        __m256i tail_b = _mm256_loadu_si256((__m256i *)(s + len - 32));
+        _mm256_storeu_si256((__m256i *)d, head_a);
+        _mm256_storeu_si256((__m256i *)(d + 32), head_b);
+        _mm256_storeu_si256((__m256i *)(d + len - 64), tail_a);
+        _mm256_storeu_si256((__m256i *)(d + len - 32), tail_b);
+        return dst;
+    }
+
+    __m256i tail = _mm256_loadu_si256((__m256i *)(s + len - 32));
+    u8 *d_tail = d + len - 32;
+
+    if (len > PONE_MEMORY_MEDIUM_MAX) {
+        __m256i head = _mm256_loadu_si256((__m256i *)s);
+        _mm256_storeu_si256((__m256i *)d, head);
+        usize skew = 32 - ((usize)d & 31);
+        d += skew;
+        s += skew;
+
+        if (len >= PONE_MEMORY_NON_TEMPORAL_THRESHOLD) {
+            for (; d + 128 <= d_tail; d += 128, s += 128) {
+                __m256i a = _mm256_loadu_si256((__m256i *)s);
+                __m256i b = _mm256_loadu_si256((__m256i *)(s + 32));
+                __m256i c = _mm256_loadu_si256((__m256i *)(s + 64));
+                __m256i e = _mm256_loadu_si256((__m256i *)(s + 96));
+                _mm256_stream_si256((__m256i *)d, a);
+                _mm256_stream_si256((__m256i *)(d + 32), b);
+                _mm256_stream_si256((__m256i *)(d + 64), c);
+                _mm256_stream_si256((__m256i *)(d + 96), e);
+            }
+            _mm_sfence();
+        } else {
+            for (; d + 128 <= d_tail; d += 128, s += 128) {
+                __m256i a = _mm256_loadu_si256((__m256i *)s);
+                __m256i b = _mm256_loadu_si256((__m256i *)(s + 32));
+                __m256i c = _mm256_loadu_si256((__m256i *)(s + 64));
+                __m256i e = _mm256_loadu_si256((__m256i *)(s + 96));
+                _mm256_store_si256((__m256i *)d, a);
+                _mm256_store_si256((__m256i *)(d + 32), b);
+                _mm256_store_si256((__m256i *)(d + 64), c);
+                _mm256_store_si256((__m256i *)(d + 96), e);
+            }
+        }
+    }
+
+    for (; d < d_tail; d += 32, s += 32) {
+        _mm256_storeu_si256((__m256i *)d, _mm256_loadu_si256((__m256i *)s));
+    }
+    _mm256_storeu_si256((__m256i *)d_tail, tail);
+
+    return dst;
+}
+
+__attribute__((target("avx2"))) static void pone_memset_avx2(void *p, u8 c,
+                                                             usize n) {
+    u8 *d = (u8 *)p;
+    if (n <= 16) {
+        pone_memset_small(d, (u64)c * 0x0101010101010101ull, n);
+        return;
+    }
+    if (n <= 32) {
+        __m128i v = _mm_set1_epi8((char)c);
+        _mm_storeu_si128((__m128i *)d, v);
+        _mm_storeu_si128((__m128i *)(d + n - 16), v);
+        return;
+    }
+
+    __m256i v = _mm256_set1_epi8((char)c);
+    u8 *d_tail = d + n - 32;
+    _mm256_storeu_si256((__m256i *)d, v);
+    if (n <= 64) {
+        _mm256_storeu_si256((__m256i *)d_tail, v);
+        return;
+    }
+    if (n <= 128) {
+        _mm256_storeu_si256((__m256i *)(d + 32), v);
+        _mm256_storeu_si256((__m256i *)(d_tail - 32), v);
+        _mm256_storeu_si256((__m256i *)d_tail, v);
+        return;
+    }
+
+    d += 32 - ((usize)d & 31);
+    if (n >= PONE_MEMORY_NON_TEMPORAL_THRESHOLD) {
+        for (; d + 128 <= d_tail; d += 128) {
+            _mm256_stream_si256((__m256i *)d, v);
+            _mm256_stream_si256((__m256i *)(d + 32), v);
+            _mm256_stream_si256((__m256i *)(d + 64), v);
+            _mm256_stream_si256((__m256i *)(d + 96), v);
+        }
+        _mm_sfence();
+    } else {
+        for (; d + 128 <= d_tail; d += 128) {
+            _mm256_store_si256((__m256i *)d, v);
+            _mm256_store_si256((__m256i *)(d + 32), v);
+            _mm256_store_si256((__m256i *)(d + 64), v);
+            _mm256_store_si256((__m256i *)(d + 96), v);
+        }
+    }
+    for (; d < d_tail; d += 32) {
+        _mm256_store_si256((__m256i *)d, v);
+    }
+    _mm256_storeu_si256((__m256i *)d_tail, v);
+}
+
+#endif
+
+static void *pone_memcpy_resolve(void *dst, void *src, usize len);
+static void pone_memset_resolve(void *p, u8 c, usize n);
+
+static PoneMemcpyFn pone_memcpy_impl = pone_memcpy_resolve;
+static PoneMemsetFn pone_memset_impl = pone_memset_resolve;
+
+void pone_memory_init(void) {
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+
+#if defined(PONE_MEMORY_X64)
+    if (system_info.cpu_features & PONE_PLATFORM_CPU_FEATURE_AVX2) {
+        pone_memcpy_impl = pone_memcpy_avx2;
+        pone_memset_impl = pone_memset_avx2;
+    } else {
+        pone_memcpy_impl = pone_memcpy_sse2;
+        pone_memset_impl = pone_memset_sse2;
+    }
+#else
+    pone_memcpy_impl = pone_memcpy_scalar;
+    pone_memset_impl = pone_memset_scalar;
+#endif
+}
+
+// Anything that copies before pone_memory_init ran ends up here once. The
+// selected function pointers are the same for every thread so the race on
+// the first call is benign.
+static void *pone_memcpy_resolve(void *dst, void *src, usize len) {
+    pone_memory_init();
+    return pone_memcpy_impl(dst, src, len);
+}
+
+static void pone_memset_resolve(void *p, u8 c, usize n) {
+    pone_memory_init();
+    pone_memset_impl(p, c, n);
+}
+
+void *pone_memcpy(void *dst, void *src, usize len) {
+    return pone_memcpy_impl(dst, src, len);
+}
+
+void pone_memset(void *p, u8 c, usize n) { pone_memset_impl(p, c, n); }
@@ -4,13 +4,62 @@
 #include "pone_memory.h"
 
 #include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/syscall.h>
 #include <time.h>
 #include <unistd.h>
 
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+static u32 pone_platform_get_cpu_features(void) {
+    u32 features = 0;
+#if defined(__x86_64__)
+    u32 eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return features;
+    }
+
+    if (edx & bit_SSE2) {
+        features |= PONE_PLATFORM_CPU_FEATURE_SSE2;
+    }
+    if (ecx & bit_SSE4_1) {
+        features |= PONE_PLATFORM_CPU_FEATURE_SSE4_1;
+    }
+
+    // AVX state has to be enabled by the OS as well, otherwise touching ymm
+    // registers faults.
+    if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX)) {
+        return features;
+    }
+    u32 xcr0_lo, xcr0_hi;
+    __asm__ volatile("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    if ((xcr0_lo & 0x6) != 0x6) {
+        return features;
+    }
+
+    if (ecx & bit_FMA) {
+        features |= PONE_PLATFORM_CPU_FEATURE_FMA;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_AVX2)) {
+        features |= PONE_PLATFORM_CPU_FEATURE_AVX2;
+    }
+#endif
+
+    return features;
+}
+
 void pone_platform_get_system_info(PonePlatformSystemInfo *info) {
     info->page_size = (usize)getpagesize();
+    info->cpu_features = pone_platform_get_cpu_features();
+    info->processor_count = (u32)sysconf(_SC_NPROCESSORS_ONLN);
 }
 
 void *pone_platform_allocate_memory(void *addr, usize size) {
@@ -26,6 +75,33 @@ void *pone_platform_allocate_memory(void *addr, usize size) {
 
 void pone_platform_deallocate_memory(void *p) {}
 
+void *pone_platform_reserve_memory(void *addr, usize size) {
+    void *p = mmap(addr, size, PROT_NONE,
+                   MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+
+    if (p == MAP_FAILED) {
+        return 0;
+    } else {
+        return p;
+    }
+}
+
+b8 pone_platform_commit_memory(void *p, usize size) {
+    return mprotect(p, size, PROT_READ | PROT_WRITE) == 0;
+}
+
+void pone_platform_decommit_memory(void *p, usize size) {
+    int ret = madvise(p, size, MADV_DONTNEED);
+    pone_assert(ret == 0);
+    ret = mprotect(p, size, PROT_NONE);
+    pone_assert(ret == 0);
+}
+
+void pone_platform_release_memory(void *p, usize size) {
+    int ret = munmap(p, size);
+    pone_assert(ret == 0);
+}
+
 u64 pone_platform_get_time(void) {
     struct timespec ts;
     int ret = clock_gettime(CLOCK_MONOTONIC, &ts);
@@ -34,12 +110,71 @@ u64 pone_platform_get_time(void) {
     return (u64)ts.tv_sec * 1000000000ull + (u64)ts.tv_nsec;
 }
 
+void pone_platform_wait_on_address(volatile u32 *addr, u32 expected) {
+    syscall(SYS_futex, (u32 *)addr, FUTEX_WAIT_PRIVATE, expected, 0, 0, 0);
+}
+
+void pone_platform_wake_by_address_single(volatile u32 *addr) {
+    syscall(SYS_futex, (u32 *)addr, FUTEX_WAKE_PRIVATE, 1, 0, 0, 0);
+}
+
+void pone_platform_wake_by_address_all(volatile u32 *addr) {
+    syscall(SYS_futex, (u32 *)addr, FUTEX_WAKE_PRIVATE, INT_MAX, 0, 0, 0);
+}
+
+static void *pone_platform_thread_start(void *param) {
+    PonePlatformThread *thread = (PonePlatformThread *)param;
+    (thread->proc)(thread->param);
+
+    return 0;
+}
+
+void pone_platform_create_thread(PonePlatformThread *thread,
+                                 PonePlatformThreadProc proc, void *param) {
+    thread->proc = proc;
+    thread->param = param;
+
+    pthread_t handle;
+    int ret = pthread_create(&handle, 0, pone_platform_thread_start,
+                             (void *)thread);
+    pone_assert(ret == 0);
+    thread->handle = (u64)handle;
+}
+
+void pone_platform_join_thread(PonePlatformThread *thread) {
+    int ret = pthread_join((pthread_t)thread->handle, 0);
+    pone_assert(ret == 0);
+}
+
+void pone_platform_pin_thread(PonePlatformThread *thread,
+                              u32 processor_index) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(processor_index, &cpu_set);
+    // Affinity is a hint here, a restricted cpuset must not be fatal.
+    pthread_setaffinity_np((pthread_t)thread->handle, sizeof(cpu_set),
+                           &cpu_set);
+}
+
+void pone_platform_yield_thread(void) { sched_yield(); }
+
+static char *pone_platform_path_c_str(PoneString *path, const char *suffix,
+                                      Arena *arena) {
+    usize suffix_len = 0;
+    while (suffix[suffix_len]) {
+        suffix_len++;
+    }
+
+    char *c_str = arena_alloc_array(arena, path->len + suffix_len + 1, char);
+    pone_memcpy((void *)c_str, (void *)path->buf, path->len);
+    pone_memcpy((void *)(c_str + path->len), (void *)suffix, suffix_len + 1);
+    return c_str;
+}
+
 void pone_platform_read_file(PoneString *path, usize *size, void *data,
                              Arena *arena) {
-    PoneArenaTmp *tmp_arena = pone_arena_tmp_begin(arena);
-    char *path_c_str = arena_alloc_array(tmp_arena->arena, path->len + 1, char);
-    pone_memcpy((void *)path_c_str, (void *)path->buf, path->len);
-    path_c_str[path->len] = '\0';
+    PoneArenaTmp tmp_arena = pone_arena_tmp_begin(arena);
+    char *path_c_str = pone_platform_path_c_str(path, "", tmp_arena.arena);
 
     if (!data) {
         struct stat statbuf;
@@ -60,3 +195,65 @@ void pone_platform_read_file(PoneString *path, usize *size, void *data,
 
     pone_arena_tmp_end(tmp_arena);
 }
+
+void *pone_platform_map_file(PoneString *path, usize *size, Arena *arena) {
+    PoneArenaTmp tmp_arena = pone_arena_tmp_begin(arena);
+    char *path_c_str = pone_platform_path_c_str(path, "", tmp_arena.arena);
+
+    void *p = 0;
+    int fd = open(path_c_str, O_RDONLY);
+    if (fd != -1) {
+        struct stat statbuf;
+        if (fstat(fd, &statbuf) == 0 && statbuf.st_size > 0) {
+            p = mmap(0, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p == MAP_FAILED) {
+                p = 0;
+            } else {
+                *size = statbuf.st_size;
+            }
+        }
+        // The mapping keeps its own reference to the file.
+        close(fd);
+    }
+
+    pone_arena_tmp_end(tmp_arena);
+    return p;
+}
+
+void pone_platform_unmap_file(void *p, usize size) {
+    int ret = munmap(p, size);
+    pone_assert(ret == 0);
+}
+
+b8 pone_platform_write_file(PoneString *path, void *data, usize size,
+                            Arena *arena) {
+    PoneArenaTmp tmp_arena = pone_arena_tmp_begin(arena);
+    char *path_c_str = pone_platform_path_c_str(path, "", tmp_arena.arena);
+    char *tmp_path_c_str =
+        pone_platform_path_c_str(path, ".tmp", tmp_arena.arena);
+
+    b8 result = 0;
+    int fd = open(tmp_path_c_str, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd != -1) {
+        u8 *p = (u8 *)data;
+        usize remaining = size;
+        while (remaining) {
+            ssize_t n = write(fd, p, remaining);
+            if (n <= 0) {
+                break;
+            }
+            p += n;
+            remaining -= n;
+        }
+        close(fd);
+
+        if (remaining == 0 && rename(tmp_path_c_str, path_c_str) == 0) {
+            result = 1;
+        } else {
+            unlink(tmp_path_c_str);
+        }
+    }
+
+    pone_arena_tmp_end(tmp_arena);
+    return result;
+}
@@ -0,0 +1,133 @@
+#include "pone_pool.h"
+
+#include "pone_assert.h"
+#include "pone_atomic.h"
+
+#define PONE_POOL_TAG_SHIFT 48
+#define PONE_POOL_POINTER_MASK ((1ull << PONE_POOL_TAG_SHIFT) - 1)
+
+static usize _pone_pool_block_size(usize block_size, usize block_align) {
+    if (block_size < sizeof(PonePoolFreeNode)) {
+        block_size = sizeof(PonePoolFreeNode);
+    }
+    block_size += (block_align - 1) & -block_size;
+
+    return block_size;
+}
+
+void pone_pool_init(PonePool *pool, Arena *arena, usize block_size,
+                    usize block_align) {
+    if (block_align < alignof(PonePoolFreeNode)) {
+        block_align = alignof(PonePoolFreeNode);
+    }
+
+    *pool = (PonePool){
+        .arena = arena,
+        .block_size = _pone_pool_block_size(block_size, block_align),
+        .block_align = block_align,
+        .free_list = 0,
+    };
+}
+
+void *pone_pool_alloc(PonePool *pool) {
+    PonePoolFreeNode *node = pool->free_list;
+    if (node) {
+        pool->free_list = node->next;
+        return (void *)node;
+    }
+
+    return arena_alloc_aligned(pool->arena, pool->block_size,
+                               pool->block_align);
+}
+
+void pone_pool_free(PonePool *pool, void *p) {
+    if (!p) {
+        return;
+    }
+
+    PonePoolFreeNode *node = (PonePoolFreeNode *)p;
+    node->next = pool->free_list;
+    pool->free_list = node;
+}
+
+void pone_atomic_pool_init(PoneAtomicPool *pool, Arena *arena,
+                           usize block_size, usize block_align,
+                           usize block_count) {
+    if (block_align < alignof(PonePoolFreeNode)) {
+        block_align = alignof(PonePoolFreeNode);
+    }
+    block_size = _pone_pool_block_size(block_size, block_align);
+
+    u8 *blocks =
+        (u8 *)arena_alloc_aligned(arena, block_size * block_count, block_align);
+    pone_assert(blocks);
+    // Tagged pointers only work while user space addresses fit in 48 bits.
+    pone_assert(((usize)(blocks + block_size * block_count) &
+                 ~PONE_POOL_POINTER_MASK) == 0);
+
+    pool->blocks = blocks;
+    pool->block_size = block_size;
+    pool->block_count = block_count;
+    _pone_atomic_store_n(&pool->next_unused, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&pool->head, 0, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+void *pone_atomic_pool_alloc(PoneAtomicPool *pool) {
+    u64 head = _pone_atomic_load_n(&pool->head, PONE_MEMORY_ORDERING_ACQUIRE);
+    for (;;) {
+        PonePoolFreeNode *node =
+            (PonePoolFreeNode *)(head & PONE_POOL_POINTER_MASK);
+        if (!node) {
+            break;
+        }
+
+        // node may already be popped and reused by another thread, the
+        // read is still in bounds and the tag makes the CAS fail then.
+        PonePoolFreeNode *next =
+            _pone_atomic_load_n(&node->next, PONE_MEMORY_ORDERING_RELAXED);
+        u64 tag = (head >> PONE_POOL_TAG_SHIFT) + 1;
+        u64 new_head = (u64)next | (tag << PONE_POOL_TAG_SHIFT);
+        if (_pone_atomic_compare_exchange_n(&pool->head, &head, new_head, 1,
+                                            PONE_MEMORY_ORDERING_ACQUIRE,
+                                            PONE_MEMORY_ORDERING_ACQUIRE)) {
+            return (void *)node;
+        }
+    }
+
+    if (_pone_atomic_load_n(&pool->next_unused,
+                            PONE_MEMORY_ORDERING_RELAXED) >=
+        pool->block_count) {
+        return 0;
+    }
+    usize index = _pone_atomic_fetch_add(&pool->next_unused, 1,
+                                         PONE_MEMORY_ORDERING_RELAXED);
+    if (index >= pool->block_count) {
+        return 0;
+    }
+
+    return (void *)(pool->blocks + index * pool->block_size);
+}
+
+void pone_atomic_pool_free(PoneAtomicPool *pool, void *p) {
+    if (!p) {
+        return;
+    }
+
+    PonePoolFreeNode *node = (PonePoolFreeNode *)p;
+    u8 *blocks_end = pool->blocks + pool->block_size * pool->block_count;
+    pone_assert((u8 *)node >= pool->blocks && (u8 *)node < blocks_end);
+
+    u64 head = _pone_atomic_load_n(&pool->head, PONE_MEMORY_ORDERING_RELAXED);
+    for (;;) {
+        PonePoolFreeNode *next =
+            (PonePoolFreeNode *)(head & PONE_POOL_POINTER_MASK);
+        _pone_atomic_store_n(&node->next, next, PONE_MEMORY_ORDERING_RELAXED);
+        u64 tag = (head >> PONE_POOL_TAG_SHIFT) + 1;
+        u64 new_head = (u64)node | (tag << PONE_POOL_TAG_SHIFT);
+        if (_pone_atomic_compare_exchange_n(&pool->head, &head, new_head, 1,
+                                            PONE_MEMORY_ORDERING_RELEASE,
+                                            PONE_MEMORY_ORDERING_RELAXED)) {
+            return;
+        }
+    }
+}
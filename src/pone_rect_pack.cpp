@@ -4,6 +4,15 @@
 #include "pone_math.h"
 #include "pone_memory.h"
 
+// Shelf heights are rounded up to this, so glyphs of similar size share
+// shelves.
+#define PONE_RECT_SHELF_HEIGHT_ALIGNMENT 4
+
+// The single pass packers grow the bin side by side / this whenever an item
+// does not fit. Small steps keep the bin from overshooting the side it
+// needs.
+#define PONE_RECT_PACK_GROWTH_DIVISOR 64
+
 static void _pone_rect_pack_sort_by_area_merge(PoneRectPackItem *left,
                                                PoneRectPackItem *mid,
                                                PoneRectPackItem *right,
@@ -277,7 +286,9 @@ b8 pone_rect_pack(PoneRectPackItem *items, usize item_count, u32 max_bin_side,
         arena_alloc_array(arena, item_count, PoneRectPackItem);
 
     PoneRectPackEmptySpacePool empty_spaces;
-    pone_rect_pack_empty_space_pool_init(arena, 1000, &empty_spaces);
+    // Placing an item takes one space and leaves at most two.
+    pone_rect_pack_empty_space_pool_init(arena, item_count + 1,
+                                         &empty_spaces);
 
     pone_rect_pack_item_sort_by_area(items, item_count, arena);
     for (usize item_index = 0; item_index < item_count; item_index++) {
@@ -426,3 +437,1079 @@ b8 pone_rect_pack(PoneRectPackItem *items, usize item_count, u32 max_bin_side,
         }
     }
 }
+
+typedef b8 (*PoneRectPackItemSortsBefore)(PoneRectPackItem *a,
+                                          PoneRectPackItem *b);
+
+// Longest side first, then the shorter one, both single pass packers place
+// big items while there is still room for them.
+static b8 _pone_rect_pack_item_is_longer(PoneRectPackItem *a,
+                                         PoneRectPackItem *b) {
+    u32 a_width = pone_rect_u32_width(&a->rect);
+    u32 a_height = pone_rect_u32_height(&a->rect);
+    u32 b_width = pone_rect_u32_width(&b->rect);
+    u32 b_height = pone_rect_u32_height(&b->rect);
+    u32 a_long = PONE_MAX(a_width, a_height);
+    u32 a_short = PONE_MIN(a_width, a_height);
+    u32 b_long = PONE_MAX(b_width, b_height);
+    u32 b_short = PONE_MIN(b_width, b_height);
+
+    if (a_long != b_long) {
+        return a_long > b_long;
+    }
+    return a_short > b_short;
+}
+
+// Tallest first, then the wider one, so shelves fill with rects of similar
+// height.
+static b8 _pone_rect_pack_item_is_taller(PoneRectPackItem *a,
+                                         PoneRectPackItem *b) {
+    u32 a_height = pone_rect_u32_height(&a->rect);
+    u32 b_height = pone_rect_u32_height(&b->rect);
+    if (a_height != b_height) {
+        return a_height > b_height;
+    }
+    return pone_rect_u32_width(&a->rect) > pone_rect_u32_width(&b->rect);
+}
+
+// Bottom up merge sort, a single buffer of item_count items is all it
+// allocates.
+static void _pone_rect_pack_item_sort(PoneRectPackItem *items,
+                                      usize item_count,
+                                      PoneRectPackItemSortsBefore sorts_before,
+                                      Arena *arena) {
+    if (item_count < 2) {
+        return;
+    }
+
+    usize arena_tmp_begin = arena->offset;
+    PoneRectPackItem *src = items;
+    PoneRectPackItem *dst =
+        arena_alloc_array(arena, item_count, PoneRectPackItem);
+    for (usize run = 1; run < item_count; run *= 2) {
+        for (usize left = 0; left < item_count; left += 2 * run) {
+            usize mid = PONE_MIN(left + run, item_count);
+            usize right = PONE_MIN(left + 2 * run, item_count);
+            usize i = left;
+            usize j = mid;
+            usize k = left;
+            while (i < mid && j < right) {
+                if (sorts_before(src + j, src + i)) {
+                    dst[k++] = src[j++];
+                } else {
+                    dst[k++] = src[i++];
+                }
+            }
+            while (i < mid) {
+                dst[k++] = src[i++];
+            }
+            while (j < right) {
+                dst[k++] = src[j++];
+            }
+        }
+
+        PoneRectPackItem *tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != items) {
+        pone_memcpy((void *)items, (void *)src,
+                    item_count * sizeof(PoneRectPackItem));
+    }
+    arena->offset = arena_tmp_begin;
+}
+
+// The side the total area of items needs, but at least their longest side.
+static u32 _pone_rect_pack_initial_side(PoneRectPackItem *items,
+                                        usize item_count) {
+    u64 area = 0;
+    u32 side = 1;
+    for (usize i = 0; i < item_count; ++i) {
+        u32 width = pone_rect_u32_width(&items[i].rect);
+        u32 height = pone_rect_u32_height(&items[i].rect);
+        area += (u64)width * height;
+        side = PONE_MAX(side, width);
+        side = PONE_MAX(side, height);
+    }
+
+    u32 area_side = (u32)pone_ceil(pone_sqrt((f32)area));
+    return PONE_MAX(side, area_side);
+}
+
+static u32 _pone_rect_pack_grow_side(u32 side, u32 max_bin_side) {
+    u32 step = PONE_MAX(side / PONE_RECT_PACK_GROWTH_DIVISOR, 1u);
+    u32 grown = side + step;
+    return PONE_MIN(grown, max_bin_side);
+}
+
+struct PoneRectSkylineNode {
+    u32 x;
+    u32 y;
+    u32 width;
+};
+
+// Nodes are sorted by x and cover [0, side) without gaps, neighbours never
+// share the same y.
+struct PoneRectSkyline {
+    PoneRectSkylineNode *nodes;
+    usize node_count;
+    u32 side;
+};
+
+// Moves the nodes from from on to start at to.
+static void _pone_rect_skyline_move_nodes(PoneRectSkyline *skyline,
+                                          usize from, usize to) {
+    PoneRectSkylineNode *nodes = skyline->nodes;
+    usize count = skyline->node_count - from;
+    if (to < from) {
+        for (usize i = 0; i < count; ++i) {
+            nodes[to + i] = nodes[from + i];
+        }
+    } else if (to > from) {
+        for (usize i = count; i > 0; --i) {
+            nodes[to + i - 1] = nodes[from + i - 1];
+        }
+    }
+    skyline->node_count = to + count;
+}
+
+// Finds the node whose left edge gives the rect the lowest top. The rect
+// rests on the highest node below it.
+static b8 _pone_rect_skyline_find(PoneRectSkyline *skyline, u32 width,
+                                  u32 height, usize *node_index, u32 *y) {
+    PoneRectSkylineNode *nodes = skyline->nodes;
+    u32 best_top = U32_MAX;
+    for (usize i = 0; i < skyline->node_count; ++i) {
+        if (nodes[i].x + width > skyline->side) {
+            break;
+        }
+
+        u32 rest_y = 0;
+        u32 covered = 0;
+        for (usize j = i; covered < width && rest_y + height < best_top;
+             ++j) {
+            rest_y = PONE_MAX(rest_y, nodes[j].y);
+            covered += nodes[j].width;
+        }
+
+        u32 top = rest_y + height;
+        if (covered >= width && top < best_top && top <= skyline->side) {
+            best_top = top;
+            *node_index = i;
+            *y = rest_y;
+        }
+    }
+
+    return best_top != U32_MAX;
+}
+
+static void _pone_rect_skyline_place(PoneRectSkyline *skyline,
+                                     usize node_index, u32 width, u32 top) {
+    PoneRectSkylineNode *nodes = skyline->nodes;
+    u32 x = nodes[node_index].x;
+    u32 x_end = x + width;
+
+    // Nodes the rect covers are replaced by a single one, the node it ends
+    // in is cut.
+    usize end = node_index;
+    while (end < skyline->node_count &&
+           nodes[end].x + nodes[end].width <= x_end) {
+        ++end;
+    }
+    if (end < skyline->node_count && nodes[end].x < x_end) {
+        nodes[end].width -= x_end - nodes[end].x;
+        nodes[end].x = x_end;
+    }
+    _pone_rect_skyline_move_nodes(skyline, end, node_index + 1);
+    nodes[node_index] = {
+        .x = x,
+        .y = top,
+        .width = width,
+    };
+
+    if (node_index + 1 < skyline->node_count &&
+        nodes[node_index + 1].y == top) {
+        nodes[node_index].width += nodes[node_index + 1].width;
+        _pone_rect_skyline_move_nodes(skyline, node_index + 2,
+                                      node_index + 1);
+    }
+    if (node_index > 0 && nodes[node_index - 1].y == top) {
+        nodes[node_index - 1].width += nodes[node_index].width;
+        _pone_rect_skyline_move_nodes(skyline, node_index + 1, node_index);
+    }
+}
+
+// The bin is empty right of the old side, so the skyline only gets wider.
+static void _pone_rect_skyline_grow(PoneRectSkyline *skyline, u32 side) {
+    PoneRectSkylineNode *last = skyline->nodes + skyline->node_count - 1;
+    if (last->y == 0) {
+        last->width += side - skyline->side;
+    } else {
+        skyline->nodes[skyline->node_count++] = {
+            .x = skyline->side,
+            .y = 0,
+            .width = side - skyline->side,
+        };
+    }
+    skyline->side = side;
+}
+
+b8 pone_rect_pack_skyline(PoneRectPackItem *items, usize item_count,
+                          u32 max_bin_side, Arena *arena, u32 *side) {
+    u32 bin_side = _pone_rect_pack_initial_side(items, item_count);
+    if (bin_side > max_bin_side) {
+        return 0;
+    }
+
+    usize arena_offset_begin = arena->offset;
+    _pone_rect_pack_item_sort(items, item_count, _pone_rect_pack_item_is_longer,
+                              arena);
+
+    // Every placed rect adds at most one node, so does every growth.
+    usize grow_count = 0;
+    for (u32 s = bin_side; s < max_bin_side;
+         s = _pone_rect_pack_grow_side(s, max_bin_side)) {
+        ++grow_count;
+    }
+    PoneRectSkyline skyline = {
+        .nodes = arena_alloc_array(arena, item_count + grow_count + 1,
+                                   PoneRectSkylineNode),
+        .node_count = 1,
+        .side = bin_side,
+    };
+    skyline.nodes[0] = {
+        .x = 0,
+        .y = 0,
+        .width = bin_side,
+    };
+
+    u32 used_side = 0;
+    for (usize item_index = 0; item_index < item_count; ++item_index) {
+        PoneRectU32 *item_rect = &items[item_index].rect;
+        u32 width = pone_rect_u32_width(item_rect);
+        u32 height = pone_rect_u32_height(item_rect);
+        if (width == 0 || height == 0) {
+            *item_rect = {
+                .x_max = width,
+                .y_max = height,
+            };
+            continue;
+        }
+
+        usize node_index;
+        u32 y;
+        while (!_pone_rect_skyline_find(&skyline, width, height, &node_index,
+                                        &y)) {
+            if (skyline.side == max_bin_side) {
+                arena->offset = arena_offset_begin;
+                return 0;
+            }
+            _pone_rect_skyline_grow(
+                &skyline, _pone_rect_pack_grow_side(skyline.side,
+                                                    max_bin_side));
+        }
+
+        u32 x = skyline.nodes[node_index].x;
+        _pone_rect_skyline_place(&skyline, node_index, width, y + height);
+        *item_rect = {
+            .x_min = x,
+            .y_min = y,
+            .x_max = x + width,
+            .y_max = y + height,
+        };
+        used_side = PONE_MAX(used_side, item_rect->x_max);
+        used_side = PONE_MAX(used_side, item_rect->y_max);
+    }
+
+    *side = used_side;
+    arena->offset = arena_offset_begin;
+    return 1;
+}
+
+// Free rects are the maximal empty rects of the bin, they overlap and none
+// of them contains another. Free rects narrower than min_width or lower than
+// min_height can not take any item and are not kept, unless they touch the
+// right or bottom edge, growing the bin widens those. Pruned ones are marked
+// empty until compacted.
+struct PoneRectMaxRects {
+    PoneRectU32 *free_rects;
+    usize free_count;
+    usize free_capacity;
+    u32 side;
+    u32 min_width;
+    u32 min_height;
+};
+
+static b8 _pone_rect_u32_contains(PoneRectU32 *outer, PoneRectU32 *inner) {
+    return inner->x_min >= outer->x_min && inner->y_min >= outer->y_min &&
+           inner->x_max <= outer->x_max && inner->y_max <= outer->y_max;
+}
+
+static b8 _pone_rect_u32_intersects(PoneRectU32 *a, PoneRectU32 *b) {
+    return a->x_min < b->x_max && b->x_min < a->x_max &&
+           a->y_min < b->y_max && b->y_min < a->y_max;
+}
+
+// The free rects are the most recent allocation, so this grows them in
+// place.
+static void _pone_rect_max_rects_reserve(PoneRectMaxRects *bin, usize count,
+                                         Arena *arena) {
+    if (count > bin->free_capacity) {
+        usize capacity = PONE_MAX(count, bin->free_capacity * 2);
+        bin->free_rects = (PoneRectU32 *)arena_realloc(
+            arena, bin->free_rects, capacity * sizeof(PoneRectU32));
+        bin->free_capacity = capacity;
+    }
+}
+
+static void _pone_rect_max_rects_push(PoneRectMaxRects *bin, u32 x_min,
+                                      u32 y_min, u32 x_max, u32 y_max) {
+    pone_assert(bin->free_count < bin->free_capacity);
+    bin->free_rects[bin->free_count++] = {
+        .x_min = x_min,
+        .y_min = y_min,
+        .x_max = x_max,
+        .y_max = y_max,
+    };
+}
+
+// Drops the free rects from begin on that are too small for any item or
+// that another free rect contains, of two equal ones the first goes.
+static void _pone_rect_max_rects_prune(PoneRectMaxRects *bin, usize begin) {
+    PoneRectU32 *free_rects = bin->free_rects;
+    for (usize i = begin; i < bin->free_count; ++i) {
+        b8 is_inner = free_rects[i].x_max < bin->side &&
+                      free_rects[i].y_max < bin->side;
+        if (is_inner &&
+            (pone_rect_u32_width(free_rects + i) < bin->min_width ||
+             pone_rect_u32_height(free_rects + i) < bin->min_height)) {
+            free_rects[i].x_max = free_rects[i].x_min;
+            continue;
+        }
+
+        for (usize j = 0; j < bin->free_count; ++j) {
+            if (j != i && free_rects[j].x_min != free_rects[j].x_max &&
+                _pone_rect_u32_contains(free_rects + j, free_rects + i)) {
+                free_rects[i].x_max = free_rects[i].x_min;
+                break;
+            }
+        }
+    }
+
+    usize free_count = 0;
+    for (usize i = 0; i < bin->free_count; ++i) {
+        if (free_rects[i].x_min != free_rects[i].x_max) {
+            free_rects[free_count++] = free_rects[i];
+        }
+    }
+    bin->free_count = free_count;
+}
+
+// Best short side fit, the free rect leaving the smallest gap on its
+// tighter side, then on the other one.
+static b8 _pone_rect_max_rects_find(PoneRectMaxRects *bin, u32 width,
+                                    u32 height, PoneRectU32 *rect) {
+    u32 best_short_gap = U32_MAX;
+    u32 best_long_gap = U32_MAX;
+    b8 found = 0;
+    for (usize i = 0; i < bin->free_count; ++i) {
+        PoneRectU32 *free_rect = bin->free_rects + i;
+        u32 free_width = pone_rect_u32_width(free_rect);
+        u32 free_height = pone_rect_u32_height(free_rect);
+        if (free_width < width || free_height < height) {
+            continue;
+        }
+
+        u32 dw = free_width - width;
+        u32 dh = free_height - height;
+        u32 short_gap = PONE_MIN(dw, dh);
+        u32 long_gap = PONE_MAX(dw, dh);
+        if (short_gap < best_short_gap ||
+            (short_gap == best_short_gap && long_gap < best_long_gap)) {
+            best_short_gap = short_gap;
+            best_long_gap = long_gap;
+            *rect = {
+                .x_min = free_rect->x_min,
+                .y_min = free_rect->y_min,
+                .x_max = free_rect->x_min + width,
+                .y_max = free_rect->y_min + height,
+            };
+            found = 1;
+        }
+    }
+
+    return found;
+}
+
+// Every free rect rect overlaps is replaced by the up to four maximal rects
+// left of, right of, above and below it. Only those new ones need pruning,
+// the old ones did not contain each other before.
+static void _pone_rect_max_rects_place(PoneRectMaxRects *bin,
+                                       PoneRectU32 *rect, Arena *arena) {
+    usize old_count = bin->free_count;
+    usize split_count = 0;
+    for (usize i = 0; i < old_count; ++i) {
+        split_count += _pone_rect_u32_intersects(bin->free_rects + i, rect);
+    }
+    _pone_rect_max_rects_reserve(bin, old_count + split_count * 4, arena);
+
+    for (usize i = 0; i < old_count; ++i) {
+        PoneRectU32 free_rect = bin->free_rects[i];
+        if (!_pone_rect_u32_intersects(&free_rect, rect)) {
+            continue;
+        }
+
+        if (rect->x_min > free_rect.x_min) {
+            _pone_rect_max_rects_push(bin, free_rect.x_min, free_rect.y_min,
+                                      rect->x_min, free_rect.y_max);
+        }
+        if (rect->x_max < free_rect.x_max) {
+            _pone_rect_max_rects_push(bin, rect->x_max, free_rect.y_min,
+                                      free_rect.x_max, free_rect.y_max);
+        }
+        if (rect->y_min > free_rect.y_min) {
+            _pone_rect_max_rects_push(bin, free_rect.x_min, free_rect.y_min,
+                                      free_rect.x_max, rect->y_min);
+        }
+        if (rect->y_max < free_rect.y_max) {
+            _pone_rect_max_rects_push(bin, free_rect.x_min, rect->y_max,
+                                      free_rect.x_max, free_rect.y_max);
+        }
+        bin->free_rects[i].x_max = bin->free_rects[i].x_min;
+    }
+
+    _pone_rect_max_rects_prune(bin, old_count);
+}
+
+// The new strips are empty, so free rects touching the old right or bottom
+// edge reach the new one. Those are moved behind the others and the strips
+// are added after them. Only these can contain, or be contained in, another
+// free rect now.
+static void _pone_rect_max_rects_grow(PoneRectMaxRects *bin, u32 side,
+                                      Arena *arena) {
+    PoneRectU32 *free_rects = bin->free_rects;
+    usize begin = bin->free_count;
+    for (usize i = bin->free_count; i > 0; --i) {
+        PoneRectU32 *free_rect = free_rects + i - 1;
+        if (free_rect->x_max == bin->side || free_rect->y_max == bin->side) {
+            --begin;
+            PoneRectU32 tmp = free_rects[begin];
+            free_rects[begin] = *free_rect;
+            *free_rect = tmp;
+        }
+    }
+    for (usize i = begin; i < bin->free_count; ++i) {
+        if (free_rects[i].x_max == bin->side) {
+            free_rects[i].x_max = side;
+        }
+        if (free_rects[i].y_max == bin->side) {
+            free_rects[i].y_max = side;
+        }
+    }
+
+    _pone_rect_max_rects_reserve(bin, bin->free_count + 2, arena);
+    _pone_rect_max_rects_push(bin, bin->side, 0, side, side);
+    _pone_rect_max_rects_push(bin, 0, bin->side, side, side);
+    bin->side = side;
+
+    free_rects = bin->free_rects;
+    for (usize i = 0; i < begin; ++i) {
+        for (usize j = begin; j < bin->free_count; ++j) {
+            if (_pone_rect_u32_contains(free_rects + j, free_rects + i)) {
+                free_rects[i].x_max = free_rects[i].x_min;
+                break;
+            }
+        }
+    }
+    _pone_rect_max_rects_prune(bin, begin);
+}
+
+static void _pone_rect_max_rects_open(PoneRectMaxRects *bin, u32 side,
+                                      u32 min_width, u32 min_height,
+                                      usize capacity, Arena *arena) {
+    *bin = {
+        .free_rects = 0,
+        .free_count = 0,
+        .free_capacity = 0,
+        .side = side,
+        .min_width = min_width,
+        .min_height = min_height,
+    };
+    _pone_rect_max_rects_reserve(bin, capacity, arena);
+    _pone_rect_max_rects_push(bin, 0, 0, side, side);
+}
+
+b8 pone_rect_pack_max_rects(PoneRectPackItem *items, usize item_count,
+                            u32 max_bin_side, Arena *arena, u32 *side) {
+    u32 page_count;
+    return pone_rect_pack_max_rects_pages(items, item_count, max_bin_side, 1,
+                                          arena, side, &page_count);
+}
+
+b8 pone_rect_pack_max_rects_pages(PoneRectPackItem *items, usize item_count,
+                                  u32 max_bin_side, u32 max_page_count,
+                                  Arena *arena, u32 *side, u32 *page_count) {
+    pone_assert(max_page_count > 0);
+    u32 bin_side = _pone_rect_pack_initial_side(items, item_count);
+    if (bin_side > max_bin_side) {
+        if (max_page_count == 1) {
+            return 0;
+        }
+        bin_side = max_bin_side;
+    }
+
+    usize arena_offset_begin = arena->offset;
+    _pone_rect_pack_item_sort(items, item_count, _pone_rect_pack_item_is_longer,
+                              arena);
+
+    u32 min_width = U32_MAX;
+    u32 min_height = U32_MAX;
+    for (usize item_index = 0; item_index < item_count; ++item_index) {
+        PoneRectU32 *item_rect = &items[item_index].rect;
+        u32 width = pone_rect_u32_width(item_rect);
+        u32 height = pone_rect_u32_height(item_rect);
+        if (width > max_bin_side || height > max_bin_side) {
+            arena->offset = arena_offset_begin;
+            return 0;
+        }
+        if (width && height) {
+            min_width = PONE_MIN(min_width, width);
+            min_height = PONE_MIN(min_height, height);
+        }
+    }
+
+    // The free rects of every page but the last are reallocated away from
+    // the top of the arena, those few copies are left behind.
+    PoneRectMaxRects *bins =
+        arena_alloc_array(arena, max_page_count, PoneRectMaxRects);
+    u32 bin_count = 1;
+    _pone_rect_max_rects_open(bins, bin_side, min_width, min_height,
+                              item_count + 1, arena);
+
+    u32 used_side = 0;
+    for (usize item_index = 0; item_index < item_count; ++item_index) {
+        PoneRectU32 *item_rect = &items[item_index].rect;
+        u32 width = pone_rect_u32_width(item_rect);
+        u32 height = pone_rect_u32_height(item_rect);
+        if (width == 0 || height == 0) {
+            *item_rect = {
+                .x_max = width,
+                .y_max = height,
+            };
+            items[item_index].page = 0;
+            continue;
+        }
+
+        // Only the first page is ever below max_bin_side, and only while it
+        // is the only one.
+        u32 page = 0;
+        PoneRectU32 rect;
+        while (!_pone_rect_max_rects_find(bins + page, width, height, &rect)) {
+            if (bins[page].side < max_bin_side) {
+                _pone_rect_max_rects_grow(
+                    bins + page,
+                    _pone_rect_pack_grow_side(bins[page].side, max_bin_side),
+                    arena);
+                continue;
+            }
+            if (++page == bin_count) {
+                if (bin_count == max_page_count) {
+                    arena->offset = arena_offset_begin;
+                    return 0;
+                }
+                _pone_rect_max_rects_open(bins + bin_count++, max_bin_side,
+                                          min_width, min_height,
+                                          item_count - item_index + 1, arena);
+            }
+        }
+
+        _pone_rect_max_rects_place(bins + page, &rect, arena);
+        *item_rect = rect;
+        items[item_index].page = page;
+        used_side = PONE_MAX(used_side, rect.x_max);
+        used_side = PONE_MAX(used_side, rect.y_max);
+    }
+
+    *side = used_side;
+    *page_count = bin_count;
+    arena->offset = arena_offset_begin;
+    return 1;
+}
+
+static usize _pone_rect_shelf_block_capacity(PoneRectShelfPacker *packer) {
+    // Every shelf has at most one more free block than packed ones.
+    return packer->item_capacity * 2 + packer->shelf_capacity;
+}
+
+static usize
+_pone_rect_shelf_height_class_word_count(PoneRectShelfPacker *packer) {
+    return (packer->shelf_capacity + 63) / 64;
+}
+
+void pone_rect_shelf_packer_init(PoneRectShelfPacker *packer, u32 width,
+                                 u32 height, usize item_capacity,
+                                 Arena *arena) {
+    pone_assert(width < 65536);
+    packer->width = width;
+    packer->height = height;
+    packer->used_height = 0;
+    packer->item_capacity = item_capacity;
+    packer->shelf_count = 0;
+    packer->shelf_capacity = height / PONE_RECT_SHELF_HEIGHT_ALIGNMENT;
+    packer->shelves =
+        arena_alloc_array(arena, packer->shelf_capacity, PoneRectShelf);
+
+    usize block_capacity = _pone_rect_shelf_block_capacity(packer);
+    packer->blocks =
+        arena_alloc_array(arena, block_capacity, PoneRectShelfBlock);
+    for (usize i = 0; i < block_capacity; ++i) {
+        packer->blocks[i].next =
+            i + 1 < block_capacity ? (u32)(i + 1) : PONE_RECT_SHELF_NONE;
+    }
+    packer->free_block = 0;
+
+    usize list_count =
+        packer->shelf_capacity * PONE_RECT_SHELF_WIDTH_CLASS_COUNT;
+    packer->free_lists = arena_alloc_array(arena, list_count, u32);
+    for (usize i = 0; i < list_count; ++i) {
+        packer->free_lists[i] = PONE_RECT_SHELF_NONE;
+    }
+    packer->width_class_masks =
+        arena_alloc_array(arena, packer->shelf_capacity, u64);
+    pone_memset((void *)packer->width_class_masks, 0,
+                packer->shelf_capacity * sizeof(u64));
+    usize word_count = _pone_rect_shelf_height_class_word_count(packer);
+    packer->height_class_masks = arena_alloc_array(arena, word_count, u64);
+    pone_memset((void *)packer->height_class_masks, 0,
+                word_count * sizeof(u64));
+
+    u32 bucket_count = 1;
+    while (bucket_count < item_capacity * 2) {
+        bucket_count <<= 1;
+    }
+    packer->buckets = arena_alloc_array(arena, bucket_count, u32);
+    for (u32 i = 0; i < bucket_count; ++i) {
+        packer->buckets[i] = PONE_RECT_SHELF_NONE;
+    }
+    packer->bucket_mask = bucket_count - 1;
+}
+
+static u32 _pone_rect_shelf_packer_alloc_block(PoneRectShelfPacker *packer) {
+    u32 block_index = packer->free_block;
+    pone_assert(block_index != PONE_RECT_SHELF_NONE);
+    packer->free_block = packer->blocks[block_index].next;
+    return block_index;
+}
+
+static void _pone_rect_shelf_packer_free_block(PoneRectShelfPacker *packer,
+                                               u32 block_index) {
+    packer->blocks[block_index].next = packer->free_block;
+    packer->free_block = block_index;
+}
+
+static u32 _pone_rect_shelf_height_class(u32 shelf_height) {
+    return shelf_height / PONE_RECT_SHELF_HEIGHT_ALIGNMENT - 1;
+}
+
+static u32 _pone_rect_shelf_width_class(u32 width) {
+    if (width < 8) {
+        return width;
+    }
+
+    u32 log2 = 31 - (u32)__builtin_clz(width);
+    return 8 + (log2 - 3) * 4 + ((width >> (log2 - 2)) & 3);
+}
+
+// The first width class whose blocks are all at least width wide.
+static u32 _pone_rect_shelf_width_class_up(u32 width) {
+    u32 width_class = _pone_rect_shelf_width_class(width);
+    if (width >= 8) {
+        u32 log2 = 31 - (u32)__builtin_clz(width);
+        width_class += (width & ((1u << (log2 - 2)) - 1)) != 0;
+    }
+
+    return width_class;
+}
+
+static u32 *_pone_rect_shelf_free_list(PoneRectShelfPacker *packer,
+                                       u32 height_class, u32 width_class) {
+    return packer->free_lists +
+           (height_class * PONE_RECT_SHELF_WIDTH_CLASS_COUNT) + width_class;
+}
+
+static void _pone_rect_shelf_link_free(PoneRectShelfPacker *packer,
+                                       u32 block_index) {
+    PoneRectShelfBlock *block = packer->blocks + block_index;
+    u32 height_class =
+        _pone_rect_shelf_height_class(packer->shelves[block->shelf].height);
+    u32 width_class = _pone_rect_shelf_width_class(block->width);
+    u32 *head = _pone_rect_shelf_free_list(packer, height_class, width_class);
+
+    block->link_prev = PONE_RECT_SHELF_NONE;
+    block->link_next = *head;
+    if (*head != PONE_RECT_SHELF_NONE) {
+        packer->blocks[*head].link_prev = block_index;
+    }
+    *head = block_index;
+    packer->width_class_masks[height_class] |= 1ull << width_class;
+    packer->height_class_masks[height_class / 64] |= 1ull
+                                                     << (height_class % 64);
+}
+
+static void _pone_rect_shelf_unlink_free(PoneRectShelfPacker *packer,
+                                         u32 block_index) {
+    PoneRectShelfBlock *block = packer->blocks + block_index;
+    u32 height_class =
+        _pone_rect_shelf_height_class(packer->shelves[block->shelf].height);
+    u32 width_class = _pone_rect_shelf_width_class(block->width);
+    u32 *head = _pone_rect_shelf_free_list(packer, height_class, width_class);
+
+    if (block->link_prev != PONE_RECT_SHELF_NONE) {
+        packer->blocks[block->link_prev].link_next = block->link_next;
+    } else {
+        *head = block->link_next;
+    }
+    if (block->link_next != PONE_RECT_SHELF_NONE) {
+        packer->blocks[block->link_next].link_prev = block->link_prev;
+    }
+
+    if (*head == PONE_RECT_SHELF_NONE) {
+        packer->width_class_masks[height_class] &= ~(1ull << width_class);
+        if (!packer->width_class_masks[height_class]) {
+            packer->height_class_masks[height_class / 64] &=
+                ~(1ull << (height_class % 64));
+        }
+    }
+}
+
+// The first height class from height_class on with any free block.
+static u32 _pone_rect_shelf_next_height_class(PoneRectShelfPacker *packer,
+                                              u32 height_class) {
+    usize word_count = _pone_rect_shelf_height_class_word_count(packer);
+    for (usize word = height_class / 64; word < word_count; ++word) {
+        u64 mask = packer->height_class_masks[word];
+        if (word == height_class / 64) {
+            mask &= ~0ull << (height_class % 64);
+        }
+        if (mask) {
+            return (u32)(word * 64) + (u32)__builtin_ctzll(mask);
+        }
+    }
+
+    return PONE_RECT_SHELF_NONE;
+}
+
+// A free block of height_class at least width wide. The head of width's own
+// class is tried first, as its blocks may be just wide enough.
+static u32 _pone_rect_shelf_find_block(PoneRectShelfPacker *packer,
+                                       u32 height_class, u32 width) {
+    u32 exact = *_pone_rect_shelf_free_list(
+        packer, height_class, _pone_rect_shelf_width_class(width));
+    if (exact != PONE_RECT_SHELF_NONE &&
+        packer->blocks[exact].width >= width) {
+        return exact;
+    }
+
+    u64 mask = packer->width_class_masks[height_class] &
+               (~0ull << _pone_rect_shelf_width_class_up(width));
+    if (!mask) {
+        return PONE_RECT_SHELF_NONE;
+    }
+    return *_pone_rect_shelf_free_list(packer, height_class,
+                                       (u32)__builtin_ctzll(mask));
+}
+
+static u32 _pone_rect_shelf_bucket(PoneRectShelfPacker *packer, u32 x,
+                                   u32 y) {
+    u32 hash = ((y << 16) ^ x) * 0x9e3779b1u;
+    return (hash ^ (hash >> 16)) & packer->bucket_mask;
+}
+
+b8 pone_rect_shelf_packer_insert(PoneRectShelfPacker *packer, u32 width,
+                                 u32 height, PoneRectU32 *rect) {
+    if (width == 0 || height == 0 || width > packer->width ||
+        height > packer->height) {
+        return 0;
+    }
+
+    // Prefers the shelf wasting the least height. Shelves much taller than
+    // the rect are only taken when no new shelf fits anymore.
+    u32 aligned_height = (height + PONE_RECT_SHELF_HEIGHT_ALIGNMENT - 1) /
+                         PONE_RECT_SHELF_HEIGHT_ALIGNMENT *
+                         PONE_RECT_SHELF_HEIGHT_ALIGNMENT;
+    u32 max_waste = aligned_height / 2;
+    u32 first_class = _pone_rect_shelf_height_class(aligned_height);
+    u32 last_height = (height + max_waste) /
+                      PONE_RECT_SHELF_HEIGHT_ALIGNMENT *
+                      PONE_RECT_SHELF_HEIGHT_ALIGNMENT;
+    last_height = PONE_MAX(last_height, aligned_height);
+    u32 last_class = _pone_rect_shelf_height_class(last_height);
+    u32 block_index = PONE_RECT_SHELF_NONE;
+    for (u32 height_class =
+             _pone_rect_shelf_next_height_class(packer, first_class);
+         height_class <= last_class && block_index == PONE_RECT_SHELF_NONE;
+         height_class =
+             _pone_rect_shelf_next_height_class(packer, height_class + 1)) {
+        block_index = _pone_rect_shelf_find_block(packer, height_class, width);
+    }
+
+    b8 has_room = packer->used_height + aligned_height <= packer->height &&
+                  packer->shelf_count < packer->shelf_capacity;
+    if (block_index == PONE_RECT_SHELF_NONE && has_room) {
+        u32 shelf_index = (u32)packer->shelf_count++;
+        block_index = _pone_rect_shelf_packer_alloc_block(packer);
+        packer->shelves[shelf_index] = {
+            .y = packer->used_height,
+            .height = aligned_height,
+            .first_block = block_index,
+        };
+        packer->blocks[block_index] = {
+            .x = 0,
+            .width = packer->width,
+            .height = 0,
+            .shelf = shelf_index,
+            .prev = PONE_RECT_SHELF_NONE,
+            .next = PONE_RECT_SHELF_NONE,
+        };
+        _pone_rect_shelf_link_free(packer, block_index);
+        packer->used_height += aligned_height;
+    }
+    for (u32 height_class =
+             _pone_rect_shelf_next_height_class(packer, last_class + 1);
+         height_class != PONE_RECT_SHELF_NONE &&
+         block_index == PONE_RECT_SHELF_NONE;
+         height_class =
+             _pone_rect_shelf_next_height_class(packer, height_class + 1)) {
+        block_index = _pone_rect_shelf_find_block(packer, height_class, width);
+    }
+    if (block_index == PONE_RECT_SHELF_NONE) {
+        return 0;
+    }
+
+    // The rect takes the left end of the free block.
+    PoneRectShelfBlock *block = packer->blocks + block_index;
+    PoneRectShelf *shelf = packer->shelves + block->shelf;
+    _pone_rect_shelf_unlink_free(packer, block_index);
+    u32 used_index = block_index;
+    if (block->width > width) {
+        used_index = _pone_rect_shelf_packer_alloc_block(packer);
+        packer->blocks[used_index] = {
+            .x = block->x,
+            .width = width,
+            .shelf = block->shelf,
+            .prev = block->prev,
+            .next = block_index,
+        };
+        if (block->prev != PONE_RECT_SHELF_NONE) {
+            packer->blocks[block->prev].next = used_index;
+        } else {
+            shelf->first_block = used_index;
+        }
+        block->prev = used_index;
+        block->x += width;
+        block->width -= width;
+        _pone_rect_shelf_link_free(packer, block_index);
+    }
+
+    PoneRectShelfBlock *used = packer->blocks + used_index;
+    u32 *bucket =
+        packer->buckets + _pone_rect_shelf_bucket(packer, used->x, shelf->y);
+    used->height = height;
+    used->link_prev = PONE_RECT_SHELF_NONE;
+    used->link_next = *bucket;
+    *bucket = used_index;
+
+    *rect = {
+        .x_min = used->x,
+        .y_min = shelf->y,
+        .x_max = used->x + width,
+        .y_max = shelf->y + height,
+    };
+    return 1;
+}
+
+void pone_rect_shelf_packer_remove(PoneRectShelfPacker *packer,
+                                   PoneRectU32 *rect) {
+    PoneRectShelfBlock *blocks = packer->blocks;
+    u32 *link = packer->buckets +
+                _pone_rect_shelf_bucket(packer, rect->x_min, rect->y_min);
+    while (*link != PONE_RECT_SHELF_NONE &&
+           (blocks[*link].x != rect->x_min ||
+            packer->shelves[blocks[*link].shelf].y != rect->y_min)) {
+        link = &blocks[*link].link_next;
+    }
+    pone_assert(*link != PONE_RECT_SHELF_NONE);
+
+    u32 block_index = *link;
+    PoneRectShelfBlock *block = blocks + block_index;
+    pone_assert(block->width == pone_rect_u32_width(rect) &&
+                block->height == pone_rect_u32_height(rect));
+    *link = block->link_next;
+    block->height = 0;
+
+    if (block->prev != PONE_RECT_SHELF_NONE && !blocks[block->prev].height) {
+        u32 prev_index = block->prev;
+        PoneRectShelfBlock *prev = blocks + prev_index;
+        _pone_rect_shelf_unlink_free(packer, prev_index);
+        prev->width += block->width;
+        prev->next = block->next;
+        if (block->next != PONE_RECT_SHELF_NONE) {
+            blocks[block->next].prev = prev_index;
+        }
+        _pone_rect_shelf_packer_free_block(packer, block_index);
+        block_index = prev_index;
+        block = prev;
+    }
+    if (block->next != PONE_RECT_SHELF_NONE && !blocks[block->next].height) {
+        u32 next_index = block->next;
+        PoneRectShelfBlock *next = blocks + next_index;
+        _pone_rect_shelf_unlink_free(packer, next_index);
+        block->width += next->width;
+        block->next = next->next;
+        if (next->next != PONE_RECT_SHELF_NONE) {
+            blocks[next->next].prev = block_index;
+        }
+        _pone_rect_shelf_packer_free_block(packer, next_index);
+    }
+    _pone_rect_shelf_link_free(packer, block_index);
+
+    // Empty shelves at the bottom give their height back, so it can be
+    // reopened at any shelf height.
+    while (packer->shelf_count) {
+        PoneRectShelf *last = packer->shelves + packer->shelf_count - 1;
+        PoneRectShelfBlock *first = blocks + last->first_block;
+        if (first->height || first->width != packer->width) {
+            break;
+        }
+
+        _pone_rect_shelf_unlink_free(packer, last->first_block);
+        _pone_rect_shelf_packer_free_block(packer, last->first_block);
+        packer->used_height = last->y;
+        packer->shelf_count--;
+    }
+}
+
+void pone_rect_shelf_packer_stats(PoneRectShelfPacker *packer,
+                                  PoneRectShelfPackerStats *stats) {
+    *stats = {};
+    for (usize shelf_index = 0; shelf_index < packer->shelf_count;
+         ++shelf_index) {
+        PoneRectShelf *shelf = packer->shelves + shelf_index;
+        for (u32 block_index = shelf->first_block;
+             block_index != PONE_RECT_SHELF_NONE;
+             block_index = packer->blocks[block_index].next) {
+            PoneRectShelfBlock *block = packer->blocks + block_index;
+            if (block->height) {
+                stats->rect_count++;
+                stats->used_area += (u64)block->width * block->height;
+                stats->waste_area +=
+                    (u64)block->width * (shelf->height - block->height);
+            } else {
+                u64 area = (u64)block->width * shelf->height;
+                stats->free_block_count++;
+                stats->free_area += area;
+                stats->largest_free_area =
+                    PONE_MAX(stats->largest_free_area, area);
+            }
+        }
+    }
+
+    u64 unopened_area =
+        (u64)packer->width * (packer->height - packer->used_height);
+    stats->free_area += unopened_area;
+    stats->largest_free_area =
+        PONE_MAX(stats->largest_free_area, unopened_area);
+    if (stats->free_area) {
+        stats->fragmentation =
+            1.0f - (f32)stats->largest_free_area / (f32)stats->free_area;
+    }
+}
+
+// Both were initialized with the same sizes.
+static void _pone_rect_shelf_packer_copy(PoneRectShelfPacker *dst,
+                                         PoneRectShelfPacker *src) {
+    pone_assert(dst->width == src->width && dst->height == src->height &&
+                dst->item_capacity == src->item_capacity);
+    dst->used_height = src->used_height;
+    dst->shelf_count = src->shelf_count;
+    dst->free_block = src->free_block;
+    pone_memcpy((void *)dst->shelves, (void *)src->shelves,
+                src->shelf_capacity * sizeof(PoneRectShelf));
+    pone_memcpy((void *)dst->blocks, (void *)src->blocks,
+                _pone_rect_shelf_block_capacity(src) *
+                    sizeof(PoneRectShelfBlock));
+    pone_memcpy((void *)dst->free_lists, (void *)src->free_lists,
+                src->shelf_capacity * PONE_RECT_SHELF_WIDTH_CLASS_COUNT *
+                    sizeof(u32));
+    pone_memcpy((void *)dst->width_class_masks,
+                (void *)src->width_class_masks,
+                src->shelf_capacity * sizeof(u64));
+    pone_memcpy((void *)dst->height_class_masks,
+                (void *)src->height_class_masks,
+                _pone_rect_shelf_height_class_word_count(src) * sizeof(u64));
+    pone_memcpy((void *)dst->buckets, (void *)src->buckets,
+                ((usize)src->bucket_mask + 1) * sizeof(u32));
+}
+
+b8 pone_rect_shelf_packer_defragment(PoneRectShelfPacker *packer,
+                                     Arena *arena, PoneRectShelfMove **moves,
+                                     usize *move_count) {
+    usize arena_offset_begin = arena->offset;
+    PoneRectShelfPackerStats stats;
+    pone_rect_shelf_packer_stats(packer, &stats);
+    PoneRectShelfMove *packer_moves =
+        arena_alloc_array(arena, stats.rect_count, PoneRectShelfMove);
+
+    usize arena_tmp_begin = arena->offset;
+    PoneRectPackItem *items =
+        arena_alloc_array(arena, stats.rect_count, PoneRectPackItem);
+    usize item_count = 0;
+    for (usize shelf_index = 0; shelf_index < packer->shelf_count;
+         ++shelf_index) {
+        PoneRectShelf *shelf = packer->shelves + shelf_index;
+        for (u32 block_index = shelf->first_block;
+             block_index != PONE_RECT_SHELF_NONE;
+             block_index = packer->blocks[block_index].next) {
+            PoneRectShelfBlock *block = packer->blocks + block_index;
+            if (block->height) {
+                items[item_count++] = {
+                    .rect = {
+                        .x_min = block->x,
+                        .y_min = shelf->y,
+                        .x_max = block->x + block->width,
+                        .y_max = shelf->y + block->height,
+                    },
+                };
+            }
+        }
+    }
+    _pone_rect_pack_item_sort(items, item_count, _pone_rect_pack_item_is_taller,
+                              arena);
+
+    PoneRectShelfPacker repacked;
+    pone_rect_shelf_packer_init(&repacked, packer->width, packer->height,
+                                packer->item_capacity, arena);
+    usize packer_move_count = 0;
+    for (usize item_index = 0; item_index < item_count; ++item_index) {
+        PoneRectU32 *src = &items[item_index].rect;
+        PoneRectU32 dst;
+        if (!pone_rect_shelf_packer_insert(&repacked, pone_rect_u32_width(src),
+                                           pone_rect_u32_height(src), &dst)) {
+            arena->offset = arena_offset_begin;
+            return 0;
+        }
+        if (dst.x_min != src->x_min || dst.y_min != src->y_min) {
+            packer_moves[packer_move_count++] = {
+                .src = *src,
+                .dst = dst,
+            };
+        }
+    }
+
+    _pone_rect_shelf_packer_copy(packer, &repacked);
+    arena->offset = arena_tmp_begin;
+    *moves = packer_moves;
+    *move_count = packer_move_count;
+    return 1;
+}
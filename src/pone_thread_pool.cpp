@@ -0,0 +1,212 @@
+#include "pone_thread_pool.h"
+
+#include "pone_assert.h"
+
+static thread_local PoneThreadPool *pone_thread_pool_current_pool;
+static thread_local usize pone_thread_pool_current_thread_index;
+static thread_local u32 pone_thread_pool_random_state;
+
+usize pone_thread_pool_thread_index(void) {
+    return pone_thread_pool_current_thread_index;
+}
+
+static u32 _pone_thread_pool_random(void) {
+    u32 x = pone_thread_pool_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    pone_thread_pool_random_state = x;
+
+    return x;
+}
+
+static b8 _pone_thread_pool_steal(PoneThreadPool *pool, usize thread_index,
+                                  PoneWorkQueueData *data) {
+    usize deque_count = pool->worker_count + 1;
+    for (;;) {
+        b8 was_aborted = 0;
+        usize victim = _pone_thread_pool_random() % deque_count;
+        for (usize i = 0; i < deque_count; ++i) {
+            usize victim_index = (victim + i) % deque_count;
+            if (victim_index == thread_index) {
+                continue;
+            }
+
+            PoneWorkDequeStealResult result =
+                pone_work_deque_steal(&pool->deques[victim_index], data);
+            if (result == PONE_WORK_DEQUE_STEAL_RESULT_SUCCESS) {
+                return 1;
+            }
+            if (result == PONE_WORK_DEQUE_STEAL_RESULT_ABORT) {
+                was_aborted = 1;
+            }
+        }
+
+        // Lost races only mean somebody else got that item, retry while
+        // there are signs of work left.
+        if (!was_aborted) {
+            return 0;
+        }
+    }
+}
+
+b8 pone_thread_pool_try_consume_work(PoneThreadPool *pool) {
+    PoneWorkQueueData data;
+    b8 is_pool_thread = pone_thread_pool_current_pool == pool;
+    usize thread_index =
+        is_pool_thread ? pone_thread_pool_current_thread_index : (usize)-1;
+
+    b8 found = 0;
+    if (is_pool_thread) {
+        found = pone_work_deque_pop(&pool->deques[thread_index], &data);
+    }
+    if (!found) {
+        found = pone_work_queue_dequeue(&pool->work_queue, &data);
+    }
+    if (!found) {
+        found = _pone_thread_pool_steal(pool, thread_index, &data);
+    }
+    if (!found) {
+        return 0;
+    }
+
+    (data.work)(data.user_data);
+
+    if (_pone_atomic_fetch_sub(&pool->pending_count, 1,
+                               PONE_MEMORY_ORDERING_ACQ_REL) == 1) {
+        pone_platform_wake_by_address_all(&pool->pending_count);
+    }
+
+    return 1;
+}
+
+static void pone_thread_pool_worker_proc(void *param) {
+    PoneThreadPoolWorker *worker = (PoneThreadPoolWorker *)param;
+    PoneThreadPool *pool = worker->pool;
+    pone_thread_pool_current_pool = pool;
+    pone_thread_pool_current_thread_index = worker->thread_index;
+    pone_thread_pool_random_state = 0x9e3779b9u * (u32)worker->thread_index;
+
+    while (_pone_atomic_load_n(&pool->is_running,
+                               PONE_MEMORY_ORDERING_ACQUIRE)) {
+        if (pone_thread_pool_try_consume_work(pool)) {
+            continue;
+        }
+
+        // Announce the sleep before the last look for work, pushers check
+        // sleeper_count after publishing their item.
+        _pone_atomic_fetch_add(&pool->sleeper_count, 1,
+                               PONE_MEMORY_ORDERING_SEQ_CST);
+        if (!pone_thread_pool_try_consume_work(pool)) {
+            pone_semaphore_wait(&pool->work_semaphore);
+        }
+        _pone_atomic_fetch_sub(&pool->sleeper_count, 1,
+                               PONE_MEMORY_ORDERING_RELAXED);
+    }
+
+    pone_scratch_release();
+}
+
+void pone_thread_pool_init(PoneThreadPool *pool, usize worker_count,
+                           Arena *arena) {
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    if (worker_count == 0) {
+        worker_count =
+            system_info.processor_count > 1 ? system_info.processor_count - 1
+                                            : 1;
+    }
+
+    pone_work_queue_init(&pool->work_queue, arena);
+    pool->deques =
+        arena_alloc_array_aligned(arena, worker_count + 1, PoneWorkDeque);
+    for (usize i = 0; i < worker_count + 1; ++i) {
+        pone_work_deque_init(&pool->deques[i]);
+    }
+    pone_semaphore_init(&pool->work_semaphore, 0);
+    _pone_atomic_store_n(&pool->sleeper_count, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&pool->pending_count, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&pool->is_running, 1, PONE_MEMORY_ORDERING_RELEASE);
+    pool->worker_count = worker_count;
+    pool->workers =
+        arena_alloc_array_aligned(arena, worker_count, PoneThreadPoolWorker);
+
+    pone_thread_pool_current_pool = pool;
+    pone_thread_pool_current_thread_index = 0;
+    pone_thread_pool_random_state = 0x9e3779b9u;
+
+    // The calling thread keeps processor 0, workers take the rest.
+    for (usize i = 0; i < worker_count; ++i) {
+        PoneThreadPoolWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->thread_index = i + 1;
+        pone_platform_create_thread(&worker->thread,
+                                    pone_thread_pool_worker_proc,
+                                    (void *)worker);
+        if (system_info.processor_count > 1) {
+            pone_platform_pin_thread(&worker->thread,
+                                     (u32)((i + 1) %
+                                           system_info.processor_count));
+        }
+    }
+}
+
+void pone_thread_pool_destroy(PoneThreadPool *pool) {
+    pone_thread_pool_wait_all(pool);
+
+    _pone_atomic_store_n(&pool->is_running, 0, PONE_MEMORY_ORDERING_RELEASE);
+    for (usize i = 0; i < pool->worker_count; ++i) {
+        pone_semaphore_signal(&pool->work_semaphore);
+    }
+    for (usize i = 0; i < pool->worker_count; ++i) {
+        pone_platform_join_thread(&pool->workers[i].thread);
+    }
+    for (usize i = 0; i < pool->worker_count + 1; ++i) {
+        pone_work_deque_destroy(&pool->deques[i]);
+    }
+
+    if (pone_thread_pool_current_pool == pool) {
+        pone_thread_pool_current_pool = 0;
+    }
+}
+
+void pone_thread_pool_push(PoneThreadPool *pool, PoneWorkFn work,
+                           void *user_data) {
+    PoneWorkQueueData data = {
+        .work = work,
+        .user_data = user_data,
+    };
+
+    _pone_atomic_fetch_add(&pool->pending_count, 1,
+                           PONE_MEMORY_ORDERING_RELAXED);
+    if (pone_thread_pool_current_pool == pool) {
+        pone_work_deque_push(
+            &pool->deques[pone_thread_pool_current_thread_index], &data);
+    } else {
+        // A full queue is drained by the producer itself instead of failing.
+        while (!pone_work_queue_enqueue(&pool->work_queue, &data)) {
+            pone_thread_pool_try_consume_work(pool);
+        }
+    }
+
+    _pone_atomic_thread_fence(PONE_MEMORY_ORDERING_SEQ_CST);
+    if (_pone_atomic_load_n(&pool->sleeper_count,
+                            PONE_MEMORY_ORDERING_RELAXED)) {
+        pone_semaphore_signal(&pool->work_semaphore);
+    }
+}
+
+void pone_thread_pool_wait_all(PoneThreadPool *pool) {
+    for (;;) {
+        u32 pending_count = _pone_atomic_load_n(&pool->pending_count,
+                                                PONE_MEMORY_ORDERING_ACQUIRE);
+        if (pending_count == 0) {
+            break;
+        }
+
+        if (!pone_thread_pool_try_consume_work(pool)) {
+            pone_platform_wait_on_address(&pool->pending_count,
+                                          pending_count);
+        }
+    }
+}
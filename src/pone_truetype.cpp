@@ -1,71 +1,92 @@
 #include "pone_truetype.h"
 
 #include "pone_assert.h"
+#include "pone_hash.h"
 #include "pone_math.h"
 #include "pone_memory.h"
+#include "pone_platform.h"
 #include "pone_rect.h"
 #include "pone_rect_pack.h"
 #include "pone_string.h"
 
+#if defined(__x86_64__) || defined(_M_X64)
+#define PONE_TRUETYPE_X64
+#include <immintrin.h>
+#endif
+
+// Reads that would go past the end of input return 0 and set is_failed
+// instead, so parsing only has to check is_failed once it is done with a
+// table. Parsers also set it when they find values that make no sense.
 struct PoneSfntScanner {
     PoneTruetypeInput input;
     usize cursor;
+    b8 is_failed;
 };
 
-static void pone_sfnt_scanner_read_string(PoneSfntScanner *scanner,
-                                          PoneString *s, usize length) {
-    pone_assert(scanner->cursor < scanner->input.length);
+static inline usize pone_sfnt_scanner_remaining(PoneSfntScanner *scanner) {
+    return scanner->cursor < scanner->input.length
+               ? scanner->input.length - scanner->cursor
+               : 0;
+}
 
-    s->buf = (u8 *)scanner->input.data + scanner->cursor;
-    s->len = length;
+// Returns where the next size bytes start, or 0 when they are not all there.
+// cursor may already be past the end after skipping.
+static inline u8 *pone_sfnt_scanner_take(PoneSfntScanner *scanner,
+                                         usize size) {
+    if (size > pone_sfnt_scanner_remaining(scanner)) {
+        scanner->is_failed = 1;
+        return 0;
+    }
 
-    scanner->cursor += length;
+    u8 *p = (u8 *)scanner->input.data + scanner->cursor;
+    scanner->cursor += size;
+    return p;
 }
 
-static inline u32 pone_sfnt_scanner_read_be_u32(PoneSfntScanner *scanner) {
-    pone_assert(scanner->cursor < scanner->input.length);
+static void pone_sfnt_scanner_read_string(PoneSfntScanner *scanner,
+                                          PoneString *s, usize length) {
+    s->buf = pone_sfnt_scanner_take(scanner, length);
+    s->len = s->buf ? length : 0;
+}
 
-    u32 v = *(u32 *)((u8 *)scanner->input.data + scanner->cursor);
-    scanner->cursor += 4;
+// Font data has no alignment guarantees, the memcpy compiles to a plain
+// unaligned load.
+static inline u32 pone_sfnt_scanner_read_be_u32(PoneSfntScanner *scanner) {
+    u8 *p = pone_sfnt_scanner_take(scanner, 4);
+    if (!p) {
+        return 0;
+    }
 
-    return (v >> 24) | ((v >> 8) & 0x0000FF00) | ((v << 8) & 0x00FF0000) |
-           (v << 24);
+    u32 v;
+    __builtin_memcpy(&v, p, 4);
+    return __builtin_bswap32(v);
 }
 
 static inline u16 pone_sfnt_scanner_read_be_u16(PoneSfntScanner *scanner) {
-    pone_assert(scanner->cursor < scanner->input.length);
-
-    u16 v = *(u16 *)((u8 *)scanner->input.data + scanner->cursor);
-    scanner->cursor += 2;
+    u8 *p = pone_sfnt_scanner_take(scanner, 2);
+    if (!p) {
+        return 0;
+    }
 
-    return (v << 8) | (v >> 8);
+    u16 v;
+    __builtin_memcpy(&v, p, 2);
+    return __builtin_bswap16(v);
 }
 
 static inline i8 pone_sfnt_scanner_read_be_i8(PoneSfntScanner *scanner) {
-    pone_assert(scanner->cursor < scanner->input.length);
-
-    i8 v = *(i8 *)((u8 *)scanner->input.data + scanner->cursor);
-    ++scanner->cursor;
+    u8 *p = pone_sfnt_scanner_take(scanner, 1);
 
-    return v;
+    return p ? (i8)*p : 0;
 }
 
 static inline i16 pone_sfnt_scanner_read_be_i16(PoneSfntScanner *scanner) {
-    pone_assert(scanner->cursor < scanner->input.length);
-
-    u16 v = *(u16 *)((u8 *)scanner->input.data + scanner->cursor);
-    scanner->cursor += 2;
-
-    v = (v << 8) | (v >> 8);
-    return *(i16 *)&v;
+    return (i16)pone_sfnt_scanner_read_be_u16(scanner);
 }
 
 static inline u8 pone_sfnt_scanner_read_u8(PoneSfntScanner *scanner) {
-    pone_assert(scanner->cursor < scanner->input.length);
+    u8 *p = pone_sfnt_scanner_take(scanner, 1);
 
-    u8 v = *((u8 *)scanner->input.data + scanner->cursor);
-    ++scanner->cursor;
-    return v;
+    return p ? *p : 0;
 }
 
 static inline f32 pone_sfnt_scanner_read_f2dot14(PoneSfntScanner *scanner) {
@@ -115,6 +136,27 @@ static void pone_sfnt_parse_table_dir(PoneSfntScanner *scanner,
     }
 }
 
+// Tables are parsed with a scanner of their own, so reads can not run into
+// the next table. Fails when entry is missing or reaches past the input.
+static b8 pone_sfnt_table_scanner(PoneTruetypeInput input,
+                                  PoneSfntTableDirEntry *entry,
+                                  PoneSfntScanner *scanner) {
+    if (!entry || (u64)entry->offset + entry->length > input.length) {
+        return 0;
+    }
+
+    *scanner = {
+        .input =
+            {
+                .data = (u8 *)input.data + entry->offset,
+                .length = entry->length,
+            },
+        .cursor = 0,
+        .is_failed = 0,
+    };
+    return 1;
+}
+
 struct PoneSfntHead {
     u16 units_per_em;
     PoneSfntGlyphBbox global_bbox;
@@ -139,35 +181,58 @@ struct PoneSfntLoca {
     usize offset_count;
 };
 
+// Offsets have to be ascending and stay within glyf, glyph records are then
+// known to lie inside the font.
 static void pone_sfnt_parse_loca(PoneSfntScanner *scanner, b8 format,
-                                 usize offset_count, PoneSfntLoca *loca,
-                                 Arena *arena) {
+                                 usize offset_count, usize glyf_length,
+                                 PoneSfntLoca *loca, Arena *arena) {
     loca->format = format;
 
+    usize prev_offset = 0;
     if (format) {
         u32 *offsets = arena_alloc_array(arena, offset_count, u32);
         for (usize i = 0; i < offset_count; ++i) {
             offsets[i] = pone_sfnt_scanner_read_be_u32(scanner);
-            pone_assert(offsets[i] < scanner->input.length);
+            if (offsets[i] < prev_offset || offsets[i] > glyf_length) {
+                scanner->is_failed = 1;
+            }
+            prev_offset = offsets[i];
         }
         loca->offsets = (void *)offsets;
     } else {
         u16 *offsets = arena_alloc_array(arena, offset_count, u16);
         for (usize i = 0; i < offset_count; ++i) {
             offsets[i] = pone_sfnt_scanner_read_be_u16(scanner);
-            pone_assert(offsets[i] < scanner->input.length);
+            usize offset = (usize)offsets[i] * 2;
+            if (offset < prev_offset || offset > glyf_length) {
+                scanner->is_failed = 1;
+            }
+            prev_offset = offset;
         }
         loca->offsets = (void *)offsets;
     }
 }
 
 struct PoneSfntMaxp {
+    u32 version;
     u16 num_glyphs;
+    u16 max_points;
+    u16 max_contours;
+    u16 max_component_elements;
 };
 
 static void pone_sfnt_parse_maxp(PoneSfntScanner *scanner, PoneSfntMaxp *maxp) {
-    scanner->cursor += 4;
+    maxp->version = pone_sfnt_scanner_read_be_u32(scanner);
     maxp->num_glyphs = pone_sfnt_scanner_read_be_u16(scanner);
+    // Version 0.5 is for CFF outlines and stops after num_glyphs.
+    // Glyph 0 is the missing glyph every unmapped codepoint falls back to.
+    if (maxp->version < 0x00010000 || maxp->num_glyphs == 0) {
+        scanner->is_failed = 1;
+    }
+    maxp->max_points = pone_sfnt_scanner_read_be_u16(scanner);
+    maxp->max_contours = pone_sfnt_scanner_read_be_u16(scanner);
+    scanner->cursor += 18;
+    maxp->max_component_elements = pone_sfnt_scanner_read_be_u16(scanner);
 }
 
 struct PoneSfntGlyphDescription {
@@ -228,6 +293,11 @@ static void pone_sfnt_scanner_parse_cmap_format_12(PoneSfntScanner *scanner,
     format->length = pone_sfnt_scanner_read_be_u32(scanner);
     format->language = pone_sfnt_scanner_read_be_u32(scanner);
     format->group_count = pone_sfnt_scanner_read_be_u32(scanner);
+    // Checked before allocating, a corrupt count could be billions.
+    if (format->group_count > pone_sfnt_scanner_remaining(scanner) / 12) {
+        scanner->is_failed = 1;
+        format->group_count = 0;
+    }
     format->groups = arena_alloc_array(arena, format->group_count,
                                        PoneSfntSequentialMapGroup);
     for (usize group_index = 0; group_index < format->group_count;
@@ -239,6 +309,74 @@ static void pone_sfnt_scanner_parse_cmap_format_12(PoneSfntScanner *scanner,
     }
 }
 
+static u32 pone_sfnt_cmap_format_12_glyph_id(PoneSfntCmapFormat12 *cmap,
+                                             u32 codepoint) {
+    // Groups are sorted by start_char.
+    usize lo = 0;
+    usize hi = cmap->group_count;
+    while (lo < hi) {
+        usize mid = lo + (hi - lo) / 2;
+        PoneSfntSequentialMapGroup *group = cmap->groups + mid;
+        if (codepoint < group->start_char) {
+            hi = mid;
+        } else if (codepoint > group->end_char) {
+            lo = mid + 1;
+        } else {
+            return group->start_glyph_id + (codepoint - group->start_char);
+        }
+    }
+
+    return PONE_TRUETYPE_MISSING_GLYPH;
+}
+
+// Every page without a mapped codepoint points at the shared page 0, so
+// the table costs 512 bytes per page of the BMP the font covers.
+static void pone_truetype_cmap_page_table_build(
+    PoneTrueTypeCmapPageTable *table, PoneSfntCmapFormat12 *cmap,
+    usize glyph_count, Arena *arena) {
+    pone_memset((void *)table->page_indices, 0, sizeof(table->page_indices));
+    table->page_count = 1;
+    for (usize group_index = 0; group_index < cmap->group_count;
+         ++group_index) {
+        PoneSfntSequentialMapGroup *group = cmap->groups + group_index;
+        if (group->start_char > PONE_TRUETYPE_BMP_END ||
+            group->start_char > group->end_char) {
+            continue;
+        }
+        u32 end_char = PONE_MIN(group->end_char, PONE_TRUETYPE_BMP_END);
+        for (u32 page = group->start_char >> 8; page <= end_char >> 8;
+             ++page) {
+            if (!table->page_indices[page]) {
+                table->page_indices[page] = (u16)table->page_count++;
+            }
+        }
+    }
+
+    table->pages = (u16(*)[PONE_TRUETYPE_CMAP_PAGE_SIZE])arena_alloc(
+        arena, table->page_count * sizeof(table->pages[0]));
+    pone_memset((void *)table->pages, PONE_TRUETYPE_MISSING_GLYPH,
+                table->page_count * sizeof(table->pages[0]));
+    for (usize group_index = 0; group_index < cmap->group_count;
+         ++group_index) {
+        PoneSfntSequentialMapGroup *group = cmap->groups + group_index;
+        if (group->start_char > PONE_TRUETYPE_BMP_END ||
+            group->start_char > group->end_char) {
+            continue;
+        }
+        u32 end_char = PONE_MIN(group->end_char, PONE_TRUETYPE_BMP_END);
+        for (u32 codepoint = group->start_char; codepoint <= end_char;
+             ++codepoint) {
+            u32 glyph_id =
+                group->start_glyph_id + (codepoint - group->start_char);
+            if (glyph_id >= glyph_count) {
+                glyph_id = PONE_TRUETYPE_MISSING_GLYPH;
+            }
+            table->pages[table->page_indices[codepoint >> 8]]
+                        [codepoint & 0xff] = (u16)glyph_id;
+        }
+    }
+}
+
 static inline b8 pone_sfnt_outline_flags_on_curve(u8 flag) {
     // 0b00000001
     return flag & 0x1;
@@ -286,15 +424,32 @@ static void pone_sfnt_scanner_read_coordinate(PoneSfntScanner *scanner,
     }
 }
 
+// A glyph going over these is treated as corrupt.
+struct PoneSfntGlyphLimits {
+    usize glyph_count;
+    usize point_count;
+    usize contour_count;
+    usize component_count;
+};
+
 static void pone_sfnt_parse_simple_glyph(PoneSfntScanner *scanner,
                                          PoneSfntGlyphDescription *desc,
+                                         PoneSfntGlyphLimits *limits,
                                          PoneSfntSimpleGlyph *glyph,
                                          Arena *arena, b8 debug_print) {
     usize end_points_of_contour_count = desc->number_of_contours;
+    if (end_points_of_contour_count > limits->contour_count) {
+        scanner->is_failed = 1;
+        return;
+    }
     u16 *end_points_of_contours =
         arena_alloc_array(arena, end_points_of_contour_count, u16);
     for (usize i = 0; i < end_points_of_contour_count; ++i) {
         end_points_of_contours[i] = pone_sfnt_scanner_read_be_u16(scanner);
+        if (i > 0 &&
+            end_points_of_contours[i] <= end_points_of_contours[i - 1]) {
+            scanner->is_failed = 1;
+        }
     }
 
     u16 instruction_count = pone_sfnt_scanner_read_be_u16(scanner);
@@ -307,6 +462,10 @@ static void pone_sfnt_parse_simple_glyph(PoneSfntScanner *scanner,
     } else {
         point_count = 0;
     }
+    if (scanner->is_failed || point_count > limits->point_count) {
+        scanner->is_failed = 1;
+        return;
+    }
     PoneSfntGlyphPoint *points =
         arena_alloc_array(arena, point_count, PoneSfntGlyphPoint);
     usize x_size = 0;
@@ -314,7 +473,7 @@ static void pone_sfnt_parse_simple_glyph(PoneSfntScanner *scanner,
     usize flag_index = 0;
     usize arena_temp_begin = arena->offset;
     u8 *flags = arena_alloc_array(arena, point_count, u8);
-    while (flag_index < point_count) {
+    while (flag_index < point_count && !scanner->is_failed) {
         usize x_size_increase = 0;
         flags[flag_index] = pone_sfnt_scanner_read_u8(scanner);
         b8 repeat = pone_sfnt_outline_flags_repeat(flags[flag_index]);
@@ -329,6 +488,10 @@ static void pone_sfnt_parse_simple_glyph(PoneSfntScanner *scanner,
 
         if (repeat) {
             u8 repeat_count = pone_sfnt_scanner_read_u8(scanner);
+            if (repeat_count >= point_count - flag_index) {
+                scanner->is_failed = 1;
+                break;
+            }
             x_size += repeat_count * x_size_increase;
             for (usize i = 0; i < repeat_count; ++i) {
                 flags[flag_index + i + 1] = flags[flag_index];
@@ -339,12 +502,18 @@ static void pone_sfnt_parse_simple_glyph(PoneSfntScanner *scanner,
         ++flag_index;
     }
 
+    if (scanner->is_failed) {
+        arena->offset = arena_temp_begin;
+        return;
+    }
+
     i16 x = 0;
     i16 y = 0;
     PoneSfntScanner *x_coordinates = scanner;
     PoneSfntScanner y_coordinates = {
         .input = scanner->input,
         .cursor = scanner->cursor + x_size,
+        .is_failed = 0,
     };
     for (usize point_index = 0; point_index < point_count; ++point_index) {
         u8 flag = flags[point_index];
@@ -365,6 +534,7 @@ static void pone_sfnt_parse_simple_glyph(PoneSfntScanner *scanner,
             .y = y,
         };
     }
+    y_coordinates.is_failed |= scanner->is_failed;
     *scanner = y_coordinates;
     arena->offset = arena_temp_begin;
 
@@ -432,12 +602,17 @@ static usize pone_sfnt_scanner_count_component_glyphs_in_compound_glyph(
 
 static void
 pone_sfnt_parse_component_glyph(PoneSfntScanner *scanner,
+                                PoneSfntGlyphLimits *limits,
                                 PoneSfntComponentGlyph *component_glyph) {
 
     component_glyph->flags = pone_sfnt_scanner_read_be_u16(scanner);
     component_glyph->glyph_index = pone_sfnt_scanner_read_be_u16(scanner);
-    pone_assert(
-        pone_sfnt_compound_glyph_args_are_x_y_values(component_glyph->flags));
+    // Components positioned by matching points are not supported.
+    if (!pone_sfnt_compound_glyph_args_are_x_y_values(
+            component_glyph->flags) ||
+        component_glyph->glyph_index >= limits->glyph_count) {
+        scanner->is_failed = 1;
+    }
 
     if (pone_sfnt_compound_glyph_arg1_and_arg2_are_words(
             component_glyph->flags)) {
@@ -483,23 +658,30 @@ pone_sfnt_parse_component_glyph(PoneSfntScanner *scanner,
 
 static void
 pone_sfnt_parse_compound_glyph(PoneSfntScanner *scanner,
+                               PoneSfntGlyphLimits *limits,
                                PoneSfntCompoundGlyph *compound_glyph,
                                Arena *arena) {
     usize begin_cursor = scanner->cursor;
     compound_glyph->component_glyph_count =
         pone_sfnt_scanner_count_component_glyphs_in_compound_glyph(scanner);
     scanner->cursor = begin_cursor;
+    if (scanner->is_failed ||
+        compound_glyph->component_glyph_count > limits->component_count) {
+        scanner->is_failed = 1;
+        return;
+    }
 
     compound_glyph->component_glyphs = arena_alloc_array(
         arena, compound_glyph->component_glyph_count, PoneSfntComponentGlyph);
     for (usize i = 0; i < compound_glyph->component_glyph_count; ++i) {
         PoneSfntComponentGlyph *component_glyph =
             compound_glyph->component_glyphs + i;
-        pone_sfnt_parse_component_glyph(scanner, component_glyph);
+        pone_sfnt_parse_component_glyph(scanner, limits, component_glyph);
     }
 }
 
 static void pone_sfnt_parse_glyph(PoneSfntScanner *scanner,
+                                  PoneSfntGlyphLimits *limits,
                                   PoneSfntGlyph *glyph, Arena *arena,
                                   b8 debug_print) {
     PoneSfntGlyphDescription glyph_desc;
@@ -513,11 +695,15 @@ static void pone_sfnt_parse_glyph(PoneSfntScanner *scanner,
 
     if (glyph_desc.number_of_contours > 0) {
         glyph->type = PONE_SFNT_GLYPH_TYPE_SIMPLE;
-        pone_sfnt_parse_simple_glyph(scanner, &glyph_desc, &glyph->simple,
-                                     arena, debug_print);
+        pone_sfnt_parse_simple_glyph(scanner, &glyph_desc, limits,
+                                     &glyph->simple, arena, debug_print);
     } else if (glyph_desc.number_of_contours < 0) {
         glyph->type = PONE_SFNT_GLYPH_TYPE_COMPOUND;
-        pone_sfnt_parse_compound_glyph(scanner, &glyph->compound, arena);
+        pone_sfnt_parse_compound_glyph(scanner, limits, &glyph->compound,
+                                       arena);
+    } else {
+        glyph->type = PONE_SFNT_GLYPH_TYPE_SIMPLE;
+        glyph->simple = {};
     }
 }
 
@@ -537,107 +723,355 @@ static inline void pone_sfnt_glyph_bbox_rect(PoneSfntGlyphBbox *bbox,
     };
 }
 
-PoneTrueTypeFont *pone_truetype_parse(PoneTruetypeInput input, Arena *arena) {
+// Leaves glyph without an outline and returns 0 when its record is corrupt.
+static b8 pone_truetype_font_decode_glyph(PoneTrueTypeFont *font,
+                                          u32 glyph_id, PoneSfntGlyph *glyph,
+                                          Arena *arena) {
+    *glyph = {
+        .type = PONE_SFNT_GLYPH_TYPE_SIMPLE,
+        .bbox = {},
+        .simple = {},
+    };
+
+    usize glyph_offset;
+    usize next_glyph_offset;
+    if (font->loca_format) {
+        glyph_offset = (usize) * ((u32 *)font->loca_offsets + glyph_id);
+        next_glyph_offset =
+            (usize) * ((u32 *)font->loca_offsets + glyph_id + 1);
+    } else {
+        // The short format stores offsets divided by two.
+        glyph_offset = (usize) * ((u16 *)font->loca_offsets + glyph_id) * 2;
+        next_glyph_offset =
+            (usize) * ((u16 *)font->loca_offsets + glyph_id + 1) * 2;
+    }
+
+    if (glyph_offset == next_glyph_offset) {
+        // Glyphs without an outline, like space, have no data at all.
+        return 1;
+    }
+
+    // The lazy cache's arena only has room for glyphs within maxp's limits,
+    // fully parsed fonts are only limited by the format.
+    PoneSfntGlyphLimits limits = {
+        .glyph_count = font->glyph_count,
+        .point_count = USIZE_MAX,
+        .contour_count = USIZE_MAX,
+        .component_count = USIZE_MAX,
+    };
+    PoneTrueTypeGlyphOutlineCache *cache = font->outline_cache;
+    if (cache) {
+        limits.point_count = cache->max_points;
+        limits.contour_count = cache->max_contours;
+        limits.component_count = cache->max_component_elements;
+    }
+
+    // loca was checked to stay within glyf, which was checked to stay
+    // within the input.
+    PoneSfntScanner scanner = {
+        .input =
+            {
+                .data = (u8 *)font->input.data + font->glyf_offset +
+                        glyph_offset,
+                .length = next_glyph_offset - glyph_offset,
+            },
+        .cursor = 0,
+        .is_failed = 0,
+    };
+    usize arena_begin = arena->offset;
+    pone_sfnt_parse_glyph(&scanner, &limits, glyph, arena, glyph_id < 5);
+    if (scanner.is_failed) {
+        arena->offset = arena_begin;
+        *glyph = {
+            .type = PONE_SFNT_GLYPH_TYPE_SIMPLE,
+            .bbox = {},
+            .simple = {},
+        };
+        return 0;
+    }
+
+    return 1;
+}
+
+static PoneSfntTableDirEntry *
+pone_sfnt_find_table(PoneSfntTableDirEntry *entries, usize entry_count,
+                     const char *tag) {
+    for (usize i = 0; i < entry_count; ++i) {
+        if (pone_string_eq(entries[i].tag, {.buf = (u8 *)tag, .len = 4})) {
+            return entries + i;
+        }
+    }
+
+    return 0;
+}
+
+// Everything but the outlines, which are left to the caller. Returns 0 when
+// a table is missing, truncated or corrupt, or the font uses something
+// that is not supported.
+static PoneTrueTypeFont *pone_truetype_parse_tables(PoneTruetypeInput input,
+                                                    PoneSfntMaxp *maxp,
+                                                    Arena *arena) {
     PoneSfntScanner scanner = {
         .input = input,
         .cursor = 0,
+        .is_failed = 0,
     };
     PoneSfntFontDir font_dir;
     pone_sfnt_parse_font_dir(&scanner, &font_dir);
+    if (scanner.is_failed) {
+        return 0;
+    }
 
     usize entry_count = font_dir.num_tables;
     PoneSfntTableDirEntry *entries =
         arena_alloc_array(arena, entry_count, PoneSfntTableDirEntry);
     pone_sfnt_parse_table_dir(&scanner, entries, entry_count, arena);
-    PoneSfntTableDirEntry *glyph_entry;
-    PoneSfntTableDirEntry *head_entry;
-    PoneSfntTableDirEntry *loca_entry;
-    PoneSfntTableDirEntry *maxp_entry;
-    PoneSfntTableDirEntry *cmap_entry;
-    for (usize i = 0; i < entry_count; ++i) {
-        if (pone_string_eq(entries[i].tag, {.buf = (u8 *)"glyf", .len = 4})) {
-            glyph_entry = entries + i;
-        } else if (pone_string_eq(entries[i].tag,
-                                  {.buf = (u8 *)"head", .len = 4})) {
-            head_entry = entries + i;
-        } else if (pone_string_eq(entries[i].tag,
-                                  {.buf = (u8 *)"loca", .len = 4})) {
-            loca_entry = entries + i;
-        } else if (pone_string_eq(entries[i].tag,
-                                  {.buf = (u8 *)"loca", .len = 4})) {
-            loca_entry = entries + i;
-        } else if (pone_string_eq(entries[i].tag,
-                                  {.buf = (u8 *)"maxp", .len = 4})) {
-            maxp_entry = entries + i;
-        } else if (pone_string_eq(entries[i].tag,
-                                  {.buf = (u8 *)"cmap", .len = 4})) {
-            cmap_entry = entries + i;
-        }
-    }
-    pone_assert(head_entry);
-    pone_assert(maxp_entry);
-    pone_assert(loca_entry);
-    pone_assert(glyph_entry);
-    pone_assert(cmap_entry);
-    scanner.cursor = cmap_entry->offset;
+    if (scanner.is_failed) {
+        return 0;
+    }
+    PoneSfntScanner glyf_scanner;
+    PoneSfntScanner head_scanner;
+    PoneSfntScanner loca_scanner;
+    PoneSfntScanner maxp_scanner;
+    PoneSfntScanner cmap_scanner;
+    if (!pone_sfnt_table_scanner(
+            input, pone_sfnt_find_table(entries, entry_count, "glyf"),
+            &glyf_scanner) ||
+        !pone_sfnt_table_scanner(
+            input, pone_sfnt_find_table(entries, entry_count, "head"),
+            &head_scanner) ||
+        !pone_sfnt_table_scanner(
+            input, pone_sfnt_find_table(entries, entry_count, "loca"),
+            &loca_scanner) ||
+        !pone_sfnt_table_scanner(
+            input, pone_sfnt_find_table(entries, entry_count, "maxp"),
+            &maxp_scanner) ||
+        !pone_sfnt_table_scanner(
+            input, pone_sfnt_find_table(entries, entry_count, "cmap"),
+            &cmap_scanner)) {
+        return 0;
+    }
+
+    PoneSfntHead head;
+    pone_sfnt_parse_head(&head_scanner, &head);
+    if (head_scanner.is_failed || head.units_per_em == 0 ||
+        (head.index_to_loc_format != 0 && head.index_to_loc_format != 1)) {
+        return 0;
+    }
+
+    pone_sfnt_parse_maxp(&maxp_scanner, maxp);
+    if (maxp_scanner.is_failed) {
+        return 0;
+    }
+
     PoneSfntCmapIndex cmap_index;
-    pone_sfnt_scanner_parse_cmap_index(&scanner, &cmap_index);
+    pone_sfnt_scanner_parse_cmap_index(&cmap_scanner, &cmap_index);
     b8 found_unicode_subtable = 0;
     for (usize cmap_subtable_index = 0;
-         cmap_subtable_index < cmap_index.number_subtables;
+         cmap_subtable_index < cmap_index.number_subtables &&
+         !cmap_scanner.is_failed;
          ++cmap_subtable_index) {
         PoneSfntCmapSubtable subtable;
-        pone_sfnt_scanner_parse_cmap_subtable(&scanner, &subtable);
+        pone_sfnt_scanner_parse_cmap_subtable(&cmap_scanner, &subtable);
         if (subtable.platform_id == 0 && subtable.platform_specific_id == 4) {
-            scanner.cursor = cmap_entry->offset + subtable.offset;
+            cmap_scanner.cursor = subtable.offset;
             found_unicode_subtable = 1;
             break;
         }
     }
-    pone_assert(found_unicode_subtable);
-    u16 format_id = pone_sfnt_scanner_read_be_u16(&scanner);
-    pone_assert(format_id == 12);
+    u16 format_id = pone_sfnt_scanner_read_be_u16(&cmap_scanner);
+    if (!found_unicode_subtable || format_id != 12) {
+        return 0;
+    }
     PoneSfntCmapFormat12 format_12;
-    pone_sfnt_scanner_parse_cmap_format_12(&scanner, &format_12, arena);
-
-    scanner.cursor = head_entry->offset;
-    PoneSfntHead head;
-    pone_sfnt_parse_head(&scanner, &head);
-
-    scanner.cursor = maxp_entry->offset;
-    PoneSfntMaxp maxp;
-    pone_sfnt_parse_maxp(&scanner, &maxp);
+    pone_sfnt_scanner_parse_cmap_format_12(&cmap_scanner, &format_12, arena);
+    if (cmap_scanner.is_failed) {
+        return 0;
+    }
 
-    scanner.cursor = loca_entry->offset;
     PoneSfntLoca loca;
-    pone_sfnt_parse_loca(&scanner, (b8)head.index_to_loc_format,
-                         (usize)maxp.num_glyphs, &loca, arena);
+    // One offset more than glyphs, a glyph ends where the next one starts.
+    pone_sfnt_parse_loca(&loca_scanner, (b8)head.index_to_loc_format,
+                         (usize)maxp->num_glyphs + 1,
+                         glyf_scanner.input.length, &loca, arena);
+    if (loca_scanner.is_failed) {
+        return 0;
+    }
 
     PoneTrueTypeFont *font =
         (PoneTrueTypeFont *)arena_alloc(arena, sizeof(PoneTrueTypeFont));
     font->format_12 = format_12;
+    pone_truetype_cmap_page_table_build(&font->cmap_page_table, &format_12,
+                                        maxp->num_glyphs, arena);
     font->units_per_em = head.units_per_em;
     font->global_bbox = head.global_bbox;
-    font->glyph_count = maxp.num_glyphs;
-    font->glyphs = arena_alloc_array(arena, font->glyph_count, PoneSfntGlyph);
-    for (usize glyph_index = 0; glyph_index < font->glyph_count;
-         ++glyph_index) {
-        usize glyph_offset;
-        if (loca.format) {
-            glyph_offset = (usize) * ((u32 *)loca.offsets + glyph_index);
-        } else {
-            glyph_offset = (usize) * ((u16 *)loca.offsets + glyph_index);
+    font->glyph_count = maxp->num_glyphs;
+    font->glyphs = 0;
+    font->outline_cache = 0;
+    font->input = input;
+    font->glyf_offset = (u8 *)glyf_scanner.input.data - (u8 *)input.data;
+    font->loca_format = loca.format;
+    font->loca_offsets = loca.offsets;
+
+    return font;
+}
+
+PoneTrueTypeFont *pone_truetype_parse(PoneTruetypeInput input, Arena *arena) {
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    // Rolled back only when parsing fails.
+    usize arena_offset_begin = arena->offset;
+    PoneSfntMaxp maxp;
+    PoneTrueTypeFont *font = pone_truetype_parse_tables(input, &maxp, arena);
+    if (font) {
+        font->glyphs =
+            arena_alloc_array(arena, font->glyph_count, PoneSfntGlyph);
+        for (u32 glyph_id = 0; glyph_id < font->glyph_count; ++glyph_id) {
+            if (!pone_truetype_font_decode_glyph(
+                    font, glyph_id, font->glyphs + glyph_id, arena)) {
+                font = 0;
+                break;
+            }
         }
+    }
+    if (font) {
+        // Everything was decoded, input may go away now.
+        font->input = {};
+    } else {
+        arena->offset = arena_offset_begin;
+    }
+    PONE_ARENA_TAG_END();
+
+    return font;
+}
 
-        scanner.cursor = glyph_entry->offset + glyph_offset;
-        b8 debug_print = glyph_index < 5;
-        pone_sfnt_parse_glyph(&scanner, font->glyphs + glyph_index, arena,
-                              debug_print);
+// Headroom for the alignment and header arena_alloc adds to each of the at
+// most three allocations a glyph is decoded into.
+#define PONE_TRUETYPE_GLYPH_ALLOCATION_SLACK 64
+// Address space a lazily parsed font may reserve for its outlines, real
+// fonts stay far below it.
+#define PONE_TRUETYPE_OUTLINE_RESERVE_MAX GIGABYTES((usize)16)
+
+PoneTrueTypeFont *pone_truetype_parse_lazy(PoneTruetypeInput input,
+                                           Arena *arena) {
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    usize arena_offset_begin = arena->offset;
+    PoneSfntMaxp maxp = {};
+    PoneTrueTypeFont *font = pone_truetype_parse_tables(input, &maxp, arena);
+
+    // maxp bounds every glyph, the flags are scratch but count at the peak.
+    usize glyph_size =
+        (usize)maxp.max_points * (sizeof(PoneSfntGlyphPoint) + sizeof(u8)) +
+        (usize)maxp.max_contours * sizeof(u16) +
+        (usize)maxp.max_component_elements * sizeof(PoneSfntComponentGlyph) +
+        3 * PONE_TRUETYPE_GLYPH_ALLOCATION_SLACK;
+    // Room for every glyph of the font and the tables indexing them, only
+    // the pages that are touched cost memory. A corrupt maxp can ask for
+    // far more than any font needs.
+    usize outline_size = 0;
+    if (font) {
+        usize table_size =
+            font->glyph_count * (sizeof(u32) + sizeof(PoneSfntGlyph)) +
+            2 * PONE_TRUETYPE_GLYPH_ALLOCATION_SLACK;
+        outline_size = font->glyph_count * glyph_size + table_size;
     }
+    if (!font || outline_size > PONE_TRUETYPE_OUTLINE_RESERVE_MAX) {
+        arena->offset = arena_offset_begin;
+        PONE_ARENA_TAG_END();
+        return 0;
+    }
+
+    PoneTrueTypeGlyphOutlineCache *cache =
+        arena_alloc_struct(arena, PoneTrueTypeGlyphOutlineCache);
+    // Its own reservation, a font with tens of thousands of glyphs would
+    // not fit in the address space of the arena it is parsed into.
+    if (!pone_arena_create_virtual(0, outline_size, PONE_ARENA_FLAG_GUARD_PAGE,
+                                   &cache->arena)) {
+        arena->offset = arena_offset_begin;
+        PONE_ARENA_TAG_END();
+        return 0;
+    }
+    pone_mutex_init(&cache->mutex);
+    cache->glyph_count = 0;
+    cache->max_points = maxp.max_points;
+    cache->max_contours = maxp.max_contours;
+    cache->max_component_elements = maxp.max_component_elements;
+    cache->glyph_states = (volatile u32 *)arena_alloc_array(
+        &cache->arena, font->glyph_count, u32);
+    cache->glyphs =
+        arena_alloc_array(&cache->arena, font->glyph_count, PoneSfntGlyph);
+    font->outline_cache = cache;
+    PONE_ARENA_TAG_END();
 
     return font;
 }
 
+void pone_truetype_font_release(PoneTrueTypeFont *font) {
+    if (font->outline_cache) {
+        pone_arena_release(&font->outline_cache->arena);
+        font->outline_cache = 0;
+    }
+}
+
+PoneSfntGlyph *pone_truetype_font_glyph(PoneTrueTypeFont *font,
+                                        u32 glyph_id) {
+    pone_assert(glyph_id < font->glyph_count);
+    if (font->glyphs) {
+        return font->glyphs + glyph_id;
+    }
+
+    PoneTrueTypeGlyphOutlineCache *cache = font->outline_cache;
+    PoneSfntGlyph *glyph = cache->glyphs + glyph_id;
+    if (_pone_atomic_load_n(&cache->glyph_states[glyph_id],
+                            PONE_MEMORY_ORDERING_ACQUIRE) ==
+        PONE_TRUETYPE_GLYPH_OUTLINE_DECODED) {
+        return glyph;
+    }
+
+    // Another thread may have decoded it while this one waited.
+    pone_mutex_lock(&cache->mutex);
+    if (cache->glyph_states[glyph_id] == PONE_TRUETYPE_GLYPH_OUTLINE_MISSING) {
+        PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+        // A corrupt glyph is cached without an outline like any other.
+        pone_truetype_font_decode_glyph(font, glyph_id, glyph, &cache->arena);
+        PONE_ARENA_TAG_END();
+        cache->glyph_count++;
+        // Publishes the glyph to lookups that take no lock.
+        _pone_atomic_store_n(&cache->glyph_states[glyph_id],
+                             PONE_TRUETYPE_GLYPH_OUTLINE_DECODED,
+                             PONE_MEMORY_ORDERING_RELEASE);
+    }
+    pone_mutex_unlock(&cache->mutex);
+
+    return glyph;
+}
+
+u32 pone_truetype_font_glyph_index(PoneTrueTypeFont *font, u32 codepoint) {
+    if (codepoint <= PONE_TRUETYPE_BMP_END) {
+        PoneTrueTypeCmapPageTable *table = &font->cmap_page_table;
+        return table->pages[table->page_indices[codepoint >> 8]]
+                           [codepoint & 0xff];
+    }
+
+    u32 glyph_id =
+        pone_sfnt_cmap_format_12_glyph_id(&font->format_12, codepoint);
+    return glyph_id < font->glyph_count ? glyph_id
+                                        : PONE_TRUETYPE_MISSING_GLYPH;
+}
+
+void pone_truetype_font_glyph_indices(PoneTrueTypeFont *font, u32 *codepoints,
+                                      usize count, u32 *glyph_indices) {
+    // Most text stays within the first page, it is indexed directly.
+    PoneTrueTypeCmapPageTable *table = &font->cmap_page_table;
+    u16 *first_page = table->pages[table->page_indices[0]];
+    for (usize i = 0; i < count; ++i) {
+        u32 codepoint = codepoints[i];
+        glyph_indices[i] = codepoint < PONE_TRUETYPE_CMAP_PAGE_SIZE
+                               ? first_page[codepoint]
+                               : pone_truetype_font_glyph_index(font,
+                                                                codepoint);
+    }
+}
+
 static inline Vec2 pone_linear_interp(Vec2 p0, Vec2 p1, f32 t) {
     return (Vec2){
         .x = p0.x * (1.0f - t) + p1.x * t,
@@ -742,7 +1176,6 @@ static inline b8 pone_truetype_between_closed_open(Vec2 p, PoneRectF32 *rect) {
            p.y < rect->p_max.y - PONE_EPSILON;
 }
 
-#if 0
 static Vec2 pone_truetype_edge_segment_derivative(PoneTrueTypeEdgeSegment *edge,
                                                   f32 t) {
     switch (edge->point_count) {
@@ -759,13 +1192,14 @@ static Vec2 pone_truetype_edge_segment_derivative(PoneTrueTypeEdgeSegment *edge,
     }
 }
 
-#endif
-
 static f32 pone_solve_linear_equation(f32 a, f32 b) { return -b / a; }
 
+// Leaves z alone when there are no real roots.
 static void pone_solve_quadratic_equation(f32 a, f32 b, f32 c, f32 *z) {
     f32 d = b * b - 4 * a * c;
-    pone_assert(pone_is_sign_positive(d));
+    if (!pone_is_sign_positive(d)) {
+        return;
+    }
     f32 d_sqrt = pone_sqrt(d);
     z[0] = (-b + d_sqrt) / (2 * a);
     z[1] = (-b - d_sqrt) / (2 * a);
@@ -803,7 +1237,8 @@ static f32 pone_truetype_quadratic_bezier_segment_find_distance(
             return dist;
         }
 
-        f32 z[2];
+        // Without a stationary point the distance is smallest at an end.
+        f32 z[2] = {0.0f, 1.0f};
         pone_solve_quadratic_equation(a[2], a[1], a[0], z);
 
         f32 dist = PONE_F32_MAX;
@@ -1055,26 +1490,23 @@ pone_truetype_edge_segment_calculate_side(PoneTrueTypeEdgeSegment *edge, Vec2 p,
 }
 
 static f32
-pone_truetype_edge_segment_calculate_distance(PoneTrueTypeEdgeSegment *edge,
-                                              Vec2 p, b8 *side) {
-    f32 d;
-    f32 t;
+pone_truetype_edge_segment_find_distance(PoneTrueTypeEdgeSegment *edge, Vec2 p,
+                                         f32 *t) {
+    // Not every branch of the quadratic solver sets t.
+    *t = 0.0f;
     switch (edge->point_count) {
     case 2: {
-        d = pone_truetype_line_segment_find_distance(edge, p, &t);
+        return pone_truetype_line_segment_find_distance(edge, p, t);
     } break;
     case 3: {
-        d = pone_truetype_quadratic_bezier_segment_find_distance(edge, p, &t);
+        return pone_truetype_quadratic_bezier_segment_find_distance(edge, p,
+                                                                    t);
     } break;
     default: {
-        t = 0.0f;
-        d = 0.0f;
         pone_assert(0);
+        return 0.0f;
     } break;
     }
-
-    *side = pone_truetype_edge_segment_calculate_side(edge, p, t);
-    return d;
 }
 
 static b8 pone_truetype_orthogonality_test(Vec2 point,
@@ -1195,252 +1627,358 @@ static Vec2 pone_sfnt_glyph_point_mid_vec2(PoneSfntGlyphPoint *p1,
     };
 }
 
-struct PoneSdfData {
-    usize width;
-    usize height;
-    u32 *sdf_buf;
-    f32 *d_mins;
-    i8 *delta_windings;
-    u32 d_pad;
-    u32 d_max;
+enum PoneSdfEdgeKind {
+    PONE_SDF_EDGE_KIND_LINE,
+    PONE_SDF_EDGE_KIND_QUADRATIC,
+    // Quadratics without a cubic term, the vector kernels leave these to
+    // the scalar one.
+    PONE_SDF_EDGE_KIND_QUADRATIC_FLAT,
 };
 
-struct PoneSfntGlyphContourEdgeIterator {
-    PoneSfntSimpleGlyph *glyph;
-    usize contour_index;
-    usize point_index;
-    Vec2 closing_point;
-    b8 closing_point_is_end;
-    b8 was_on_curve;
-    PoneSfntGlyphPointMapConstants *map_constants;
+// A glyph's edges in SDF pixels, one array per coordinate. Built once per
+// rendering from the glyph's outline, the distance and bbox loops then read
+// the edges without mapping points or looking at how the contours run.
+// Lines leave p2 unused. Contours are laid out as in the outline.
+struct PoneSdfEdgeBuffer {
+    f32 *p0_x;
+    f32 *p0_y;
+    f32 *p1_x;
+    f32 *p1_y;
+    f32 *p2_x;
+    f32 *p2_y;
+    u8 *kinds;
+    f32 *x_mins;
+    f32 *y_mins;
+    f32 *x_maxs;
+    f32 *y_maxs;
+    usize count;
+    usize *contour_ends;
+    usize contour_count;
 };
 
-static b8 pone_sfnt_glyph_contour_next_edge_segment(
-    PoneSfntGlyphContourEdgeIterator *iter,
-    PoneTrueTypeEdgeSegment *edge_segment) {
-    usize first_point_index = 0;
-    if (iter->contour_index > 0) {
-        first_point_index =
-            (usize)(iter->glyph
-                        ->end_points_of_contours[iter->contour_index - 1]) +
-            1;
-    }
-    usize contour_point_count =
-        (usize)(iter->glyph->end_points_of_contours[iter->contour_index]) + 1 -
-        first_point_index;
-
-    if (iter->point_index >= contour_point_count + 1) {
-        return 0;
-    }
-
-    if (iter->point_index == 0) {
-        PoneSfntGlyphPoint *first_point =
-            (iter->glyph->points + first_point_index);
-        PoneSfntGlyphPoint *last_point =
-            (iter->glyph->points + first_point_index + contour_point_count - 1);
-        iter->was_on_curve = first_point->on_curve;
-        if (first_point->on_curve) {
-            iter->closing_point = pone_sfnt_glyph_point_vec2(first_point);
-            if (iter->map_constants) {
-                pone_sfnt_glyph_point_map(&iter->closing_point,
-                                          iter->map_constants);
-            }
-        } else {
-            if (last_point->on_curve) {
-                iter->closing_point = pone_sfnt_glyph_point_vec2(last_point);
-                if (iter->map_constants) {
-                    pone_sfnt_glyph_point_map(&iter->closing_point,
-                                              iter->map_constants);
-                }
-                iter->closing_point_is_end = 1;
-            } else {
-                iter->closing_point =
-                    pone_sfnt_glyph_point_mid_vec2(first_point, last_point);
-                if (iter->map_constants) {
-                    pone_sfnt_glyph_point_map(&iter->closing_point,
-                                              iter->map_constants);
-                }
-            }
-            edge_segment->points[1] = pone_sfnt_glyph_point_vec2(first_point);
-            if (iter->map_constants) {
-                pone_sfnt_glyph_point_map(&edge_segment->points[1],
-                                          iter->map_constants);
-            }
-        }
-        edge_segment->points[0] = iter->closing_point;
-        if (iter->closing_point_is_end) {
-            pone_assert(0);
-            contour_point_count--;
-        }
-        iter->point_index++;
+static void pone_sdf_edge_buffer_get(PoneSdfEdgeBuffer *edges, usize index,
+                                     PoneTrueTypeEdgeSegment *edge,
+                                     PoneRectF32 *bbox) {
+    edge->points[0] = {.x = edges->p0_x[index], .y = edges->p0_y[index]};
+    edge->points[1] = {.x = edges->p1_x[index], .y = edges->p1_y[index]};
+    edge->points[2] = {.x = edges->p2_x[index], .y = edges->p2_y[index]};
+    edge->point_count = edges->kinds[index] == PONE_SDF_EDGE_KIND_LINE ? 2 : 3;
+    if (bbox) {
+        *bbox = {
+            .p_min =
+                {
+                    .x = edges->x_mins[index],
+                    .y = edges->y_mins[index],
+                },
+            .p_max =
+                {
+                    .x = edges->x_maxs[index],
+                    .y = edges->y_maxs[index],
+                },
+        };
     }
+}
 
-    if (iter->point_index > 1 && iter->point_index < contour_point_count) {
-        PoneSfntGlyphPoint *point =
-            iter->glyph->points + first_point_index + iter->point_index;
-        Vec2 p = pone_sfnt_glyph_point_vec2(point);
-        if (iter->map_constants) {
-            pone_sfnt_glyph_point_map(&p, iter->map_constants);
-        }
+#define PONE_SDF_EDGE_BAND_PIECE_COUNT 4
 
-        edge_segment->points[0] =
-            edge_segment->points[edge_segment->point_count - 1];
-        if (!iter->was_on_curve && !point->on_curve &&
-            iter->point_index < contour_point_count) {
+// Where an edge runs, to find the pixels of a row that can lie within d_pad
+// of it. Lines are clipped exactly, quadratics go by pieces whose control
+// point hulls contain the curve.
+struct PoneSdfEdgeBand {
+    PoneTrueTypeEdgeSegment edge;
+    PoneRectF32 piece_bboxes[PONE_SDF_EDGE_BAND_PIECE_COUNT];
+};
 
-            edge_segment->points[1] = p;
+static void pone_sdf_edge_band_init(PoneSdfEdgeBuffer *edges,
+                                    usize edge_index, PoneSdfEdgeBand *band) {
+    pone_sdf_edge_buffer_get(edges, edge_index, &band->edge, 0);
+    if (band->edge.point_count == 2) {
+        return;
+    }
 
-            iter->point_index++;
-        } else {
-            iter->was_on_curve = 1;
-        }
+    Vec2 *p = band->edge.points;
+    for (u32 i = 0; i < PONE_SDF_EDGE_BAND_PIECE_COUNT; ++i) {
+        f32 t0 = (f32)i / PONE_SDF_EDGE_BAND_PIECE_COUNT;
+        f32 t1 = (f32)(i + 1) / PONE_SDF_EDGE_BAND_PIECE_COUNT;
+        // The piece's control points are the curve's blossoms at (t0, t0),
+        // (t0, t1) and (t1, t1).
+        Vec2 q[3] = {
+            pone_quadratic_bezier_curve(p[0], p[1], p[2], t0),
+            pone_vec2_add(
+                pone_vec2_add(
+                    pone_vec2_mul_scalar((1.0f - t0) * (1.0f - t1), p[0]),
+                    pone_vec2_mul_scalar((1.0f - t0) * t1 + t0 * (1.0f - t1),
+                                         p[1])),
+                pone_vec2_mul_scalar(t0 * t1, p[2])),
+            pone_quadratic_bezier_curve(p[0], p[1], p[2], t1),
+        };
+        PoneRectF32 *bbox = band->piece_bboxes + i;
+        bbox->p_min.x = PONE_MIN(PONE_MIN(q[0].x, q[1].x), q[2].x);
+        bbox->p_min.y = PONE_MIN(PONE_MIN(q[0].y, q[1].y), q[2].y);
+        bbox->p_max.x = PONE_MAX(PONE_MAX(q[0].x, q[1].x), q[2].x);
+        bbox->p_max.y = PONE_MAX(PONE_MAX(q[0].y, q[1].y), q[2].y);
     }
+}
 
-    while (iter->point_index < contour_point_count) {
-        PoneSfntGlyphPoint *point =
-            iter->glyph->points + first_point_index + iter->point_index;
-        Vec2 p = pone_sfnt_glyph_point_vec2(point);
-        if (iter->map_constants) {
-            pone_sfnt_glyph_point_map(&p, iter->map_constants);
+// Narrows the pixels of row y to those whose centers lie within d_pad of
+// the edge's x extent between y - d_pad and y + d_pad, returns 0 when none
+// are left. Anything farther than d_pad clamps to the same texel value, so
+// leaving it out does not change the output.
+static b8 pone_sdf_edge_band_row_span(PoneSdfEdgeBand *band, u32 y, f32 d_pad,
+                                      PoneRectU32 *pixels, u32 *x_begin,
+                                      u32 *x_end) {
+    f32 y_lo = (y + 0.5f) - d_pad;
+    f32 y_hi = (y + 0.5f) + d_pad;
+    f32 x_lo = PONE_F32_MAX;
+    f32 x_hi = PONE_F32_MIN;
+    if (band->edge.point_count == 2) {
+        Vec2 p0 = band->edge.points[0];
+        Vec2 p1 = band->edge.points[1];
+        f32 dy = p1.y - p0.y;
+        f32 t0 = 0.0f;
+        f32 t1 = 1.0f;
+        if (dy != 0.0f) {
+            f32 ta = (y_lo - p0.y) / dy;
+            f32 tb = (y_hi - p0.y) / dy;
+            t0 = PONE_MAX(PONE_MIN(ta, tb), 0.0f);
+            t1 = PONE_MIN(PONE_MAX(ta, tb), 1.0f);
+        } else if (p0.y < y_lo || p0.y > y_hi) {
+            return 0;
+        }
+        if (t0 > t1) {
+            return 0;
+        }
+        f32 x0 = p0.x + (p1.x - p0.x) * t0;
+        f32 x1 = p0.x + (p1.x - p0.x) * t1;
+        x_lo = PONE_MIN(x0, x1);
+        x_hi = PONE_MAX(x0, x1);
+    } else {
+        for (u32 i = 0; i < PONE_SDF_EDGE_BAND_PIECE_COUNT; ++i) {
+            PoneRectF32 *bbox = band->piece_bboxes + i;
+            if (bbox->p_max.y >= y_lo && bbox->p_min.y <= y_hi) {
+                x_lo = PONE_MIN(x_lo, bbox->p_min.x);
+                x_hi = PONE_MAX(x_hi, bbox->p_max.x);
+            }
+        }
+        if (x_lo > x_hi) {
+            return 0;
         }
-        if (iter->was_on_curve && point->on_curve) {
-            edge_segment->points[1] = p;
-            edge_segment->point_count = 2;
+    }
 
-            iter->point_index++;
-            return 1;
-        } else if (iter->was_on_curve && !point->on_curve) {
-            edge_segment->points[1] = p;
-            iter->was_on_curve = 0;
+    f32 x_first = PONE_MAX(pone_ceil((x_lo - d_pad) - 0.5f), 0.0f);
+    f32 x_last = PONE_MAX(pone_floor((x_hi + d_pad) - 0.5f) + 1.0f, 0.0f);
+    *x_begin = PONE_MAX(pixels->x_min, (u32)x_first);
+    *x_end = PONE_MIN(pixels->x_max, (u32)x_last);
 
-            iter->point_index++;
-        } else if (!iter->was_on_curve && point->on_curve) {
-            edge_segment->points[2] = p;
-            edge_segment->point_count = 3;
+    return *x_begin < *x_end;
+}
 
-            iter->was_on_curve = 1;
-            iter->point_index++;
-            return 1;
-        } else {
-            edge_segment->points[2] = pone_vec2_mul_scalar(
-                0.5f, pone_vec2_add(edge_segment->points[1], p));
-            edge_segment->point_count = 3;
+// Distance spans: the nearest distance of every pixel in the edge's padded
+// bbox that lies within d_pad of the edge, d_mins is width texels wide.
+// Only magnitudes matter, the signs come from the winding fill.
+typedef void (*PoneSdfSpanFn)(PoneSdfEdgeBuffer *edges, usize edge_index,
+                              PoneRectU32 *pixels, u32 d_pad, usize width,
+                              f32 *d_mins);
+
+static void pone_truetype_edge_segment_distance_span_scalar(
+    PoneSdfEdgeBuffer *edges, usize edge_index, PoneRectU32 *pixels,
+    u32 d_pad, usize width, f32 *d_mins) {
+    PoneSdfEdgeBand band;
+    pone_sdf_edge_band_init(edges, edge_index, &band);
+    for (u32 y = pixels->y_min; y < pixels->y_max; ++y) {
+        u32 x_begin;
+        u32 x_end;
+        if (!pone_sdf_edge_band_row_span(&band, y, (f32)d_pad, pixels,
+                                         &x_begin, &x_end)) {
+            continue;
+        }
 
-            return 1;
+        f32 *d_mins_row = d_mins + (y * width);
+        for (u32 x = x_begin; x < x_end; ++x) {
+            Vec2 p_px = {.x = x + 0.5f, .y = y + 0.5f};
+            f32 *d_min = d_mins_row + x;
+            f32 t;
+            f32 d =
+                pone_truetype_edge_segment_find_distance(&band.edge, p_px, &t);
+            if (pone_abs(d) < pone_abs(*d_min)) {
+                *d_min = d;
+            }
         }
     }
+}
 
-    if (iter->was_on_curve) {
-        edge_segment->points[1] = iter->closing_point;
-        edge_segment->point_count = 2;
+// Per-edge terms of the distance functions above, evaluated in the same order
+// so the vector kernels round like the scalar path wherever no transcendental
+// function is involved.
+struct PoneSdfSpanConstants {
+    Vec2 p0;
+    Vec2 p1;
+    Vec2 p2;
+    // Line: p1 - p0. Quadratic: p1 - p0 and p2 - 2 p1 + p0.
+    Vec2 d1;
+    Vec2 d2;
+    f32 line_len_squared;
+    f32 a1;
+    f32 a2;
+    f32 a3;
+    f32 root_offset;
+};
 
-        iter->point_index++;
+// Returns 0 for quadratics without a cubic term, those stay scalar.
+static b8 pone_sdf_span_constants_init(PoneTrueTypeEdgeSegment *edge,
+                                       PoneSdfSpanConstants *constants) {
+    constants->p0 = edge->points[0];
+    constants->p1 = edge->points[1];
+    constants->d1 = pone_vec2_sub(edge->points[1], edge->points[0]);
+    if (edge->point_count == 2) {
+        constants->line_len_squared =
+            pone_vec2_dot(constants->d1, constants->d1);
         return 1;
-    } else {
-        edge_segment->points[2] = iter->closing_point;
-        edge_segment->point_count = 3;
+    }
 
-        iter->point_index++;
-        return 1;
+    constants->p2 = edge->points[2];
+    constants->d2 = pone_vec2_add(
+        pone_vec2_add(edge->points[2],
+                      pone_vec2_mul_scalar(-2.0f, edge->points[1])),
+        edge->points[0]);
+    constants->a3 = pone_vec2_dot(constants->d2, constants->d2);
+    if (pone_abs(constants->a3) < PONE_EPSILON) {
+        return 0;
     }
-}
+    constants->a2 = 3.0f * pone_vec2_dot(constants->d1, constants->d2) /
+                    constants->a3;
+    constants->a1 = pone_vec2_dot(pone_vec2_mul_scalar(2.0f, constants->d1),
+                                  constants->d1);
+    constants->root_offset = (-1.0f / 3.0f) * constants->a2;
 
-static void pone_sfnt_simple_glyph_bounding_box(
-    PoneSfntSimpleGlyph *glyph, PoneSfntGlyphPointMapConstants *map_constants,
-    PoneRectF32 *bbox) {
-    *bbox = (PoneRectF32){
-        .p_min =
-            {
-                .x = PONE_F32_MAX,
-                .y = PONE_F32_MAX,
-            },
-        .p_max =
-            {
-                .x = PONE_F32_MIN,
-                .y = PONE_F32_MIN,
-            },
-    };
+    return 1;
+}
 
-    for (usize contour_index = 0;
-         contour_index < glyph->end_points_of_contour_count; contour_index++) {
-        PoneSfntGlyphContourEdgeIterator iter = {
-            .glyph = glyph,
-            .contour_index = contour_index,
-            .map_constants = map_constants,
-        };
+#if defined(PONE_TRUETYPE_X64)
+static const f32 pone_sdf_acos_coefficients[8] = {
+    1.5707963050f, -0.2145988016f, 0.0889789874f, -0.0501743046f,
+    0.0308918810f, -0.0170881256f, 0.0066700901f, -0.0012624911f,
+};
 
-        PoneTrueTypeEdgeSegment edge_segment;
-        while (
-            pone_sfnt_glyph_contour_next_edge_segment(&iter, &edge_segment)) {
-            PoneRectF32 edge_segment_bbox;
+// The SSE4.1 and AVX2 kernels share one source, the width picks the
+// intrinsics.
+#define PONE_SDF_SIMD_WIDTH 4
+#include "pone_truetype_sdf_span.inl"
+#define PONE_SDF_SIMD_WIDTH 8
+#include "pone_truetype_sdf_span.inl"
+#endif
 
-            pone_truetype_edge_segment_bbox(&edge_segment, &edge_segment_bbox);
-            bbox->p_min.x = PONE_MIN(bbox->p_min.x, edge_segment_bbox.p_min.x);
-            bbox->p_min.y = PONE_MIN(bbox->p_min.y, edge_segment_bbox.p_min.y);
-            bbox->p_max.x = PONE_MAX(bbox->p_max.x, edge_segment_bbox.p_max.x);
-            bbox->p_max.y = PONE_MAX(bbox->p_max.y, edge_segment_bbox.p_max.y);
-        }
+usize pone_truetype_sdf_atlas_format_size(PoneTrueTypeSdfAtlasFormat format) {
+    switch (format) {
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM:
+        return sizeof(u8);
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R16_SFLOAT:
+        return sizeof(u16);
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM:
+        return 4 * sizeof(u8);
     }
+    pone_assert(0);
+    return 0;
 }
 
-static void pone_sfnt_glyph_bounding_box(PoneTrueTypeFont *font,
-                                         PoneSfntGlyph *glyph, PoneRectF32 *bbox) {
-    switch (glyph->type) {
-    case PONE_SFNT_GLYPH_TYPE_SIMPLE: {
-        pone_sfnt_simple_glyph_bounding_box(&glyph->simple, 0, bbox);
-    } break;
-    case PONE_SFNT_GLYPH_TYPE_COMPOUND: {
-        *bbox = {
-            .p_min =
-                {
-                    .x = PONE_F32_MAX,
-                    .y = PONE_F32_MAX,
-                },
-            .p_max =
-                {
-                    .x = PONE_F32_MIN,
-                    .y = PONE_F32_MIN,
-                },
-        };
-        for (usize glyph_component_index = 0;
-             glyph_component_index < glyph->compound.component_glyph_count;
-             ++glyph_component_index) {
-            PoneSfntComponentGlyph *component_glyph_ref =
-                glyph->compound.component_glyphs + glyph_component_index;
-            PoneSfntGlyph *component_glyph =
-                font->glyphs + component_glyph_ref->glyph_index;
-            PoneSfntGlyphPointTransformation transform = {
-                .offset = component_glyph_ref->offset,
-                .scale = component_glyph_ref->transformation};
-            PoneSfntGlyphPointMapConstants map_constants = {
-                .range_map = 0,
-                .transform = &transform,
-            };
-            pone_assert(component_glyph->type == PONE_SFNT_GLYPH_TYPE_SIMPLE);
-            PoneRectF32 component_bbox;
-            pone_sfnt_simple_glyph_bounding_box(
-                &component_glyph->simple, &map_constants, &component_bbox);
-            bbox->p_min.x = PONE_MIN(bbox->p_min.x, component_bbox.p_min.x);
-            bbox->p_min.y = PONE_MIN(bbox->p_min.y, component_bbox.p_min.y);
-            bbox->p_max.x = PONE_MAX(bbox->p_max.x, component_bbox.p_max.x);
-            bbox->p_max.y = PONE_MAX(bbox->p_max.y, component_bbox.p_max.y);
-        }
-        break;
-    }
-    }
-}
-
-static void pone_sfnt_simple_glyph_calculate_sdf(
-    PoneSfntSimpleGlyph *glyph, PoneSfntGlyphPointMapConstants *map_constants,
-    PoneSdfData *sdf_data) {
-    usize contour_begin_point_index = 0;
-    for (usize contour_index = 0;
-         contour_index < glyph->end_points_of_contour_count; ++contour_index) {
+struct PoneSdfData {
+    usize width;
+    usize height;
+    PoneTrueTypeSdfAtlasFormat format;
+    u8 *sdf_buf;
+    f32 *d_mins;
+    i8 *delta_windings;
+    // Three per pixel, only for the MSDF format.
+    f32 *msdf_distances;
+    u32 d_pad;
+    u32 d_max;
+    PoneSdfSpanFn distance_span;
+};
+
+// Deeper nesting than this is taken for a component cycle, real fonts stay
+// within a few levels. The component limit keeps a glyph that references
+// the same compound many times on every level from blowing up, components
+// past either limit are left out.
+#define PONE_TRUETYPE_MAX_COMPONENT_DEPTH 8
+#define PONE_TRUETYPE_MAX_COMPONENT_COUNT 1024
+
+// A glyph's outline in font units, with the components of compound glyphs,
+// nested ones too, transformed into place. Contour i is the edges from
+// contour_ends[i - 1] (or 0) up to contour_ends[i]. Glyphs are flattened
+// once per rendering, the bbox, SDF and MSDF passes all walk the edges.
+struct PoneTrueTypeOutline {
+    PoneTrueTypeEdgeSegment *edges;
+    usize edge_count;
+    usize *contour_ends;
+    usize contour_count;
+};
+
+// Both passes over the components of a glyph have to leave out the same
+// ones, so they share this.
+static b8 pone_truetype_outline_take_component(u32 depth,
+                                               u32 *component_budget) {
+    if (depth == PONE_TRUETYPE_MAX_COMPONENT_DEPTH || *component_budget == 0) {
+        return 0;
+    }
+    --*component_budget;
+
+    return 1;
+}
+
+// A contour yields at most one edge per point plus the closing one.
+static void pone_truetype_outline_count(PoneTrueTypeFont *font,
+                                        PoneSfntGlyph *glyph, u32 depth,
+                                        u32 *component_budget,
+                                        usize *edge_count,
+                                        usize *contour_count) {
+    if (glyph->type == PONE_SFNT_GLYPH_TYPE_SIMPLE) {
+        *edge_count += glyph->simple.point_count +
+                       glyph->simple.end_points_of_contour_count;
+        *contour_count += glyph->simple.end_points_of_contour_count;
+        return;
+    }
+
+    for (usize glyph_component_index = 0;
+         glyph_component_index < glyph->compound.component_glyph_count;
+         ++glyph_component_index) {
+        if (!pone_truetype_outline_take_component(depth, component_budget)) {
+            return;
+        }
+        PoneSfntComponentGlyph *component_glyph_ref =
+            glyph->compound.component_glyphs + glyph_component_index;
+        pone_truetype_outline_count(
+            font,
+            pone_truetype_font_glyph(font, component_glyph_ref->glyph_index),
+            depth + 1, component_budget, edge_count, contour_count);
+    }
+}
+
+static void pone_truetype_outline_push_edge(PoneTrueTypeOutline *outline,
+                                            PoneTrueTypeEdgeSegment *edge) {
+    outline->edges[outline->edge_count++] = *edge;
+}
+
+static Vec2
+pone_sfnt_glyph_point_transform(Vec2 p,
+                                PoneSfntGlyphPointTransformation *transform) {
+    if (transform) {
+        pone_sfnt_glyph_point_apply_transformation(&p, transform);
+    }
+
+    return p;
+}
+
+static void pone_truetype_outline_append_simple_glyph(
+    PoneTrueTypeOutline *outline, PoneSfntSimpleGlyph *glyph,
+    PoneSfntGlyphPointTransformation *transform) {
+    usize contour_begin_point_index = 0;
+    for (usize contour_index = 0;
+         contour_index < glyph->end_points_of_contour_count; ++contour_index) {
         usize contour_point_count =
             (usize)glyph->end_points_of_contours[contour_index] + 1 -
             contour_begin_point_index;
 
-        PoneTrueTypeEdgeSegment candidate_edge_segment;
+        PoneTrueTypeEdgeSegment edge;
         Vec2 closing_point;
         b8 closing_point_is_end = 0;
 
@@ -1450,26 +1988,27 @@ static void pone_sfnt_simple_glyph_calculate_sdf(
             (glyph->points + contour_begin_point_index + contour_point_count -
              1);
 
+        // A contour that starts off the curve closes at its last point if
+        // that one is on it, or else halfway between the two.
         b8 was_on_curve = contour_begin_point->on_curve;
         if (contour_begin_point->on_curve) {
-            closing_point = pone_sfnt_glyph_point_vec2(contour_begin_point);
-            pone_sfnt_glyph_point_map(&closing_point, map_constants);
+            closing_point = pone_sfnt_glyph_point_transform(
+                pone_sfnt_glyph_point_vec2(contour_begin_point), transform);
         } else {
             if (contour_end_point->on_curve) {
-                closing_point = pone_sfnt_glyph_point_vec2(contour_end_point);
-                pone_sfnt_glyph_point_map(&closing_point, map_constants);
+                closing_point = pone_sfnt_glyph_point_transform(
+                    pone_sfnt_glyph_point_vec2(contour_end_point), transform);
                 closing_point_is_end = 1;
             } else {
-                closing_point = pone_sfnt_glyph_point_mid_vec2(
-                    contour_begin_point, contour_end_point);
-                pone_sfnt_glyph_point_map(&closing_point, map_constants);
+                closing_point = pone_sfnt_glyph_point_transform(
+                    pone_sfnt_glyph_point_mid_vec2(contour_begin_point,
+                                                   contour_end_point),
+                    transform);
             }
-            candidate_edge_segment.points[1] =
-                pone_sfnt_glyph_point_vec2(contour_begin_point);
-            pone_sfnt_glyph_point_map(&candidate_edge_segment.points[1],
-                                      map_constants);
+            edge.points[1] = pone_sfnt_glyph_point_transform(
+                pone_sfnt_glyph_point_vec2(contour_begin_point), transform);
         }
-        candidate_edge_segment.points[0] = closing_point;
+        edge.points[0] = closing_point;
         if (closing_point_is_end) {
             --contour_point_count;
         }
@@ -1478,159 +2017,322 @@ static void pone_sfnt_simple_glyph_calculate_sdf(
              contour_point_index < contour_point_count; ++contour_point_index) {
             PoneSfntGlyphPoint *contour_point =
                 glyph->points + contour_begin_point_index + contour_point_index;
-            Vec2 p_contour = pone_sfnt_glyph_point_vec2(contour_point);
-            pone_sfnt_glyph_point_map(&p_contour, map_constants);
+            Vec2 p_contour = pone_sfnt_glyph_point_transform(
+                pone_sfnt_glyph_point_vec2(contour_point), transform);
 
             if (was_on_curve && contour_point->on_curve) {
-                candidate_edge_segment.points[1] = p_contour;
-                candidate_edge_segment.point_count = 2;
+                edge.points[1] = p_contour;
+                edge.point_count = 2;
             } else if (was_on_curve && !contour_point->on_curve) {
-                candidate_edge_segment.points[1] = p_contour;
+                edge.points[1] = p_contour;
 
                 was_on_curve = 0;
                 continue;
             } else if (!was_on_curve && contour_point->on_curve) {
-                candidate_edge_segment.points[2] = p_contour;
-                candidate_edge_segment.point_count = 3;
+                edge.points[2] = p_contour;
+                edge.point_count = 3;
             } else {
-                candidate_edge_segment.points[2] = pone_vec2_mul_scalar(
-                    0.5f,
-                    pone_vec2_add(candidate_edge_segment.points[1], p_contour));
-                candidate_edge_segment.point_count = 3;
-            }
-
-            PoneRectF32 edge_segment_bbox;
-            pone_truetype_edge_segment_bbox(&candidate_edge_segment,
-                                            &edge_segment_bbox);
-
-            PoneRectF32 edge_segment_bbox_padded = {
-                .p_min =
-                    {
-                        .x = edge_segment_bbox.p_min.x - sdf_data->d_pad,
-                        .y = edge_segment_bbox.p_min.y - sdf_data->d_pad,
-                    },
-                .p_max =
-                    {
-                        .x = edge_segment_bbox.p_max.x + sdf_data->d_pad,
-                        .y = edge_segment_bbox.p_max.y + sdf_data->d_pad,
-                    },
-            };
-            u32 x_min_u32 = (u32)pone_floor(edge_segment_bbox_padded.p_min.x);
-            u32 y_min_u32 = (u32)pone_floor(edge_segment_bbox_padded.p_min.y);
-            u32 x_max_u32 = (u32)pone_ceil(edge_segment_bbox_padded.p_max.x -
-                                           sdf_data->width * PONE_EPSILON);
-            u32 y_max_u32 = (u32)pone_ceil(edge_segment_bbox_padded.p_max.y -
-                                           sdf_data->height * PONE_EPSILON);
-            pone_assert(x_min_u32 >= 0 && x_max_u32 <= sdf_data->width);
-            pone_assert(y_min_u32 >= 0 && y_max_u32 <= sdf_data->height);
-
-            for (u32 y = y_min_u32; y < y_max_u32; ++y) {
-                f32 *d_mins_row = sdf_data->d_mins + (y * sdf_data->width);
-                i8 *delta_windings_row =
-                    sdf_data->delta_windings + (y * sdf_data->width);
-
-                i8 prev_side = 0;
-                for (u32 x = x_min_u32; x < x_max_u32; ++x) {
-                    Vec2 p_px = {.x = x + 0.5f, .y = y + 0.5f};
-                    f32 *d_min = d_mins_row + x;
-                    i8 *delta_winding = delta_windings_row + x;
-                    b8 side;
-                    f32 d = pone_truetype_edge_segment_calculate_distance(
-                        &candidate_edge_segment, p_px, &side);
-                    if (pone_truetype_between_closed_open(p_px,
-                                                          &edge_segment_bbox)) {
-                        if (prev_side == -1 && !side) {
-                            *delta_winding += 1;
-                        } else if (prev_side == 1 && side) {
-                            *delta_winding += -1;
-                        }
-                    }
-                    prev_side = side ? -1 : 1;
-                    if (pone_abs(d) < pone_abs(*d_min)) {
-                        *d_min = d;
-                    }
-                }
+                edge.points[2] = pone_vec2_mul_scalar(
+                    0.5f, pone_vec2_add(edge.points[1], p_contour));
+                edge.point_count = 3;
             }
+            pone_truetype_outline_push_edge(outline, &edge);
 
-            candidate_edge_segment.points[0] =
-                candidate_edge_segment
-                    .points[candidate_edge_segment.point_count - 1];
+            edge.points[0] = edge.points[edge.point_count - 1];
             if (!was_on_curve && !contour_point->on_curve) {
-                candidate_edge_segment.points[1] = p_contour;
+                edge.points[1] = p_contour;
             } else {
                 was_on_curve = 1;
             }
         }
 
         if (was_on_curve) {
-            candidate_edge_segment.points[1] = closing_point;
-            candidate_edge_segment.point_count = 2;
+            edge.points[1] = closing_point;
+            edge.point_count = 2;
         } else {
-            candidate_edge_segment.points[2] = closing_point;
-            candidate_edge_segment.point_count = 3;
+            edge.points[2] = closing_point;
+            edge.point_count = 3;
+        }
+        pone_truetype_outline_push_edge(outline, &edge);
+
+        outline->contour_ends[outline->contour_count++] = outline->edge_count;
+        contour_begin_point_index =
+            (usize)glyph->end_points_of_contours[contour_index] + 1;
+    }
+}
+
+// transform places glyph in the outline, 0 for the identity.
+static void
+pone_truetype_outline_append_glyph(PoneTrueTypeOutline *outline,
+                                   PoneTrueTypeFont *font, PoneSfntGlyph *glyph,
+                                   PoneSfntGlyphPointTransformation *transform,
+                                   u32 depth, u32 *component_budget) {
+    if (glyph->type == PONE_SFNT_GLYPH_TYPE_SIMPLE) {
+        pone_truetype_outline_append_simple_glyph(outline, &glyph->simple,
+                                                  transform);
+        return;
+    }
+
+    for (usize glyph_component_index = 0;
+         glyph_component_index < glyph->compound.component_glyph_count;
+         ++glyph_component_index) {
+        if (!pone_truetype_outline_take_component(depth, component_budget)) {
+            return;
         }
+        PoneSfntComponentGlyph *component_glyph_ref =
+            glyph->compound.component_glyphs + glyph_component_index;
+        PoneSfntGlyphPointTransformation component_transform = {
+            .offset = component_glyph_ref->offset,
+            .scale = component_glyph_ref->transformation,
+        };
+        if (transform) {
+            // The component's transform goes first, then the one placing
+            // its parent.
+            Mat2 *a = &transform->scale;
+            Mat2 *b = &component_glyph_ref->transformation;
+            component_transform.scale = {{
+                a->data[0] * b->data[0] + a->data[1] * b->data[2],
+                a->data[0] * b->data[1] + a->data[1] * b->data[3],
+                a->data[2] * b->data[0] + a->data[3] * b->data[2],
+                a->data[2] * b->data[1] + a->data[3] * b->data[3],
+            }};
+            pone_sfnt_glyph_point_apply_transformation(
+                &component_transform.offset, transform);
+        }
+        pone_truetype_outline_append_glyph(
+            outline, font,
+            pone_truetype_font_glyph(font, component_glyph_ref->glyph_index),
+            &component_transform, depth + 1, component_budget);
+    }
+}
 
+static void pone_truetype_outline_flatten(PoneTrueTypeFont *font,
+                                          PoneSfntGlyph *glyph,
+                                          PoneTrueTypeOutline *outline,
+                                          Arena *arena) {
+    usize edge_capacity = 0;
+    usize contour_capacity = 0;
+    u32 component_budget = PONE_TRUETYPE_MAX_COMPONENT_COUNT;
+    pone_truetype_outline_count(font, glyph, 0, &component_budget,
+                                &edge_capacity, &contour_capacity);
+
+    *outline = {
+        .edges = arena_alloc_array(arena, edge_capacity,
+                                   PoneTrueTypeEdgeSegment),
+        .edge_count = 0,
+        .contour_ends = arena_alloc_array(arena, contour_capacity, usize),
+        .contour_count = 0,
+    };
+    component_budget = PONE_TRUETYPE_MAX_COMPONENT_COUNT;
+    pone_truetype_outline_append_glyph(outline, font, glyph, 0, 0,
+                                       &component_budget);
+    pone_assert(outline->edge_count <= edge_capacity);
+}
+
+// Inverted, with p_min at PONE_F32_MAX, when the outline has no edges.
+static void pone_truetype_outline_bbox(PoneTrueTypeOutline *outline,
+                                       PoneRectF32 *bbox) {
+    *bbox = (PoneRectF32){
+        .p_min =
+            {
+                .x = PONE_F32_MAX,
+                .y = PONE_F32_MAX,
+            },
+        .p_max =
+            {
+                .x = PONE_F32_MIN,
+                .y = PONE_F32_MIN,
+            },
+    };
+
+    for (usize edge_index = 0; edge_index < outline->edge_count;
+         ++edge_index) {
         PoneRectF32 edge_segment_bbox;
-        pone_truetype_edge_segment_bbox(&candidate_edge_segment,
+        pone_truetype_edge_segment_bbox(outline->edges + edge_index,
                                         &edge_segment_bbox);
-        PoneRectF32 edge_segment_bbox_padded = {
-            .p_min =
-                {
-                    .x = edge_segment_bbox.p_min.x - sdf_data->d_pad,
-                    .y = edge_segment_bbox.p_min.y - sdf_data->d_pad,
-                },
-            .p_max =
-                {
-                    .x = edge_segment_bbox.p_max.x + sdf_data->d_pad,
-                    .y = edge_segment_bbox.p_max.y + sdf_data->d_pad,
-                },
-        };
-        u32 x_min_u32 = (u32)pone_floor(edge_segment_bbox_padded.p_min.x);
-        u32 y_min_u32 = (u32)pone_floor(edge_segment_bbox_padded.p_min.y);
-        u32 x_max_u32 = (u32)pone_ceil(edge_segment_bbox_padded.p_max.x -
-                                       sdf_data->width * PONE_EPSILON);
-        u32 y_max_u32 = (u32)pone_ceil(edge_segment_bbox_padded.p_max.y -
-                                       sdf_data->height * PONE_EPSILON);
+        bbox->p_min.x = PONE_MIN(bbox->p_min.x, edge_segment_bbox.p_min.x);
+        bbox->p_min.y = PONE_MIN(bbox->p_min.y, edge_segment_bbox.p_min.y);
+        bbox->p_max.x = PONE_MAX(bbox->p_max.x, edge_segment_bbox.p_max.x);
+        bbox->p_max.y = PONE_MAX(bbox->p_max.y, edge_segment_bbox.p_max.y);
+    }
+}
+
+// Maps an outline edge from font units to SDF pixels.
+static void
+pone_truetype_edge_segment_map(PoneTrueTypeEdgeSegment *edge,
+                               PoneSfntGlyphPointRangeMap *range_map,
+                               PoneTrueTypeEdgeSegment *mapped_edge) {
+    PoneSfntGlyphPointMapConstants map_constants = {
+        .range_map = range_map,
+        .transform = 0,
+    };
+    *mapped_edge = *edge;
+    for (usize i = 0; i < edge->point_count; ++i) {
+        pone_sfnt_glyph_point_map(mapped_edge->points + i, &map_constants);
+    }
+}
+
+// Maps outline into SDF pixels, see PoneSdfEdgeBuffer.
+static void pone_sdf_edge_buffer_init(PoneSdfEdgeBuffer *edges,
+                                      PoneTrueTypeOutline *outline,
+                                      PoneSfntGlyphPointRangeMap *range_map,
+                                      Arena *arena) {
+    usize count = outline->edge_count;
+    *edges = {
+        .p0_x = arena_alloc_array(arena, count, f32),
+        .p0_y = arena_alloc_array(arena, count, f32),
+        .p1_x = arena_alloc_array(arena, count, f32),
+        .p1_y = arena_alloc_array(arena, count, f32),
+        .p2_x = arena_alloc_array(arena, count, f32),
+        .p2_y = arena_alloc_array(arena, count, f32),
+        .kinds = arena_alloc_array(arena, count, u8),
+        .x_mins = arena_alloc_array(arena, count, f32),
+        .y_mins = arena_alloc_array(arena, count, f32),
+        .x_maxs = arena_alloc_array(arena, count, f32),
+        .y_maxs = arena_alloc_array(arena, count, f32),
+        .count = count,
+        .contour_ends = outline->contour_ends,
+        .contour_count = outline->contour_count,
+    };
+
+    for (usize i = 0; i < count; ++i) {
+        PoneTrueTypeEdgeSegment edge;
+        pone_truetype_edge_segment_map(outline->edges + i, range_map, &edge);
+        if (edge.point_count == 2) {
+            edge.points[2] = {};
+            edges->kinds[i] = PONE_SDF_EDGE_KIND_LINE;
+        } else {
+            PoneSdfSpanConstants constants;
+            edges->kinds[i] = pone_sdf_span_constants_init(&edge, &constants)
+                                  ? PONE_SDF_EDGE_KIND_QUADRATIC
+                                  : PONE_SDF_EDGE_KIND_QUADRATIC_FLAT;
+        }
+        edges->p0_x[i] = edge.points[0].x;
+        edges->p0_y[i] = edge.points[0].y;
+        edges->p1_x[i] = edge.points[1].x;
+        edges->p1_y[i] = edge.points[1].y;
+        edges->p2_x[i] = edge.points[2].x;
+        edges->p2_y[i] = edge.points[2].y;
+
+        PoneRectF32 bbox;
+        pone_truetype_edge_segment_bbox(&edge, &bbox);
+        edges->x_mins[i] = bbox.p_min.x;
+        edges->y_mins[i] = bbox.p_min.y;
+        edges->x_maxs[i] = bbox.p_max.x;
+        edges->y_maxs[i] = bbox.p_max.y;
+    }
+}
+
+// Distances only, see pone_sdf_edge_buffer_fill_winding for the signs.
+static void
+pone_sdf_edge_buffer_calculate_distances(PoneSdfEdgeBuffer *edges,
+                                         PoneSdfData *sdf_data) {
+    f32 d_pad = (f32)sdf_data->d_pad;
+    f32 x_slack = sdf_data->width * PONE_EPSILON;
+    f32 y_slack = sdf_data->height * PONE_EPSILON;
+    for (usize edge_index = 0; edge_index < edges->count; ++edge_index) {
+        u32 x_min_u32 = (u32)pone_floor(edges->x_mins[edge_index] - d_pad);
+        u32 y_min_u32 = (u32)pone_floor(edges->y_mins[edge_index] - d_pad);
+        u32 x_max_u32 =
+            (u32)pone_ceil((edges->x_maxs[edge_index] + d_pad) - x_slack);
+        u32 y_max_u32 =
+            (u32)pone_ceil((edges->y_maxs[edge_index] + d_pad) - y_slack);
         pone_assert(x_min_u32 >= 0 && x_max_u32 <= sdf_data->width);
         pone_assert(y_min_u32 >= 0 && y_max_u32 <= sdf_data->height);
 
-        for (u32 y = y_min_u32; y < y_max_u32; ++y) {
-            f32 *d_mins_row = sdf_data->d_mins + (y * sdf_data->width);
-            i8 *delta_windings_row =
-                sdf_data->delta_windings + (y * sdf_data->width);
-
-            i8 prev_side = 0;
-            for (u32 x = x_min_u32; x < x_max_u32; ++x) {
-                Vec2 p_px = {.x = x + 0.5f, .y = y + 0.5f};
-                f32 *d_min = d_mins_row + x;
-                i8 *delta_winding = delta_windings_row + x;
-                b8 side;
-                f32 d = pone_truetype_edge_segment_calculate_distance(
-                    &candidate_edge_segment, p_px, &side);
-                if (pone_truetype_between_closed_open(p_px,
-                                                      &edge_segment_bbox)) {
-                    if (prev_side == -1 && !side) {
-                        *delta_winding += 1;
-                    } else if (prev_side == 1 && side) {
-                        *delta_winding += -1;
-                    }
-                }
-                prev_side = side ? -1 : 1;
-                if (pone_abs(d) < pone_abs(*d_min)) {
-                    *d_min = d;
-                }
+        PoneRectU32 pixels = {
+            .x_min = x_min_u32,
+            .y_min = y_min_u32,
+            .x_max = x_max_u32,
+            .y_max = y_max_u32,
+        };
+        sdf_data->distance_span(edges, edge_index, &pixels, sdf_data->d_pad,
+                                sdf_data->width, sdf_data->d_mins);
+    }
+}
+
+// Adds where a y-monotone quadratic from q[0] to q[2] crosses the pixel row
+// centers in [min y, max y) to delta_windings. Half open, so a vertex that
+// two pieces share counts once going on and twice, cancelling, at a turn.
+// A crossing lands on the first pixel whose center is not left of it.
+static void pone_sdf_data_add_crossings(PoneSdfData *sdf_data, Vec2 *q) {
+    f32 y_min = PONE_MIN(q[0].y, q[2].y);
+    f32 y_max = PONE_MAX(q[0].y, q[2].y);
+    i8 direction = q[2].y > q[0].y ? 1 : -1;
+    f32 y_first = PONE_MAX(pone_ceil(y_min - 0.5f), 0.0f);
+    f32 y_last =
+        PONE_CLAMP(pone_ceil(y_max - 0.5f), 0.0f, (f32)sdf_data->height);
+    u32 y_begin = (u32)y_first;
+    u32 y_end = (u32)y_last;
+
+    f32 a = (q[0].y - 2.0f * q[1].y) + q[2].y;
+    f32 b = 2.0f * (q[1].y - q[0].y);
+    for (u32 y = y_begin; y < y_end; ++y) {
+        // The stable pair of roots, q / a and c / q. The piece is monotone,
+        // so only one of them falls into [0, 1].
+        f32 c = q[0].y - (y + 0.5f);
+        f32 discriminant = PONE_MAX(b * b - 4.0f * a * c, 0.0f);
+        f32 r = -0.5f * (b + pone_f32_copysign(pone_sqrt(discriminant), b));
+        f32 t = 0.0f;
+        if (r != 0.0f) {
+            t = c / r;
+            if (!(t >= -PONE_EPSILON && t <= 1.0f + PONE_EPSILON) &&
+                a != 0.0f) {
+                t = r / a;
             }
         }
-        contour_begin_point_index =
-            (usize)glyph->end_points_of_contours[contour_index] + 1;
+        t = PONE_CLAMP(t, 0.0f, 1.0f);
+
+        f32 x = pone_quadratic_bezier_curve(q[0], q[1], q[2], t).x;
+        f32 x_first = PONE_MAX(pone_ceil(x - 0.5f), 0.0f);
+        if (x_first < (f32)sdf_data->width) {
+            sdf_data->delta_windings[(y * sdf_data->width) + (u32)x_first] +=
+                direction;
+        }
+    }
+}
+
+// Scanline fill: every row crossing of every edge changes the winding of
+// the pixels right of it, pone_sdf_data_resolve_sign sums them up per row.
+static void pone_sdf_edge_buffer_fill_winding(PoneSdfEdgeBuffer *edges,
+                                              PoneSdfData *sdf_data) {
+    for (usize edge_index = 0; edge_index < edges->count; ++edge_index) {
+        PoneTrueTypeEdgeSegment edge;
+        pone_sdf_edge_buffer_get(edges, edge_index, &edge, 0);
+        Vec2 *p = edge.points;
+        if (edge.point_count == 2) {
+            Vec2 q[3] = {p[0], pone_linear_interp(p[0], p[1], 0.5f), p[1]};
+            pone_sdf_data_add_crossings(sdf_data, q);
+            continue;
+        }
+
+        // Quadratics turning around in y are cut at the turn, the control
+        // points next to it get its y so both halves stay monotone.
+        f32 denominator = (p[0].y - 2.0f * p[1].y) + p[2].y;
+        f32 t = denominator != 0.0f ? (p[0].y - p[1].y) / denominator : 0.0f;
+        if (t > 0.0f && t < 1.0f) {
+            Vec2 turn = pone_quadratic_bezier_curve(p[0], p[1], p[2], t);
+            Vec2 q0[3] = {p[0], pone_linear_interp(p[0], p[1], t), turn};
+            Vec2 q1[3] = {turn, pone_linear_interp(p[1], p[2], t), p[2]};
+            q0[1].y = turn.y;
+            q1[1].y = turn.y;
+            pone_sdf_data_add_crossings(sdf_data, q0);
+            pone_sdf_data_add_crossings(sdf_data, q1);
+        } else {
+            pone_sdf_data_add_crossings(sdf_data, p);
+        }
     }
+}
+
+// Runs after pone_sdf_edge_buffer_fill_winding, signs d_mins by the
+// winding.
+static void pone_sdf_data_resolve_sign(PoneSdfData *sdf_data) {
     for (u32 y = 0; y < sdf_data->height; ++y) {
         i8 winding_score = 0;
         for (u32 x = 0; x < sdf_data->width; ++x) {
             i8 delta_winding =
                 sdf_data->delta_windings[(y * sdf_data->width) + x];
             f32 *d_min = &sdf_data->d_mins[(y * sdf_data->width) + x];
-            u32 *sdf_pixel = &sdf_data->sdf_buf[(y * sdf_data->width) + x];
 
             winding_score += delta_winding;
 
@@ -1639,88 +2341,715 @@ static void pone_sfnt_simple_glyph_calculate_sdf(
             } else {
                 *d_min = pone_f32_copysign(*d_min, -1.0f);
             }
+        }
+    }
+}
 
-            f32 d_min_z = (*d_min + sdf_data->d_max) / (2.0f * sdf_data->d_max);
-            d_min_z = PONE_CLAMP(d_min_z, 0.0f, 1.0f);
+static f32 pone_sdf_normalize_distance(f32 d, u32 d_max) {
+    f32 z = (d + d_max) / (2.0f * d_max);
+    return PONE_CLAMP(z, 0.0f, 1.0f);
+}
 
-            u8 gray_value = (u8)(d_min_z * 255.0f);
-            *sdf_pixel = (u32)gray_value << 24 | (u32)gray_value << 16 |
-                         (u32)gray_value << 8 | 0x000000FFu;
+static void pone_sdf_data_encode(PoneSdfData *sdf_data) {
+    usize pixel_size = pone_truetype_sdf_atlas_format_size(sdf_data->format);
+    for (u32 y = 0; y < sdf_data->height; ++y) {
+        u8 *sdf_row = sdf_data->sdf_buf + (y * sdf_data->width * pixel_size);
+        for (u32 x = 0; x < sdf_data->width; ++x) {
+            usize pixel_index = (y * sdf_data->width) + x;
+            f32 d_min_z = pone_sdf_normalize_distance(
+                sdf_data->d_mins[pixel_index], sdf_data->d_max);
+
+            switch (sdf_data->format) {
+            case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM: {
+                sdf_row[x] = (u8)(d_min_z * 255.0f + 0.5f);
+            } break;
+            case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R16_SFLOAT: {
+                ((u16 *)sdf_row)[x] = pone_f32_to_f16(d_min_z);
+            } break;
+            case PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM: {
+                f32 *msdf_distance =
+                    sdf_data->msdf_distances + (pixel_index * 3);
+                u8 *texel = sdf_row + (x * 4);
+                for (usize channel = 0; channel < 3; ++channel) {
+                    texel[channel] =
+                        (u8)(pone_sdf_normalize_distance(
+                                 msdf_distance[channel], sdf_data->d_max) *
+                             255.0f + 0.5f);
+                }
+                texel[3] = (u8)(d_min_z * 255.0f + 0.5f);
+            } break;
+            }
         }
     }
 }
 
-void pone_truetype_font_generate_sdf(PoneTrueTypeFont *font, u32 resolution,
-                                     u32 d_pad, Arena *permanent_arena,
-                                     Arena *transient_arena,
-                                     PoneTrueTypeSdfAtlas *atlas) {
+// MSDF, after Chlumsky's "Shape Decomposition for Multi-channel Distance
+// Fields". Edges get one of the colours below, each colour bit is one
+// channel. Every channel stores the pseudo-distance to the nearest edge that
+// has its bit, corners are where the edge colours change, so the median of
+// the three channels keeps them sharp.
+#define PONE_MSDF_COLOR_RED 0x1
+#define PONE_MSDF_COLOR_GREEN 0x2
+#define PONE_MSDF_COLOR_BLUE 0x4
+#define PONE_MSDF_COLOR_YELLOW (PONE_MSDF_COLOR_RED | PONE_MSDF_COLOR_GREEN)
+#define PONE_MSDF_COLOR_MAGENTA (PONE_MSDF_COLOR_RED | PONE_MSDF_COLOR_BLUE)
+#define PONE_MSDF_COLOR_CYAN (PONE_MSDF_COLOR_GREEN | PONE_MSDF_COLOR_BLUE)
+#define PONE_MSDF_COLOR_WHITE                                                  \
+    (PONE_MSDF_COLOR_RED | PONE_MSDF_COLOR_GREEN | PONE_MSDF_COLOR_BLUE)
+// sin(3), edges meeting at a sharper angle than about 170 degrees make a
+// corner.
+#define PONE_MSDF_CORNER_CROSS_THRESHOLD 0.14112f
+// In pixels, texels whose channels jump more than this to a neighbour
+// interpolate to a wrong median.
+#define PONE_MSDF_CLASH_THRESHOLD 1.001f
+
+struct PoneMsdfEdge {
+    PoneTrueTypeEdgeSegment segment;
+    PoneRectF32 bbox;
+    u8 color;
+    b8 starts_at_corner;
+};
+
+struct PoneMsdfContour {
+    PoneMsdfEdge *edges;
+    usize edge_count;
+};
+
+struct PoneMsdfShape {
+    PoneMsdfContour *contours;
+    usize contour_count;
+    usize contour_capacity;
+    PoneMsdfEdge *edges;
+    usize edge_count;
+    usize edge_capacity;
+};
+
+// Normalized tangent at t. A quadratic whose control point sits on an end
+// point has no tangent there, the chord stands in for it.
+static Vec2 pone_msdf_edge_direction(PoneTrueTypeEdgeSegment *edge, f32 t) {
+    Vec2 d = pone_truetype_edge_segment_derivative(edge, t);
+    if (pone_vec2_len_squared(d) < PONE_EPSILON) {
+        d = pone_vec2_sub(edge->points[edge->point_count - 1],
+                          edge->points[0]);
+    }
+    if (pone_vec2_len_squared(d) < PONE_EPSILON) {
+        return (Vec2){};
+    }
+
+    return pone_vec2_norm(d);
+}
+
+static b8 pone_msdf_edge_is_degenerate(PoneTrueTypeEdgeSegment *edge) {
+    for (usize i = 1; i < edge->point_count; ++i) {
+        if (pone_vec2_len_squared(pone_vec2_sub(edge->points[i],
+                                                edge->points[0])) >
+            PONE_EPSILON) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+static void pone_msdf_edge_split_in_thirds(PoneTrueTypeEdgeSegment *edge,
+                                           PoneTrueTypeEdgeSegment *parts) {
+    for (usize i = 0; i < 3; ++i) {
+        f32 t0 = (f32)i / 3.0f;
+        f32 t1 = (f32)(i + 1) / 3.0f;
+        PoneTrueTypeEdgeSegment *part = parts + i;
+        part->point_count = edge->point_count;
+        part->points[0] = pone_truetype_edge_segment_at_t(edge, t0);
+        part->points[part->point_count - 1] =
+            pone_truetype_edge_segment_at_t(edge, t1);
+        if (edge->point_count == 3) {
+            part->points[1] = pone_vec2_add(
+                part->points[0],
+                pone_vec2_mul_scalar(
+                    0.5f * (t1 - t0),
+                    pone_truetype_edge_segment_derivative(edge, t0)));
+        }
+    }
+}
+
+// Cycles through the two-channel colours, the last spline of a contour must
+// not share a channel pair with the first, banned carries the first colour
+// then.
+static u8 pone_msdf_switch_color(u8 color, u8 banned) {
+    u8 combined = color & banned;
+    if (combined == PONE_MSDF_COLOR_RED || combined == PONE_MSDF_COLOR_GREEN ||
+        combined == PONE_MSDF_COLOR_BLUE) {
+        return combined ^ PONE_MSDF_COLOR_WHITE;
+    }
+    if (color == 0 || color == PONE_MSDF_COLOR_WHITE) {
+        return PONE_MSDF_COLOR_CYAN;
+    }
+    u8 shifted = (u8)(color << 1);
+
+    return (shifted | (shifted >> 3)) & PONE_MSDF_COLOR_WHITE;
+}
+
+// Position of edge index of count on a 3-colour ramp that is symmetric
+// around the middle edge, -1, 0 or 1.
+static i32 pone_msdf_symmetrical_trichotomy(usize index, usize count) {
+    return (i32)(3.0f + 2.875f * (f32)index / (f32)(count - 1) - 1.4375f +
+                 0.5f) -
+           3;
+}
+
+// The contour's edges are the last ones in shape and there is at least one,
+// splitting a teardrop's edges appends in place.
+static void pone_msdf_contour_color_edges(PoneMsdfShape *shape,
+                                          PoneMsdfContour *contour) {
+    usize corner_count = 0;
+    usize first_corner = 0;
+    Vec2 prev_direction = pone_msdf_edge_direction(
+        &contour->edges[contour->edge_count - 1].segment, 1.0f);
+    for (usize edge_index = 0; edge_index < contour->edge_count;
+         ++edge_index) {
+        PoneMsdfEdge *edge = contour->edges + edge_index;
+        Vec2 direction = pone_msdf_edge_direction(&edge->segment, 0.0f);
+        edge->starts_at_corner =
+            pone_vec2_dot(prev_direction, direction) <= 0.0f ||
+            pone_abs(pone_vec2_perp_dot(prev_direction, direction)) >
+                PONE_MSDF_CORNER_CROSS_THRESHOLD;
+        if (edge->starts_at_corner) {
+            if (corner_count == 0) {
+                first_corner = edge_index;
+            }
+            corner_count++;
+        }
+        prev_direction = pone_msdf_edge_direction(&edge->segment, 1.0f);
+    }
+
+    if (corner_count == 0) {
+        for (usize i = 0; i < contour->edge_count; ++i) {
+            contour->edges[i].color = PONE_MSDF_COLOR_WHITE;
+        }
+    } else if (corner_count == 1) {
+        // Teardrop, spread three colours around the contour so the one
+        // corner still sees two of them.
+        u8 colors[3];
+        colors[0] = pone_msdf_switch_color(PONE_MSDF_COLOR_WHITE, 0);
+        colors[1] = PONE_MSDF_COLOR_WHITE;
+        colors[2] = pone_msdf_switch_color(colors[0], 0);
+        usize corner = first_corner;
+        if (contour->edge_count >= 3) {
+            for (usize i = 0; i < contour->edge_count; ++i) {
+                contour->edges[(corner + i) % contour->edge_count].color =
+                    colors[1 + pone_msdf_symmetrical_trichotomy(
+                                   i, contour->edge_count)];
+            }
+        } else {
+            PoneTrueTypeEdgeSegment parts[6];
+            usize part_count = 3 * contour->edge_count;
+            for (usize i = 0; i < contour->edge_count; ++i) {
+                pone_msdf_edge_split_in_thirds(
+                    &contour->edges[(corner + i) % contour->edge_count]
+                         .segment,
+                    parts + (3 * i));
+            }
+            pone_assert(shape->edge_count + part_count <= shape->edge_capacity);
+            for (usize i = 0; i < part_count; ++i) {
+                PoneMsdfEdge *edge = contour->edges + i;
+                edge->segment = parts[i];
+                edge->color = colors[(i * 3) / part_count];
+            }
+            contour->edge_count = part_count;
+        }
+    } else {
+        usize spline = 0;
+        u8 color = pone_msdf_switch_color(PONE_MSDF_COLOR_WHITE, 0);
+        u8 initial_color = color;
+        for (usize i = 0; i < contour->edge_count; ++i) {
+            PoneMsdfEdge *edge =
+                contour->edges + ((first_corner + i) % contour->edge_count);
+            if (i > 0 && edge->starts_at_corner) {
+                spline++;
+                color = pone_msdf_switch_color(
+                    color, spline == corner_count - 1 ? initial_color : 0);
+            }
+            edge->color = color;
+        }
+    }
+
+    for (usize i = 0; i < contour->edge_count; ++i) {
+        pone_truetype_edge_segment_bbox(&contour->edges[i].segment,
+                                        &contour->edges[i].bbox);
+    }
+}
+
+static void pone_sdf_edge_buffer_collect_msdf_contours(
+    PoneSdfEdgeBuffer *edges, PoneMsdfShape *shape) {
+    usize contour_begin_edge_index = 0;
+    for (usize contour_index = 0; contour_index < edges->contour_count;
+         contour_index++) {
+        usize contour_end_edge_index = edges->contour_ends[contour_index];
+        pone_assert(shape->contour_count < shape->contour_capacity);
+        PoneMsdfContour *contour = shape->contours + shape->contour_count;
+        contour->edges = shape->edges + shape->edge_count;
+        contour->edge_count = 0;
+
+        for (usize edge_index = contour_begin_edge_index;
+             edge_index < contour_end_edge_index; ++edge_index) {
+            PoneTrueTypeEdgeSegment edge_segment;
+            pone_sdf_edge_buffer_get(edges, edge_index, &edge_segment, 0);
+            if (pone_msdf_edge_is_degenerate(&edge_segment)) {
+                continue;
+            }
+            pone_assert(shape->edge_count + contour->edge_count <
+                        shape->edge_capacity);
+            contour->edges[contour->edge_count++].segment = edge_segment;
+        }
+        contour_begin_edge_index = contour_end_edge_index;
+        if (contour->edge_count == 0) {
+            continue;
+        }
+
+        pone_msdf_contour_color_edges(shape, contour);
+        shape->edge_count += contour->edge_count;
+        shape->contour_count++;
+    }
+}
+
+struct PoneMsdfChannelCandidate {
+    PoneMsdfEdge *edge;
+    f32 distance;
+    f32 orthogonality;
+    f32 t;
+};
+
+// d and the result are positive where perp_dot(p - B(t), B'(t)) is. Extends
+// the edge's end tangents past its end points, so channels keep straight
+// lines through a corner instead of rounding around it.
+static f32 pone_msdf_signed_pseudo_distance(PoneTrueTypeEdgeSegment *edge,
+                                            Vec2 p, f32 d, f32 t) {
+    if (t <= 0.0f) {
+        Vec2 direction = pone_msdf_edge_direction(edge, 0.0f);
+        Vec2 p_p0 = pone_vec2_sub(p, edge->points[0]);
+        if (pone_vec2_dot(p_p0, direction) < 0.0f) {
+            f32 pseudo_distance = pone_vec2_perp_dot(p_p0, direction);
+            if (pone_abs(pseudo_distance) <= pone_abs(d)) {
+                return pseudo_distance;
+            }
+        }
+    } else if (t >= 1.0f) {
+        Vec2 direction = pone_msdf_edge_direction(edge, 1.0f);
+        Vec2 p_p1 = pone_vec2_sub(p, edge->points[edge->point_count - 1]);
+        if (pone_vec2_dot(p_p1, direction) > 0.0f) {
+            f32 pseudo_distance = pone_vec2_perp_dot(p_p1, direction);
+            if (pone_abs(pseudo_distance) <= pone_abs(d)) {
+                return pseudo_distance;
+            }
+        }
+    }
+
+    return d;
+}
+
+static f32 pone_msdf_rect_distance(PoneRectF32 *rect, Vec2 p) {
+    f32 dx = PONE_MAX(PONE_MAX(rect->p_min.x - p.x, p.x - rect->p_max.x),
+                      0.0f);
+    f32 dy = PONE_MAX(PONE_MAX(rect->p_min.y - p.y, p.y - rect->p_max.y),
+                      0.0f);
+
+    return pone_sqrt(dx * dx + dy * dy);
+}
+
+static f32 pone_msdf_median(f32 a, f32 b, f32 c) {
+    return PONE_MAX(PONE_MIN(a, b), PONE_MIN(PONE_MAX(a, b), c));
+}
+
+// a and b are neighbouring texels, normalized to a pixel per unit. Flags a
+// when two channels change by more than threshold between them, and a is the
+// one farther from the outline.
+static b8 pone_msdf_detect_clash(f32 *a, f32 *b, f32 threshold) {
+    f32 a0 = a[0], a1 = a[1], a2 = a[2];
+    f32 b0 = b[0], b1 = b[1], b2 = b[2];
+    f32 tmp;
+    if (pone_abs(b0 - a0) < pone_abs(b1 - a1)) {
+        tmp = a0, a0 = a1, a1 = tmp;
+        tmp = b0, b0 = b1, b1 = tmp;
+    }
+    if (pone_abs(b1 - a1) < pone_abs(b2 - a2)) {
+        tmp = a1, a1 = a2, a2 = tmp;
+        tmp = b1, b1 = b2, b2 = tmp;
+        if (pone_abs(b0 - a0) < pone_abs(b1 - a1)) {
+            tmp = a0, a0 = a1, a1 = tmp;
+            tmp = b0, b0 = b1, b1 = tmp;
+        }
+    }
+
+    // An equalized b already went through correction.
+    return pone_abs(b1 - a1) >= threshold && !(b0 == b1 && b0 == b2) &&
+           pone_abs(a2) >= pone_abs(b2);
+}
+
+// Fills sdf_data->msdf_distances from shape. Runs after
+// pone_sdf_data_resolve_sign, the true distance in d_mins fixes texels whose
+// median lands on the wrong side of the outline.
+static void pone_msdf_shape_calculate_distances(PoneMsdfShape *shape,
+                                                PoneSdfData *sdf_data) {
+    for (u32 y = 0; y < sdf_data->height; ++y) {
+        for (u32 x = 0; x < sdf_data->width; ++x) {
+            Vec2 p = {.x = x + 0.5f, .y = y + 0.5f};
+            PoneMsdfChannelCandidate candidates[3];
+            for (usize channel = 0; channel < 3; ++channel) {
+                candidates[channel] = (PoneMsdfChannelCandidate){
+                    .edge = 0,
+                    .distance = PONE_F32_MAX,
+                    .orthogonality = 1.0f,
+                    .t = 0.0f,
+                };
+            }
+
+            for (usize edge_index = 0; edge_index < shape->edge_count;
+                 ++edge_index) {
+                PoneMsdfEdge *edge = shape->edges + edge_index;
+                f32 farthest_candidate = 0.0f;
+                for (usize channel = 0; channel < 3; ++channel) {
+                    if (edge->color & (1 << channel)) {
+                        farthest_candidate = PONE_MAX(
+                            farthest_candidate, candidates[channel].distance);
+                    }
+                }
+                if (pone_msdf_rect_distance(&edge->bbox, p) >
+                    farthest_candidate) {
+                    continue;
+                }
+
+                f32 t;
+                f32 d =
+                    pone_truetype_edge_segment_find_distance(&edge->segment,
+                                                             p, &t);
+                Vec2 bt = pone_truetype_edge_segment_at_t(&edge->segment, t);
+                Vec2 p_bt = pone_vec2_sub(p, bt);
+                f32 orthogonality = 0.0f;
+                if (pone_vec2_len_squared(p_bt) > PONE_EPSILON) {
+                    orthogonality = pone_abs(pone_vec2_dot(
+                        pone_msdf_edge_direction(&edge->segment, t),
+                        pone_vec2_norm(p_bt)));
+                }
+
+                for (usize channel = 0; channel < 3; ++channel) {
+                    PoneMsdfChannelCandidate *candidate =
+                        candidates + channel;
+                    if (!(edge->color & (1 << channel))) {
+                        continue;
+                    }
+                    if (d < candidate->distance - PONE_EPSILON ||
+                        (d < candidate->distance + PONE_EPSILON &&
+                         orthogonality < candidate->orthogonality)) {
+                        *candidate = (PoneMsdfChannelCandidate){
+                            .edge = edge,
+                            .distance = d,
+                            .orthogonality = orthogonality,
+                            .t = t,
+                        };
+                    }
+                }
+            }
+
+            usize pixel_index = (y * sdf_data->width) + x;
+            f32 *msdf_distance = sdf_data->msdf_distances + (pixel_index * 3);
+            for (usize channel = 0; channel < 3; ++channel) {
+                PoneMsdfChannelCandidate *candidate = candidates + channel;
+                if (!candidate->edge) {
+                    msdf_distance[channel] = -(f32)sdf_data->d_max;
+                    continue;
+                }
+
+                PoneTrueTypeEdgeSegment *segment = &candidate->edge->segment;
+                f32 d = candidate->distance;
+                if (pone_truetype_edge_segment_calculate_side(segment, p,
+                                                              candidate->t)) {
+                    d = -d;
+                }
+                // With y flipped the insides lie on the negative side.
+                msdf_distance[channel] =
+                    -pone_msdf_signed_pseudo_distance(segment, p, d,
+                                                      candidate->t);
+            }
+
+            f32 d_true = sdf_data->d_mins[pixel_index];
+            f32 median = pone_msdf_median(msdf_distance[0], msdf_distance[1],
+                                          msdf_distance[2]);
+            if ((median > 0.0f) != (d_true > 0.0f)) {
+                for (usize channel = 0; channel < 3; ++channel) {
+                    msdf_distance[channel] = d_true;
+                }
+            }
+        }
+    }
+}
+
+// Texels that clash with a neighbour would interpolate to a median on the
+// wrong side, they fall back to the median itself.
+static void pone_msdf_correct_errors(PoneSdfData *sdf_data, u8 *clashes) {
+    f32 threshold = PONE_MSDF_CLASH_THRESHOLD;
+    f32 diagonal_threshold = 2.0f * PONE_MSDF_CLASH_THRESHOLD;
+    i32 width = (i32)sdf_data->width;
+    i32 height = (i32)sdf_data->height;
+    for (i32 y = 0; y < height; ++y) {
+        for (i32 x = 0; x < width; ++x) {
+            f32 *a = sdf_data->msdf_distances + (((y * width) + x) * 3);
+            b8 clash = 0;
+            for (i32 dy = -1; dy <= 1 && !clash; ++dy) {
+                for (i32 dx = -1; dx <= 1 && !clash; ++dx) {
+                    if ((dx == 0 && dy == 0) || x + dx < 0 ||
+                        x + dx >= width || y + dy < 0 || y + dy >= height) {
+                        continue;
+                    }
+                    f32 *b = sdf_data->msdf_distances +
+                             ((((y + dy) * width) + (x + dx)) * 3);
+                    clash = pone_msdf_detect_clash(
+                        a, b, dx && dy ? diagonal_threshold : threshold);
+                }
+            }
+            clashes[(y * width) + x] = clash;
+        }
+    }
+
+    for (usize i = 0; i < sdf_data->width * sdf_data->height; ++i) {
+        if (clashes[i]) {
+            f32 *msdf_distance = sdf_data->msdf_distances + (i * 3);
+            f32 median = pone_msdf_median(msdf_distance[0], msdf_distance[1],
+                                          msdf_distance[2]);
+            for (usize channel = 0; channel < 3; ++channel) {
+                msdf_distance[channel] = median;
+            }
+        }
+    }
+}
+
+// A teardrop split turns a contour's single edge into six.
+static void pone_sdf_edge_buffer_calculate_msdf(PoneSdfEdgeBuffer *edges,
+                                                PoneSdfData *sdf_data,
+                                                Arena *arena) {
+    PoneMsdfShape shape = {
+        .contour_capacity = edges->contour_count,
+        .edge_capacity = edges->count + 6 * edges->contour_count,
+    };
+    shape.contours = arena_alloc_array(arena, shape.contour_capacity,
+                                       PoneMsdfContour);
+    shape.edges = arena_alloc_array(arena, shape.edge_capacity, PoneMsdfEdge);
+    pone_sdf_edge_buffer_collect_msdf_contours(edges, &shape);
+
+    usize pixel_count = sdf_data->width * sdf_data->height;
+    sdf_data->msdf_distances = arena_alloc_array(arena, pixel_count * 3, f32);
+    u8 *clashes = arena_alloc_array(arena, pixel_count, u8);
+    pone_msdf_shape_calculate_distances(&shape, sdf_data);
+    pone_msdf_correct_errors(sdf_data, clashes);
+}
+
+#define PONE_SDF_BLIT_ROWS_PER_JOB 64
+
+static PoneSdfSpanFn pone_truetype_select_distance_span(void) {
+#if defined(PONE_TRUETYPE_X64)
+    PonePlatformSystemInfo system_info;
+    pone_platform_get_system_info(&system_info);
+    if (system_info.cpu_features & PONE_PLATFORM_CPU_FEATURE_AVX2) {
+        return pone_truetype_edge_segment_distance_span_avx2;
+    }
+    if (system_info.cpu_features & PONE_PLATFORM_CPU_FEATURE_SSE4_1) {
+        return pone_truetype_edge_segment_distance_span_sse4_1;
+    }
+#endif
+    return pone_truetype_edge_segment_distance_span_scalar;
+}
+
+// outline's bbox in font units, and in atlas pixels padded by d_pad along
+// with the texel size of the SDF covering it.
+static void pone_truetype_outline_sdf_bbox(PoneTrueTypeOutline *outline,
+                                           f32 pixels_per_funit, u32 d_pad,
+                                           PoneRectF32 *glyph_bbox,
+                                           PoneRectF32 *sdf_bbox, u32 *width,
+                                           u32 *height) {
+    pone_truetype_outline_bbox(outline, glyph_bbox);
+    if (outline->edge_count == 0) {
+        *glyph_bbox = {};
+    }
+
+    sdf_bbox->p_min = pone_vec2_mul_scalar(pixels_per_funit, glyph_bbox->p_min);
+    sdf_bbox->p_max = pone_vec2_mul_scalar(pixels_per_funit, glyph_bbox->p_max);
+    sdf_bbox->p_min.x -= d_pad;
+    sdf_bbox->p_min.y -= d_pad;
+    sdf_bbox->p_max.x += d_pad;
+    sdf_bbox->p_max.y += d_pad;
+
+    *width = (u32)pone_ceil(sdf_bbox->p_max.x - sdf_bbox->p_min.x);
+    *height = (u32)pone_ceil(sdf_bbox->p_max.y - sdf_bbox->p_min.y);
+}
+
+struct PoneSdfGenerateData {
+    PoneTrueTypeSdfAtlas *atlas;
+    PoneTrueTypeOutline *outlines;
+    PoneRectF32 *glyph_bboxes;
+    u8 **sdf_bufs;
+    f32 pixels_per_funit;
+    u32 d_pad;
+    u32 d_max;
+    PoneSdfSpanFn distance_span;
+};
+
+// Renders outline into sdf_buf, which holds width * height texels of format
+// and covers sdf_bbox, see pone_truetype_outline_sdf_bbox. d_mins and
+// delta_windings come from the running thread's scratch arena.
+static void pone_truetype_outline_generate_sdf(
+    PoneTrueTypeOutline *outline, PoneRectF32 *sdf_bbox, u32 width,
+    u32 height, PoneTrueTypeSdfAtlasFormat format, f32 pixels_per_funit,
+    u32 d_pad, u32 d_max, PoneSdfSpanFn distance_span, u8 *sdf_buf) {
+    PoneArenaTmp scratch = pone_scratch_begin(0, 0);
+    f32 *d_mins = arena_alloc_array(scratch.arena, width * height, f32);
+    for (usize i = 0; i < height; ++i) {
+        for (usize j = 0; j < width; ++j) {
+            d_mins[(i * width) + j] = -(f32)(d_pad * d_pad);
+        }
+    }
+    i8 *delta_windings = arena_alloc_array(scratch.arena, width * height, i8);
+    pone_memset(delta_windings, 0, width * height * sizeof(i8));
+    PoneRectF32 range_b = {
+        .p_min =
+            {
+                .x = 0.0f,
+                .y = 0.0f,
+            },
+        .p_max =
+            {
+                .x = (f32)width,
+                .y = (f32)height,
+            },
+    };
+    PoneSdfData sdf_data = {
+        .width = width,
+        .height = height,
+        .format = format,
+        .sdf_buf = sdf_buf,
+        .d_mins = d_mins,
+        .delta_windings = delta_windings,
+        .msdf_distances = 0,
+        .d_pad = d_pad,
+        .d_max = d_max,
+        .distance_span = distance_span,
+    };
+    PoneSfntGlyphPointRangeMap range_map = {
+        .scale = pixels_per_funit,
+        .range_a = sdf_bbox,
+        .range_b = &range_b,
+        .invert_y = 1,
+    };
+
+    PoneSdfEdgeBuffer edges;
+    pone_sdf_edge_buffer_init(&edges, outline, &range_map, scratch.arena);
+    pone_sdf_edge_buffer_calculate_distances(&edges, &sdf_data);
+    pone_sdf_edge_buffer_fill_winding(&edges, &sdf_data);
+    pone_sdf_data_resolve_sign(&sdf_data);
+
+    if (sdf_data.format == PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM) {
+        pone_sdf_edge_buffer_calculate_msdf(&edges, &sdf_data, scratch.arena);
+    }
+    pone_sdf_data_encode(&sdf_data);
+    pone_scratch_end(scratch);
+}
+
+// Every glyph only writes its own sdf_bufs entry, so glyphs can be spread
+// over threads freely.
+static void pone_truetype_generate_glyph_sdfs(void *user_data, usize begin,
+                                              usize end) {
+    PoneSdfGenerateData *data = (PoneSdfGenerateData *)user_data;
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    for (usize glyph_id_index = begin; glyph_id_index < end;
+         ++glyph_id_index) {
+        PoneRectU32 *glyph_rect = data->atlas->glyph_rects + glyph_id_index;
+        pone_truetype_outline_generate_sdf(
+            data->outlines + glyph_id_index,
+            data->glyph_bboxes + glyph_id_index,
+            pone_rect_u32_width(glyph_rect), pone_rect_u32_height(glyph_rect),
+            data->atlas->format, data->pixels_per_funit, data->d_pad,
+            data->d_max, data->distance_span, data->sdf_bufs[glyph_id_index]);
+    }
+    PONE_ARENA_TAG_END();
+}
+
+// Copies the glyph rows that fall into atlas rows [begin, end), counted
+// through all layers as they follow each other in buf. Packed rects do not
+// overlap, so row bands can be blitted concurrently.
+static void pone_truetype_blit_glyph_sdf_rows(void *user_data, usize begin,
+                                              usize end) {
+    PoneSdfGenerateData *data = (PoneSdfGenerateData *)user_data;
+    PoneTrueTypeSdfAtlas *atlas = data->atlas;
+    usize pixel_size = pone_truetype_sdf_atlas_format_size(atlas->format);
+    u8 *atlas_buf = (u8 *)atlas->buf;
+    for (usize glyph_index = 0; glyph_index < atlas->glyph_count;
+         glyph_index++) {
+        PoneRectU32 *glyph_rect = atlas->glyph_rects + glyph_index;
+        usize layer_y = atlas->glyph_layers[glyph_index] * atlas->height;
+        usize glyph_y_min = layer_y + glyph_rect->y_min;
+        usize glyph_y_max = layer_y + glyph_rect->y_max;
+        usize y_min = PONE_MAX(glyph_y_min, begin);
+        usize y_max = PONE_MIN(glyph_y_max, end);
+        u32 glyph_width = pone_rect_u32_width(glyph_rect);
+        u8 *sdf_buf = data->sdf_bufs[glyph_index];
+
+        for (usize y = y_min; y < y_max; y++) {
+            pone_memcpy((void *)(atlas_buf +
+                                 ((y * atlas->width) + glyph_rect->x_min) *
+                                     pixel_size),
+                        (void *)(sdf_buf + ((y - glyph_y_min) * glyph_width *
+                                            pixel_size)),
+                        glyph_width * pixel_size);
+        }
+    }
+}
+
+// The codepoints every atlas holds, in glyph order.
+static u32 *pone_truetype_sdf_atlas_char_codes(Arena *arena, usize *count) {
 #if 0
-    atlas->glyph_count = 1;
-    u32 char_code = 89;
-    u32 *char_codes = &char_code;
+    *count = 1;
+    u32 *char_codes = arena_alloc_array(arena, *count, u32);
+    char_codes[0] = 89;
 #else
-    atlas->glyph_count = 106;
-    u32 *char_codes =
-        arena_alloc_array(transient_arena, atlas->glyph_count, u32);
+    *count = 106;
+    u32 *char_codes = arena_alloc_array(arena, *count, u32);
     // ASCII chars
     for (usize i = 0; i < 94; ++i) {
         char_codes[i] = i + 33;
     }
-    char_codes[94] = 0x87c3;  // Ç
-    char_codes[95] = 0x96c3;  // Ö
-    char_codes[96] = 0x9cc3;  // Ü
-    char_codes[97] = 0xa7c3;  // ç
-    char_codes[98] = 0xb6c3;  // ö
-    char_codes[99] = 0xbcc3;  // ü
-    char_codes[100] = 0x9ec4; // Ğ
-    char_codes[101] = 0x9fc4; // ğ
-    char_codes[102] = 0xb0c4; // İ
-    char_codes[103] = 0xb1c4; // ı
-    char_codes[104] = 0x9ec5; // Ş
-    char_codes[105] = 0x9fc5; // ş
+    char_codes[94] = 0x00c7;  // Ç
+    char_codes[95] = 0x00d6;  // Ö
+    char_codes[96] = 0x00dc;  // Ü
+    char_codes[97] = 0x00e7;  // ç
+    char_codes[98] = 0x00f6;  // ö
+    char_codes[99] = 0x00fc;  // ü
+    char_codes[100] = 0x011e; // Ğ
+    char_codes[101] = 0x011f; // ğ
+    char_codes[102] = 0x0130; // İ
+    char_codes[103] = 0x0131; // ı
+    char_codes[104] = 0x015e; // Ş
+    char_codes[105] = 0x015f; // ş
 #endif
+    return char_codes;
+}
+
+void pone_truetype_font_generate_sdf(PoneTrueTypeFont *font, u32 resolution,
+                                     u32 d_pad, Arena *permanent_arena,
+                                     Arena *transient_arena,
+                                     PoneJobSystem *job_system,
+                                     PoneTrueTypeSdfAtlasFormat format,
+                                     PoneTrueTypeSdfAtlas *atlas) {
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    u32 *char_codes = pone_truetype_sdf_atlas_char_codes(transient_arena,
+                                                         &atlas->glyph_count);
     atlas->glyph_rects =
         arena_alloc_array(permanent_arena, atlas->glyph_count, PoneRectU32);
+    atlas->glyph_layers =
+        arena_alloc_array(permanent_arena, atlas->glyph_count, u32);
     atlas->glyph_bboxes = arena_alloc_array(permanent_arena, atlas->glyph_count, PoneRectF32);
 
     u32 *glyph_ids =
         arena_alloc_array(transient_arena, atlas->glyph_count, u32);
 
-    usize i = 0;
-    usize j = 0;
-    while (i < atlas->glyph_count && j < font->format_12.group_count) {
-        u32 *utf8_char = char_codes + i;
-        PoneSfntSequentialMapGroup *group = font->format_12.groups + j;
-
-        u32 char_code = 0;
-        u8 *utf8_byte = (u8 *)utf8_char;
-        if (((*utf8_byte) & 0x80) == 0) {
-            char_code = (u32)(*utf8_byte);
-        } else if (((*utf8_byte) & 0xe0) == 0xc0) {
-            char_code |= (*utf8_byte & 0x1f) << 6;
-            utf8_byte++;
-            char_code |= ((u32)(*utf8_byte) & 0x3f);
-        } else if (((*utf8_byte) & 0xf0) == 0xe0) {
-            pone_assert(0 && "unimplemented");
-        } else if (((*utf8_byte) & 0xf8) == 0xf0) {
-            pone_assert(0 && "unimplemented");
-        } else {
-            pone_assert(0 && "invalid utf8 char");
-        }
-
-        if (char_code >= group->start_char && char_code <= group->end_char) {
-            glyph_ids[i] =
-                group->start_glyph_id + (char_code - group->start_char);
-            ++i;
-            if (char_code == group->end_char) {
-                ++j;
-            }
-        } else if (char_code > group->end_char) {
-            ++j;
-        } else {
-            pone_assert(0 && "missed one");
-        }
-    }
+    pone_truetype_font_glyph_indices(font, char_codes, atlas->glyph_count,
+                                     glyph_ids);
 
     u32 d_max = d_pad;
 
@@ -1740,24 +3069,20 @@ void pone_truetype_font_generate_sdf(PoneTrueTypeFont *font, u32 resolution,
     }
 
     PoneRectF32 *glyph_bboxes = arena_alloc_array(transient_arena, atlas->glyph_count, PoneRectF32);
+    PoneTrueTypeOutline *outlines = arena_alloc_array(
+        transient_arena, atlas->glyph_count, PoneTrueTypeOutline);
     for (usize glyph_index = 0; glyph_index < atlas->glyph_count;
          ++glyph_index) {
         u32 glyph_id = glyph_ids[glyph_index];
-        PoneSfntGlyph *glyph = font->glyphs + glyph_id;
-        PoneRectF32 *glyph_bbox = glyph_bboxes + glyph_index;
-
-        pone_sfnt_glyph_bounding_box(font, glyph, glyph_bbox);
-        atlas->glyph_bboxes[glyph_index] = *glyph_bbox;
-
-        glyph_bbox->p_min = pone_vec2_mul_scalar(pixels_per_funit, glyph_bbox->p_min);
-        glyph_bbox->p_max = pone_vec2_mul_scalar(pixels_per_funit, glyph_bbox->p_max);
-        glyph_bbox->p_min.x -= d_pad;
-        glyph_bbox->p_min.y -= d_pad;
-        glyph_bbox->p_max.x += d_pad;
-        glyph_bbox->p_max.y += d_pad;
-
-        u32 glyph_width = (u32)pone_ceil(glyph_bbox->p_max.x - glyph_bbox->p_min.x);
-        u32 glyph_height = (u32)pone_ceil(glyph_bbox->p_max.y - glyph_bbox->p_min.y);
+        PoneSfntGlyph *glyph = pone_truetype_font_glyph(font, glyph_id);
+        PoneTrueTypeOutline *outline = outlines + glyph_index;
+        pone_truetype_outline_flatten(font, glyph, outline, transient_arena);
+        u32 glyph_width;
+        u32 glyph_height;
+        pone_truetype_outline_sdf_bbox(outline, pixels_per_funit, d_pad,
+                                       atlas->glyph_bboxes + glyph_index,
+                                       glyph_bboxes + glyph_index,
+                                       &glyph_width, &glyph_height);
         sdf_bitmap_pack_items[glyph_index].rect = {
             .x_min = 0,
             .y_min = 0,
@@ -1766,8 +3091,12 @@ void pone_truetype_font_generate_sdf(PoneTrueTypeFont *font, u32 resolution,
         };
     }
     u32 side;
-    b8 packed = pone_rect_pack(sdf_bitmap_pack_items, atlas->glyph_count, 2048,
-                               transient_arena, &side);
+    u32 layer_count;
+    b8 packed = pone_rect_pack_max_rects_pages(
+        sdf_bitmap_pack_items, atlas->glyph_count,
+        PONE_TRUETYPE_SDF_ATLAS_MAX_SIDE,
+        PONE_TRUETYPE_SDF_ATLAS_MAX_LAYER_COUNT, transient_arena, &side,
+        &layer_count);
     pone_assert(packed);
     for (usize rect_pack_item_index = 0;
          rect_pack_item_index < atlas->glyph_count; rect_pack_item_index++) {
@@ -1775,116 +3104,709 @@ void pone_truetype_font_generate_sdf(PoneTrueTypeFont *font, u32 resolution,
             sdf_bitmap_pack_items + rect_pack_item_index;
         usize glyph_index = *(usize *)rect_pack_item->user_data;
         atlas->glyph_rects[glyph_index] = rect_pack_item->rect;
+        atlas->glyph_layers[glyph_index] = rect_pack_item->page;
     }
 
+    usize pixel_size = pone_truetype_sdf_atlas_format_size(format);
+    atlas->format = format;
+    atlas->distance_range = (f32)d_max;
+    atlas->pixels_per_funit = pixels_per_funit;
+    atlas->glyph_padding = d_pad;
+    atlas->units_per_em = font->units_per_em;
     atlas->width = side;
     atlas->height = side;
-    atlas->buf =
-        arena_alloc_array(permanent_arena, atlas->width * atlas->height, u32);
-    u32 **sdf_bufs =
-        arena_alloc_array(transient_arena, atlas->glyph_count, u32 *);
+    atlas->layer_count = layer_count;
+    usize atlas_buf_size =
+        atlas->width * atlas->height * atlas->layer_count * pixel_size;
+    atlas->buf = arena_alloc(permanent_arena, atlas_buf_size);
+    // Only the glyph rects are blitted, the texels between them would keep
+    // whatever the arena held before and end up in cache files.
+    pone_memset(atlas->buf, 0, atlas_buf_size);
+    u8 **sdf_bufs =
+        arena_alloc_array(transient_arena, atlas->glyph_count, u8 *);
     for (usize glyph_index = 0; glyph_index < atlas->glyph_count;
          glyph_index++) {
-        u32 **sdf_buf = sdf_bufs + glyph_index;
+        u8 **sdf_buf = sdf_bufs + glyph_index;
         PoneRectU32 *glyph_rect = atlas->glyph_rects + glyph_index;
         u32 glyph_width = pone_rect_u32_width(glyph_rect);
         u32 glyph_height = pone_rect_u32_height(glyph_rect);
 
-        *sdf_buf = arena_alloc_array(
-            transient_arena, (usize)glyph_width * (usize)glyph_height, u32);
+        *sdf_buf = (u8 *)arena_alloc(transient_arena,
+                                     (usize)glyph_width *
+                                         (usize)glyph_height * pixel_size);
     }
 
-    for (usize glyph_id_index = 0; glyph_id_index < atlas->glyph_count;
-         ++glyph_id_index) {
-        u32 glyph_id = glyph_ids[glyph_id_index];
-        PoneRectU32 *glyph_rect = atlas->glyph_rects + glyph_id_index;
-        u32 glyph_width = pone_rect_u32_width(glyph_rect);
-        u32 glyph_height = pone_rect_u32_height(glyph_rect);
-        PoneSfntGlyph *glyph = font->glyphs + glyph_id;
-
-        usize transient_arena_offset = transient_arena->offset;
-        f32 *d_mins =
-            arena_alloc_array(transient_arena, glyph_width * glyph_height, f32);
-        for (usize i = 0; i < glyph_height; ++i) {
-            for (usize j = 0; j < glyph_width; ++j) {
-                d_mins[(i * glyph_width) + j] = -(f32)(d_pad * d_pad);
+    PoneSdfGenerateData generate_data = {
+        .atlas = atlas,
+        .outlines = outlines,
+        .glyph_bboxes = glyph_bboxes,
+        .sdf_bufs = sdf_bufs,
+        .pixels_per_funit = pixels_per_funit,
+        .d_pad = d_pad,
+        .d_max = d_max,
+        .distance_span = pone_truetype_select_distance_span(),
+    };
+    if (job_system) {
+        pone_job_parallel_for(job_system, atlas->glyph_count, 1,
+                              pone_truetype_generate_glyph_sdfs,
+                              (void *)&generate_data);
+        pone_job_parallel_for(job_system, atlas->height * atlas->layer_count,
+                              PONE_SDF_BLIT_ROWS_PER_JOB,
+                              pone_truetype_blit_glyph_sdf_rows,
+                              (void *)&generate_data);
+    } else {
+        pone_truetype_generate_glyph_sdfs((void *)&generate_data, 0,
+                                          atlas->glyph_count);
+        pone_truetype_blit_glyph_sdf_rows((void *)&generate_data, 0,
+                                          atlas->height * atlas->layer_count);
+    }
+    PONE_ARENA_TAG_END();
+}
+
+static inline u32
+pone_truetype_glyph_cache_bucket(PoneTrueTypeGlyphCache *cache,
+                                 u32 codepoint) {
+    return (codepoint * 0x9e3779b1u) & cache->bucket_mask;
+}
+
+void pone_truetype_glyph_cache_init(PoneTrueTypeGlyphCache *cache,
+                                    PoneTrueTypeFont *font, u32 resolution,
+                                    u32 d_pad,
+                                    PoneTrueTypeSdfAtlasFormat format,
+                                    u32 atlas_side, u32 atlas_layer_count,
+                                    usize glyph_capacity,
+                                    u32 frames_in_flight, Arena *arena) {
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    u32 content_bitmap_size = resolution - d_pad * 2;
+    cache->font = font;
+    cache->atlas = {
+        .format = format,
+        .distance_range = (f32)d_pad,
+        .pixels_per_funit = (f32)content_bitmap_size / (f32)font->units_per_em,
+        .glyph_padding = d_pad,
+        .units_per_em = font->units_per_em,
+        .buf = arena_alloc(arena, (usize)atlas_side * (usize)atlas_side *
+                                      atlas_layer_count *
+                                      pone_truetype_sdf_atlas_format_size(
+                                          format)),
+        .width = atlas_side,
+        .height = atlas_side,
+        .layer_count = atlas_layer_count,
+        .glyph_count = 0,
+        .glyph_rects = 0,
+        .glyph_layers = 0,
+        .glyph_bboxes = 0,
+    };
+    cache->packers =
+        arena_alloc_array(arena, atlas_layer_count, PoneRectShelfPacker);
+    for (u32 layer = 0; layer < atlas_layer_count; ++layer) {
+        pone_rect_shelf_packer_init(cache->packers + layer, atlas_side,
+                                    atlas_side, glyph_capacity, arena);
+    }
+
+    cache->entry_count = 0;
+    cache->entry_capacity = glyph_capacity;
+    cache->entries = arena_alloc_array(arena, glyph_capacity,
+                                       PoneTrueTypeGlyphCacheEntry);
+    cache->free_entry = PONE_TRUETYPE_GLYPH_CACHE_NONE;
+
+    u32 bucket_count = 1;
+    while (bucket_count < glyph_capacity * 2) {
+        bucket_count <<= 1;
+    }
+    cache->buckets = arena_alloc_array(arena, bucket_count, u32);
+    for (u32 i = 0; i < bucket_count; ++i) {
+        cache->buckets[i] = PONE_TRUETYPE_GLYPH_CACHE_NONE;
+    }
+    cache->bucket_mask = bucket_count - 1;
+
+    cache->lru_head = PONE_TRUETYPE_GLYPH_CACHE_NONE;
+    cache->lru_tail = PONE_TRUETYPE_GLYPH_CACHE_NONE;
+    cache->frame = 0;
+    cache->frames_in_flight = frames_in_flight;
+    cache->is_dirty = 0;
+    cache->dirty_rect = {};
+    cache->dirty_layer_min = 0;
+    cache->dirty_layer_max = 0;
+    PONE_ARENA_TAG_END();
+}
+
+void pone_truetype_glyph_cache_begin_frame(PoneTrueTypeGlyphCache *cache) {
+    cache->frame++;
+}
+
+static void pone_truetype_glyph_cache_lru_unlink(PoneTrueTypeGlyphCache *cache,
+                                                 u32 entry_index) {
+    PoneTrueTypeGlyphCacheEntry *entry = cache->entries + entry_index;
+    if (entry->lru_prev != PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+        cache->entries[entry->lru_prev].lru_next = entry->lru_next;
+    } else {
+        cache->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next != PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+        cache->entries[entry->lru_next].lru_prev = entry->lru_prev;
+    } else {
+        cache->lru_tail = entry->lru_prev;
+    }
+}
+
+static void
+pone_truetype_glyph_cache_lru_push_front(PoneTrueTypeGlyphCache *cache,
+                                         u32 entry_index) {
+    PoneTrueTypeGlyphCacheEntry *entry = cache->entries + entry_index;
+    entry->lru_prev = PONE_TRUETYPE_GLYPH_CACHE_NONE;
+    entry->lru_next = cache->lru_head;
+    if (cache->lru_head != PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+        cache->entries[cache->lru_head].lru_prev = entry_index;
+    } else {
+        cache->lru_tail = entry_index;
+    }
+    cache->lru_head = entry_index;
+}
+
+// Drops the least recently used glyph, returns 0 when that one may still be
+// in use by the GPU.
+static b8 pone_truetype_glyph_cache_evict(PoneTrueTypeGlyphCache *cache) {
+    u32 entry_index = cache->lru_tail;
+    if (entry_index == PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+        return 0;
+    }
+    PoneTrueTypeGlyphCacheEntry *entry = cache->entries + entry_index;
+    if (cache->frame - entry->last_used_frame < cache->frames_in_flight) {
+        return 0;
+    }
+
+    u32 *link = cache->buckets +
+                pone_truetype_glyph_cache_bucket(cache, entry->codepoint);
+    while (*link != entry_index) {
+        link = &cache->entries[*link].hash_next;
+    }
+    *link = entry->hash_next;
+
+    pone_truetype_glyph_cache_lru_unlink(cache, entry_index);
+    if (entry->rect.x_max > entry->rect.x_min) {
+        pone_rect_shelf_packer_remove(cache->packers + entry->layer,
+                                      &entry->rect);
+    }
+
+    entry->hash_next = cache->free_entry;
+    cache->free_entry = entry_index;
+    return 1;
+}
+
+// Tries the layers in order, so the later ones stay untouched until the
+// earlier ones fill up.
+static b8 pone_truetype_glyph_cache_insert(PoneTrueTypeGlyphCache *cache,
+                                           u32 width, u32 height,
+                                           PoneRectU32 *rect, u32 *layer) {
+    for (u32 i = 0; i < cache->atlas.layer_count; ++i) {
+        if (pone_rect_shelf_packer_insert(cache->packers + i, width, height,
+                                          rect)) {
+            *layer = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Rows of sdf_buf start sdf_row_size bytes apart.
+static void pone_truetype_glyph_cache_blit(PoneTrueTypeGlyphCache *cache,
+                                           PoneRectU32 *rect, u32 layer,
+                                           u8 *sdf_buf, usize sdf_row_size) {
+    PoneTrueTypeSdfAtlas *atlas = &cache->atlas;
+    usize pixel_size = pone_truetype_sdf_atlas_format_size(atlas->format);
+    usize row_size = pone_rect_u32_width(rect) * pixel_size;
+    u8 *atlas_buf = (u8 *)atlas->buf +
+                    (usize)layer * atlas->width * atlas->height * pixel_size;
+    for (usize y = rect->y_min; y < rect->y_max; ++y) {
+        pone_memcpy((void *)(atlas_buf +
+                             ((y * atlas->width) + rect->x_min) * pixel_size),
+                    (void *)(sdf_buf + (y - rect->y_min) * sdf_row_size),
+                    row_size);
+    }
+
+    if (!cache->is_dirty) {
+        cache->dirty_rect = *rect;
+        cache->dirty_layer_min = layer;
+        cache->dirty_layer_max = layer;
+        cache->is_dirty = 1;
+    } else {
+        PoneRectU32 *dirty_rect = &cache->dirty_rect;
+        dirty_rect->x_min = PONE_MIN(dirty_rect->x_min, rect->x_min);
+        dirty_rect->y_min = PONE_MIN(dirty_rect->y_min, rect->y_min);
+        dirty_rect->x_max = PONE_MAX(dirty_rect->x_max, rect->x_max);
+        dirty_rect->y_max = PONE_MAX(dirty_rect->y_max, rect->y_max);
+        cache->dirty_layer_min = PONE_MIN(cache->dirty_layer_min, layer);
+        cache->dirty_layer_max = PONE_MAX(cache->dirty_layer_max, layer);
+    }
+}
+
+static u32 pone_truetype_glyph_cache_find(PoneTrueTypeGlyphCache *cache,
+                                          u32 codepoint) {
+    u32 bucket = pone_truetype_glyph_cache_bucket(cache, codepoint);
+    u32 entry_index = cache->buckets[bucket];
+    while (entry_index != PONE_TRUETYPE_GLYPH_CACHE_NONE &&
+           cache->entries[entry_index].codepoint != codepoint) {
+        entry_index = cache->entries[entry_index].hash_next;
+    }
+
+    return entry_index;
+}
+
+// Takes a free entry, there has to be one, and makes it the most recently
+// used.
+static PoneTrueTypeGlyphCacheEntry *
+pone_truetype_glyph_cache_add(PoneTrueTypeGlyphCache *cache, u32 codepoint,
+                              u32 glyph_id, PoneRectU32 *rect, u32 layer,
+                              PoneRectF32 *bbox) {
+    u32 entry_index;
+    if (cache->free_entry != PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+        entry_index = cache->free_entry;
+        cache->free_entry = cache->entries[entry_index].hash_next;
+    } else {
+        pone_assert(cache->entry_count < cache->entry_capacity);
+        entry_index = (u32)cache->entry_count++;
+    }
+    u32 bucket = pone_truetype_glyph_cache_bucket(cache, codepoint);
+    PoneTrueTypeGlyphCacheEntry *entry = cache->entries + entry_index;
+    *entry = {
+        .codepoint = codepoint,
+        .glyph_id = glyph_id,
+        .rect = *rect,
+        .layer = layer,
+        .bbox = *bbox,
+        .last_used_frame = cache->frame,
+        .lru_prev = PONE_TRUETYPE_GLYPH_CACHE_NONE,
+        .lru_next = PONE_TRUETYPE_GLYPH_CACHE_NONE,
+        .hash_next = cache->buckets[bucket],
+    };
+    cache->buckets[bucket] = entry_index;
+    pone_truetype_glyph_cache_lru_push_front(cache, entry_index);
+
+    return entry;
+}
+
+PoneTrueTypeGlyphCacheEntry *
+pone_truetype_glyph_cache_get(PoneTrueTypeGlyphCache *cache, u32 codepoint) {
+    u32 entry_index = pone_truetype_glyph_cache_find(cache, codepoint);
+    if (entry_index != PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+        PoneTrueTypeGlyphCacheEntry *entry = cache->entries + entry_index;
+        entry->last_used_frame = cache->frame;
+        pone_truetype_glyph_cache_lru_unlink(cache, entry_index);
+        pone_truetype_glyph_cache_lru_push_front(cache, entry_index);
+        return entry;
+    }
+
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    PoneTrueTypeFont *font = cache->font;
+    PoneTrueTypeSdfAtlas *atlas = &cache->atlas;
+    u32 glyph_id = pone_truetype_font_glyph_index(font, codepoint);
+    PoneSfntGlyph *glyph = pone_truetype_font_glyph(font, glyph_id);
+    PoneArenaTmp scratch = pone_scratch_begin(0, 0);
+    PoneTrueTypeOutline outline;
+    pone_truetype_outline_flatten(font, glyph, &outline, scratch.arena);
+    b8 has_outline = outline.edge_count > 0;
+
+    PoneRectF32 glyph_bbox = {};
+    PoneRectF32 sdf_bbox;
+    u32 width = 0;
+    u32 height = 0;
+    PoneRectU32 rect = {};
+    u32 layer = 0;
+    if (has_outline) {
+        pone_truetype_outline_sdf_bbox(&outline, atlas->pixels_per_funit,
+                                       atlas->glyph_padding, &glyph_bbox,
+                                       &sdf_bbox, &width, &height);
+        while (!pone_truetype_glyph_cache_insert(cache, width, height, &rect,
+                                                 &layer)) {
+            if (!pone_truetype_glyph_cache_evict(cache)) {
+                pone_scratch_end(scratch);
+                PONE_ARENA_TAG_END();
+                return 0;
             }
         }
-        i8 *delta_windings =
-            arena_alloc_array(transient_arena, glyph_width * glyph_height, i8);
-        pone_memset(delta_windings, 0, glyph_width * glyph_height * sizeof(i8));
-        PoneRectF32 range_b = {
-            .p_min =
-                {
-                    .x = 0.0f,
-                    .y = 0.0f,
-                },
-            .p_max =
-                {
-                    .x = (f32)glyph_width,
-                    .y = (f32)glyph_height,
-                },
-        };
-        PoneSdfData sdf_data = {
-            .width = glyph_width,
-            .height = glyph_height,
-            .sdf_buf = sdf_bufs[glyph_id_index],
-            .d_mins = d_mins,
-            .delta_windings = delta_windings,
-            .d_pad = d_pad,
-            .d_max = d_max,
-        };
-        PoneSfntGlyphPointRangeMap range_map = {
-            .scale = pixels_per_funit,
-            .range_a = glyph_bboxes + glyph_id_index,
-            .range_b = &range_b,
-            .invert_y = 1,
-        };
+    }
+    if (cache->free_entry == PONE_TRUETYPE_GLYPH_CACHE_NONE &&
+        cache->entry_count == cache->entry_capacity) {
+        if (!pone_truetype_glyph_cache_evict(cache)) {
+            if (has_outline) {
+                pone_rect_shelf_packer_remove(cache->packers + layer, &rect);
+            }
+            pone_scratch_end(scratch);
+            PONE_ARENA_TAG_END();
+            return 0;
+        }
+    }
 
-        if (glyph->type == PONE_SFNT_GLYPH_TYPE_SIMPLE) {
-            PoneSfntGlyphPointMapConstants map_constants = {
-                .range_map = &range_map,
-                .transform = 0,
-            };
-            pone_sfnt_simple_glyph_calculate_sdf(&glyph->simple, &map_constants,
-                                                 &sdf_data);
-        } else {
-            for (usize glyph_component_index = 0;
-                 glyph_component_index < glyph->compound.component_glyph_count;
-                 ++glyph_component_index) {
-                PoneSfntComponentGlyph *component_glyph_ref =
-                    glyph->compound.component_glyphs + glyph_component_index;
-                PoneSfntGlyph *component_glyph =
-                    font->glyphs + component_glyph_ref->glyph_index;
-                pone_assert(component_glyph->type ==
-                            PONE_SFNT_GLYPH_TYPE_SIMPLE);
-                PoneSfntGlyphPointTransformation transform = {
-                    .offset = component_glyph_ref->offset,
-                    .scale = component_glyph_ref->transformation};
-                PoneSfntGlyphPointMapConstants map_constants = {
-                    .range_map = &range_map,
-                    .transform = &transform,
-                };
-                pone_sfnt_simple_glyph_calculate_sdf(&component_glyph->simple,
-                                                     &map_constants, &sdf_data);
+    if (has_outline) {
+        u8 *sdf_buf = (u8 *)arena_alloc(
+            scratch.arena, (usize)width * (usize)height *
+                               pone_truetype_sdf_atlas_format_size(
+                                   atlas->format));
+        pone_truetype_outline_generate_sdf(
+            &outline, &sdf_bbox, width, height, atlas->format,
+            atlas->pixels_per_funit, atlas->glyph_padding,
+            (u32)atlas->distance_range, pone_truetype_select_distance_span(),
+            sdf_buf);
+        pone_truetype_glyph_cache_blit(
+            cache, &rect, layer, sdf_buf,
+            width * pone_truetype_sdf_atlas_format_size(atlas->format));
+    }
+    pone_scratch_end(scratch);
+
+    PoneTrueTypeGlyphCacheEntry *entry = pone_truetype_glyph_cache_add(
+        cache, codepoint, glyph_id, &rect, layer, &glyph_bbox);
+    PONE_ARENA_TAG_END();
+
+    return entry;
+}
+
+b8 pone_truetype_glyph_cache_seed(PoneTrueTypeGlyphCache *cache,
+                                  PoneTrueTypeSdfAtlas *baked) {
+    PoneTrueTypeSdfAtlas *atlas = &cache->atlas;
+    if (baked->format != atlas->format ||
+        baked->pixels_per_funit != atlas->pixels_per_funit ||
+        baked->glyph_padding != atlas->glyph_padding ||
+        baked->distance_range != atlas->distance_range) {
+        return 0;
+    }
+
+    PONE_ARENA_TAG_BEGIN(PONE_ARENA_TAG_TRUETYPE);
+    PoneArenaTmp scratch = pone_scratch_begin(0, 0);
+    usize char_code_count;
+    u32 *char_codes =
+        pone_truetype_sdf_atlas_char_codes(scratch.arena, &char_code_count);
+    pone_assert(char_code_count == baked->glyph_count);
+    usize pixel_size = pone_truetype_sdf_atlas_format_size(atlas->format);
+    usize baked_row_size = baked->width * pixel_size;
+    b8 seeded = 1;
+    for (usize glyph_index = 0; glyph_index < baked->glyph_count;
+         ++glyph_index) {
+        u32 codepoint = char_codes[glyph_index];
+        if (pone_truetype_glyph_cache_find(cache, codepoint) !=
+            PONE_TRUETYPE_GLYPH_CACHE_NONE) {
+            continue;
+        }
+        if (cache->free_entry == PONE_TRUETYPE_GLYPH_CACHE_NONE &&
+            cache->entry_count == cache->entry_capacity) {
+            seeded = 0;
+            break;
+        }
+
+        // Glyphs without an outline are baked with a zero bbox, the cache
+        // keeps no texels for them.
+        PoneRectF32 *glyph_bbox = baked->glyph_bboxes + glyph_index;
+        b8 has_outline = glyph_bbox->p_min.x != glyph_bbox->p_max.x ||
+                         glyph_bbox->p_min.y != glyph_bbox->p_max.y;
+        PoneRectU32 rect = {};
+        u32 layer = 0;
+        if (has_outline) {
+            PoneRectU32 *baked_rect = baked->glyph_rects + glyph_index;
+            if (!pone_truetype_glyph_cache_insert(
+                    cache, pone_rect_u32_width(baked_rect),
+                    pone_rect_u32_height(baked_rect), &rect, &layer)) {
+                seeded = 0;
+                break;
             }
+            u8 *baked_buf =
+                (u8 *)baked->buf +
+                (baked->glyph_layers[glyph_index] * baked->height *
+                     baked->width +
+                 baked_rect->y_min * baked->width + baked_rect->x_min) *
+                    pixel_size;
+            pone_truetype_glyph_cache_blit(cache, &rect, layer, baked_buf,
+                                           baked_row_size);
+        }
+        u32 glyph_id = pone_truetype_font_glyph_index(cache->font, codepoint);
+        pone_truetype_glyph_cache_add(cache, codepoint, glyph_id, &rect, layer,
+                                      glyph_bbox);
+    }
+    pone_scratch_end(scratch);
+    PONE_ARENA_TAG_END();
+
+    return seeded;
+}
+
+b8 pone_truetype_glyph_cache_take_dirty_rect(PoneTrueTypeGlyphCache *cache,
+                                             PoneRectU32 *rect,
+                                             u32 *first_layer,
+                                             u32 *layer_count) {
+    if (!cache->is_dirty) {
+        return 0;
+    }
+
+    *rect = cache->dirty_rect;
+    *first_layer = cache->dirty_layer_min;
+    *layer_count = cache->dirty_layer_max - cache->dirty_layer_min + 1;
+    cache->is_dirty = 0;
+    return 1;
+}
+
+// Channel values of the texel at (x, y) of layer, clamped to rect. Single
+// channel formats repeat their value so the median stays the same.
+static void pone_truetype_sdf_atlas_fetch(PoneTrueTypeSdfAtlas *atlas,
+                                          PoneRectU32 *rect, u32 layer, i32 x,
+                                          i32 y, f32 *channels) {
+    x = PONE_CLAMP(x, (i32)rect->x_min, (i32)rect->x_max - 1);
+    y = PONE_CLAMP(y, (i32)rect->y_min, (i32)rect->y_max - 1);
+    usize layer_y = (usize)layer * atlas->height;
+    usize texel_index = ((layer_y + (usize)y) * atlas->width) + (usize)x;
+    switch (atlas->format) {
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R8_UNORM: {
+        f32 value = ((u8 *)atlas->buf)[texel_index] / 255.0f;
+        channels[0] = channels[1] = channels[2] = value;
+    } break;
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_R16_SFLOAT: {
+        f32 value = pone_f16_to_f32(((u16 *)atlas->buf)[texel_index]);
+        channels[0] = channels[1] = channels[2] = value;
+    } break;
+    case PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM: {
+        u8 *texel = (u8 *)atlas->buf + (texel_index * 4);
+        for (usize channel = 0; channel < 3; ++channel) {
+            channels[channel] = texel[channel] / 255.0f;
         }
-        transient_arena->offset = transient_arena_offset;
+    } break;
     }
+}
+
+// Signed distance in atlas pixels at p, which is relative to rect's corner.
+static f32 pone_truetype_sdf_atlas_sample(PoneTrueTypeSdfAtlas *atlas,
+                                          PoneRectU32 *rect, u32 layer,
+                                          Vec2 p) {
+    f32 x = p.x - 0.5f;
+    f32 y = p.y - 0.5f;
+    f32 x_floor = pone_floor(x);
+    f32 y_floor = pone_floor(y);
+    f32 fx = x - x_floor;
+    f32 fy = y - y_floor;
+    i32 x0 = (i32)rect->x_min + (i32)x_floor;
+    i32 y0 = (i32)rect->y_min + (i32)y_floor;
+
+    f32 texels[4][3];
+    pone_truetype_sdf_atlas_fetch(atlas, rect, layer, x0, y0, texels[0]);
+    pone_truetype_sdf_atlas_fetch(atlas, rect, layer, x0 + 1, y0, texels[1]);
+    pone_truetype_sdf_atlas_fetch(atlas, rect, layer, x0, y0 + 1, texels[2]);
+    pone_truetype_sdf_atlas_fetch(atlas, rect, layer, x0 + 1, y0 + 1,
+                                  texels[3]);
+    f32 channels[3];
+    for (usize channel = 0; channel < 3; ++channel) {
+        f32 top = texels[0][channel] +
+                  (texels[1][channel] - texels[0][channel]) * fx;
+        f32 bottom = texels[2][channel] +
+                     (texels[3][channel] - texels[2][channel]) * fx;
+        channels[channel] = top + (bottom - top) * fy;
+    }
+    f32 value = pone_msdf_median(channels[0], channels[1], channels[2]);
+
+    return (value - 0.5f) * 2.0f * atlas->distance_range;
+}
+
+void pone_truetype_sdf_atlas_compare(
+    PoneTrueTypeSdfAtlas *atlas, PoneTrueTypeSdfAtlas *reference,
+    PoneTrueTypeSdfAtlasComparison *comparison) {
+    pone_assert(atlas->glyph_count == reference->glyph_count);
+    *comparison = (PoneTrueTypeSdfAtlasComparison){};
 
+    f32 scale = atlas->pixels_per_funit / reference->pixels_per_funit;
     for (usize glyph_index = 0; glyph_index < atlas->glyph_count;
-         glyph_index++) {
-        PoneRectU32 *glyph_rect = atlas->glyph_rects + glyph_index;
-        u32 glyph_width = pone_rect_u32_width(glyph_rect);
-        u32 glyph_height = pone_rect_u32_height(glyph_rect);
-        u32 *sdf_buf = sdf_bufs[glyph_index];
+         ++glyph_index) {
+        PoneRectU32 *rect = atlas->glyph_rects + glyph_index;
+        u32 layer = atlas->glyph_layers[glyph_index];
+        PoneRectU32 *reference_rect = reference->glyph_rects + glyph_index;
+        u32 reference_layer = reference->glyph_layers[glyph_index];
+        u32 reference_width = pone_rect_u32_width(reference_rect);
+        u32 reference_height = pone_rect_u32_height(reference_rect);
+        // Both rects start glyph_padding texels off the bbox corner with y
+        // pointing down, so they line up there.
+        Vec2 atlas_origin = {
+            .x = (f32)atlas->glyph_padding,
+            .y = (f32)pone_rect_u32_height(rect) -
+                 (f32)atlas->glyph_padding,
+        };
+        Vec2 reference_origin = {
+            .x = (f32)reference->glyph_padding,
+            .y = (f32)reference_height - (f32)reference->glyph_padding,
+        };
 
-        for (usize y = 0; y < glyph_height; y++) {
-            pone_memcpy((void *)(atlas->buf +
-                                 ((glyph_rect->y_min + y) * atlas->width) +
-                                 glyph_rect->x_min),
-                        (void *)(sdf_buf + (y * glyph_width)),
-                        glyph_width * sizeof(u32));
+        for (u32 y = 0; y < reference_height; ++y) {
+            for (u32 x = 0; x < reference_width; ++x) {
+                Vec2 reference_p = {.x = x + 0.5f, .y = y + 0.5f};
+                Vec2 p = pone_vec2_add(
+                    atlas_origin,
+                    pone_vec2_mul_scalar(
+                        scale, pone_vec2_sub(reference_p, reference_origin)));
+                f32 d = pone_truetype_sdf_atlas_sample(atlas, rect, layer, p);
+
+                f32 reference_channels[3];
+                pone_truetype_sdf_atlas_fetch(
+                    reference, reference_rect, reference_layer,
+                    (i32)(reference_rect->x_min + x),
+                    (i32)(reference_rect->y_min + y), reference_channels);
+                f32 reference_d =
+                    (pone_msdf_median(reference_channels[0],
+                                      reference_channels[1],
+                                      reference_channels[2]) -
+                     0.5f) *
+                    2.0f * reference->distance_range;
+
+                if (pone_abs(reference_d) < 1.0f) {
+                    comparison->edge_sample_count++;
+                }
+                if ((d > 0.0f) != (reference_d > 0.0f)) {
+                    comparison->error_count++;
+                }
+            }
         }
     }
 }
+
+#define PONE_TRUETYPE_SDF_ATLAS_CACHE_MAGIC 0x46445350u // "PSDF"
+// Has to be bumped whenever the generator's output or this layout changes,
+// cache files of other versions are regenerated.
+#define PONE_TRUETYPE_SDF_ATLAS_CACHE_VERSION 7
+
+// Followed by glyph_count rects, glyph_count layers, glyph_count bboxes and
+// the texels of every layer, so a valid file can be used in place.
+struct PoneTrueTypeSdfAtlasCacheHeader {
+    u32 magic;
+    u32 version;
+    u64 key;
+    u32 format;
+    f32 distance_range;
+    f32 pixels_per_funit;
+    u32 glyph_padding;
+    u32 units_per_em;
+    u32 width;
+    u32 height;
+    u32 layer_count;
+    u32 glyph_count;
+};
+
+static usize pone_truetype_sdf_atlas_cache_size(usize glyph_count,
+                                                usize buf_size) {
+    return sizeof(PoneTrueTypeSdfAtlasCacheHeader) +
+           glyph_count *
+               (sizeof(PoneRectU32) + sizeof(u32) + sizeof(PoneRectF32)) +
+           buf_size;
+}
+
+u64 pone_truetype_sdf_atlas_cache_key(PoneTruetypeInput input, u32 resolution,
+                                      u32 d_pad,
+                                      PoneTrueTypeSdfAtlasFormat format,
+                                      Arena *arena) {
+    PoneArenaTmp tmp_arena = pone_arena_tmp_begin(arena);
+    usize char_code_count;
+    u32 *char_codes =
+        pone_truetype_sdf_atlas_char_codes(tmp_arena.arena, &char_code_count);
+
+    u32 params[3] = {resolution, d_pad, (u32)format};
+    u64 key = pone_hash_64(input.data, input.length, 0);
+    key = pone_hash_64((void *)params, sizeof(params), key);
+    key = pone_hash_64((void *)char_codes, char_code_count * sizeof(u32), key);
+
+    pone_arena_tmp_end(tmp_arena);
+    return key;
+}
+
+b8 pone_truetype_sdf_atlas_cache_load(PoneString *path, u64 key,
+                                      PoneTrueTypeSdfAtlasCache *cache,
+                                      PoneTrueTypeSdfAtlas *atlas,
+                                      Arena *arena) {
+    cache->data = pone_platform_map_file(path, &cache->size, arena);
+    if (!cache->data) {
+        return 0;
+    }
+
+    PoneTrueTypeSdfAtlasCacheHeader *header =
+        (PoneTrueTypeSdfAtlasCacheHeader *)cache->data;
+    b8 is_valid =
+        cache->size >= sizeof(PoneTrueTypeSdfAtlasCacheHeader) &&
+        header->magic == PONE_TRUETYPE_SDF_ATLAS_CACHE_MAGIC &&
+        header->version == PONE_TRUETYPE_SDF_ATLAS_CACHE_VERSION &&
+        header->key == key &&
+        header->format <= PONE_TRUETYPE_SDF_ATLAS_FORMAT_MSDF_R8G8B8A8_UNORM;
+    usize buf_size = 0;
+    if (is_valid) {
+        buf_size = (usize)header->width * (usize)header->height *
+                   (usize)header->layer_count *
+                   pone_truetype_sdf_atlas_format_size(
+                       (PoneTrueTypeSdfAtlasFormat)header->format);
+        is_valid = cache->size == pone_truetype_sdf_atlas_cache_size(
+                                      header->glyph_count, buf_size);
+    }
+    if (!is_valid) {
+        pone_truetype_sdf_atlas_cache_unload(cache);
+        return 0;
+    }
+
+    u8 *p = (u8 *)cache->data + sizeof(PoneTrueTypeSdfAtlasCacheHeader);
+    atlas->format = (PoneTrueTypeSdfAtlasFormat)header->format;
+    atlas->distance_range = header->distance_range;
+    atlas->pixels_per_funit = header->pixels_per_funit;
+    atlas->glyph_padding = header->glyph_padding;
+    atlas->units_per_em = (u16)header->units_per_em;
+    atlas->width = header->width;
+    atlas->height = header->height;
+    atlas->layer_count = header->layer_count;
+    atlas->glyph_count = header->glyph_count;
+    atlas->glyph_rects = (PoneRectU32 *)p;
+    p += header->glyph_count * sizeof(PoneRectU32);
+    atlas->glyph_layers = (u32 *)p;
+    p += header->glyph_count * sizeof(u32);
+    atlas->glyph_bboxes = (PoneRectF32 *)p;
+    p += header->glyph_count * sizeof(PoneRectF32);
+    atlas->buf = (void *)p;
+
+    return 1;
+}
+
+void pone_truetype_sdf_atlas_cache_unload(PoneTrueTypeSdfAtlasCache *cache) {
+    pone_platform_unmap_file(cache->data, cache->size);
+    cache->data = 0;
+    cache->size = 0;
+}
+
+b8 pone_truetype_sdf_atlas_cache_store(PoneString *path, u64 key,
+                                       PoneTrueTypeSdfAtlas *atlas,
+                                       Arena *arena) {
+    PoneArenaTmp tmp_arena = pone_arena_tmp_begin(arena);
+    usize rects_size = atlas->glyph_count * sizeof(PoneRectU32);
+    usize layers_size = atlas->glyph_count * sizeof(u32);
+    usize bboxes_size = atlas->glyph_count * sizeof(PoneRectF32);
+    usize buf_size = atlas->width * atlas->height * atlas->layer_count *
+                     pone_truetype_sdf_atlas_format_size(atlas->format);
+    usize size =
+        pone_truetype_sdf_atlas_cache_size(atlas->glyph_count, buf_size);
+    u8 *data = (u8 *)arena_alloc(tmp_arena.arena, size);
+
+    PoneTrueTypeSdfAtlasCacheHeader *header =
+        (PoneTrueTypeSdfAtlasCacheHeader *)data;
+    *header = {
+        .magic = PONE_TRUETYPE_SDF_ATLAS_CACHE_MAGIC,
+        .version = PONE_TRUETYPE_SDF_ATLAS_CACHE_VERSION,
+        .key = key,
+        .format = (u32)atlas->format,
+        .distance_range = atlas->distance_range,
+        .pixels_per_funit = atlas->pixels_per_funit,
+        .glyph_padding = atlas->glyph_padding,
+        .units_per_em = atlas->units_per_em,
+        .width = (u32)atlas->width,
+        .height = (u32)atlas->height,
+        .layer_count = (u32)atlas->layer_count,
+        .glyph_count = (u32)atlas->glyph_count,
+    };
+    u8 *p = data + sizeof(PoneTrueTypeSdfAtlasCacheHeader);
+    pone_memcpy((void *)p, (void *)atlas->glyph_rects, rects_size);
+    p += rects_size;
+    pone_memcpy((void *)p, (void *)atlas->glyph_layers, layers_size);
+    p += layers_size;
+    pone_memcpy((void *)p, (void *)atlas->glyph_bboxes, bboxes_size);
+    p += bboxes_size;
+    pone_memcpy((void *)p, atlas->buf, buf_size);
+
+    b8 result = pone_platform_write_file(path, (void *)data, size,
+                                         tmp_arena.arena);
+
+    pone_arena_tmp_end(tmp_arena);
+    return result;
+}
@@ -0,0 +1,393 @@
+// Vector distance span kernels, included by pone_truetype.cpp once for every
+// width in PONE_SDF_SIMD_WIDTH: 4 builds the SSE4.1 kernels, 8 the AVX2 ones.
+// Everything defined here is undefined again at the end.
+
+#if PONE_SDF_SIMD_WIDTH == 8
+#define PONE_SDF_SIMD_TARGET __attribute__((target("avx2")))
+#define PONE_SDF_SIMD_FN(name) name##_avx2
+#define PONE_SDF_VEC __m256
+#define PONE_SDF_IVEC __m256i
+#define PONE_SDF_SET1(x) _mm256_set1_ps(x)
+#define PONE_SDF_ZERO() _mm256_setzero_ps()
+#define PONE_SDF_LOAD(p) _mm256_loadu_ps(p)
+#define PONE_SDF_STORE(p, a) _mm256_storeu_ps(p, a)
+#define PONE_SDF_ADD(a, b) _mm256_add_ps(a, b)
+#define PONE_SDF_SUB(a, b) _mm256_sub_ps(a, b)
+#define PONE_SDF_MUL(a, b) _mm256_mul_ps(a, b)
+#define PONE_SDF_DIV(a, b) _mm256_div_ps(a, b)
+#define PONE_SDF_SQRT(a) _mm256_sqrt_ps(a)
+#define PONE_SDF_MIN(a, b) _mm256_min_ps(a, b)
+#define PONE_SDF_MAX(a, b) _mm256_max_ps(a, b)
+#define PONE_SDF_AND(a, b) _mm256_and_ps(a, b)
+#define PONE_SDF_ANDNOT(a, b) _mm256_andnot_ps(a, b)
+#define PONE_SDF_OR(a, b) _mm256_or_ps(a, b)
+#define PONE_SDF_LT(a, b) _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define PONE_SDF_NEQ(a, b) _mm256_cmp_ps(a, b, _CMP_NEQ_OQ)
+#define PONE_SDF_SELECT(mask, a, b) _mm256_blendv_ps(b, a, mask)
+#define PONE_SDF_TO_BITS(a) _mm256_castps_si256(a)
+#define PONE_SDF_FROM_BITS(a) _mm256_castsi256_ps(a)
+#define PONE_SDF_TO_I32(a) _mm256_cvttps_epi32(a)
+#define PONE_SDF_FROM_I32(a) _mm256_cvtepi32_ps(a)
+#define PONE_SDF_I32_SET1(x) _mm256_set1_epi32(x)
+#define PONE_SDF_I32_ADD(a, b) _mm256_add_epi32(a, b)
+#define PONE_SDF_I32_SRA(a, n) _mm256_srai_epi32(a, n)
+#elif PONE_SDF_SIMD_WIDTH == 4
+#define PONE_SDF_SIMD_TARGET __attribute__((target("sse4.1")))
+#define PONE_SDF_SIMD_FN(name) name##_sse4_1
+#define PONE_SDF_VEC __m128
+#define PONE_SDF_IVEC __m128i
+#define PONE_SDF_SET1(x) _mm_set1_ps(x)
+#define PONE_SDF_ZERO() _mm_setzero_ps()
+#define PONE_SDF_LOAD(p) _mm_loadu_ps(p)
+#define PONE_SDF_STORE(p, a) _mm_storeu_ps(p, a)
+#define PONE_SDF_ADD(a, b) _mm_add_ps(a, b)
+#define PONE_SDF_SUB(a, b) _mm_sub_ps(a, b)
+#define PONE_SDF_MUL(a, b) _mm_mul_ps(a, b)
+#define PONE_SDF_DIV(a, b) _mm_div_ps(a, b)
+#define PONE_SDF_SQRT(a) _mm_sqrt_ps(a)
+#define PONE_SDF_MIN(a, b) _mm_min_ps(a, b)
+#define PONE_SDF_MAX(a, b) _mm_max_ps(a, b)
+#define PONE_SDF_AND(a, b) _mm_and_ps(a, b)
+#define PONE_SDF_ANDNOT(a, b) _mm_andnot_ps(a, b)
+#define PONE_SDF_OR(a, b) _mm_or_ps(a, b)
+#define PONE_SDF_LT(a, b) _mm_cmplt_ps(a, b)
+#define PONE_SDF_NEQ(a, b) _mm_cmpneq_ps(a, b)
+#define PONE_SDF_SELECT(mask, a, b) _mm_blendv_ps(b, a, mask)
+#define PONE_SDF_TO_BITS(a) _mm_castps_si128(a)
+#define PONE_SDF_FROM_BITS(a) _mm_castsi128_ps(a)
+#define PONE_SDF_TO_I32(a) _mm_cvttps_epi32(a)
+#define PONE_SDF_FROM_I32(a) _mm_cvtepi32_ps(a)
+#define PONE_SDF_I32_SET1(x) _mm_set1_epi32(x)
+#define PONE_SDF_I32_ADD(a, b) _mm_add_epi32(a, b)
+#define PONE_SDF_I32_SRA(a, n) _mm_srai_epi32(a, n)
+#else
+#error "PONE_SDF_SIMD_WIDTH has to be 4 or 8"
+#endif
+
+#define PONE_SDF_ABS(a) PONE_SDF_ANDNOT(PONE_SDF_SET1(-0.0f), a)
+
+// Bit trick estimate refined by three Newton steps, close to cbrtf.
+PONE_SDF_SIMD_TARGET static PONE_SDF_VEC
+PONE_SDF_SIMD_FN(pone_sdf_cbrt)(PONE_SDF_VEC x) {
+    PONE_SDF_VEC sign = PONE_SDF_AND(x, PONE_SDF_SET1(-0.0f));
+    PONE_SDF_VEC a = PONE_SDF_ABS(x);
+    PONE_SDF_IVEC bits = PONE_SDF_TO_I32(PONE_SDF_MUL(
+        PONE_SDF_FROM_I32(PONE_SDF_TO_BITS(a)), PONE_SDF_SET1(1.0f / 3.0f)));
+    bits = PONE_SDF_I32_ADD(bits, PONE_SDF_I32_SET1(709921077));
+    PONE_SDF_VEC y = PONE_SDF_FROM_BITS(bits);
+    PONE_SDF_VEC third = PONE_SDF_SET1(1.0f / 3.0f);
+    for (u32 i = 0; i < 3; ++i) {
+        y = PONE_SDF_MUL(third,
+                         PONE_SDF_ADD(PONE_SDF_ADD(y, y),
+                                      PONE_SDF_DIV(a, PONE_SDF_MUL(y, y))));
+    }
+    y = PONE_SDF_AND(y, PONE_SDF_NEQ(a, PONE_SDF_ZERO()));
+
+    return PONE_SDF_OR(y, sign);
+}
+
+// Abramowitz and Stegun 4.4.46, absolute error below 2e-8.
+PONE_SDF_SIMD_TARGET static PONE_SDF_VEC
+PONE_SDF_SIMD_FN(pone_sdf_acos)(PONE_SDF_VEC x) {
+    PONE_SDF_VEC a = PONE_SDF_ABS(x);
+    PONE_SDF_VEC poly = PONE_SDF_SET1(pone_sdf_acos_coefficients[7]);
+    for (u32 i = 7; i-- > 0;) {
+        poly = PONE_SDF_ADD(PONE_SDF_MUL(poly, a),
+                            PONE_SDF_SET1(pone_sdf_acos_coefficients[i]));
+    }
+    PONE_SDF_VEC r =
+        PONE_SDF_MUL(PONE_SDF_SQRT(PONE_SDF_SUB(PONE_SDF_SET1(1.0f), a)), poly);
+
+    return PONE_SDF_SELECT(PONE_SDF_LT(x, PONE_SDF_ZERO()),
+                           PONE_SDF_SUB(PONE_SDF_SET1(PONE_PI), r), r);
+}
+
+// Taylor series for x in [0, pi / 3], good to float precision there.
+PONE_SDF_SIMD_TARGET static void
+PONE_SDF_SIMD_FN(pone_sdf_sin_cos)(PONE_SDF_VEC x, PONE_SDF_VEC *s,
+                                   PONE_SDF_VEC *c) {
+    PONE_SDF_VEC x2 = PONE_SDF_MUL(x, x);
+    PONE_SDF_VEC cp = PONE_SDF_SET1(-1.0f / 3628800.0f);
+    cp = PONE_SDF_ADD(PONE_SDF_MUL(cp, x2), PONE_SDF_SET1(1.0f / 40320.0f));
+    cp = PONE_SDF_ADD(PONE_SDF_MUL(cp, x2), PONE_SDF_SET1(-1.0f / 720.0f));
+    cp = PONE_SDF_ADD(PONE_SDF_MUL(cp, x2), PONE_SDF_SET1(1.0f / 24.0f));
+    cp = PONE_SDF_ADD(PONE_SDF_MUL(cp, x2), PONE_SDF_SET1(-0.5f));
+    *c = PONE_SDF_ADD(PONE_SDF_MUL(cp, x2), PONE_SDF_SET1(1.0f));
+
+    PONE_SDF_VEC sp = PONE_SDF_SET1(-1.0f / 39916800.0f);
+    sp = PONE_SDF_ADD(PONE_SDF_MUL(sp, x2), PONE_SDF_SET1(1.0f / 362880.0f));
+    sp = PONE_SDF_ADD(PONE_SDF_MUL(sp, x2), PONE_SDF_SET1(-1.0f / 5040.0f));
+    sp = PONE_SDF_ADD(PONE_SDF_MUL(sp, x2), PONE_SDF_SET1(1.0f / 120.0f));
+    sp = PONE_SDF_ADD(PONE_SDF_MUL(sp, x2), PONE_SDF_SET1(-1.0f / 6.0f));
+    sp = PONE_SDF_ADD(PONE_SDF_MUL(sp, x2), PONE_SDF_SET1(1.0f));
+    *s = PONE_SDF_MUL(sp, x);
+}
+
+PONE_SDF_SIMD_TARGET static PONE_SDF_VEC
+PONE_SDF_SIMD_FN(pone_sdf_line_distance)(PoneSdfSpanConstants *constants,
+                                         PONE_SDF_VEC p_x, PONE_SDF_VEC p_y) {
+    PONE_SDF_VEC p0_x = PONE_SDF_SET1(constants->p0.x);
+    PONE_SDF_VEC p0_y = PONE_SDF_SET1(constants->p0.y);
+    PONE_SDF_VEC d1_x = PONE_SDF_SET1(constants->d1.x);
+    PONE_SDF_VEC d1_y = PONE_SDF_SET1(constants->d1.y);
+
+    PONE_SDF_VEC t =
+        PONE_SDF_DIV(PONE_SDF_ADD(PONE_SDF_MUL(PONE_SDF_SUB(p_x, p0_x), d1_x),
+                                  PONE_SDF_MUL(PONE_SDF_SUB(p_y, p0_y), d1_y)),
+                     PONE_SDF_SET1(constants->line_len_squared));
+    t = PONE_SDF_MIN(PONE_SDF_MAX(t, PONE_SDF_ZERO()), PONE_SDF_SET1(1.0f));
+
+    PONE_SDF_VEC one_minus_t = PONE_SDF_SUB(PONE_SDF_SET1(1.0f), t);
+    PONE_SDF_VEC bt_x =
+        PONE_SDF_ADD(PONE_SDF_MUL(p0_x, one_minus_t),
+                     PONE_SDF_MUL(PONE_SDF_SET1(constants->p1.x), t));
+    PONE_SDF_VEC bt_y =
+        PONE_SDF_ADD(PONE_SDF_MUL(p0_y, one_minus_t),
+                     PONE_SDF_MUL(PONE_SDF_SET1(constants->p1.y), t));
+    PONE_SDF_VEC v_x = PONE_SDF_SUB(bt_x, p_x);
+    PONE_SDF_VEC v_y = PONE_SDF_SUB(bt_y, p_y);
+
+    return PONE_SDF_SQRT(
+        PONE_SDF_ADD(PONE_SDF_MUL(v_x, v_x), PONE_SDF_MUL(v_y, v_y)));
+}
+
+PONE_SDF_SIMD_TARGET static void
+PONE_SDF_SIMD_FN(pone_sdf_quadratic_at)(PoneSdfSpanConstants *constants,
+                                        PONE_SDF_VEC t, PONE_SDF_VEC *bt_x,
+                                        PONE_SDF_VEC *bt_y) {
+    PONE_SDF_VEC one_minus_t = PONE_SDF_SUB(PONE_SDF_SET1(1.0f), t);
+    PONE_SDF_VEC w0 = PONE_SDF_MUL(one_minus_t, one_minus_t);
+    PONE_SDF_VEC w2 = PONE_SDF_MUL(t, t);
+    *bt_x = PONE_SDF_ADD(
+        PONE_SDF_ADD(PONE_SDF_SET1(constants->p1.x),
+                     PONE_SDF_MUL(w0, PONE_SDF_SET1(constants->p0.x -
+                                                    constants->p1.x))),
+        PONE_SDF_MUL(w2, PONE_SDF_SET1(constants->p2.x - constants->p1.x)));
+    *bt_y = PONE_SDF_ADD(
+        PONE_SDF_ADD(PONE_SDF_SET1(constants->p1.y),
+                     PONE_SDF_MUL(w0, PONE_SDF_SET1(constants->p0.y -
+                                                    constants->p1.y))),
+        PONE_SDF_MUL(w2, PONE_SDF_SET1(constants->p2.y - constants->p1.y)));
+}
+
+// The roots of the nearest point cubic come from all three cases of
+// pone_truetype_quadratic_bezier_segment_find_distance at once, every lane
+// then keeps the candidates of its own case.
+PONE_SDF_SIMD_TARGET static PONE_SDF_VEC
+PONE_SDF_SIMD_FN(pone_sdf_quadratic_distance)(PoneSdfSpanConstants *constants,
+                                              PONE_SDF_VEC p_x,
+                                              PONE_SDF_VEC p_y) {
+    PONE_SDF_VEC d2_x = PONE_SDF_SET1(constants->d2.x);
+    PONE_SDF_VEC d2_y = PONE_SDF_SET1(constants->d2.y);
+    PONE_SDF_VEC a3 = PONE_SDF_SET1(constants->a3);
+    PONE_SDF_VEC a2 = PONE_SDF_SET1(constants->a2);
+    PONE_SDF_VEC root_offset = PONE_SDF_SET1(constants->root_offset);
+
+    PONE_SDF_VEC p_rel_x = PONE_SDF_SUB(p_x, PONE_SDF_SET1(constants->p0.x));
+    PONE_SDF_VEC p_rel_y = PONE_SDF_SUB(p_y, PONE_SDF_SET1(constants->p0.y));
+    PONE_SDF_VEC a0 = PONE_SDF_DIV(
+        PONE_SDF_ADD(PONE_SDF_MUL(PONE_SDF_SET1(-constants->d1.x), p_rel_x),
+                     PONE_SDF_MUL(PONE_SDF_SET1(-constants->d1.y), p_rel_y)),
+        a3);
+    PONE_SDF_VEC a1 = PONE_SDF_DIV(
+        PONE_SDF_SUB(PONE_SDF_SET1(constants->a1),
+                     PONE_SDF_ADD(PONE_SDF_MUL(d2_x, p_rel_x),
+                                  PONE_SDF_MUL(d2_y, p_rel_y))),
+        a3);
+
+    PONE_SDF_VEC q = PONE_SDF_DIV(
+        PONE_SDF_SUB(PONE_SDF_MUL(PONE_SDF_SET1(3.0f), a1),
+                     PONE_SDF_MUL(a2, a2)),
+        PONE_SDF_SET1(9.0f));
+    PONE_SDF_VEC r = PONE_SDF_DIV(
+        PONE_SDF_SUB(
+            PONE_SDF_SUB(PONE_SDF_MUL(PONE_SDF_MUL(PONE_SDF_SET1(9.0f), a2),
+                                      a1),
+                         PONE_SDF_MUL(PONE_SDF_SET1(27.0f), a0)),
+            PONE_SDF_MUL(
+                PONE_SDF_MUL(PONE_SDF_MUL(PONE_SDF_SET1(2.0f), a2), a2),
+                a2)),
+        PONE_SDF_SET1(54.0f));
+    PONE_SDF_VEC d = PONE_SDF_ADD(PONE_SDF_MUL(PONE_SDF_MUL(q, q), q),
+                                  PONE_SDF_MUL(r, r));
+
+    PONE_SDF_VEC is_double =
+        PONE_SDF_LT(PONE_SDF_ABS(d), PONE_SDF_SET1(PONE_EPSILON));
+    PONE_SDF_VEC is_triple = PONE_SDF_ANDNOT(
+        is_double,
+        PONE_SDF_FROM_BITS(PONE_SDF_I32_SRA(PONE_SDF_TO_BITS(d), 31)));
+
+    // One real root.
+    PONE_SDF_VEC d_sqrt = PONE_SDF_SQRT(PONE_SDF_MAX(d, PONE_SDF_ZERO()));
+    PONE_SDF_VEC z_single = PONE_SDF_ADD(
+        root_offset,
+        PONE_SDF_ADD(PONE_SDF_SIMD_FN(pone_sdf_cbrt)(PONE_SDF_ADD(r, d_sqrt)),
+                     PONE_SDF_SIMD_FN(pone_sdf_cbrt)(PONE_SDF_SUB(r, d_sqrt))));
+
+    // A double root.
+    PONE_SDF_VEC big_s = PONE_SDF_SIMD_FN(pone_sdf_cbrt)(r);
+    PONE_SDF_VEC z_double_0 =
+        PONE_SDF_ADD(root_offset, PONE_SDF_MUL(PONE_SDF_SET1(2.0f), big_s));
+    PONE_SDF_VEC z_double_1 = PONE_SDF_SUB(root_offset, big_s);
+
+    // Three real roots, cos((theta + 2 pi k) / 3) via the angle sum formula.
+    PONE_SDF_VEC neg_q =
+        PONE_SDF_MAX(PONE_SDF_SUB(PONE_SDF_ZERO(), q), PONE_SDF_ZERO());
+    PONE_SDF_VEC cos_arg = PONE_SDF_DIV(
+        r, PONE_SDF_SQRT(PONE_SDF_MUL(PONE_SDF_MUL(neg_q, q), q)));
+    cos_arg = PONE_SDF_MIN(PONE_SDF_MAX(cos_arg, PONE_SDF_SET1(-1.0f)),
+                           PONE_SDF_SET1(1.0f));
+    PONE_SDF_VEC phi = PONE_SDF_MUL(PONE_SDF_SIMD_FN(pone_sdf_acos)(cos_arg),
+                                    PONE_SDF_SET1(1.0f / 3.0f));
+    PONE_SDF_VEC sin_phi;
+    PONE_SDF_VEC cos_phi;
+    PONE_SDF_SIMD_FN(pone_sdf_sin_cos)(phi, &sin_phi, &cos_phi);
+    PONE_SDF_VEC half_cos = PONE_SDF_MUL(PONE_SDF_SET1(-0.5f), cos_phi);
+    PONE_SDF_VEC root3_half_sin =
+        PONE_SDF_MUL(PONE_SDF_SET1(0.866025403784f), sin_phi);
+    PONE_SDF_VEC amplitude =
+        PONE_SDF_MUL(PONE_SDF_SET1(2.0f), PONE_SDF_SQRT(neg_q));
+    PONE_SDF_VEC z_triple_0 =
+        PONE_SDF_ADD(PONE_SDF_MUL(amplitude, cos_phi), root_offset);
+    PONE_SDF_VEC z_triple_1 = PONE_SDF_ADD(
+        PONE_SDF_MUL(amplitude, PONE_SDF_SUB(half_cos, root3_half_sin)),
+        root_offset);
+    PONE_SDF_VEC z_triple_2 = PONE_SDF_ADD(
+        PONE_SDF_MUL(amplitude, PONE_SDF_ADD(half_cos, root3_half_sin)),
+        root_offset);
+
+    PONE_SDF_VEC z[3];
+    z[0] = PONE_SDF_SELECT(
+        is_triple, z_triple_0,
+        PONE_SDF_SELECT(is_double, z_double_0, z_single));
+    z[1] = PONE_SDF_SELECT(
+        is_triple, z_triple_1,
+        PONE_SDF_SELECT(is_double, z_double_1, z_single));
+    z[2] = PONE_SDF_SELECT(is_triple, z_triple_2, z[0]);
+
+    PONE_SDF_VEC dist = PONE_SDF_SET1(PONE_F32_MAX);
+    for (u32 i = 0; i < 3; ++i) {
+        PONE_SDF_VEC t = PONE_SDF_MIN(PONE_SDF_MAX(z[i], PONE_SDF_ZERO()),
+                                      PONE_SDF_SET1(1.0f));
+        PONE_SDF_VEC bt_x;
+        PONE_SDF_VEC bt_y;
+        PONE_SDF_SIMD_FN(pone_sdf_quadratic_at)(constants, t, &bt_x, &bt_y);
+        PONE_SDF_VEC v_x = PONE_SDF_SUB(bt_x, p_x);
+        PONE_SDF_VEC v_y = PONE_SDF_SUB(bt_y, p_y);
+        PONE_SDF_VEC candidate_dist = PONE_SDF_SQRT(
+            PONE_SDF_ADD(PONE_SDF_MUL(v_x, v_x), PONE_SDF_MUL(v_y, v_y)));
+        dist = PONE_SDF_MIN(candidate_dist, dist);
+    }
+
+    return dist;
+}
+
+// Folds one block of distances, starting at x, into the row.
+PONE_SDF_SIMD_TARGET static inline void
+PONE_SDF_SIMD_FN(pone_sdf_span_merge)(PONE_SDF_VEC d, u32 x, u32 x_end,
+                                      f32 *d_mins_row) {
+    // A partial last block works on a copy of its d_mins, so nothing past
+    // x_end is read or written.
+    u32 lane_count = PONE_MIN(x_end - x, (u32)PONE_SDF_SIMD_WIDTH);
+    f32 d_mins_tail[PONE_SDF_SIMD_WIDTH];
+    f32 *d_mins = d_mins_row + x;
+    if (lane_count < PONE_SDF_SIMD_WIDTH) {
+        for (u32 i = 0; i < PONE_SDF_SIMD_WIDTH; ++i) {
+            d_mins_tail[i] = i < lane_count ? d_mins[i] : 0.0f;
+        }
+        d_mins = d_mins_tail;
+    }
+
+    PONE_SDF_VEC d_min = PONE_SDF_LOAD(d_mins);
+    PONE_SDF_VEC is_closer = PONE_SDF_LT(PONE_SDF_ABS(d), PONE_SDF_ABS(d_min));
+    PONE_SDF_STORE(d_mins, PONE_SDF_SELECT(is_closer, d, d_min));
+    if (lane_count < PONE_SDF_SIMD_WIDTH) {
+        for (u32 i = 0; i < lane_count; ++i) {
+            d_mins_row[x + i] = d_mins_tail[i];
+        }
+    }
+}
+
+// The segment kind is settled once per edge, each loop runs a single
+// distance kernel.
+PONE_SDF_SIMD_TARGET static void
+PONE_SDF_SIMD_FN(pone_truetype_edge_segment_distance_span)(
+    PoneSdfEdgeBuffer *edges, usize edge_index, PoneRectU32 *pixels,
+    u32 d_pad, usize width, f32 *d_mins) {
+    u8 kind = edges->kinds[edge_index];
+    if (kind == PONE_SDF_EDGE_KIND_QUADRATIC_FLAT) {
+        pone_truetype_edge_segment_distance_span_scalar(
+            edges, edge_index, pixels, d_pad, width, d_mins);
+        return;
+    }
+
+    PoneSdfEdgeBand band;
+    pone_sdf_edge_band_init(edges, edge_index, &band);
+    PoneSdfSpanConstants constants;
+    pone_sdf_span_constants_init(&band.edge, &constants);
+
+    f32 lane_centers[PONE_SDF_SIMD_WIDTH];
+    for (u32 i = 0; i < PONE_SDF_SIMD_WIDTH; ++i) {
+        lane_centers[i] = i + 0.5f;
+    }
+    PONE_SDF_VEC lane_offsets = PONE_SDF_LOAD(lane_centers);
+    for (u32 y = pixels->y_min; y < pixels->y_max; ++y) {
+        u32 x_begin;
+        u32 x_end;
+        if (!pone_sdf_edge_band_row_span(&band, y, (f32)d_pad, pixels,
+                                         &x_begin, &x_end)) {
+            continue;
+        }
+
+        f32 *d_mins_row = d_mins + (y * width);
+        PONE_SDF_VEC p_y = PONE_SDF_SET1(y + 0.5f);
+        if (kind == PONE_SDF_EDGE_KIND_LINE) {
+            for (u32 x = x_begin; x < x_end; x += PONE_SDF_SIMD_WIDTH) {
+                PONE_SDF_VEC p_x =
+                    PONE_SDF_ADD(PONE_SDF_SET1((f32)x), lane_offsets);
+                PONE_SDF_VEC d = PONE_SDF_SIMD_FN(pone_sdf_line_distance)(
+                    &constants, p_x, p_y);
+                PONE_SDF_SIMD_FN(pone_sdf_span_merge)(d, x, x_end, d_mins_row);
+            }
+        } else {
+            for (u32 x = x_begin; x < x_end; x += PONE_SDF_SIMD_WIDTH) {
+                PONE_SDF_VEC p_x =
+                    PONE_SDF_ADD(PONE_SDF_SET1((f32)x), lane_offsets);
+                PONE_SDF_VEC d = PONE_SDF_SIMD_FN(pone_sdf_quadratic_distance)(
+                    &constants, p_x, p_y);
+                PONE_SDF_SIMD_FN(pone_sdf_span_merge)(d, x, x_end, d_mins_row);
+            }
+        }
+    }
+}
+
+#undef PONE_SDF_ABS
+#undef PONE_SDF_I32_SRA
+#undef PONE_SDF_I32_ADD
+#undef PONE_SDF_I32_SET1
+#undef PONE_SDF_FROM_I32
+#undef PONE_SDF_TO_I32
+#undef PONE_SDF_FROM_BITS
+#undef PONE_SDF_TO_BITS
+#undef PONE_SDF_SELECT
+#undef PONE_SDF_NEQ
+#undef PONE_SDF_LT
+#undef PONE_SDF_OR
+#undef PONE_SDF_ANDNOT
+#undef PONE_SDF_AND
+#undef PONE_SDF_MAX
+#undef PONE_SDF_MIN
+#undef PONE_SDF_SQRT
+#undef PONE_SDF_DIV
+#undef PONE_SDF_MUL
+#undef PONE_SDF_SUB
+#undef PONE_SDF_ADD
+#undef PONE_SDF_STORE
+#undef PONE_SDF_LOAD
+#undef PONE_SDF_ZERO
+#undef PONE_SDF_SET1
+#undef PONE_SDF_IVEC
+#undef PONE_SDF_VEC
+#undef PONE_SDF_SIMD_FN
+#undef PONE_SDF_SIMD_TARGET
+#undef PONE_SDF_SIMD_WIDTH
@@ -0,0 +1,129 @@
+#include "pone_work_deque.h"
+
+#include "pone_assert.h"
+#include "pone_memory.h"
+
+#define PONE_WORK_DEQUE_INITIAL_CAPACITY 256
+#define PONE_WORK_DEQUE_ARENA_CAPACITY MEGABYTES((usize)256)
+
+// Slots are read by thieves while the owner may be writing them after a
+// wrap around. Such a thief always loses the CAS on top, so the fields just
+// have to be accessed atomically, not the pair.
+static inline void _pone_work_deque_store(PoneWorkDequeArray *array, isize i,
+                                          PoneWorkQueueData *data) {
+    PoneWorkQueueData *slot = &array->buffer[(usize)i & (array->capacity - 1)];
+    _pone_atomic_store_n(&slot->work, data->work, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&slot->user_data, data->user_data,
+                         PONE_MEMORY_ORDERING_RELAXED);
+}
+
+static inline void _pone_work_deque_load(PoneWorkDequeArray *array, isize i,
+                                         PoneWorkQueueData *data) {
+    PoneWorkQueueData *slot = &array->buffer[(usize)i & (array->capacity - 1)];
+    data->work = _pone_atomic_load_n(&slot->work, PONE_MEMORY_ORDERING_RELAXED);
+    data->user_data =
+        _pone_atomic_load_n(&slot->user_data, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+static PoneWorkDequeArray *_pone_work_deque_alloc_array(PoneWorkDeque *deque,
+                                                        usize capacity) {
+    PoneWorkDequeArray *array =
+        arena_alloc_struct(&deque->arena, PoneWorkDequeArray);
+    array->capacity = capacity;
+    array->buffer =
+        arena_alloc_array_aligned(&deque->arena, capacity, PoneWorkQueueData);
+
+    return array;
+}
+
+void pone_work_deque_init(PoneWorkDeque *deque) {
+    b8 ok = pone_arena_create_virtual(0, PONE_WORK_DEQUE_ARENA_CAPACITY, 0,
+                                      &deque->arena);
+    pone_assert(ok);
+    PoneWorkDequeArray *array =
+        _pone_work_deque_alloc_array(deque, PONE_WORK_DEQUE_INITIAL_CAPACITY);
+
+    _pone_atomic_store_n(&deque->top, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&deque->bottom, 0, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&deque->array, array, PONE_MEMORY_ORDERING_RELEASE);
+}
+
+void pone_work_deque_destroy(PoneWorkDeque *deque) {
+    pone_arena_release(&deque->arena);
+    deque->array = 0;
+}
+
+void pone_work_deque_push(PoneWorkDeque *deque, PoneWorkQueueData *data) {
+    isize b = _pone_atomic_load_n(&deque->bottom, PONE_MEMORY_ORDERING_RELAXED);
+    isize t = _pone_atomic_load_n(&deque->top, PONE_MEMORY_ORDERING_ACQUIRE);
+    PoneWorkDequeArray *array =
+        _pone_atomic_load_n(&deque->array, PONE_MEMORY_ORDERING_RELAXED);
+
+    if (b - t > (isize)array->capacity - 1) {
+        PoneWorkDequeArray *new_array =
+            _pone_work_deque_alloc_array(deque, array->capacity * 2);
+        for (isize i = t; i < b; ++i) {
+            PoneWorkQueueData item;
+            _pone_work_deque_load(array, i, &item);
+            _pone_work_deque_store(new_array, i, &item);
+        }
+        _pone_atomic_store_n(&deque->array, new_array,
+                             PONE_MEMORY_ORDERING_RELEASE);
+        array = new_array;
+    }
+
+    _pone_work_deque_store(array, b, data);
+    _pone_atomic_thread_fence(PONE_MEMORY_ORDERING_RELEASE);
+    _pone_atomic_store_n(&deque->bottom, b + 1, PONE_MEMORY_ORDERING_RELAXED);
+}
+
+b8 pone_work_deque_pop(PoneWorkDeque *deque, PoneWorkQueueData *data) {
+    isize b =
+        _pone_atomic_load_n(&deque->bottom, PONE_MEMORY_ORDERING_RELAXED) - 1;
+    PoneWorkDequeArray *array =
+        _pone_atomic_load_n(&deque->array, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_store_n(&deque->bottom, b, PONE_MEMORY_ORDERING_RELAXED);
+    _pone_atomic_thread_fence(PONE_MEMORY_ORDERING_SEQ_CST);
+    isize t = _pone_atomic_load_n(&deque->top, PONE_MEMORY_ORDERING_RELAXED);
+
+    if (t > b) {
+        _pone_atomic_store_n(&deque->bottom, b + 1,
+                             PONE_MEMORY_ORDERING_RELAXED);
+        return 0;
+    }
+
+    _pone_work_deque_load(array, b, data);
+    if (t == b) {
+        // Last item, race the thieves for it.
+        b8 won = _pone_atomic_compare_exchange_n(
+            &deque->top, &t, t + 1, 0, PONE_MEMORY_ORDERING_SEQ_CST,
+            PONE_MEMORY_ORDERING_RELAXED);
+        _pone_atomic_store_n(&deque->bottom, b + 1,
+                             PONE_MEMORY_ORDERING_RELAXED);
+        return won;
+    }
+
+    return 1;
+}
+
+PoneWorkDequeStealResult pone_work_deque_steal(PoneWorkDeque *deque,
+                                               PoneWorkQueueData *data) {
+    isize t = _pone_atomic_load_n(&deque->top, PONE_MEMORY_ORDERING_ACQUIRE);
+    _pone_atomic_thread_fence(PONE_MEMORY_ORDERING_SEQ_CST);
+    isize b = _pone_atomic_load_n(&deque->bottom, PONE_MEMORY_ORDERING_ACQUIRE);
+
+    if (t >= b) {
+        return PONE_WORK_DEQUE_STEAL_RESULT_EMPTY;
+    }
+
+    PoneWorkDequeArray *array =
+        _pone_atomic_load_n(&deque->array, PONE_MEMORY_ORDERING_ACQUIRE);
+    _pone_work_deque_load(array, t, data);
+    if (!_pone_atomic_compare_exchange_n(&deque->top, &t, t + 1, 0,
+                                         PONE_MEMORY_ORDERING_SEQ_CST,
+                                         PONE_MEMORY_ORDERING_RELAXED)) {
+        return PONE_WORK_DEQUE_STEAL_RESULT_ABORT;
+    }
+
+    return PONE_WORK_DEQUE_STEAL_RESULT_SUCCESS;
+}